@@ -0,0 +1,1328 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include "expressao.h"
+
+/*
+ * Benchmarks do avaliador de expressões.
+ *
+ * Compilação (junto com expressao.exe):
+ *   gcc -O2 expressao.c benchmark.c -o benchmark.exe -lm -lpthread
+ * Com contagem de alocações (ld do GNU):
+ *   gcc -O2 -DCONTAR_ALOCACOES expressao.c benchmark.c -o benchmark.exe -lm -lpthread \
+ *       -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc
+ * Uso: benchmark.exe [--json arquivo] [--semente N] [num_termos]
+ *
+ * A suíte de cargas geradas mede getValorPosFixa, getFormaInFixa e os
+ * avaliadores em float, double e long double sobre expressões pós-fixas
+ * válidas sorteadas com tamanho, profundidade e mistura de operadores
+ * controlados, e grava os resultados em JSON para comparação entre versões.
+ * As seções seguintes medem partes específicas (conversão infixa, análise
+ * léxica, cache, erros, funções rápidas, código nativo do JIT, avaliação
+ * incremental, avaliação em fluxo, biblioteca binária, caminho inteiro,
+ * expressão completa em uma passada, avaliação paralela de uma expressão e
+ * otimização de programas compilados).
+ */
+
+// Gerador pseudoaleatório com semente fixa (xorshift32), para entradas reproduzíveis
+unsigned int estado_aleatorio = 2463534242u;
+
+unsigned int proximo_aleatorio(void) {
+    estado_aleatorio ^= estado_aleatorio << 13;
+    estado_aleatorio ^= estado_aleatorio >> 17;
+    estado_aleatorio ^= estado_aleatorio << 5;
+    return estado_aleatorio;
+}
+
+#define EH_DIGITO_BENCHMARK(c) ((c) >= '0' && (c) <= '9')
+
+// Tempo monotônico em segundos
+double agora(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// =================================================================================
+// CONTAGEM DE ALOCAÇÕES
+// =================================================================================
+
+// Alocações feitas desde o início (biblioteca e benchmark)
+unsigned long long num_alocacoes = 0;
+
+#ifdef CONTAR_ALOCACOES
+// Com -Wl,--wrap=..., as chamadas a malloc/calloc/realloc chegam aqui
+void *__real_malloc(size_t tamanho);
+void *__real_calloc(size_t quantidade, size_t tamanho);
+void *__real_realloc(void *ptr, size_t tamanho);
+
+void *__wrap_malloc(size_t tamanho) {
+    __atomic_fetch_add(&num_alocacoes, 1, __ATOMIC_RELAXED);
+    return __real_malloc(tamanho);
+}
+
+void *__wrap_calloc(size_t quantidade, size_t tamanho) {
+    __atomic_fetch_add(&num_alocacoes, 1, __ATOMIC_RELAXED);
+    return __real_calloc(quantidade, tamanho);
+}
+
+void *__wrap_realloc(void *ptr, size_t tamanho) {
+    __atomic_fetch_add(&num_alocacoes, 1, __ATOMIC_RELAXED);
+    return __real_realloc(ptr, tamanho);
+}
+#define ALOCACOES_CONTADAS 1
+#else
+#define ALOCACOES_CONTADAS 0
+#endif
+
+// =================================================================================
+// GERADOR DE CARGAS
+// =================================================================================
+
+// Parâmetros de uma carga de expressões pós-fixas sorteadas
+typedef struct {
+    const char *nome;
+    int num_expressoes;
+    int num_operandos;         // Números por expressão (tamanho)
+    int profundidade_maxima;   // Altura máxima da árvore (profundidade)
+    int pesos[NUM_OPCODES];    // Peso de cada operador e função no sorteio (mistura)
+} CargaTrabalho;
+
+// Texto que cresce conforme os tokens são acrescentados
+typedef struct {
+    char *dados;
+    size_t usado;
+    size_t capacidade;
+    long num_tokens;
+} TextoGerado;
+
+int anexar_token(TextoGerado *texto, const char *token) {
+    size_t tamanho = strlen(token);
+    if (texto->usado + tamanho + 2 > texto->capacidade) {
+        size_t nova_capacidade = (texto->capacidade + tamanho + 2) * 2;
+        char *novo = (char *)realloc(texto->dados, nova_capacidade);
+        if (novo == NULL) {
+            return 0;
+        }
+        texto->dados = novo;
+        texto->capacidade = nova_capacidade;
+    }
+    if (texto->usado > 0) {
+        texto->dados[texto->usado++] = ' ';
+    }
+    memcpy(texto->dados + texto->usado, token, tamanho + 1);
+    texto->usado += tamanho;
+    texto->num_tokens++;
+    return 1;
+}
+
+// Texto de cada opcode na forma pós-fixa
+const char *token_do_opcode(Opcode op) {
+    static const char *textos[NUM_OPCODES] = {
+        "", "", "+", "-", "*", "/", "%", "^", "raiz", "sen", "cos", "tg", "log"
+    };
+    return textos[op];
+}
+
+// Maior número de operandos que cabe em uma árvore binária de altura 'profundidade'
+long capacidade_profundidade(int profundidade) {
+    return (profundidade >= 31) ? 0x40000000L : (1L << (profundidade - 1));
+}
+
+// Sorteia um opcode entre os pesos de [primeiro, ultimo]; NUM_OPCODES se todos forem 0
+Opcode sortear_opcode(const CargaTrabalho *carga, Opcode primeiro, Opcode ultimo) {
+    int total = 0;
+    for (int op = primeiro; op <= (int)ultimo; op++) {
+        total += carga->pesos[op];
+    }
+    if (total == 0) {
+        return NUM_OPCODES;
+    }
+    int r = (int)(proximo_aleatorio() % (unsigned int)total);
+    for (int op = primeiro; op <= (int)ultimo; op++) {
+        r -= carga->pesos[op];
+        if (r < 0) {
+            return (Opcode)op;
+        }
+    }
+    return NUM_OPCODES;
+}
+
+int gerar_subexpressao(const CargaTrabalho *carga, long num_operandos, int profundidade, TextoGerado *texto);
+
+/*
+ * gerar_no
+ * --------
+ * Escreve em pós-fixa uma subárvore com exatamente num_operandos números e
+ * altura no máximo 'profundidade'. Cada nó sorteia, pelos pesos da carga,
+ * entre um operador binário (os operandos são divididos entre os dois lados
+ * respeitando a altura) e uma função unária (quando ainda cabe um nível).
+ */
+int gerar_no(const CargaTrabalho *carga, long num_operandos, int profundidade, TextoGerado *texto) {
+    int peso_binarios = 0, peso_funcoes = 0;
+    for (int op = OP_SOMA; op <= OP_POTENCIA; op++) peso_binarios += carga->pesos[op];
+    for (int op = OP_RAIZ; op <= OP_LOGARITMO; op++) peso_funcoes += carga->pesos[op];
+
+    int pode_binario = (num_operandos > 1 && peso_binarios > 0);
+    int pode_funcao = (profundidade > 1 && peso_funcoes > 0 &&
+                       num_operandos <= capacidade_profundidade(profundidade - 1));
+    if (num_operandos == 1) {
+        // Folha, possivelmente dentro de uma função
+        if (pode_funcao && (int)(proximo_aleatorio() % (unsigned int)(peso_binarios + peso_funcoes)) < peso_funcoes) {
+            Opcode funcao = sortear_opcode(carga, OP_RAIZ, OP_LOGARITMO);
+            return gerar_subexpressao(carga, 1, profundidade - 1, texto) &&
+                   anexar_token(texto, token_do_opcode(funcao));
+        }
+        char numero[16];
+        unsigned int a = proximo_aleatorio() % 999 + 1;
+        if (proximo_aleatorio() % 4 == 0) {
+            snprintf(numero, sizeof(numero), "%u.%u", a, proximo_aleatorio() % 10);
+        } else {
+            snprintf(numero, sizeof(numero), "%u", a);
+        }
+        return anexar_token(texto, numero);
+    }
+
+    if (!pode_binario || (pode_funcao && (int)(proximo_aleatorio() % (unsigned int)(peso_binarios + peso_funcoes)) < peso_funcoes)) {
+        Opcode funcao = sortear_opcode(carga, OP_RAIZ, OP_LOGARITMO);
+        return gerar_subexpressao(carga, num_operandos, profundidade - 1, texto) &&
+               anexar_token(texto, token_do_opcode(funcao));
+    }
+
+    // Divide os operandos de modo que cada lado caiba em profundidade - 1
+    long limite = capacidade_profundidade(profundidade - 1);
+    long minimo = (num_operandos - limite > 1) ? num_operandos - limite : 1;
+    long maximo = (num_operandos - 1 < limite) ? num_operandos - 1 : limite;
+    long esquerdo = minimo + (long)(proximo_aleatorio() % (unsigned long)(maximo - minimo + 1));
+    Opcode op = sortear_opcode(carga, OP_SOMA, OP_POTENCIA);
+    return gerar_subexpressao(carga, esquerdo, profundidade - 1, texto) &&
+           gerar_subexpressao(carga, num_operandos - esquerdo, profundidade - 1, texto) &&
+           anexar_token(texto, token_do_opcode(op));
+}
+
+/*
+ * gerar_subexpressao
+ * ------------------
+ * Gera uma subárvore com gerar_no e a sorteia de novo enquanto seu valor for
+ * inválido ou grande demais. Em pós-fixa a subárvore é um trecho contíguo no
+ * fim do texto, então basta avaliá-lo e, se for rejeitado, truncar o texto.
+ * Limitar o valor de cada subárvore evita que expressões longas estourem para
+ * infinito e terminem em NaN.
+ */
+int gerar_subexpressao(const CargaTrabalho *carga, long num_operandos, int profundidade, TextoGerado *texto) {
+    size_t usado = texto->usado;
+    long num_tokens = texto->num_tokens;
+    size_t inicio = (usado > 0) ? usado + 1 : 0; // Pula o espaço separador
+
+    for (int tentativa = 0; ; tentativa++) {
+        if (!gerar_no(carga, num_operandos, profundidade, texto)) {
+            return 0;
+        }
+        ErroExpressao erro;
+        float valor = getValorPosFixaComErro(texto->dados + inicio, &erro);
+        if ((erro.codigo == ERRO_NENHUM && fabsf(valor) <= 1e6f) || tentativa == 20) {
+            return 1;
+        }
+        texto->usado = usado;
+        texto->num_tokens = num_tokens;
+        texto->dados[usado] = '\0';
+    }
+}
+
+// Sorteia uma expressão válida (sem erro de avaliação); NULL se faltar memória
+char *gerar_posfixa(const CargaTrabalho *carga, long *num_tokens) {
+    int profundidade = carga->profundidade_maxima;
+    while (capacidade_profundidade(profundidade) < carga->num_operandos) {
+        profundidade++;
+    }
+    for (int tentativa = 0; ; tentativa++) {
+        TextoGerado texto = {NULL, 0, 0, 0};
+        if (!gerar_subexpressao(carga, carga->num_operandos, profundidade, &texto)) {
+            free(texto.dados);
+            return NULL;
+        }
+        ErroExpressao erro;
+        getValorPosFixaComErro(texto.dados, &erro);
+        if (erro.codigo == ERRO_NENHUM || tentativa == 100) {
+            *num_tokens = texto.num_tokens;
+            return texto.dados;
+        }
+        free(texto.dados);
+    }
+}
+
+// =================================================================================
+// SUÍTE DE CARGAS
+// =================================================================================
+
+typedef struct {
+    double ns_por_expressao;
+    double tokens_por_segundo;
+    double alocacoes_por_chamada; // Negativo quando a contagem está desligada
+} Medida;
+
+// Funções medidas pela suíte, na ordem de chamar_funcao
+static const char *nomes_funcoes[] = {
+    "getValorPosFixa", "getFormaInFixa", "getValorPosFixaFloat", "getValorPosFixaDouble",
+    "getValorPosFixaLongDouble"
+};
+#define NUM_FUNCOES_CARGA 5
+
+// Chama uma das funções públicas sobre a expressão (liberando a infixa)
+float chamar_funcao(int funcao, char *expressao) {
+    ErroExpressao erro;
+    switch (funcao) {
+        case 0:
+            return getValorPosFixa(expressao);
+        case 1: {
+            char *infixa = getFormaInFixa(expressao);
+            float tamanho = (infixa != NULL) ? (float)strlen(infixa) : 0.0f;
+            free(infixa);
+            return tamanho;
+        }
+        case 2:
+            return getValorPosFixaFloat(expressao, &erro);
+        case 3:
+            return (float)getValorPosFixaDouble(expressao, &erro);
+        default:
+            return (float)getValorPosFixaLongDouble(expressao, &erro);
+    }
+}
+
+/*
+ * medir_carga
+ * -----------
+ * Execução única: cada expressão é processada uma vez, na ordem, com dados e
+ * caches ainda frios. Execução repetida: cada expressão é aquecida e então
+ * processada 'repeticoes' vezes seguidas.
+ */
+void medir_carga(int funcao, char **expressoes, const long *tokens, int num_expressoes,
+                 int repeticoes, Medida *unica, Medida *repetida) {
+    double soma = 0.0;
+    long total_tokens = 0;
+    for (int i = 0; i < num_expressoes; i++) {
+        total_tokens += tokens[i];
+    }
+
+    unsigned long long alocacoes = num_alocacoes;
+    double inicio = agora();
+    for (int i = 0; i < num_expressoes; i++) {
+        soma += chamar_funcao(funcao, expressoes[i]);
+    }
+    double tempo = agora() - inicio;
+    unica->ns_por_expressao = tempo / num_expressoes * 1e9;
+    unica->tokens_por_segundo = total_tokens / tempo;
+    unica->alocacoes_por_chamada = ALOCACOES_CONTADAS ? (double)(num_alocacoes - alocacoes) / num_expressoes : -1.0;
+
+    tempo = 0.0;
+    alocacoes = 0;
+    for (int i = 0; i < num_expressoes; i++) {
+        soma += chamar_funcao(funcao, expressoes[i]);
+        unsigned long long antes = num_alocacoes;
+        inicio = agora();
+        for (int r = 0; r < repeticoes; r++) {
+            soma += chamar_funcao(funcao, expressoes[i]);
+        }
+        tempo += agora() - inicio;
+        alocacoes += num_alocacoes - antes;
+    }
+    double chamadas = (double)num_expressoes * repeticoes;
+    repetida->ns_por_expressao = tempo / chamadas * 1e9;
+    repetida->tokens_por_segundo = (double)total_tokens * repeticoes / tempo;
+    repetida->alocacoes_por_chamada = ALOCACOES_CONTADAS ? alocacoes / chamadas : -1.0;
+
+    if (soma == 12345.678) {
+        printf(" "); // Impede que o compilador descarte as chamadas
+    }
+}
+
+void escrever_medida_json(FILE *json, const char *nome, const Medida *m, int ultima) {
+    fprintf(json, "        \"%s\": {\"ns_por_expressao\": %.1f, \"tokens_por_segundo\": %.0f, ", nome,
+            m->ns_por_expressao, m->tokens_por_segundo);
+    if (m->alocacoes_por_chamada < 0) {
+        fprintf(json, "\"alocacoes_por_chamada\": null}%s\n", ultima ? "" : ",");
+    } else {
+        fprintf(json, "\"alocacoes_por_chamada\": %.2f}%s\n", m->alocacoes_por_chamada, ultima ? "" : ",");
+    }
+}
+
+// Executa todas as cargas; grava o JSON em 'json' se não for NULL. Uma carga que
+// não pôde ser gerada (falta de memória) fica fora do JSON, que continua válido.
+void benchmark_cargas(FILE *json, unsigned int semente) {
+    // Pesos na ordem dos opcodes: -, -, + - * / % ^, raiz sen cos tg log
+    static const CargaTrabalho cargas[] = {
+        {"curta_aritmetica", 20000, 8, 6, {0, 0, 4, 4, 4, 2, 0, 0, 0, 0, 0, 0, 0}},
+        {"media_mista", 4000, 64, 12, {0, 0, 4, 4, 4, 2, 1, 1, 1, 1, 1, 1, 1}},
+        {"funcoes", 4000, 32, 24, {0, 0, 2, 2, 2, 1, 0, 0, 3, 3, 3, 3, 3}},
+        {"longa_balanceada", 300, 1024, 11, {0, 0, 4, 4, 4, 2, 1, 1, 1, 1, 1, 1, 1}},
+        {"longa_profunda", 300, 1024, 512, {0, 0, 4, 4, 4, 2, 1, 1, 1, 1, 1, 1, 1}}
+    };
+    int num_cargas = (int)(sizeof(cargas) / sizeof(cargas[0]));
+    int cargas_escritas = 0; // A vírgula vai antes de cada carga, depois da primeira
+
+    estado_aleatorio = (semente != 0) ? semente : 2463534242u;
+    printf("Cargas geradas (semente %u, alocacoes %s):\n", estado_aleatorio,
+           ALOCACOES_CONTADAS ? "contadas" : "nao contadas");
+    if (json != NULL) {
+        fprintf(json, "{\n  \"semente\": %u,\n  \"alocacoes_contadas\": %s,\n  \"cargas\": [\n",
+                estado_aleatorio, ALOCACOES_CONTADAS ? "true" : "false");
+    }
+
+    for (int c = 0; c < num_cargas; c++) {
+        const CargaTrabalho *carga = &cargas[c];
+        char **expressoes = (char **)calloc(carga->num_expressoes, sizeof(char *));
+        long *tokens = (long *)calloc(carga->num_expressoes, sizeof(long));
+        long total_tokens = 0;
+        if (expressoes == NULL || tokens == NULL) {
+            fprintf(stderr, "Erro de alocacao de memoria.\n");
+            free(expressoes);
+            free(tokens);
+            break;
+        }
+        for (int i = 0; i < carga->num_expressoes; i++) {
+            expressoes[i] = gerar_posfixa(carga, &tokens[i]);
+            if (expressoes[i] == NULL) {
+                fprintf(stderr, "Erro de alocacao de memoria.\n");
+                carga = NULL;
+                break;
+            }
+            total_tokens += tokens[i];
+        }
+
+        if (carga != NULL) {
+            // Cerca de 2 milhões de tokens na execução repetida
+            int repeticoes = (int)(2000000 / total_tokens) + 1;
+            double tokens_medios = (double)total_tokens / carga->num_expressoes;
+            printf("  %-18s %6d expressoes, %7.1f tokens/expressao, profundidade <= %d\n",
+                   carga->nome, carga->num_expressoes, tokens_medios, carga->profundidade_maxima);
+            if (json != NULL) {
+                fprintf(json, "%s    {\n      \"nome\": \"%s\",\n      \"num_expressoes\": %d,\n"
+                              "      \"num_operandos\": %d,\n      \"profundidade_maxima\": %d,\n"
+                              "      \"tokens_medios\": %.1f,\n      \"repeticoes\": %d,\n",
+                        (cargas_escritas > 0) ? ",\n" : "", carga->nome, carga->num_expressoes, carga->num_operandos,
+                        carga->profundidade_maxima, tokens_medios, repeticoes);
+            }
+            for (int f = 0; f < NUM_FUNCOES_CARGA; f++) {
+                Medida unica, repetida;
+                medir_carga(f, expressoes, tokens, carga->num_expressoes, repeticoes, &unica, &repetida);
+                printf("    %-25s unica %9.1f ns/expr %7.2f Mtokens/s | repetida %9.1f ns/expr %7.2f Mtokens/s",
+                       nomes_funcoes[f], unica.ns_por_expressao, unica.tokens_por_segundo / 1e6,
+                       repetida.ns_por_expressao, repetida.tokens_por_segundo / 1e6);
+                if (ALOCACOES_CONTADAS) {
+                    printf(" | %.2f alocacoes/chamada", repetida.alocacoes_por_chamada);
+                }
+                printf("\n");
+                if (json != NULL) {
+                    fprintf(json, "      \"%s\": {\n", nomes_funcoes[f]);
+                    escrever_medida_json(json, "unica", &unica, 0);
+                    escrever_medida_json(json, "repetida", &repetida, 1);
+                    fprintf(json, "      }%s\n", (f + 1 < NUM_FUNCOES_CARGA) ? "," : "");
+                }
+            }
+            if (json != NULL) {
+                fprintf(json, "    }");
+                cargas_escritas++;
+            }
+        }
+
+        for (int i = 0; i < cargas[c].num_expressoes; i++) {
+            free(expressoes[i]);
+        }
+        free(expressoes);
+        free(tokens);
+    }
+    if (json != NULL) {
+        fprintf(json, "%s  ]\n}\n", (cargas_escritas > 0) ? "\n" : "");
+    }
+}
+
+/*
+ * gerar_infixa_grande
+ * -------------------
+ * Gera uma expressão infixa com num_termos termos ligados por operadores
+ * binários. Alguns termos são sub-expressões entre parênteses ou chamadas de
+ * função, e alguns números têm parte decimal.
+ *
+ * Retorno:
+ * - String alocada dinamicamente; *num_tokens recebe a quantidade de tokens.
+ */
+char *gerar_infixa_grande(long num_termos, long *num_tokens) {
+    static const char operadores[] = "+-*/+-*";
+    static const char *funcoes[] = {"raiz", "sen", "cos", "tg", "log"};
+    char *texto = (char *)malloc(num_termos * 32 + 1);
+    char *p = texto;
+    long tokens = 0;
+
+    if (texto == NULL) {
+        return NULL;
+    }
+    for (long i = 0; i < num_termos; i++) {
+        if (i > 0) {
+            *p++ = operadores[proximo_aleatorio() % 7];
+            tokens++;
+        }
+        unsigned int tipo = proximo_aleatorio() % 8;
+        unsigned int a = proximo_aleatorio() % 1000 + 1;
+        unsigned int b = proximo_aleatorio() % 100 + 1;
+        if (tipo == 0) {
+            p += sprintf(p, "(%u+%u.%u)", a, b, a % 10);
+            tokens += 3;
+        } else if (tipo == 1) {
+            p += sprintf(p, "%s(%u)", funcoes[a % 5], b);
+            tokens += 2;
+        } else if (tipo == 2) {
+            p += sprintf(p, "%u^2", b % 10);
+            tokens += 3;
+        } else {
+            p += sprintf(p, "%u", a);
+            tokens++;
+        }
+    }
+    *p = '\0';
+    *num_tokens = tokens;
+    return texto;
+}
+
+// Mede a conversão infixa -> pós-fixa (programa compilado e texto canônico)
+void benchmark_infixa(long num_termos) {
+    long num_tokens;
+    char *infixa = gerar_infixa_grande(num_termos, &num_tokens);
+    if (infixa == NULL) {
+        fprintf(stderr, "Erro de alocacao de memoria.\n");
+        return;
+    }
+    size_t bytes = strlen(infixa);
+    printf("Infixa -> pos-fixa: %ld tokens, %zu bytes\n", num_tokens, bytes);
+
+    ProgramaPosFixa programa;
+    double inicio = agora();
+    int ok = compilarInFixa(infixa, &programa);
+    double tempo = agora() - inicio;
+    if (ok) {
+        printf("  compilarInFixa : %8.3f ms  %8.2f Mtokens/s  %8.2f MB/s\n",
+               tempo * 1e3, num_tokens / tempo / 1e6, bytes / tempo / 1e6);
+        liberarPrograma(&programa);
+    }
+
+    inicio = agora();
+    char *posFixa = getFormaPosFixa(infixa);
+    tempo = agora() - inicio;
+    if (posFixa != NULL) {
+        printf("  getFormaPosFixa: %8.3f ms  %8.2f Mtokens/s  %8.2f MB/s\n",
+               tempo * 1e3, num_tokens / tempo / 1e6, bytes / tempo / 1e6);
+        free(posFixa);
+    }
+    free(infixa);
+}
+
+// Mede o analisador léxico pós-fixo sozinho e a compilação que depende dele
+void benchmark_lexico(long num_termos) {
+    long num_tokens_infixa;
+    char *infixa = gerar_infixa_grande(num_termos, &num_tokens_infixa);
+    char *posFixa = (infixa != NULL) ? getFormaPosFixa(infixa) : NULL;
+    free(infixa);
+    if (posFixa == NULL) {
+        fprintf(stderr, "Erro de alocacao de memoria.\n");
+        return;
+    }
+    size_t bytes = strlen(posFixa);
+
+    AnalisadorLexico lexico;
+    Token token;
+    long num_tokens = 0;
+    double soma = 0.0; // Impede que o compilador descarte a conversão dos números
+    double inicio = agora();
+    iniciarAnalisadorLexico(&lexico, posFixa);
+    while (proximoToken(&lexico, &token) != TOKEN_FIM) {
+        soma += token.valor;
+        num_tokens++;
+    }
+    double tempo = agora() - inicio;
+    printf("Lexico pos-fixo: %ld tokens, %zu bytes (soma %g)\n", num_tokens, bytes, soma);
+    printf("  proximoToken   : %8.3f ms  %8.2f Mtokens/s  %8.2f MB/s\n",
+           tempo * 1e3, num_tokens / tempo / 1e6, bytes / tempo / 1e6);
+
+    ProgramaPosFixa programa;
+    inicio = agora();
+    int ok = compilarPosFixa(posFixa, &programa);
+    tempo = agora() - inicio;
+    if (ok) {
+        printf("  compilarPosFixa: %8.3f ms  %8.2f Mtokens/s  %8.2f MB/s\n",
+               tempo * 1e3, num_tokens / tempo / 1e6, bytes / tempo / 1e6);
+        liberarPrograma(&programa);
+    }
+
+    free(posFixa);
+}
+
+// Mede consultas repetidas de um conjunto pequeno de expressões, com e sem cache
+void benchmark_cache(void) {
+    enum { NUM_EXPRESSOES = 1000, NUM_CONSULTAS = 200000 };
+    char *expressoes[NUM_EXPRESSOES];
+    for (int i = 0; i < NUM_EXPRESSOES; i++) {
+        long num_tokens;
+        char *infixa = gerar_infixa_grande(4 + proximo_aleatorio() % 8, &num_tokens);
+        expressoes[i] = (infixa != NULL) ? getFormaPosFixa(infixa) : NULL;
+        free(infixa);
+        if (expressoes[i] == NULL) {
+            fprintf(stderr, "Erro de alocacao de memoria.\n");
+            return;
+        }
+        // Só expressões sem erro: o caminho de erro sempre reavalia para imprimir as mensagens
+        ProgramaPosFixa programa;
+        if (compilarPosFixa(expressoes[i], &programa)) {
+            int valida = !isnan(avaliarPrograma(&programa));
+            liberarPrograma(&programa);
+            if (!valida) {
+                free(expressoes[i]);
+                i--;
+            }
+        }
+    }
+    // Índices concentrados nas primeiras expressões, como um tráfego repetitivo
+    int *ordem = (int *)malloc(NUM_CONSULTAS * sizeof(int));
+    if (ordem == NULL) {
+        return;
+    }
+    for (int i = 0; i < NUM_CONSULTAS; i++) {
+        unsigned int r = proximo_aleatorio() % NUM_EXPRESSOES;
+        ordem[i] = (int)(r * r / NUM_EXPRESSOES);
+    }
+
+    printf("Cache (%d expressoes, %d consultas):\n", NUM_EXPRESSOES, NUM_CONSULTAS);
+    double soma = 0.0;
+    double inicio = agora();
+    for (int i = 0; i < NUM_CONSULTAS; i++) {
+        soma += getValorPosFixa(expressoes[ordem[i]]);
+        free(getFormaInFixa(expressoes[ordem[i]]));
+    }
+    double tempo = agora() - inicio;
+    printf("  sem cache      : %8.1f ns/expr\n", tempo / NUM_CONSULTAS * 1e9);
+
+    // Capacidade e tamanho mínimo de subexpressão (0 = só expressões inteiras)
+    struct { size_t capacidade; int minimo; } configuracoes[] = {
+        {64, 0}, {64, 3}, {256, 0}, {256, 3}, {4096, 0}, {4096, 3}
+    };
+    for (size_t c = 0; c < sizeof(configuracoes) / sizeof(configuracoes[0]); c++) {
+        CacheExpressoes *cache = criarCacheExpressoes(configuracoes[c].capacidade, configuracoes[c].minimo);
+        if (cache == NULL) {
+            break;
+        }
+        inicio = agora();
+        for (int i = 0; i < NUM_CONSULTAS; i++) {
+            soma += getValorPosFixaCache(cache, expressoes[ordem[i]]);
+            free(getFormaInFixaCache(cache, expressoes[ordem[i]]));
+        }
+        tempo = agora() - inicio;
+        EstatisticasCache e;
+        obterEstatisticasCache(cache, &e);
+        printf("  cache %4zu/%d   : %8.1f ns/expr  acertos %5.1f%%  subexpressoes %7llu  remocoes %7llu\n",
+               configuracoes[c].capacidade, configuracoes[c].minimo, tempo / NUM_CONSULTAS * 1e9,
+               100.0 * e.acertos / (e.acertos + e.faltas), e.acertos_subarvores, e.remocoes);
+        destruirCacheExpressoes(cache);
+    }
+    printf("  (soma %g)\n", soma);
+
+    free(ordem);
+    for (int i = 0; i < NUM_EXPRESSOES; i++) {
+        free(expressoes[i]);
+    }
+}
+
+// Mede entradas inválidas com mensagens em stderr e com o canal de erros sem E/S
+void benchmark_erros(void) {
+    enum { NUM_CONSULTAS = 100000 };
+    const char *invalidas[] = {"5 0 /", "1 x +", "3 4 + +", "0 log 2 *"};
+    double soma = 0.0;
+
+    printf("Entradas invalidas (%d consultas):\n", NUM_CONSULTAS);
+    double inicio = agora();
+    for (int i = 0; i < NUM_CONSULTAS; i++) {
+        soma += getValorPosFixa((char *)invalidas[i % 4]);
+    }
+    double tempo = agora() - inicio;
+    printf("  getValorPosFixa       : %8.1f ns/expr (mensagens em stderr)\n", tempo / NUM_CONSULTAS * 1e9);
+
+    inicio = agora();
+    for (int i = 0; i < NUM_CONSULTAS; i++) {
+        ErroExpressao erro;
+        soma += getValorPosFixaComErro(invalidas[i % 4], &erro);
+    }
+    tempo = agora() - inicio;
+    printf("  getValorPosFixaComErro: %8.1f ns/expr (soma %g)\n", tempo / NUM_CONSULTAS * 1e9, soma);
+}
+
+// Funções exatas x aproximadas (CALCULO_RAPIDO), uma linha por valor e em lote
+void benchmark_funcoes_rapidas(void) {
+    enum { NUM_LINHAS = 1 << 20 };
+    const char *expressoes[] = {"x sen", "x cos", "x tg", "x log", "x raiz"};
+    float *x = (float *)malloc(NUM_LINHAS * sizeof(float));
+    float *saida = (float *)malloc(NUM_LINHAS * sizeof(float));
+    if (x == NULL || saida == NULL) {
+        fprintf(stderr, "Erro de alocacao de memoria.\n");
+        free(x);
+        free(saida);
+        return;
+    }
+    for (int i = 0; i < NUM_LINHAS; i++) {
+        x[i] = (float)(proximo_aleatorio() % 3600000) / 1000.0f + 0.001f; // (0, 3600] graus
+    }
+
+    printf("Funcoes exatas x rapidas (%d linhas, ns/linha):\n", NUM_LINHAS);
+    printf("  %-8s %10s %10s %10s %10s\n", "", "exata", "rapida", "lote exata", "lote rapida");
+    for (size_t e = 0; e < sizeof(expressoes) / sizeof(expressoes[0]); e++) {
+        ProgramaPosFixa programa;
+        if (!compilarPosFixa(expressoes[e], &programa)) {
+            continue;
+        }
+        double tempos[4];
+        double soma = 0.0;
+        for (int modo = 0; modo < 2; modo++) {
+            programa.modo = (modo == 0) ? CALCULO_EXATO : CALCULO_RAPIDO;
+            double inicio = agora();
+            for (int i = 0; i < NUM_LINHAS; i++) {
+                soma += avaliarProgramaComVariaveis(&programa, &x[i]);
+            }
+            tempos[modo] = agora() - inicio;
+
+            const float *colunas[1] = {x};
+            inicio = agora();
+            avaliarProgramaEmLote(&programa, colunas, NUM_LINHAS, saida);
+            tempos[2 + modo] = agora() - inicio;
+            soma += saida[NUM_LINHAS - 1];
+        }
+        printf("  %-8s %10.2f %10.2f %10.2f %10.2f  (soma %g)\n", expressoes[e],
+               tempos[0] / NUM_LINHAS * 1e9, tempos[1] / NUM_LINHAS * 1e9,
+               tempos[2] / NUM_LINHAS * 1e9, tempos[3] / NUM_LINHAS * 1e9, soma);
+        liberarPrograma(&programa);
+    }
+    free(x);
+    free(saida);
+}
+
+// Código nativo (ativarJit) x interpretador x texto, por avaliação de uma expressão com x e y
+void benchmark_jit(void) {
+    enum { NUM_LINHAS = 1 << 20, NUM_TEXTO = 1 << 18 };
+    // Cada expressão com variáveis e a mesma com x = 1.5 e y = 2.25 (caminho do texto)
+    const char *expressoes[][2] = {
+        {"x y * x + y x - / 3 *", "1.5 2.25 * 1.5 + 2.25 1.5 - / 3 *"},
+        {"x x * 3 * x 2 * + 1 - y y * 0.5 * -", "1.5 1.5 * 3 * 1.5 2 * + 1 - 2.25 2.25 * 0.5 * -"},
+        {"x 1 + x 2 + x 3 + x 4 + x 5 + * * * * y /", "1.5 1 + 1.5 2 + 1.5 3 + 1.5 4 + 1.5 5 + * * * * 2.25 /"},
+        {"x sen y cos * x y ^ + x raiz +", "1.5 sen 2.25 cos * 1.5 2.25 ^ + 1.5 raiz +"}
+    };
+    float *x = (float *)malloc(NUM_LINHAS * sizeof(float));
+    float *y = (float *)malloc(NUM_LINHAS * sizeof(float));
+    if (x == NULL || y == NULL) {
+        fprintf(stderr, "Erro de alocacao de memoria.\n");
+        free(x);
+        free(y);
+        return;
+    }
+    for (int i = 0; i < NUM_LINHAS; i++) {
+        x[i] = (float)(proximo_aleatorio() % 100000) / 1000.0f;
+        y[i] = (float)(proximo_aleatorio() % 10000) / 1000.0f + 0.0005f; // Nunca igual a x
+    }
+
+    printf("JIT x interpretador x texto (ns/avaliacao, JIT %s):\n", jitDisponivel() ? "disponivel" : "indisponivel");
+    printf("  %-40s %10s %10s %10s\n", "", "texto", "programa", "jit");
+    for (size_t e = 0; e < sizeof(expressoes) / sizeof(expressoes[0]); e++) {
+        ProgramaPosFixa programa;
+        if (!compilarPosFixa(expressoes[e][0], &programa)) {
+            continue;
+        }
+        int ix = obterIndiceVariavel(&programa, "x");
+        int iy = obterIndiceVariavel(&programa, "y");
+        double tempos[3];
+        double soma = 0.0;
+
+        double inicio = agora();
+        for (int i = 0; i < NUM_TEXTO; i++) {
+            soma += getValorPosFixa((char *)expressoes[e][1]);
+        }
+        tempos[0] = (agora() - inicio) / NUM_TEXTO;
+
+        for (int nativo = 0; nativo < 2; nativo++) {
+            if (nativo && !ativarJit(&programa)) {
+                tempos[2] = NAN;
+                break;
+            }
+            float valores[2];
+            inicio = agora();
+            for (int i = 0; i < NUM_LINHAS; i++) {
+                valores[ix] = x[i];
+                valores[iy] = y[i];
+                soma += avaliarProgramaComVariaveis(&programa, valores);
+            }
+            tempos[1 + nativo] = (agora() - inicio) / NUM_LINHAS;
+        }
+        printf("  %-40s %10.2f %10.2f %10.2f  (soma %g)\n", expressoes[e][0],
+               tempos[0] * 1e9, tempos[1] * 1e9, tempos[2] * 1e9, soma);
+        liberarPrograma(&programa);
+    }
+    free(x);
+    free(y);
+}
+
+// Anexa a forma pós-fixa de uma árvore balanceada sobre as entradas [inicio, fim): produtos
+// de pares nas folhas e somas e subtrações acima. Com 'variaveis', as entradas são x<i>;
+// sem, o número 1.5 (o texto que getValorPosFixa recalcularia a cada mudança).
+int gerar_arvore_entradas(TextoGerado *texto, int inicio, int fim, int variaveis) {
+    if (fim - inicio == 1) {
+        char token[32];
+        if (variaveis) {
+            snprintf(token, sizeof(token), "x%d", inicio);
+        } else {
+            snprintf(token, sizeof(token), "1.5");
+        }
+        return anexar_token(texto, token);
+    }
+    int meio = (inicio + fim) / 2;
+    return gerar_arvore_entradas(texto, inicio, meio, variaveis) &&
+           gerar_arvore_entradas(texto, meio, fim, variaveis) &&
+           anexar_token(texto, (fim - inicio == 2) ? "*" : (inicio / (fim - inicio)) % 2 ? "-" : "+");
+}
+
+// Atualização incremental (isolada e em lotes) x reavaliação completa x texto
+void benchmark_incremental(void) {
+    enum { NUM_ENTRADAS = 1 << 16, NUM_ATUALIZACOES = 100000, TAMANHO_LOTE = 64 };
+    TextoGerado texto = {NULL, 0, 0, 0};
+    TextoGerado numeros = {NULL, 0, 0, 0};
+    float *entradas = (float *)malloc(NUM_ENTRADAS * sizeof(float));
+    ProgramaPosFixa programa;
+    AvaliacaoIncremental *avaliacao = NULL;
+    if (entradas == NULL || !gerar_arvore_entradas(&texto, 0, NUM_ENTRADAS, 1) ||
+        !gerar_arvore_entradas(&numeros, 0, NUM_ENTRADAS, 0) || !compilarPosFixa(texto.dados, &programa)) {
+        fprintf(stderr, "Erro de alocacao de memoria.\n");
+        free(texto.dados);
+        free(numeros.dados);
+        free(entradas);
+        return;
+    }
+    for (int i = 0; i < NUM_ENTRADAS; i++) {
+        entradas[i] = 1.5f;
+    }
+    avaliacao = criarAvaliacaoIncremental(texto.dados, entradas);
+    if (avaliacao == NULL) {
+        fprintf(stderr, "Erro de alocacao de memoria.\n");
+        liberarPrograma(&programa);
+        free(texto.dados);
+        free(numeros.dados);
+        free(entradas);
+        return;
+    }
+    // As entradas aparecem em ordem no texto: x<i> é a variável i
+    double soma = 0.0;
+
+    double inicio = agora();
+    for (int k = 0; k < 20; k++) {
+        soma += getValorPosFixa(numeros.dados);
+    }
+    double tempo_texto = (agora() - inicio) / 20;
+
+    inicio = agora();
+    for (int k = 0; k < 100; k++) {
+        entradas[proximo_aleatorio() % NUM_ENTRADAS] = (float)(proximo_aleatorio() % 1000) / 500.0f;
+        soma += avaliarProgramaComVariaveis(&programa, entradas);
+    }
+    double tempo_completo = (agora() - inicio) / 100;
+
+    long recalculados = 0;
+    inicio = agora();
+    for (int k = 0; k < NUM_ATUALIZACOES; k++) {
+        soma += atualizarEntradaIncremental(avaliacao, (int)(proximo_aleatorio() % NUM_ENTRADAS),
+                                            (float)(proximo_aleatorio() % 1000) / 500.0f);
+        recalculados += nosRecalculadosIncremental(avaliacao);
+    }
+    double tempo_isolada = (agora() - inicio) / NUM_ATUALIZACOES;
+
+    int indices[TAMANHO_LOTE];
+    float valores[TAMANHO_LOTE];
+    long recalculados_lote = 0;
+    inicio = agora();
+    for (int k = 0; k < NUM_ATUALIZACOES / TAMANHO_LOTE; k++) {
+        // Entradas vizinhas compartilham ancestrais, recalculados uma vez por lote
+        int base = (int)(proximo_aleatorio() % (NUM_ENTRADAS - 4 * TAMANHO_LOTE));
+        for (int j = 0; j < TAMANHO_LOTE; j++) {
+            indices[j] = base + 4 * j;
+            valores[j] = (float)(proximo_aleatorio() % 1000) / 500.0f;
+        }
+        soma += atualizarEntradasIncremental(avaliacao, indices, valores, TAMANHO_LOTE);
+        recalculados_lote += nosRecalculadosIncremental(avaliacao);
+    }
+    double tempo_lote = (agora() - inicio) / (NUM_ATUALIZACOES / TAMANHO_LOTE);
+
+    printf("Avaliacao incremental (%d entradas, %ld tokens):\n", NUM_ENTRADAS, texto.num_tokens);
+    printf("  getValorPosFixa (texto inteiro): %12.2f us\n", tempo_texto * 1e6);
+    printf("  Reavaliacao completa:            %12.2f us\n", tempo_completo * 1e6);
+    printf("  Atualizacao isolada:             %12.2f us (%.1f nos recalculados)\n", tempo_isolada * 1e6,
+           (double)recalculados / NUM_ATUALIZACOES);
+    printf("  Lote de %d entradas:             %12.2f us (%.1f nos recalculados)  (soma %g)\n", TAMANHO_LOTE,
+           tempo_lote * 1e6, (double)recalculados_lote / (NUM_ATUALIZACOES / TAMANHO_LOTE), soma);
+
+    destruirAvaliacaoIncremental(avaliacao);
+    liberarPrograma(&programa);
+    free(texto.dados);
+    free(numeros.dados);
+    free(entradas);
+}
+
+// Fonte em memória para as funções de fluxo (pedaços de até 64 KiB, como um read())
+typedef struct {
+    const char *texto;
+    size_t tamanho;
+    size_t posicao;
+} FonteMemoria;
+
+long ler_fonte_memoria(void *contexto, char *destino, size_t tamanho) {
+    FonteMemoria *fonte = (FonteMemoria *)contexto;
+    size_t n = fonte->tamanho - fonte->posicao;
+    n = (n < tamanho) ? n : tamanho;
+    memcpy(destino, fonte->texto + fonte->posicao, n);
+    fonte->posicao += n;
+    return (long)n;
+}
+
+// Avaliação e forma infixa em fluxo x funções de string, sobre uma expressão de ~32 MB
+void benchmark_fluxo(void) {
+    enum { NUM_PASSOS = 2500000 };
+    // "1 0.5 * 0.25 + 0.5 * 0.25 + ...": valor limitado, 13 bytes por passo
+    size_t tamanho = 1 + 13 * (size_t)NUM_PASSOS;
+    char *texto = (char *)malloc(tamanho + 1);
+    FILE *nulo = fopen("/dev/null", "w");
+    if (texto == NULL || nulo == NULL) {
+        fprintf(stderr, "Erro de alocacao de memoria.\n");
+        free(texto);
+        if (nulo != NULL) {
+            fclose(nulo);
+        }
+        return;
+    }
+    texto[0] = '1';
+    for (size_t i = 0; i < NUM_PASSOS; i++) {
+        memcpy(texto + 1 + 13 * i, " 0.5 * 0.25 +", 13);
+    }
+    texto[tamanho] = '\0';
+
+    ErroExpressao erro;
+    double mb = (double)tamanho / (1024.0 * 1024.0);
+    double inicio = agora();
+    float v = getValorPosFixa(texto);
+    double tempo_string = agora() - inicio;
+
+    FonteMemoria fonte = {texto, tamanho, 0};
+    inicio = agora();
+    float f = avaliarPosFixaStream(ler_fonte_memoria, &fonte, &erro);
+    double tempo_fluxo = agora() - inicio;
+
+    inicio = agora();
+    char *infixa = getFormaInFixa(texto);
+    if (infixa != NULL) {
+        fputs(infixa, nulo);
+    }
+    double tempo_infixa_string = agora() - inicio;
+    free(infixa);
+
+    fonte.posicao = 0;
+    inicio = agora();
+    int escrita = escreverInFixaStream(ler_fonte_memoria, &fonte, nulo, &erro);
+    double tempo_infixa_fluxo = agora() - inicio;
+
+    printf("Fluxo x string (%.1f MB, valor %g / %g, infixa %s):\n", mb, v, f, escrita ? "ok" : "erro");
+    printf("  getValorPosFixa:       %8.1f MB/s\n", mb / tempo_string);
+    printf("  avaliarPosFixaStream:  %8.1f MB/s\n", mb / tempo_fluxo);
+    printf("  getFormaInFixa:        %8.1f MB/s\n", mb / tempo_infixa_string);
+    printf("  escreverInFixaStream:  %8.1f MB/s\n", mb / tempo_infixa_fluxo);
+    fclose(nulo);
+    free(texto);
+}
+
+// Fórmulas inteiras: caminho int64 x as mesmas fórmulas com literais "N.0", que
+// seguem o caminho em float (pow, fmod) com os mesmos valores
+void benchmark_inteiros(void) {
+    static const char *formulas[] = {
+        "8 5 2 4 + * +",
+        "9 5 2 8 * 4 + * +",
+        "2 10 ^ 7 % 3 *",
+        "123456 789 * 1000 % 17 +",
+        "3 4 ^ 5 % 6 * 7 2 ^ -",
+        "100 7 % 3 ^ 25 5 / +"
+    };
+    enum { NUM_FORMULAS = sizeof(formulas) / sizeof(formulas[0]), REPETICOES = 500000 };
+    char reais[NUM_FORMULAS][128];
+    for (int i = 0; i < NUM_FORMULAS; i++) {
+        // Acrescenta ".0" a cada número
+        size_t usado = 0;
+        for (const char *p = formulas[i]; *p != '\0'; p++) {
+            reais[i][usado++] = *p;
+            if (EH_DIGITO_BENCHMARK(p[0]) && !EH_DIGITO_BENCHMARK(p[1])) {
+                reais[i][usado++] = '.';
+                reais[i][usado++] = '0';
+            }
+        }
+        reais[i][usado] = '\0';
+    }
+
+    printf("Inteiros exatos (int64) x float (%d avaliacoes por formula):\n", REPETICOES);
+    for (int i = 0; i < NUM_FORMULAS; i++) {
+        ErroExpressao erro;
+        float soma_inteiros = 0.0f, soma_reais = 0.0f;
+        double inicio = agora();
+        for (int k = 0; k < REPETICOES; k++) {
+            soma_inteiros += getValorPosFixaComErro(formulas[i], &erro);
+        }
+        double tempo_inteiros = (agora() - inicio) / REPETICOES;
+        inicio = agora();
+        for (int k = 0; k < REPETICOES; k++) {
+            soma_reais += getValorPosFixaComErro(reais[i], &erro);
+        }
+        double tempo_reais = (agora() - inicio) / REPETICOES;
+        printf("  %-28s %7.1f ns  float %7.1f ns  (%.2fx, %s)\n", formulas[i], tempo_inteiros * 1e9,
+               tempo_reais * 1e9, tempo_reais / tempo_inteiros, soma_inteiros == soma_reais ? "mesmo valor" : "difere");
+    }
+}
+
+// Partida a frio: compilar cada fórmula do texto x abrir a biblioteca binária (mmap)
+void benchmark_biblioteca(void) {
+    enum { NUM_FORMULAS = 50000 };
+    const char *caminho_texto = "benchmark_biblioteca.txt";
+    const char *caminho_biblioteca = "benchmark_biblioteca.bib";
+    CargaTrabalho carga = {"biblioteca", NUM_FORMULAS, 24, 10, {0, 0, 4, 4, 4, 2, 0, 1, 1, 1, 1, 0, 1}};
+    TextoGerado texto = {NULL, 0, 0, 0};
+
+    FILE *arquivo = fopen(caminho_texto, "w");
+    if (arquivo == NULL) {
+        fprintf(stderr, "Erro: Nao foi possivel criar %s.\n", caminho_texto);
+        return;
+    }
+    for (int i = 0; i < NUM_FORMULAS; i++) {
+        texto.usado = 0;
+        if (!gerar_subexpressao(&carga, 2 + proximo_aleatorio() % carga.num_operandos, carga.profundidade_maxima, &texto)) {
+            fprintf(stderr, "Erro de alocacao de memoria.\n");
+            fclose(arquivo);
+            free(texto.dados);
+            return;
+        }
+        fprintf(arquivo, "%s\n", texto.dados);
+    }
+    fclose(arquivo);
+    free(texto.dados);
+
+    // Como na inicialização atual: ler o texto e compilar linha a linha
+    double inicio = agora();
+    FILE *entrada = fopen(caminho_texto, "r");
+    ProgramaPosFixa *programas = (ProgramaPosFixa *)calloc(NUM_FORMULAS, sizeof(ProgramaPosFixa));
+    char linha[4096];
+    int compiladas = 0;
+    while (entrada != NULL && programas != NULL && compiladas < NUM_FORMULAS && fgets(linha, sizeof(linha), entrada) != NULL) {
+        compiladas += compilarPosFixa(linha, &programas[compiladas]);
+    }
+    double tempo_texto = agora() - inicio;
+    if (entrada != NULL) {
+        fclose(entrada);
+    }
+
+    inicio = agora();
+    long formulas = gravarBibliotecaExpressoes(caminho_texto, caminho_biblioteca, NULL);
+    double tempo_gravacao = agora() - inicio;
+    inicio = agora();
+    BibliotecaExpressoes *biblioteca = (formulas >= 0) ? abrirBibliotecaExpressoes(caminho_biblioteca) : NULL;
+    double tempo_abertura = agora() - inicio;
+
+    if (biblioteca != NULL && programas != NULL) {
+        double soma = 0.0, soma_biblioteca = 0.0;
+        inicio = agora();
+        // Fórmulas em ordem aleatória nos dois casos, como em um serviço
+        for (int k = 0; k < 10; k++) {
+            for (int i = 0; i < compiladas; i++) {
+                soma += avaliarPrograma(&programas[proximo_aleatorio() % (unsigned int)compiladas]);
+            }
+        }
+        double tempo_programas = (agora() - inicio) / (10.0 * compiladas);
+        inicio = agora();
+        for (int k = 0; k < 10; k++) {
+            for (int i = 0; i < compiladas; i++) {
+                soma_biblioteca += avaliarFormulaBiblioteca(biblioteca, proximo_aleatorio() % (unsigned int)formulas, NULL);
+            }
+        }
+        double tempo_biblioteca = (agora() - inicio) / (10.0 * compiladas);
+
+        printf("Biblioteca binaria (%ld formulas):\n", formulas);
+        printf("  Texto -> compilarPosFixa:  %10.2f ms\n", tempo_texto * 1e3);
+        printf("  gravarBiblioteca:          %10.2f ms (conversao, fora da partida)\n", tempo_gravacao * 1e3);
+        printf("  abrirBiblioteca:           %10.2f ms (mmap e verificacao)\n", tempo_abertura * 1e3);
+        printf("  Avaliacao (programa):      %10.1f ns\n", tempo_programas * 1e9);
+        printf("  Avaliacao (biblioteca):    %10.1f ns  (somas %g / %g)\n", tempo_biblioteca * 1e9, soma,
+               soma_biblioteca);
+    }
+
+    fecharBibliotecaExpressoes(biblioteca);
+    for (int i = 0; programas != NULL && i < compiladas; i++) {
+        liberarPrograma(&programas[i]);
+    }
+    free(programas);
+    remove(caminho_texto);
+    remove(caminho_biblioteca);
+}
+
+// Valor e forma infixa de cada registro: duas chamadas (duas leituras, strdup e free)
+// x preencherExpressoes (uma leitura, texto escrito direto em inFixa)
+void benchmark_expressao_completa(void) {
+    enum { NUM_EXPRESSOES = 20000, REPETICOES = 20 };
+    CargaTrabalho carga = {"completa", NUM_EXPRESSOES, 24, 10, {0, 0, 4, 4, 4, 2, 0, 1, 1, 1, 1, 0, 1}};
+    TextoGerado texto = {NULL, 0, 0, 0};
+    Expressao *expressoes = (Expressao *)calloc(NUM_EXPRESSOES, sizeof(Expressao));
+    if (expressoes == NULL) {
+        fprintf(stderr, "Erro de alocacao de memoria.\n");
+        return;
+    }
+    for (int i = 0; i < NUM_EXPRESSOES; i++) {
+        do {
+            texto.usado = 0;
+            if (!gerar_subexpressao(&carga, 2 + proximo_aleatorio() % carga.num_operandos, carga.profundidade_maxima, &texto)) {
+                fprintf(stderr, "Erro de alocacao de memoria.\n");
+                free(texto.dados);
+                free(expressoes);
+                return;
+            }
+        } while (texto.usado >= sizeof(expressoes[i].posFixa));
+        memcpy(expressoes[i].posFixa, texto.dados, texto.usado + 1);
+    }
+    free(texto.dados);
+
+    unsigned long long alocacoes = num_alocacoes;
+    float soma_separada = 0.0f;
+    double inicio = agora();
+    for (int r = 0; r < REPETICOES; r++) {
+        for (int i = 0; i < NUM_EXPRESSOES; i++) {
+            ErroExpressao erro;
+            expressoes[i].Valor = getValorPosFixaComErro(expressoes[i].posFixa, &erro);
+            char *infixa = getFormaInFixaComErro(expressoes[i].posFixa, &erro);
+            if (infixa != NULL) {
+                strncpy(expressoes[i].inFixa, infixa, sizeof(expressoes[i].inFixa) - 1);
+                free(infixa);
+            }
+            soma_separada += expressoes[i].Valor;
+        }
+    }
+    double tempo_separado = (agora() - inicio) / ((double)REPETICOES * NUM_EXPRESSOES);
+    double alocacoes_separado = (double)(num_alocacoes - alocacoes) / ((double)REPETICOES * NUM_EXPRESSOES);
+
+    alocacoes = num_alocacoes;
+    float soma_completa = 0.0f;
+    size_t completos = 0;
+    inicio = agora();
+    for (int r = 0; r < REPETICOES; r++) {
+        completos = preencherExpressoes(expressoes, NUM_EXPRESSOES, NULL);
+        for (int i = 0; i < NUM_EXPRESSOES; i++) {
+            soma_completa += expressoes[i].Valor;
+        }
+    }
+    double tempo_completo = (agora() - inicio) / ((double)REPETICOES * NUM_EXPRESSOES);
+    double alocacoes_completo = (double)(num_alocacoes - alocacoes) / ((double)REPETICOES * NUM_EXPRESSOES);
+
+    printf("Valor + forma infixa em registros Expressao (%d expressoes, %zu sem erro):\n", NUM_EXPRESSOES, completos);
+    printf("  getValorPosFixa + getFormaInFixa: %7.1f ns/expr", tempo_separado * 1e9);
+    if (ALOCACOES_CONTADAS) {
+        printf("  %.2f alocacoes/expr", alocacoes_separado);
+    }
+    printf("\n  preencherExpressoes:              %7.1f ns/expr", tempo_completo * 1e9);
+    if (ALOCACOES_CONTADAS) {
+        printf("  %.2f alocacoes/expr", alocacoes_completo);
+    }
+    printf("\n  Aceleracao: %.2fx (%s)\n", tempo_separado / tempo_completo,
+           soma_separada == soma_completa ? "mesmos valores" : "valores diferentes");
+    free(expressoes);
+}
+
+// Uma expressão enorme (2048 fórmulas de 512 operandos, com funções, somadas em uma
+// árvore balanceada): getValorPosFixa sequencial x getValorPosFixaParalelo com 1 a N threads
+void benchmark_paralelo(void) {
+    enum { NUM_PARTES = 2048, REPETICOES = 3 };
+    CargaTrabalho carga = {"paralela", 1, 512, 14, {0, 0, 4, 4, 4, 2, 0, 1, 2, 2, 2, 0, 2}};
+    TextoGerado texto = {NULL, 0, 0, 0};
+    long num_tokens = 0;
+    for (int k = 1; k <= NUM_PARTES; k++) {
+        long tokens_parte = 0;
+        char *parte = gerar_posfixa(&carga, &tokens_parte);
+        int ok = parte != NULL && anexar_token(&texto, parte);
+        num_tokens += tokens_parte;
+        free(parte);
+        // Depois da parte k, um "+" por zero à direita de k: as partes se juntam aos pares
+        for (int b = k; ok && b % 2 == 0; b /= 2) {
+            ok = anexar_token(&texto, "+");
+            num_tokens++;
+        }
+        if (!ok) {
+            fprintf(stderr, "Erro de alocacao de memoria.\n");
+            free(texto.dados);
+            return;
+        }
+    }
+    char *expressao = texto.dados;
+
+    ErroExpressao erro;
+    float esperado = 0.0f;
+    double melhor_sequencial = 1e30;
+    for (int r = 0; r < REPETICOES; r++) {
+        double inicio = agora();
+        esperado = getValorPosFixaComErro(expressao, &erro);
+        double tempo = agora() - inicio;
+        melhor_sequencial = (tempo < melhor_sequencial) ? tempo : melhor_sequencial;
+    }
+    printf("Avaliacao paralela de uma expressao (%ld tokens):\n", num_tokens);
+    printf("  sequencial (getValorPosFixa): %8.1f ms\n", melhor_sequencial * 1e3);
+
+    // De 1 thread até o número de núcleos (no mínimo 4), dobrando
+    PoolTrabalho *pool = criarPoolTrabalho(0);
+    int max_threads = (pool != NULL && numeroTrabalhadores(pool) > 4) ? numeroTrabalhadores(pool) : 4;
+    destruirPoolTrabalho(pool);
+    for (int threads = 1; threads <= max_threads; threads = (threads * 2 > max_threads && threads < max_threads) ? max_threads : threads * 2) {
+        pool = criarPoolTrabalho(threads);
+        if (pool == NULL) {
+            break;
+        }
+        float valor = 0.0f;
+        double melhor = 1e30;
+        for (int r = 0; r < REPETICOES; r++) {
+            double inicio = agora();
+            valor = getValorPosFixaParalelo(pool, expressao, 0, &erro);
+            double tempo = agora() - inicio;
+            melhor = (tempo < melhor) ? tempo : melhor;
+        }
+        printf("  %2d thread(s):                 %8.1f ms  (%.2fx, %s)\n", numeroTrabalhadores(pool), melhor * 1e3,
+               melhor_sequencial / melhor, memcmp(&valor, &esperado, sizeof(float)) == 0 ? "mesmo valor" : "difere");
+        destruirPoolTrabalho(pool);
+    }
+    free(expressao);
+}
+
+// Programa otimizado (exato e inexato) x original, pelo interpretador e em lote
+void benchmark_otimizacao(void) {
+    enum { NUM_LINHAS = 1 << 20 };
+    const char *expressoes[] = {
+        "x 10 log * 45 60 + / y 2 ^ +",
+        "x 2 ^ y 2 ^ + raiz x 2 ^ y 2 ^ + raiz 4 / + 2 45 sen * *",
+        "x y - 2 ^ x y - 2 ^ 3 / + x y + raiz +",
+        "x 3 ^ y 4 ^ + x 7 / y 3 / + *"
+    };
+    const int opcoes[] = {0, OTIMIZAR_PADRAO, OTIMIZAR_PADRAO | OTIMIZAR_INEXATO};
+    float *x = (float *)malloc(NUM_LINHAS * sizeof(float));
+    float *y = (float *)malloc(NUM_LINHAS * sizeof(float));
+    float *saida = (float *)malloc(NUM_LINHAS * sizeof(float));
+    float *referencia = (float *)malloc(NUM_LINHAS * sizeof(float));
+    if (x == NULL || y == NULL || saida == NULL || referencia == NULL) {
+        fprintf(stderr, "Erro de alocacao de memoria.\n");
+        free(x);
+        free(y);
+        free(saida);
+        free(referencia);
+        return;
+    }
+    for (int i = 0; i < NUM_LINHAS; i++) {
+        x[i] = (float)(proximo_aleatorio() % 100000) / 1000.0f;
+        y[i] = (float)(proximo_aleatorio() % 10000) / 1000.0f + 0.0005f;
+    }
+
+    printf("Otimizacao de programas (instrucoes, ns/avaliacao, ns/linha em lote, maior diferenca relativa):\n");
+    printf("  %-58s %-8s %6s %10s %10s %10s\n", "", "opcoes", "instr", "programa", "lote", "diferenca");
+    for (size_t e = 0; e < sizeof(expressoes) / sizeof(expressoes[0]); e++) {
+        for (int o = 0; o < 3; o++) {
+            ProgramaPosFixa programa;
+            if (!compilarPosFixa(expressoes[e], &programa)) {
+                continue;
+            }
+            if (opcoes[o] != 0 && !otimizarPrograma(&programa, opcoes[o])) {
+                liberarPrograma(&programa);
+                continue;
+            }
+            int ix = obterIndiceVariavel(&programa, "x");
+            int iy = obterIndiceVariavel(&programa, "y");
+            const float *colunas[2];
+            colunas[ix] = x;
+            colunas[iy] = y;
+            float valores[2];
+            double soma = 0.0;
+
+            double inicio = agora();
+            for (int i = 0; i < NUM_LINHAS; i++) {
+                valores[ix] = x[i];
+                valores[iy] = y[i];
+                soma += avaliarProgramaComVariaveis(&programa, valores);
+            }
+            double tempo_programa = (agora() - inicio) / NUM_LINHAS;
+
+            inicio = agora();
+            avaliarProgramaEmLote(&programa, colunas, NUM_LINHAS, saida);
+            double tempo_lote = (agora() - inicio) / NUM_LINHAS;
+
+            // O original é a referência das diferenças (zero sem OTIMIZAR_INEXATO)
+            double diferenca = 0.0;
+            for (int i = 0; i < NUM_LINHAS; i++) {
+                if (o == 0) {
+                    referencia[i] = saida[i];
+                } else if (saida[i] != referencia[i]) {
+                    double d = fabs((double)saida[i] - referencia[i]) / fmax(1.0, fabs(referencia[i]));
+                    diferenca = fmax(diferenca, d);
+                }
+            }
+            const char *nomes[] = {"nenhuma", "padrao", "inexato"};
+            printf("  %-58s %-8s %6d %10.2f %10.2f %10.2g  (soma %g)\n", (o == 0) ? expressoes[e] : "", nomes[o],
+                   programa.num_instrucoes, tempo_programa * 1e9, tempo_lote * 1e9, diferenca, soma);
+            liberarPrograma(&programa);
+        }
+    }
+    free(x);
+    free(y);
+    free(saida);
+    free(referencia);
+}
+
+int main(int argc, char *argv[]) {
+    long num_termos = 1000000;
+    unsigned int semente = 0;
+    const char *caminho_json = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            caminho_json = argv[++i];
+        } else if (strcmp(argv[i], "--semente") == 0 && i + 1 < argc) {
+            semente = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else {
+            num_termos = atol(argv[i]);
+            if (num_termos <= 0) {
+                fprintf(stderr, "Uso: %s [--json arquivo] [--semente N] [num_termos]\n", argv[0]);
+                return 1;
+            }
+        }
+    }
+
+    FILE *json = NULL;
+    if (caminho_json != NULL) {
+        json = fopen(caminho_json, "w");
+        if (json == NULL) {
+            fprintf(stderr, "Erro: Nao foi possivel criar %s.\n", caminho_json);
+            return 1;
+        }
+    }
+    benchmark_cargas(json, semente);
+    if (json != NULL) {
+        fclose(json);
+    }
+
+    benchmark_infixa(num_termos);
+    benchmark_lexico(num_termos);
+    benchmark_cache();
+    benchmark_erros();
+    benchmark_funcoes_rapidas();
+    benchmark_jit();
+    benchmark_incremental();
+    benchmark_fluxo();
+    benchmark_biblioteca();
+    benchmark_inteiros();
+    benchmark_expressao_completa();
+    benchmark_paralelo();
+    benchmark_otimizacao();
+    return 0;
+}
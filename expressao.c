@@ -3,8 +3,32 @@
 #include <string.h>
 #include <math.h>
 #include <ctype.h>
+#include <locale.h>
+#include <limits.h>
+#include <stdint.h>
+#include <float.h>
+#include <time.h>
+#include <errno.h>
 #include "expressao.h"
 
+#include <pthread.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define LOTE_X86_64 1
+#endif
+
+// Código nativo (ativarJit): x86-64 com a convenção de chamada System V
+#if defined(LOTE_X86_64) && !defined(_WIN32) && !defined(EXPRESSAO_SEM_JIT)
+#define JIT_X86_64 1
+#endif
+
 // Constante para conversão de graus para radianos
 #define PI 3.14159265358979323846
 #define GRAUS_PARA_RADIANOS(graus) ((graus) * PI / 180.0)
@@ -13,419 +37,6167 @@
 // ESTRUTURAS DE DADOS
 // =================================================================================
 
-// Estrutura para armazenar um valor (float) ou uma string (para notação infixa)
+// Capacidades iniciais dos buffers locais (na pilha de execução do chamador)
+#define CAPACIDADE_NUMEROS_LOCAL 64
+
+// Pilha numérica contígua. Começa em um buffer fornecido pelo chamador e só vai
+// para o heap (crescendo geometricamente) em expressões muito profundas.
 typedef struct {
-    float valor;
-    char str[512]; // Usado para armazenar sub-expressões infixas
-    int eh_valor;  // 1 se for valor, 0 se for string (para infixa)
-} ElementoPilha;
+    float *dados;
+    int topo;       // Índice do topo (-1 quando vazia)
+    int capacidade;
+    int dinamica;   // 1 se dados foi alocado com malloc
+} PilhaNumerica;
+
+// Valor da pilha de getValorPosFixa: inteiro exato (int64) enquanto a subárvore
+// só tiver literais inteiros e operações com resultado inteiro representável;
+// float a partir da primeira operação que não preserva o inteiro
+typedef struct {
+    long long inteiro;
+    float real;         // Válido quando eh_inteiro = 0
+    int eh_inteiro;
+} ValorMisto;
+
+// Pilha de ValorMisto, com o mesmo esquema de buffer local da PilhaNumerica
+typedef struct {
+    ValorMisto *dados;
+    int topo;
+    int capacidade;
+    int dinamica;
+} PilhaMista;
 
-// Estrutura de nó para a pilha
-typedef struct no {
-    ElementoPilha elemento;
-    struct no *proximo;
-} No;
+// Nó da árvore de expressão. Os nós ficam em um vetor na ordem pós-fixa, então
+// os filhos sempre têm índice menor que o pai e a subárvore de um nó i ocupa os
+// índices [i - tamanho + 1, i].
+typedef struct {
+    Opcode op;          // OP_CONSTANTE, OP_VARIAVEL ou operador
+    int esquerdo;       // Filho esquerdo (ou único filho, nas funções); -1 nas folhas
+    int direito;        // Filho direito dos operadores binários; -1 nos demais
+    int tamanho;        // Quantidade de nós da subárvore
+    int variavel;       // Índice da variável (OP_VARIAVEL)
+    float valor;        // Valor da constante (OP_CONSTANTE)
+    const char *texto;  // Trecho do token na expressão original
+    size_t tamanho_texto;
+} NoArvore;
 
-// Estrutura da Pilha
+// Árvore de expressão construída a partir da forma pós-fixa
 typedef struct {
-    No *topo;
-} Pilha;
+    NoArvore *nos;
+    int num_nos;             // A raiz é o último nó
+    char **nomes_variaveis;
+    int num_variaveis;
+} ArvoreExpressao;
 
 // =================================================================================
-// FUNÇÕES AUXILIARES DE PILHA
+// INSTRUMENTAÇÃO
 // =================================================================================
 
-// Inicializa a pilha
-void inicializar_pilha(Pilha *p) {
-    p->topo = NULL;
+// Com EXPRESSAO_INSTRUMENTACAO definida, os pontos INSTR_* abaixo contam tokens,
+// alocações, altura da pilha e latência. Cada thread escreve só no próprio bloco
+// (sem disputa de cache entre núcleos) e obterMetricasExpressao soma os blocos
+// das threads vivas com os das que já terminaram. Sem a macro, os pontos somem.
+#ifdef EXPRESSAO_INSTRUMENTACAO
+
+typedef struct BlocoMetricas {
+    MetricasExpressao metricas;
+    struct BlocoMetricas *anterior;
+    struct BlocoMetricas *proximo;
+} BlocoMetricas;
+
+pthread_mutex_t trava_metricas = PTHREAD_MUTEX_INITIALIZER;
+BlocoMetricas *blocos_metricas = NULL;   // Blocos das threads vivas
+MetricasExpressao metricas_encerradas;   // Soma das threads que já terminaram
+pthread_key_t chave_metricas;            // Destrutor que recolhe o bloco no fim da thread
+pthread_once_t chave_metricas_criada = PTHREAD_ONCE_INIT;
+__thread BlocoMetricas *metricas_thread = NULL;
+
+// Só a thread dona escreve no bloco; as leituras de outras threads são atômicas
+#define SOMAR_METRICA(campo, n) \
+    __atomic_store_n(&(campo), __atomic_load_n(&(campo), __ATOMIC_RELAXED) + (n), __ATOMIC_RELAXED)
+
+// Soma 'origem' (possivelmente sendo escrita por outra thread) em 'destino'
+void somar_metricas(MetricasExpressao *destino, MetricasExpressao *origem) {
+    for (int op = 0; op < NUM_OPCODES; op++) {
+        destino->tokens[op] += __atomic_load_n(&origem->tokens[op], __ATOMIC_RELAXED);
+    }
+    destino->alocacoes += __atomic_load_n(&origem->alocacoes, __ATOMIC_RELAXED);
+    int altura = __atomic_load_n(&origem->altura_maxima_pilha, __ATOMIC_RELAXED);
+    if (altura > destino->altura_maxima_pilha) {
+        destino->altura_maxima_pilha = altura;
+    }
+    for (int f = 0; f < NUM_FUNCOES_MEDIDAS; f++) {
+        destino->chamadas[f] += __atomic_load_n(&origem->chamadas[f], __ATOMIC_RELAXED);
+        for (int i = 0; i < NUM_FAIXAS_LATENCIA; i++) {
+            destino->latencia[f][i] += __atomic_load_n(&origem->latencia[f][i], __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// Destrutor da chave: soma o bloco da thread que termina e o libera
+void encerrar_metricas_thread(void *argumento) {
+    BlocoMetricas *bloco = (BlocoMetricas *)argumento;
+    pthread_mutex_lock(&trava_metricas);
+    somar_metricas(&metricas_encerradas, &bloco->metricas);
+    if (bloco->anterior != NULL) {
+        bloco->anterior->proximo = bloco->proximo;
+    } else {
+        blocos_metricas = bloco->proximo;
+    }
+    if (bloco->proximo != NULL) {
+        bloco->proximo->anterior = bloco->anterior;
+    }
+    pthread_mutex_unlock(&trava_metricas);
+    metricas_thread = NULL;
+    free(bloco);
+}
+
+void criar_chave_metricas(void) {
+    pthread_key_create(&chave_metricas, encerrar_metricas_thread);
 }
 
-// Verifica se a pilha está vazia
-int pilha_vazia(Pilha *p) {
-    return (p->topo == NULL);
+// Bloco de métricas da thread atual, criado no primeiro uso (NULL se faltar memória)
+BlocoMetricas *metricas_da_thread(void) {
+    if (metricas_thread == NULL) {
+        pthread_once(&chave_metricas_criada, criar_chave_metricas);
+        BlocoMetricas *bloco = (BlocoMetricas *)calloc(1, sizeof(BlocoMetricas));
+        if (bloco == NULL) {
+            return NULL;
+        }
+        pthread_mutex_lock(&trava_metricas);
+        bloco->proximo = blocos_metricas;
+        if (blocos_metricas != NULL) {
+            blocos_metricas->anterior = bloco;
+        }
+        blocos_metricas = bloco;
+        pthread_mutex_unlock(&trava_metricas);
+        pthread_setspecific(chave_metricas, bloco);
+        metricas_thread = bloco;
+    }
+    return metricas_thread;
 }
 
-// Empilha (push) um elemento
-int empilhar(Pilha *p, ElementoPilha elemento) {
-    No *novo = (No *)malloc(sizeof(No));
-    if (novo == NULL) {
-        // Erro de alocação de memória
-        return 0; 
+// Tempo monotônico em nanossegundos
+long long instrumentacao_agora(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (long long)t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+void instrumentar_token(Opcode op) {
+    BlocoMetricas *bloco = metricas_da_thread();
+    if (bloco != NULL) {
+        SOMAR_METRICA(bloco->metricas.tokens[op], 1);
+    }
+}
+
+void instrumentar_alocacoes(int n) {
+    BlocoMetricas *bloco = metricas_da_thread();
+    if (bloco != NULL) {
+        SOMAR_METRICA(bloco->metricas.alocacoes, n);
+    }
+}
+
+void instrumentar_altura_pilha(int altura) {
+    BlocoMetricas *bloco = metricas_da_thread();
+    if (bloco != NULL && altura > bloco->metricas.altura_maxima_pilha) {
+        __atomic_store_n(&bloco->metricas.altura_maxima_pilha, altura, __ATOMIC_RELAXED);
+    }
+}
+
+// Conta a chamada na faixa floor(log2(ns)) do histograma da função
+void instrumentar_latencia(FuncaoMedida funcao, long long inicio) {
+    long long ns = instrumentacao_agora() - inicio;
+    int faixa = (ns > 1) ? 63 - __builtin_clzll((unsigned long long)ns) : 0;
+    if (faixa >= NUM_FAIXAS_LATENCIA) {
+        faixa = NUM_FAIXAS_LATENCIA - 1;
     }
-    novo->elemento = elemento;
-    novo->proximo = p->topo;
-    p->topo = novo;
+    BlocoMetricas *bloco = metricas_da_thread();
+    if (bloco != NULL) {
+        SOMAR_METRICA(bloco->metricas.chamadas[funcao], 1);
+        SOMAR_METRICA(bloco->metricas.latencia[funcao][faixa], 1);
+    }
+}
+
+#define INSTR_TOKEN(op) instrumentar_token(op)
+#define INSTR_ALOCACOES(n) instrumentar_alocacoes(n)
+#define INSTR_ALTURA_PILHA(altura) instrumentar_altura_pilha(altura)
+#define INSTR_INICIO(inicio) long long inicio = instrumentacao_agora()
+#define INSTR_FIM(funcao, inicio) instrumentar_latencia(funcao, inicio)
+
+#else
+
+#define INSTR_TOKEN(op) ((void)0)
+#define INSTR_ALOCACOES(n) ((void)0)
+#define INSTR_ALTURA_PILHA(altura) ((void)0)
+#define INSTR_INICIO(inicio)
+#define INSTR_FIM(funcao, inicio) ((void)0)
+
+#endif
+
+// Nomes usados por escreverMetricasExpressao
+static const char *nomes_tokens_metricas[NUM_OPCODES] = {
+    "numero", "variavel", "+", "-", "*", "/", "%", "^", "raiz", "sen", "cos", "tg", "log"
+};
+static const char *nomes_funcoes_medidas[NUM_FUNCOES_MEDIDAS] = {
+    "getValorPosFixa", "getFormaInFixa"
+};
+
+// Indica se a biblioteca foi compilada com EXPRESSAO_INSTRUMENTACAO
+int instrumentacaoAtiva(void) {
+#ifdef EXPRESSAO_INSTRUMENTACAO
     return 1;
+#else
+    return 0;
+#endif
 }
 
-// Desempilha (pop) um elemento
-ElementoPilha desempilhar(Pilha *p) {
-    ElementoPilha elemento_vazio = {NAN, "", 0}; // Usar NAN para valor numérico vazio
-    if (pilha_vazia(p)) {
-        // Retorna um elemento vazio/nulo em caso de pilha vazia
-        return elemento_vazio; 
+// Soma as métricas de todas as threads (zeros se a instrumentação estiver desligada)
+void obterMetricasExpressao(MetricasExpressao *metricas) {
+    memset(metricas, 0, sizeof(MetricasExpressao));
+#ifdef EXPRESSAO_INSTRUMENTACAO
+    pthread_mutex_lock(&trava_metricas);
+    somar_metricas(metricas, &metricas_encerradas);
+    for (BlocoMetricas *bloco = blocos_metricas; bloco != NULL; bloco = bloco->proximo) {
+        somar_metricas(metricas, &bloco->metricas);
     }
-    No *remover = p->topo;
-    ElementoPilha elemento = remover->elemento;
-    p->topo = remover->proximo;
-    free(remover);
-    return elemento;
+    pthread_mutex_unlock(&trava_metricas);
+#endif
 }
 
-// Libera toda a memória alocada pela pilha
-void liberar_pilha(Pilha *p) {
-    No *atual = p->topo;
-    while (atual != NULL) {
-        No *proximo = atual->proximo;
-        free(atual);
-        atual = proximo;
+/*
+ * escreverMetricasExpressao
+ * -------------------------
+ * Escreve um retrato das métricas somadas de todas as threads, como texto
+ * legível ou como um objeto JSON. No histograma, a faixa i conta as chamadas
+ * que levaram de 2^i a 2^(i+1) - 1 ns.
+ *
+ * Parâmetros:
+ * - saida: Arquivo de destino (ex: stdout).
+ * - formato: METRICAS_TEXTO ou METRICAS_JSON.
+ *
+ * Retorno:
+ * - 1 em sucesso; 0 se houver erro de escrita.
+ */
+int escreverMetricasExpressao(FILE *saida, FormatoMetricas formato) {
+    MetricasExpressao m;
+    obterMetricasExpressao(&m);
+
+    if (formato == METRICAS_JSON) {
+        fprintf(saida, "{\n  \"instrumentacao\": %s,\n  \"tokens\": {", instrumentacaoAtiva() ? "true" : "false");
+        for (int op = 0; op < NUM_OPCODES; op++) {
+            fprintf(saida, "%s\"%s\": %llu", (op > 0) ? ", " : "", nomes_tokens_metricas[op], m.tokens[op]);
+        }
+        fprintf(saida, "},\n  \"alocacoes\": %llu,\n  \"altura_maxima_pilha\": %d,\n  \"funcoes\": {\n",
+                m.alocacoes, m.altura_maxima_pilha);
+        for (int f = 0; f < NUM_FUNCOES_MEDIDAS; f++) {
+            fprintf(saida, "    \"%s\": {\"chamadas\": %llu, \"latencia_log2_ns\": [",
+                    nomes_funcoes_medidas[f], m.chamadas[f]);
+            for (int i = 0; i < NUM_FAIXAS_LATENCIA; i++) {
+                fprintf(saida, "%s%llu", (i > 0) ? ", " : "", m.latencia[f][i]);
+            }
+            fprintf(saida, "]}%s\n", (f + 1 < NUM_FUNCOES_MEDIDAS) ? "," : "");
+        }
+        fprintf(saida, "  }\n}\n");
+    } else {
+        fprintf(saida, "Instrumentacao: %s\n", instrumentacaoAtiva() ? "ligada" : "desligada");
+        fprintf(saida, "Tokens avaliados:\n");
+        for (int op = 0; op < NUM_OPCODES; op++) {
+            if (m.tokens[op] > 0) {
+                fprintf(saida, "  %-8s %llu\n", nomes_tokens_metricas[op], m.tokens[op]);
+            }
+        }
+        fprintf(saida, "Altura maxima da pilha: %d\n", m.altura_maxima_pilha);
+        fprintf(saida, "Alocacoes: %llu\n", m.alocacoes);
+        for (int f = 0; f < NUM_FUNCOES_MEDIDAS; f++) {
+            fprintf(saida, "%s: %llu chamadas\n", nomes_funcoes_medidas[f], m.chamadas[f]);
+            for (int i = 0; i < NUM_FAIXAS_LATENCIA; i++) {
+                if (m.latencia[f][i] > 0) {
+                    fprintf(saida, "  %12llu - %12llu ns: %llu\n",
+                            1ULL << i, (1ULL << (i + 1)) - 1, m.latencia[f][i]);
+                }
+            }
+        }
     }
-    p->topo = NULL;
+    return !ferror(saida);
 }
 
 // =================================================================================
-// FUNÇÕES AUXILIARES DE AVALIAÇÃO E CONVERSÃO
+// FUNÇÕES AUXILIARES DE PILHA
 // =================================================================================
 
-// Verifica se o token é um operador binário
-int eh_operador_binario(const char *token) {
-    return (strcmp(token, "+") == 0 || strcmp(token, "-") == 0 ||
-            strcmp(token, "*") == 0 || strcmp(token, "/") == 0 ||
-            strcmp(token, "%") == 0 || strcmp(token, "^") == 0);
+// Inicializa a pilha numérica sobre um buffer do chamador
+void inicializar_pilha_numerica(PilhaNumerica *p, float *buffer, int capacidade) {
+    p->dados = buffer;
+    p->topo = -1;
+    p->capacidade = capacidade;
+    p->dinamica = 0;
 }
 
-// Verifica se o token é uma função unária
-int eh_funcao_unaria(const char *token) {
-    return (strcmp(token, "raiz") == 0 || strcmp(token, "sen") == 0 ||
-            strcmp(token, "cos") == 0 || strcmp(token, "tg") == 0 ||
-            strcmp(token, "log") == 0);
+// Verifica se a pilha numérica está vazia
+int pilha_numerica_vazia(PilhaNumerica *p) {
+    return (p->topo < 0);
 }
 
-// Verifica se o token é um operador (binário ou unário)
-int eh_operador(const char *token) {
-    return eh_operador_binario(token) || eh_funcao_unaria(token);
+// Garante espaço para pelo menos 'capacidade' elementos (crescimento geométrico)
+int reservar_pilha_numerica(PilhaNumerica *p, int capacidade) {
+    if (capacidade <= p->capacidade) {
+        return 1;
+    }
+    int nova_capacidade = p->capacidade * 2;
+    if (nova_capacidade < capacidade) {
+        nova_capacidade = capacidade;
+    }
+    INSTR_ALOCACOES(1);
+    float *novos = p->dinamica ? (float *)realloc(p->dados, nova_capacidade * sizeof(float))
+                               : (float *)malloc(nova_capacidade * sizeof(float));
+    if (novos == NULL) {
+        // Erro de alocação de memória
+        return 0;
+    }
+    if (!p->dinamica) {
+        memcpy(novos, p->dados, (p->topo + 1) * sizeof(float));
+    }
+    p->dados = novos;
+    p->capacidade = nova_capacidade;
+    p->dinamica = 1;
+    return 1;
 }
 
-// Realiza a operação binária
-float realizar_operacao_binaria(float op2, float op1, const char *op) {
-    if (strcmp(op, "+") == 0) return op1 + op2;
-    if (strcmp(op, "-") == 0) return op1 - op2;
-    if (strcmp(op, "*") == 0) return op1 * op2;
-    if (strcmp(op, "/") == 0) {
-        if (op2 == 0.0) {
-            fprintf(stderr, "Erro: Divisao por zero.\n");
-            return NAN; // Não a numero.
-        }
-        return op1 / op2;
+// Empilha (push) um valor
+int empilhar_numero(PilhaNumerica *p, float valor) {
+    if (p->topo + 1 >= p->capacidade && !reservar_pilha_numerica(p, p->topo + 2)) {
+        return 0;
     }
-    if (strcmp(op, "%") == 0) {
-        // O operador % (resto da divisão) em C é para inteiros.
-        // Para floats, vamos usar fmod.
-        if (op2 == 0.0) {
-            fprintf(stderr, "Erro: Modulo por zero.\n");
-            return NAN;
-        }
-        return fmod(op1, op2);
+    p->dados[++p->topo] = valor;
+    return 1;
+}
+
+// Desempilha (pop) um valor; retorna NAN se a pilha estiver vazia
+float desempilhar_numero(PilhaNumerica *p) {
+    if (pilha_numerica_vazia(p)) {
+        return NAN;
     }
-    if (strcmp(op, "^") == 0) return pow(op1, op2);
-    return NAN;
+    return p->dados[p->topo--];
 }
 
-// Realiza a operação unária
-float realizar_operacao_unaria(float op1, const char *op) {
-    if (strcmp(op, "raiz") == 0) {
-        if (op1 < 0.0) {
-            fprintf(stderr, "Erro: Raiz quadrada de numero negativo.\n");
-            return NAN;
-        }
-        return sqrt(op1);
+// Libera a memória dinâmica da pilha numérica (o buffer do chamador não é tocado)
+void liberar_pilha_numerica(PilhaNumerica *p) {
+    if (p->dinamica) {
+        free(p->dados);
     }
-    // Seno, Cosseno e Tangente em graus
-    if (strcmp(op, "sen") == 0) return sin(GRAUS_PARA_RADIANOS(op1));
-    if (strcmp(op, "cos") == 0) return cos(GRAUS_PARA_RADIANOS(op1));
-    if (strcmp(op, "tg") == 0) return tan(GRAUS_PARA_RADIANOS(op1));
-    // Logaritmo decimal (base 10)
-    if (strcmp(op, "log") == 0) {
-        if (op1 <= 0.0) {
-            fprintf(stderr, "Erro: Logaritmo de numero nao positivo.\n");
-            return NAN;
+    p->dados = NULL;
+    p->topo = -1;
+    p->capacidade = 0;
+    p->dinamica = 0;
+}
+
+// Inicializa a pilha mista sobre um buffer do chamador
+void inicializar_pilha_mista(PilhaMista *p, ValorMisto *buffer, int capacidade) {
+    p->dados = buffer;
+    p->topo = -1;
+    p->capacidade = capacidade;
+    p->dinamica = 0;
+}
+
+// Reserva uma posição no topo (crescimento geométrico); NULL se faltar memória
+ValorMisto *empilhar_misto(PilhaMista *p) {
+    if (p->topo + 1 >= p->capacidade) {
+        int nova_capacidade = p->capacidade * 2;
+        INSTR_ALOCACOES(1);
+        ValorMisto *novos = p->dinamica ? (ValorMisto *)realloc(p->dados, nova_capacidade * sizeof(ValorMisto))
+                                        : (ValorMisto *)malloc(nova_capacidade * sizeof(ValorMisto));
+        if (novos == NULL) {
+            return NULL;
         }
-        return log10(op1);
+        if (!p->dinamica) {
+            memcpy(novos, p->dados, (p->topo + 1) * sizeof(ValorMisto));
+        }
+        p->dados = novos;
+        p->capacidade = nova_capacidade;
+        p->dinamica = 1;
     }
-    return NAN;
+    return &p->dados[++p->topo];
+}
+
+// Libera a memória dinâmica da pilha mista (o buffer do chamador não é tocado)
+void liberar_pilha_mista(PilhaMista *p) {
+    if (p->dinamica) {
+        free(p->dados);
+    }
+    p->dados = NULL;
+    p->topo = -1;
+    p->capacidade = 0;
+    p->dinamica = 0;
 }
 
 // =================================================================================
-// FUNÇÕES PRINCIPAIS (expressao.h)
+// FUNÇÕES AUXILIARES DE AVALIAÇÃO E CONVERSÃO
 // =================================================================================
 
-/*
- * getValorPosFixa
- * ---------------
- * Calcula o valor numérico de uma expressão na notação pós-fixa.
- *
- * Parâmetro:
- * - StrPosFixa: String contendo a expressão pós-fixa (ex: "3 4 + 5 *").
- *
- * Retorno:
- * - O valor numérico da expressão. Retorna NAN (Not a Number) em caso de erro.
- */
-float getValorPosFixa(char *StrPosFixa) {
-    Pilha pilha;
-    inicializar_pilha(&pilha);
-    
-    // Cria uma cópia da string para tokenização, pois strtok modifica a string original
-    char *str_copia = strdup(StrPosFixa);
-    if (str_copia == NULL) {
-        fprintf(stderr, "Erro de alocacao de memoria.\n");
-        return NAN;
+// Retorna o índice de 'nome' (com 'tamanho' caracteres) na tabela de nomes,
+// registrando-o se for novo (-1 em erro)
+int registrar_nome(char ***nomes, int *num_nomes, const char *nome, size_t tamanho) {
+    for (int i = 0; i < *num_nomes; i++) {
+        if (strncmp((*nomes)[i], nome, tamanho) == 0 && (*nomes)[i][tamanho] == '\0') {
+            return i;
+        }
     }
+    // Cresce a tabela de nomes em potências de 2
+    int n = *num_nomes;
+    if ((n & (n - 1)) == 0) {
+        int nova_capacidade = (n == 0) ? 4 : n * 2;
+        char **novos = (char **)realloc(*nomes, nova_capacidade * sizeof(char *));
+        if (novos == NULL) {
+            return -1;
+        }
+        *nomes = novos;
+    }
+    (*nomes)[n] = (char *)malloc(tamanho + 1);
+    if ((*nomes)[n] == NULL) {
+        return -1;
+    }
+    memcpy((*nomes)[n], nome, tamanho);
+    (*nomes)[n][tamanho] = '\0';
+    (*num_nomes)++;
+    return n;
+}
 
-    char *token = strtok(str_copia, " ");
-    float resultado = NAN;
-
-    while (token != NULL) {
-        ElementoPilha elemento;
-        elemento.eh_valor = 1; // Por padrão, é um valor
+// Texto do operador ou função correspondente ao opcode ("" para operandos)
+const char *texto_do_opcode(Opcode op) {
+    static const char *textos[NUM_OPCODES] = {
+        "", "", "+", "-", "*", "/", "%", "^", "raiz", "sen", "cos", "tg", "log"
+    };
+    return (op < NUM_OPCODES) ? textos[op] : "";
+}
 
-        // Tenta converter o token para float (número)
-        char *endptr;
-        float num = strtof(token, &endptr);
+// Verifica se o opcode consome dois operandos
+int opcode_eh_binario(Opcode op) {
+    return op >= OP_SOMA && op <= OP_POTENCIA;
+}
 
-        // Verifica se é um número válido (incluindo números com ponto flutuante)
-        if (*endptr == '\0' || (*endptr == '.' && *(endptr + 1) == '\0')) {
-            // É um número válido
-            elemento.valor = num;
-            if (!empilhar(&pilha, elemento)) {
-                fprintf(stderr, "Erro ao empilhar valor.\n");
-                goto erro;
+/*
+ * aplicar_operacao
+ * ----------------
+ * Aplica um operador ou função (op2 é ignorado pelas funções unárias) sem
+ * nenhuma E/S. Os resultados são os mesmos em todos os caminhos de avaliação.
+ *
+ * Retorno:
+ * - O resultado; NAN em caso de erro, com a causa em *codigo.
+ */
+float aplicar_operacao(Opcode op, float op1, float op2, CodigoErro *codigo) {
+    float resultado;
+    switch (op) {
+        case OP_SOMA: resultado = op1 + op2; break;
+        case OP_SUBTRACAO: resultado = op1 - op2; break;
+        case OP_MULTIPLICACAO: resultado = op1 * op2; break;
+        case OP_DIVISAO:
+            if (op2 == 0.0) {
+                *codigo = ERRO_DIVISAO_POR_ZERO;
+                return NAN; // Não a numero.
             }
-        } else if (eh_operador_binario(token)) {
-            // É um operador binário
-            if (pilha_vazia(&pilha)) {
-                fprintf(stderr, "Erro: Expressao pos-fixa invalida (operador binario sem operandos).\n");
-                goto erro;
+            resultado = op1 / op2;
+            break;
+        case OP_MODULO:
+            // O operador % (resto da divisão) em C é para inteiros.
+            // Para floats, vamos usar fmod.
+            if (op2 == 0.0) {
+                *codigo = ERRO_MODULO_POR_ZERO;
+                return NAN;
             }
-            float op2 = desempilhar(&pilha).valor;
-            if (pilha_vazia(&pilha)) {
-                fprintf(stderr, "Erro: Expressao pos-fixa invalida (operador binario com apenas um operando).\n");
-                goto erro;
+            resultado = fmod(op1, op2);
+            break;
+        case OP_POTENCIA:
+            // pow(NAN, 0) seria 1: operandos NAN continuam sendo erro
+            resultado = (isnan(op1) || isnan(op2)) ? NAN : pow(op1, op2);
+            break;
+        case OP_RAIZ:
+            if (op1 < 0.0) {
+                *codigo = ERRO_RAIZ_NEGATIVA;
+                return NAN;
             }
-            float op1 = desempilhar(&pilha).valor;
-            
-            resultado = realizar_operacao_binaria(op2, op1, token);
-            if (isnan(resultado)) {
-                goto erro;
+            resultado = sqrt(op1);
+            break;
+        // Seno, Cosseno e Tangente em graus
+        case OP_SENO: resultado = sin(GRAUS_PARA_RADIANOS(op1)); break;
+        case OP_COSSENO: resultado = cos(GRAUS_PARA_RADIANOS(op1)); break;
+        case OP_TANGENTE: resultado = tan(GRAUS_PARA_RADIANOS(op1)); break;
+        // Logaritmo decimal (base 10)
+        case OP_LOGARITMO:
+            if (op1 <= 0.0) {
+                *codigo = ERRO_LOGARITMO_NAO_POSITIVO;
+                return NAN;
             }
-            
-            elemento.valor = resultado;
-            if (!empilhar(&pilha, elemento)) {
-                fprintf(stderr, "Erro ao empilhar resultado.\n");
-                goto erro;
+            resultado = log10(op1);
+            break;
+        default: resultado = NAN; break;
+    }
+    if (isnan(resultado)) {
+        *codigo = ERRO_RESULTADO_INVALIDO;
+    }
+    return resultado;
+}
+
+// Valor em float de uma posição da pilha mista (um único arredondamento)
+float valor_real(const ValorMisto *v) {
+    return v->eh_inteiro ? (float)v->inteiro : v->real;
+}
+
+/*
+ * aplicar_operacao_inteira
+ * ------------------------
+ * Aplica um operador binário a dois inteiros em int64: ^ por quadrados
+ * sucessivos, % nativo (mesmo sinal de fmod) e / só quando a divisão é exata.
+ * Quando o resultado exato não é um inteiro representável (transbordamento,
+ * divisão não exata, expoente negativo, divisor zero) ou seria -0.0 em float
+ * (ex: 0 * -3), retorna 0 e o chamador refaz a operação em float com
+ * aplicar_operacao, que dá o mesmo resultado e o mesmo erro de antes.
+ *
+ * Retorno:
+ * - 1 com o resultado exato em *resultado; 0 para voltar ao float.
+ */
+int aplicar_operacao_inteira(Opcode op, long long a, long long b, long long *resultado) {
+    switch (op) {
+        case OP_SOMA:
+            return !__builtin_add_overflow(a, b, resultado);
+        case OP_SUBTRACAO:
+            return !__builtin_sub_overflow(a, b, resultado);
+        case OP_MULTIPLICACAO:
+            if (__builtin_mul_overflow(a, b, resultado)) {
+                return 0;
             }
-        } else if (eh_funcao_unaria(token)) {
-            // É uma função unária
-            if (pilha_vazia(&pilha)) {
-                fprintf(stderr, "Erro: Expressao pos-fixa invalida (funcao unaria sem operando).\n");
-                goto erro;
+            return *resultado != 0 || (a >= 0 && b >= 0);
+        case OP_DIVISAO:
+            if (b == 0 || (b == -1 && a == LLONG_MIN) || a % b != 0 || (a == 0 && b < 0)) {
+                return 0;
             }
-            float op1 = desempilhar(&pilha).valor;
-            
-            resultado = realizar_operacao_unaria(op1, token);
-            if (isnan(resultado)) {
-                goto erro;
+            *resultado = a / b;
+            return 1;
+        case OP_MODULO:
+            if (b == 0) {
+                return 0;
             }
-            
-            elemento.valor = resultado;
-            if (!empilhar(&pilha, elemento)) {
-                fprintf(stderr, "Erro ao empilhar resultado.\n");
-                goto erro;
+            *resultado = (b == -1) ? 0 : a % b;
+            return *resultado != 0 || a >= 0;
+        case OP_POTENCIA: {
+            if (b < 0) {
+                return 0;
             }
-        } else {
-            // Token inválido (não é número nem operador)
-            fprintf(stderr, "Erro: Token invalido na expressao pos-fixa: %s\n", token);
-            goto erro;
+            long long r = 1;
+            long long base = a;
+            while (b > 0) {
+                if ((b & 1) && __builtin_mul_overflow(r, base, &r)) {
+                    return 0;
+                }
+                b >>= 1;
+                if (b > 0 && __builtin_mul_overflow(base, base, &base)) {
+                    return 0;
+                }
+            }
+            *resultado = r;
+            return 1;
         }
+        default:
+            return 0;
+    }
+}
 
-        token = strtok(NULL, " ");
+// Aplica um operador binário na pilha mista: em int64 se os dois operandos forem
+// inteiros e o resultado exato couber, senão em float. 0 em erro (código em *codigo).
+int aplicar_operacao_mista(Opcode op, ValorMisto *op1, const ValorMisto *op2, CodigoErro *codigo) {
+    long long inteiro;
+    if (op1->eh_inteiro && op2->eh_inteiro && aplicar_operacao_inteira(op, op1->inteiro, op2->inteiro, &inteiro)) {
+        op1->inteiro = inteiro;
+        return 1;
     }
+    op1->real = aplicar_operacao(op, valor_real(op1), valor_real(op2), codigo);
+    op1->eh_inteiro = 0;
+    return !isnan(op1->real);
+}
 
-    // Ao final, a pilha deve conter apenas o resultado
-    if (pilha_vazia(&pilha)) {
-        // Expressão vazia ou erro
-        resultado = NAN;
-    } else {
-        resultado = desempilhar(&pilha).valor;
-        if (!pilha_vazia(&pilha)) {
-            fprintf(stderr, "Erro: Expressao pos-fixa invalida (operandos restantes).\n");
-            resultado = NAN;
+// =================================================================================
+// FUNÇÕES APROXIMADAS (CALCULO_RAPIDO)
+// =================================================================================
+
+// sen/cos/tg: o argumento em graus é reduzido a r em [-45, 45] com x = r + 90q.
+// Abaixo de 2^23 todo float é múltiplo do seu ulp (<= 1) e 90q é inteiro menor
+// que 2^24, então r = x - 90q sai exato; acima disso x é inteiro e fmodf(x, 360)
+// também é exato. Assim, ao contrário de sin(x * PI / 180), não há erro de
+// redução e sen 180 e cos 90 saem exatamente 0. Os polinômios (coeficientes
+// minimax do Cephes) valem em [-pi/4, pi/4]. As versões vetoriais (lote)
+// repetem as mesmas operações na mesma ordem.
+#define LIMITE_REDUCAO_GRAUS 8388608.0f // 2^23
+#define GRAUS_PARA_RADIANOS_F 0.017453292519943295f
+#define SENO_C1 -1.6666654611e-1f
+#define SENO_C2 8.3321608736e-3f
+#define SENO_C3 -1.9515295891e-4f
+#define COSSENO_C1 4.166664568298827e-2f
+#define COSSENO_C2 -1.388731625493765e-3f
+#define COSSENO_C3 2.443315711809948e-5f
+
+// log: x = m * 2^e com m em [sqrt(2)/2, sqrt(2)] e ln(m) = f - f^2/2 + f^3 P(f), f = m - 1
+#define LOG_C0 3.3333331174e-1f
+#define LOG_C1 -2.4999993993e-1f
+#define LOG_C2 2.0000714765e-1f
+#define LOG_C3 -1.6668057665e-1f
+#define LOG_C4 1.4249322787e-1f
+#define LOG_C5 -1.2420140846e-1f
+#define LOG_C6 1.1676998740e-1f
+#define LOG_C7 -1.1514610310e-1f
+#define LOG_C8 7.0376836292e-2f
+#define LOG10_E_F 0.43429448190325176f
+#define LOG10_2_F 0.30102999566398120f
+#define RAIZ_2_F 1.41421356237309505f
+
+// Reduz x (graus) e calcula o seno (s) e o cosseno (c) de r; retorna q mod 4
+int reduzir_graus(float x, float *s, float *c) {
+    if (!(fabsf(x) < LIMITE_REDUCAO_GRAUS)) {
+        x = fmodf(x, 360.0f); // Exato; NAN e infinito viram NAN
+        if (isnan(x)) {
+            *s = *c = x;
+            return 0;
         }
     }
+    float k = rintf(x * (1.0f / 90.0f));
+    float t = (x - k * 90.0f) * GRAUS_PARA_RADIANOS_F;
+    float z = t * t;
+    *s = t + (t * z) * ((SENO_C3 * z + SENO_C2) * z + SENO_C1);
+    *c = (1.0f - 0.5f * z) + (z * z) * ((COSSENO_C3 * z + COSSENO_C2) * z + COSSENO_C1);
+    return (int)k & 3;
+}
 
-    free(str_copia);
-    liberar_pilha(&pilha);
-    return resultado;
-
-erro:
-    free(str_copia);
-    liberar_pilha(&pilha);
-    return NAN;
+// Seno de x graus (erro absoluto <= 1e-7)
+float seno_graus_rapido(float x) {
+    float s, c;
+    int q = reduzir_graus(x, &s, &c);
+    float v = (q & 1) ? c : s;
+    return (q & 2) ? -v : v;
 }
 
-/*
- * getFormaInFixa
- * --------------
- * Converte uma expressão na notação pós-fixa para a notação infixa.
- *
- * Parâmetro:
- * - Str: String contendo a expressão pós-fixa (ex: "3 4 + 5 *").
- *
- * Retorno:
- * - Ponteiro para a string infixa resultante (alocada dinamicamente).
- * - NULL em caso de erro (ex: expressão pós-fixa inválida).
- */
-char * getFormaInFixa(char *Str) {
-    Pilha pilha;
-    inicializar_pilha(&pilha);
-    
-    // Cria uma cópia da string para tokenização
-    char *str_copia = strdup(Str);
-    if (str_copia == NULL) {
-        fprintf(stderr, "Erro de alocacao de memoria.\n");
-        return NULL;
-    }
+// Cosseno de x graus (erro absoluto <= 1e-7)
+float cosseno_graus_rapido(float x) {
+    float s, c;
+    int q = (reduzir_graus(x, &s, &c) + 1) & 3; // cos(x) = sen(x + 90)
+    float v = (q & 1) ? c : s;
+    return (q & 2) ? -v : v;
+}
 
-    char *token = strtok(str_copia, " ");
-    char *resultado_infixa = NULL;
+// Tangente de x graus (erro <= 2.5e-7, relativo acima de 1; infinito em 90 + 180k)
+float tangente_graus_rapida(float x) {
+    float s, c;
+    int q = reduzir_graus(x, &s, &c);
+    return (q & 1) ? -(c / s) : s / c;
+}
 
-    while (token != NULL) {
-        ElementoPilha elemento;
-        elemento.eh_valor = 0; // É uma string (sub-expressão infixa)
+// Logaritmo decimal (erro relativo <= 2e-7); NAN se x <= 0
+float log10_rapido(float x) {
+    if (!(x > 0.0f)) {
+        return NAN;
+    }
+    if (x == INFINITY) {
+        return INFINITY;
+    }
+    int e = 0;
+    if (x < FLT_MIN) {
+        x *= 8388608.0f; // Subnormal: normaliza antes de separar o expoente
+        e = -23;
+    }
+    unsigned int bits;
+    memcpy(&bits, &x, sizeof(bits));
+    e += (int)(bits >> 23) - 127;
+    bits = (bits & 0x7FFFFFu) | 0x3F800000u;
+    float m;
+    memcpy(&m, &bits, sizeof(m));
+    if (m > RAIZ_2_F) {
+        m *= 0.5f;
+        e++;
+    }
+    float f = m - 1.0f;
+    float z = f * f;
+    float p = ((((((((LOG_C8 * f + LOG_C7) * f + LOG_C6) * f + LOG_C5) * f + LOG_C4) * f +
+                 LOG_C3) * f + LOG_C2) * f + LOG_C1) * f + LOG_C0);
+    float ln = f + ((p * f) * z - 0.5f * z);
+    return ln * LOG10_E_F + (float)e * LOG10_2_F;
+}
 
-        // Tenta converter o token para float (número)
-        char *endptr;
-        strtof(token, &endptr);
+// Raiz quadrada em float (sqrtss: arredondamento correto); NAN se x < 0
+float raiz_rapida(float x) {
+    return (x < 0.0f) ? NAN : sqrtf(x);
+}
 
-        if (*endptr == '\0' || (*endptr == '.' && *(endptr + 1) == '\0')) {
-            // É um operando (número)
-            // Copia o token diretamente para a string da sub-expressão
-            snprintf(elemento.str, 512, "%s", token);
-            
-            if (!empilhar(&pilha, elemento)) {
-                fprintf(stderr, "Erro ao empilhar operando.\n");
-                goto erro;
+// Como aplicar_operacao, com as funções aproximadas acima
+float aplicar_operacao_rapida(Opcode op, float op1, float op2, CodigoErro *codigo) {
+    float resultado;
+    switch (op) {
+        case OP_RAIZ:
+            if (op1 < 0.0f) {
+                *codigo = ERRO_RAIZ_NEGATIVA;
+                return NAN;
             }
-        } else if (eh_operador_binario(token)) {
-            // É um operador binário (ex: +, *, ^)
-            if (pilha_vazia(&pilha)) {
-                fprintf(stderr, "Erro: Expressao pos-fixa invalida (operador binario sem operandos).\n");
-                goto erro;
-            }
-            ElementoPilha op2 = desempilhar(&pilha);
-            if (pilha_vazia(&pilha)) {
-                fprintf(stderr, "Erro: Expressao pos-fixa invalida (operador binario com apenas um operando).\n");
-                goto erro;
-            }
-            ElementoPilha op1 = desempilhar(&pilha);
-            
-            // Constrói a nova sub-expressão infixa: (op1 op op2)
-            // O PDF exige: "não deve conter espaços, nem parênteses além dos estritamente necessários."
-            // A conversão de posfixa para infixa é inerentemente ambígua em relação à precedência
-            // sem parênteses. Para respeitar o requisito de "sem espaços" e "sem parênteses além dos estritamente necessários",
-            // vamos usar a forma mais simples: op1 op op2, e adicionar parênteses APENAS se a sub-expressão
-            // for mais complexa (ou seja, se ela já tiver parênteses).
-            
-            // Para garantir a precedência correta na infixa, é necessário adicionar parênteses
-            // em torno da sub-expressão binária. O requisito de "além dos estritamente necessários"
-            // é difícil de satisfazer perfeitamente sem um analisador de precedência completo.
-            // A abordagem mais segura para a conversão posfixa->infixa é parentizar.
-            
-            // Vamos usar a abordagem de parentizar a sub-expressão binária: (op1 op op2)
-            // e remover os parênteses externos no final, se houver.
-            
-            // Formato: (<op1.str><token><op2.str>)
-                        // Lógica para adicionar parênteses apenas quando necessário (considerando precedência)
-            // Esta é uma simplificação. Uma implementação completa requer rastrear a precedência do operador que gerou a sub-expressão.
-            // Para este trabalho, vamos parentizar para garantir a correção, e depois remover os externos.
-            snprintf(elemento.str, 512, "(%s%s%s)", op1.str, token, op2.str);
-            
-            if (!empilhar(&pilha, elemento)) {
-                fprintf(stderr, "Erro ao empilhar sub-expressao binaria.\n");
-                goto erro;
-            }
-            
-        } else if (eh_funcao_unaria(token)) {
-            // É uma função unária (ex: sen, log)
-            if (pilha_vazia(&pilha)) {
-                fprintf(stderr, "Erro: Expressao pos-fixa invalida (funcao unaria sem operando).\n");
-                goto erro;
-            }
-            ElementoPilha op1 = desempilhar(&pilha);
-            
-            // Constrói a nova sub-expressão infixa: token(op1)
-            // Ex: "3 log" -> "log(3)"
-            snprintf(elemento.str, 512, "%s(%s)", token, op1.str);
-            
-            if (!empilhar(&pilha, elemento)) {
-                fprintf(stderr, "Erro ao empilhar sub-expressao unaria.\n");
-                goto erro;
+            resultado = sqrtf(op1);
+            break;
+        case OP_SENO: resultado = seno_graus_rapido(op1); break;
+        case OP_COSSENO: resultado = cosseno_graus_rapido(op1); break;
+        case OP_TANGENTE: resultado = tangente_graus_rapida(op1); break;
+        case OP_LOGARITMO:
+            if (op1 <= 0.0f) {
+                *codigo = ERRO_LOGARITMO_NAO_POSITIVO;
+                return NAN;
             }
-        } else {
-            // Token inválido (não é número nem operador)
-            fprintf(stderr, "Erro: Token invalido na expressao pos-fixa: %s\n", token);
-            goto erro;
-        }
+            resultado = log10_rapido(op1);
+            break;
+        default:
+            return aplicar_operacao(op, op1, op2, codigo);
+    }
+    if (isnan(resultado)) {
+        *codigo = ERRO_RESULTADO_INVALIDO;
+    }
+    return resultado;
+}
+
+// =================================================================================
+// ANÁLISE LÉXICA
+// =================================================================================
 
-        token = strtok(NULL, " ");
+// Classificação de caracteres independente da locale
+#define EH_ESPACO(c) ((c) == ' ' || ((unsigned int)(unsigned char)(c) - '\t') <= (unsigned int)('\r' - '\t'))
+#define EH_DIGITO(c) (((unsigned int)(unsigned char)(c) - '0') <= 9u)
+#define EH_LETRA(c) ((((unsigned int)(unsigned char)(c) | 0x20u) - 'a') <= (unsigned int)('z' - 'a') || (c) == '_')
+
+// Maior mantissa representável exatamente em float (2^24)
+#define MANTISSA_EXATA_FLOAT 16777216u
+
+// Potências de 10 exatas em float
+static const float potencias_10_float[] = {
+    1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+// Converte com strtof um número já validado por ler_numero (caminho lento)
+float converter_numero_lento(const char *inicio, size_t tamanho) {
+    char buffer[128];
+    char *copia = buffer;
+    if (tamanho >= sizeof(buffer)) {
+        INSTR_ALOCACOES(1);
+        copia = (char *)malloc(tamanho + 1);
+        if (copia == NULL) {
+            return NAN;
+        }
     }
+    memcpy(copia, inicio, tamanho);
+    copia[tamanho] = '\0';
 
-    // Ao final, a pilha deve conter apenas a expressão infixa resultante
-    if (pilha_vazia(&pilha)) {
-        // Expressão vazia ou erro
-        goto erro;
-    } else {
-        ElementoPilha resultado = desempilhar(&pilha);
-        if (!pilha_vazia(&pilha)) {
-            fprintf(stderr, "Erro: Expressao pos-fixa invalida (operandos restantes).\n");
-            goto erro;
+    // strtof segue a locale: troca o ponto pelo separador decimal vigente
+    char separador = localeconv()->decimal_point[0];
+    if (separador != '.') {
+        char *ponto = strchr(copia, '.');
+        if (ponto != NULL) {
+            *ponto = separador;
         }
-        
-        // Aloca memória para a string de retorno
-        resultado_infixa = strdup(resultado.str);
-        if (resultado_infixa == NULL) {
-            fprintf(stderr, "Erro de alocacao de memoria para o resultado.\n");
-            goto erro;
+    }
+    float valor = strtof(copia, NULL);
+    if (copia != buffer) {
+        free(copia);
+    }
+    return valor;
+}
+
+/*
+ * ler_numero
+ * ----------
+ * Lê o maior número decimal que começa em p: [+-]dígitos[.dígitos][(e|E)[+-]dígitos],
+ * com ao menos um dígito antes ou depois do ponto. Quando a mantissa cabe em
+ * 24 bits e o expoente decimal está em [-10, 10], o valor sai de uma única
+ * multiplicação ou divisão exata em float (correta por arredondamento); nos
+ * demais casos o trecho é convertido por strtof.
+ *
+ * Retorno:
+ * - Ponteiro para o primeiro caractere após o número (p se não houver número).
+ */
+const char *ler_numero(const char *p, float *valor) {
+    const char *inicio = p;
+    int negativo = 0;
+    unsigned long long mantissa = 0;
+    int expoente = 0;
+    int digitos = 0;
+    int truncado = 0;
+
+    if (*p == '+' || *p == '-') {
+        negativo = (*p == '-');
+        p++;
+    }
+    for (; EH_DIGITO(*p); p++, digitos++) {
+        if (mantissa < 100000000000000000ull) {
+            mantissa = mantissa * 10 + (unsigned int)(*p - '0');
+        } else {
+            expoente++;
+            truncado = 1;
         }
-        
-        // REQUISITO: A string de retorno de getFormaInFixa() não deve conter espaços,
-        // nem parênteses alé        // Remoção de parênteses externos desnecessários:
-        // Se a string começar com '(' e terminar com ')' e a sub-expressão interna não estiver
-        // completamente entre parênteses, remove os parênteses externos.
-        size_t len = strlen(resultado_infixa);
-        if (len > 2 && resultado_infixa[0] == '(' && resultado_infixa[len - 1] == ')') {
-            int balance = 0;
-            int unwrap = 1;
-            for (int i = 1; i < len - 1; i++) {
-                if (resultado_infixa[i] == '(') balance++;
-                else if (resultado_infixa[i] == ')') balance--;
-                if (balance < 0) {
-                    unwrap = 0;
-                    break;
-                }
+    }
+    if (*p == '.') {
+        p++;
+        for (; EH_DIGITO(*p); p++, digitos++) {
+            if (mantissa < 100000000000000000ull) {
+                mantissa = mantissa * 10 + (unsigned int)(*p - '0');
+                expoente--;
+            } else {
+                truncado = 1;
             }
-            if (unwrap && balance == 0) {
-                 memmove(resultado_infixa, resultado_infixa + 1, len - 2);
-                 resultado_infixa[len - 2] = '\0';
+        }
+    }
+    if (digitos == 0) {
+        return inicio;
+    }
+    if ((*p == 'e' || *p == 'E') &&
+        (EH_DIGITO(p[1]) || ((p[1] == '+' || p[1] == '-') && EH_DIGITO(p[2])))) {
+        const char *q = p + 1;
+        int negativo_expoente = (*q == '-');
+        int valor_expoente = 0;
+        if (*q == '+' || *q == '-') {
+            q++;
+        }
+        for (; EH_DIGITO(*q); q++) {
+            if (valor_expoente < 100000) {
+                valor_expoente = valor_expoente * 10 + (*q - '0');
             }
         }
+        expoente += negativo_expoente ? -valor_expoente : valor_expoente;
+        p = q;
     }
 
-    free(str_copia);
-    liberar_pilha(&pilha);
-    return resultado_infixa;
+    if (!truncado && mantissa <= MANTISSA_EXATA_FLOAT && expoente >= -10 && expoente <= 10) {
+        float v = (float)mantissa;
+        v = (expoente < 0) ? v / potencias_10_float[-expoente] : v * potencias_10_float[expoente];
+        *valor = negativo ? -v : v;
+    } else {
+        *valor = converter_numero_lento(inicio, (size_t)(p - inicio));
+    }
+    return p;
+}
 
-erro:
-    free(str_copia);
-    liberar_pilha(&pilha);
-    return NULL;
+// Lê um literal inteiro ([+-]dígitos, até 18 dígitos, sem ponto nem expoente).
+// "-0" não conta: em float ele é -0.0, que nenhum int64 representa.
+int ler_literal_inteiro(const char *p, size_t tamanho, long long *valor) {
+    const char *fim = p + tamanho;
+    int negativo = (*p == '-');
+    p += (*p == '+' || *p == '-');
+    if (p == fim || fim - p > 18) {
+        return 0;
+    }
+    long long v = 0;
+    for (; p < fim; p++) {
+        if (!EH_DIGITO(*p)) {
+            return 0;
+        }
+        v = v * 10 + (*p - '0');
+    }
+    if (negativo && v == 0) {
+        return 0;
+    }
+    *valor = negativo ? -v : v;
+    return 1;
+}
+
+// Reconhece o nome de uma função unária pelo tamanho e pelos caracteres
+Opcode funcao_do_nome(const char *nome, size_t tamanho) {
+    switch (tamanho) {
+        case 2:
+            return (nome[0] == 't' && nome[1] == 'g') ? OP_TANGENTE : NUM_OPCODES;
+        case 3:
+            if (memcmp(nome, "sen", 3) == 0) return OP_SENO;
+            if (memcmp(nome, "cos", 3) == 0) return OP_COSSENO;
+            if (memcmp(nome, "log", 3) == 0) return OP_LOGARITMO;
+            return NUM_OPCODES;
+        case 4:
+            return (memcmp(nome, "raiz", 4) == 0) ? OP_RAIZ : NUM_OPCODES;
+        default:
+            return NUM_OPCODES;
+    }
+}
+
+// Classifica o trecho [p, p + tamanho) de um token pós-fixo
+TipoToken classificar_token(const char *p, size_t tamanho, Token *token) {
+    switch (p[0]) {
+        case '+':
+        case '-':
+            if (tamanho == 1) {
+                token->op = (p[0] == '+') ? OP_SOMA : OP_SUBTRACAO;
+                return TOKEN_OPERADOR;
+            }
+            return (ler_numero(p, &token->valor) == p + tamanho) ? TOKEN_NUMERO : TOKEN_INVALIDO;
+        case '*':
+            token->op = OP_MULTIPLICACAO;
+            return (tamanho == 1) ? TOKEN_OPERADOR : TOKEN_INVALIDO;
+        case '/':
+            token->op = OP_DIVISAO;
+            return (tamanho == 1) ? TOKEN_OPERADOR : TOKEN_INVALIDO;
+        case '%':
+            token->op = OP_MODULO;
+            return (tamanho == 1) ? TOKEN_OPERADOR : TOKEN_INVALIDO;
+        case '^':
+            token->op = OP_POTENCIA;
+            return (tamanho == 1) ? TOKEN_OPERADOR : TOKEN_INVALIDO;
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+        case '.':
+            return (ler_numero(p, &token->valor) == p + tamanho) ? TOKEN_NUMERO : TOKEN_INVALIDO;
+        default:
+            break;
+    }
+    if (!EH_LETRA(p[0])) {
+        return TOKEN_INVALIDO;
+    }
+    token->op = funcao_do_nome(p, tamanho);
+    if (token->op != NUM_OPCODES) {
+        return TOKEN_OPERADOR;
+    }
+    for (size_t i = 1; i < tamanho; i++) {
+        if (!EH_LETRA(p[i]) && !EH_DIGITO(p[i])) {
+            return TOKEN_INVALIDO;
+        }
+    }
+    return TOKEN_VARIAVEL;
+}
+
+// Posiciona o analisador léxico no início do texto
+void iniciarAnalisadorLexico(AnalisadorLexico *lexico, const char *texto) {
+    lexico->inicio = texto;
+    lexico->cursor = texto;
+}
+
+/*
+ * proximoToken
+ * ------------
+ * Lê o próximo token pós-fixo diretamente no texto, sem copiá-lo: tokens são
+ * separados por qualquer espaço em branco (espaço, tabulação, quebra de linha).
+ * Operadores e funções são reconhecidos por um switch no primeiro caractere e
+ * no tamanho, e números são convertidos por ler_numero.
+ *
+ * Parâmetros:
+ * - lexico: Analisador iniciado por iniciarAnalisadorLexico.
+ * - token: Recebe o tipo, o trecho (inicio, tamanho) e o opcode ou valor.
+ *
+ * Retorno:
+ * - O tipo do token (TOKEN_FIM quando o texto termina).
+ */
+TipoToken proximoToken(AnalisadorLexico *lexico, Token *token) {
+    const char *p = lexico->cursor;
+    while (EH_ESPACO(*p)) p++;
+
+    const char *fim = p;
+    while (*fim != '\0' && !EH_ESPACO(*fim)) fim++;
+
+    token->inicio = p;
+    token->tamanho = (size_t)(fim - p);
+    token->op = NUM_OPCODES;
+    token->valor = 0.0f;
+    lexico->cursor = fim;
+
+    token->tipo = (fim == p) ? TOKEN_FIM : classificar_token(p, token->tamanho, token);
+    return token->tipo;
+}
+
+// Conta os tokens de uma expressão pós-fixa sem classificá-los
+int contar_tokens(const char *p) {
+    int num_tokens = 0;
+    for (;;) {
+        while (EH_ESPACO(*p)) p++;
+        if (*p == '\0') {
+            return num_tokens;
+        }
+        num_tokens++;
+        while (*p != '\0' && !EH_ESPACO(*p)) p++;
+    }
+}
+
+// =================================================================================
+// ERROS
+// =================================================================================
+
+// Nome curto de cada código e a mensagem que as funções principais imprimem (NULL = nenhuma)
+static const struct {
+    const char *nome;
+    const char *mensagem;
+} descricoes_erro[NUM_CODIGOS_ERRO] = {
+    {"nenhum", NULL},
+    {"divisao_por_zero", "Erro: Divisao por zero."},
+    {"modulo_por_zero", "Erro: Modulo por zero."},
+    {"raiz_negativa", "Erro: Raiz quadrada de numero negativo."},
+    {"logaritmo_nao_positivo", "Erro: Logaritmo de numero nao positivo."},
+    {"resultado_invalido", NULL},
+    {"token_invalido", "Erro: Token invalido na expressao pos-fixa:"},
+    {"operador_sem_operandos", "Erro: Expressao pos-fixa invalida (operador binario sem operandos)."},
+    {"operador_um_operando", "Erro: Expressao pos-fixa invalida (operador binario com apenas um operando)."},
+    {"funcao_sem_operando", "Erro: Expressao pos-fixa invalida (funcao unaria sem operando)."},
+    {"operandos_restantes", "Erro: Expressao pos-fixa invalida (operandos restantes)."},
+    {"expressao_vazia", NULL},
+    {"memoria", "Erro de alocacao de memoria."},
+    {"entrada_saida", "Erro: Falha de leitura ou escrita."},
+    {"programa_grande", "Erro: Expressao grande demais para um programa compilado (mais de 2^24 constantes ou variaveis)."}
+};
+
+// Erros por código, somados atomicamente por todas as threads
+unsigned long long contadores_erro[NUM_CODIGOS_ERRO];
+
+// Preenche *erro e conta o erro (uma vez por chamada às funções ComErro)
+void registrar_erro(ErroExpressao *erro, CodigoErro codigo, long posicao) {
+    erro->codigo = codigo;
+    erro->posicao = posicao;
+    if (codigo != ERRO_NENHUM) {
+        __atomic_fetch_add(&contadores_erro[codigo], 1, __ATOMIC_RELAXED);
+    }
+}
+
+// Imprime em stderr a mensagem de um erro (usada só pelas funções que imprimem)
+void imprimir_erro(const char *str, const ErroExpressao *erro) {
+    const char *mensagem = descricoes_erro[erro->codigo].mensagem;
+    if (mensagem == NULL) {
+        return;
+    }
+    if (erro->codigo == ERRO_TOKEN_INVALIDO) {
+        const char *token = str + erro->posicao;
+        size_t tamanho = 0;
+        while (token[tamanho] != '\0' && !EH_ESPACO(token[tamanho])) {
+            tamanho++;
+        }
+        fprintf(stderr, "%s %.*s\n", mensagem, (int)tamanho, token);
+    } else {
+        fprintf(stderr, "%s\n", mensagem);
+    }
+}
+
+// Nome curto e estável de um código de erro, para logs e métricas
+const char *nomeCodigoErro(CodigoErro codigo) {
+    return ((unsigned int)codigo < NUM_CODIGOS_ERRO) ? descricoes_erro[codigo].nome : "desconhecido";
+}
+
+// Copia os contadores de erro por código (acumulados desde o início do processo)
+void obterContadoresErro(unsigned long long contadores[NUM_CODIGOS_ERRO]) {
+    for (int i = 0; i < NUM_CODIGOS_ERRO; i++) {
+        contadores[i] = __atomic_load_n(&contadores_erro[i], __ATOMIC_RELAXED);
+    }
+}
+
+// =================================================================================
+// ÁRVORE DE EXPRESSÃO
+// =================================================================================
+
+// Libera a memória de uma árvore de expressão
+void liberar_arvore(ArvoreExpressao *arvore) {
+    free(arvore->nos);
+    for (int i = 0; i < arvore->num_variaveis; i++) {
+        free(arvore->nomes_variaveis[i]);
+    }
+    free(arvore->nomes_variaveis);
+    memset(arvore, 0, sizeof(ArvoreExpressao));
+}
+
+/*
+ * construir_arvore
+ * ----------------
+ * Constrói a árvore de uma expressão pós-fixa. Como os nós são guardados na
+ * ordem dos tokens, não é preciso uma pilha de nós: o filho direito de um
+ * operador é o nó anterior e o esquerdo vem logo antes da subárvore direita.
+ *
+ * Parâmetros:
+ * - str: String contendo a expressão pós-fixa.
+ * - aceitar_variaveis: 1 para aceitar nomes de variáveis como operandos.
+ * - arvore: Estrutura que recebe a árvore.
+ * - erro: Recebe o código e a posição do erro (sem E/S e sem contar o erro).
+ *
+ * Retorno:
+ * - 1 em caso de sucesso; 0 se a expressão for inválida.
+ */
+int construir_arvore(const char *str, int aceitar_variaveis, ArvoreExpressao *arvore, ErroExpressao *erro) {
+    AnalisadorLexico lexico;
+    Token token;
+    int num_tokens = contar_tokens(str);
+    int altura = 0;
+
+    memset(arvore, 0, sizeof(ArvoreExpressao));
+    erro->codigo = ERRO_NENHUM;
+    erro->posicao = -1;
+    if (num_tokens == 0) {
+        erro->codigo = ERRO_EXPRESSAO_VAZIA;
+        return 0;
+    }
+    INSTR_ALOCACOES(1);
+    arvore->nos = (NoArvore *)malloc(num_tokens * sizeof(NoArvore));
+    if (arvore->nos == NULL) {
+        erro->codigo = ERRO_MEMORIA;
+        return 0;
+    }
+
+    iniciarAnalisadorLexico(&lexico, str);
+    while (proximoToken(&lexico, &token) != TOKEN_FIM) {
+        int i = arvore->num_nos;
+        NoArvore *no = &arvore->nos[i];
+
+        no->texto = token.inicio;
+        no->tamanho_texto = token.tamanho;
+        no->esquerdo = -1;
+        no->direito = -1;
+        no->tamanho = 1;
+        no->variavel = -1;
+        no->valor = 0.0f;
+        erro->posicao = (long)(token.inicio - str);
+
+        Opcode op = token.op;
+
+        if (token.tipo == TOKEN_NUMERO) {
+            // É um operando (número)
+            no->op = OP_CONSTANTE;
+            no->valor = token.valor;
+            altura++;
+        } else if (token.tipo == TOKEN_VARIAVEL && aceitar_variaveis) {
+            // É uma variável
+            no->op = OP_VARIAVEL;
+            no->variavel = registrar_nome(&arvore->nomes_variaveis, &arvore->num_variaveis,
+                                          token.inicio, token.tamanho);
+            if (no->variavel < 0) {
+                erro->codigo = ERRO_MEMORIA;
+                goto erro;
+            }
+            altura++;
+        } else if (token.tipo == TOKEN_OPERADOR && opcode_eh_binario(op)) {
+            // É um operador binário: direito = nó anterior, esquerdo = antes da subárvore direita
+            if (altura < 2) {
+                erro->codigo = (altura == 0) ? ERRO_OPERADOR_SEM_OPERANDOS : ERRO_OPERADOR_UM_OPERANDO;
+                goto erro;
+            }
+            no->op = op;
+            no->direito = i - 1;
+            no->esquerdo = i - 1 - arvore->nos[i - 1].tamanho;
+            no->tamanho = 1 + arvore->nos[no->esquerdo].tamanho + arvore->nos[no->direito].tamanho;
+            altura--;
+        } else if (token.tipo == TOKEN_OPERADOR) {
+            // É uma função unária: o único filho é o nó anterior
+            if (altura == 0) {
+                erro->codigo = ERRO_FUNCAO_SEM_OPERANDO;
+                goto erro;
+            }
+            no->op = op;
+            no->esquerdo = i - 1;
+            no->tamanho = 1 + arvore->nos[i - 1].tamanho;
+        } else {
+            // Token inválido (não é número nem operador)
+            erro->codigo = ERRO_TOKEN_INVALIDO;
+            goto erro;
+        }
+        arvore->num_nos++;
+    }
+
+    // Ao final, deve restar apenas a raiz
+    if (altura != 1) {
+        erro->codigo = ERRO_OPERANDOS_RESTANTES;
+        erro->posicao = -1;
+        goto erro;
+    }
+    erro->posicao = -1;
+    return 1;
+
+erro:
+    liberar_arvore(arvore);
+    return 0;
+}
+
+// Precedência na forma infixa: + - (1), * / % (2), ^ (3), folhas e funções (4)
+int precedencia_opcode(Opcode op) {
+    switch (op) {
+        case OP_SOMA:
+        case OP_SUBTRACAO:
+            return 1;
+        case OP_MULTIPLICACAO:
+        case OP_DIVISAO:
+        case OP_MODULO:
+            return 2;
+        case OP_POTENCIA:
+            return 3;
+        default:
+            return 4;
+    }
+}
+
+// Verifica se o nó é um número escrito com sinal (ex: "-4"), que se comporta
+// como um menos unário: "3-(-4)" e "(-4)^2" precisam de parênteses
+int literal_com_sinal(const NoArvore *no) {
+    return no->op == OP_CONSTANTE && (no->texto[0] == '-' || no->texto[0] == '+');
+}
+
+// Verifica se o filho de um operador binário precisa de parênteses. 'filho_com_sinal':
+// o texto do filho começa com sinal, seja um literal ("-4") ou uma operação cujo
+// operando mais à esquerda é um ("-4*3"), e por isso pede "1-(-4*3)" e "(-4)^2".
+int precisa_parenteses_opcodes(Opcode pai, Opcode filho, int filho_com_sinal, int eh_direito) {
+    int prec_pai = precedencia_opcode(pai);
+    int prec_filho = precedencia_opcode(filho);
+
+    if (filho_com_sinal && (eh_direito || pai == OP_POTENCIA)) {
+        return 1;
+    }
+    if (prec_filho != prec_pai) {
+        return prec_filho < prec_pai;
+    }
+    // Mesma precedência: ^ associa à direita; os demais, à esquerda
+    return (pai == OP_POTENCIA) ? !eh_direito : eh_direito;
+}
+
+// Bits de 'parenteses' em medir_infixa e escrever_infixa
+#define ENTRE_PARENTESES 1u    // O nó é escrito entre parênteses (decidido pelo pai)
+#define TEXTO_COM_SINAL 2u     // O texto do nó começa com sinal (ex: "-4" ou "-4*3")
+
+// Fase 1 de gerar_infixa_subarvore: em ordem pós-fixa (filhos antes dos pais),
+// calcula o tamanho do texto de cada um dos n nós a partir de 'base' (sem os
+// parênteses externos) e decide quais filhos ficam entre parênteses. Retorna o
+// tamanho do texto inteiro.
+size_t medir_infixa(const NoArvore *nos, int n, int base, size_t *comprimento, unsigned char *parenteses) {
+    for (int i = 0; i < n; i++) {
+        const NoArvore *no = &nos[i];
+        int esquerdo = no->esquerdo - base;
+        int direito = no->direito - base;
+        parenteses[i] = literal_com_sinal(no) ? TEXTO_COM_SINAL : 0;
+        if (no->op == OP_CONSTANTE || no->op == OP_VARIAVEL) {
+            comprimento[i] = no->tamanho_texto;
+        } else if (no->direito < 0) {
+            comprimento[i] = no->tamanho_texto + 2 + comprimento[esquerdo];
+        } else {
+            if (precisa_parenteses_opcodes(no->op, nos[esquerdo].op, (parenteses[esquerdo] & TEXTO_COM_SINAL) != 0, 0)) {
+                parenteses[esquerdo] = ENTRE_PARENTESES;
+            }
+            if (precisa_parenteses_opcodes(no->op, nos[direito].op, (parenteses[direito] & TEXTO_COM_SINAL) != 0, 1)) {
+                parenteses[direito] = ENTRE_PARENTESES;
+            }
+            // O texto começa pelo do operando esquerdo
+            parenteses[i] = parenteses[esquerdo] & TEXTO_COM_SINAL;
+            comprimento[i] = comprimento[esquerdo] + 2 * (parenteses[esquerdo] & ENTRE_PARENTESES) +
+                             no->tamanho_texto +
+                             comprimento[direito] + 2 * (parenteses[direito] & ENTRE_PARENTESES);
+        }
+    }
+    return comprimento[n - 1];
+}
+
+// Fase 2: em ordem inversa (pais antes dos filhos), cada nó escreve seus próprios
+// caracteres em 'saida' e informa a cada filho a posição onde o texto dele começa.
+// 'saida' precisa de medir_infixa(...) + 1 bytes.
+void escrever_infixa(const NoArvore *nos, int n, int base, const size_t *comprimento, size_t *posicao,
+                     const unsigned char *parenteses, char *saida) {
+    posicao[n - 1] = 0;
+    for (int i = n - 1; i >= 0; i--) {
+        const NoArvore *no = &nos[i];
+        int esquerdo = no->esquerdo - base;
+        int direito = no->direito - base;
+        char *texto = saida + posicao[i];
+        if (parenteses[i] & ENTRE_PARENTESES) {
+            texto[0] = '(';
+            texto[1 + comprimento[i]] = ')';
+            texto++;
+        }
+        size_t inicio = (size_t)(texto - saida);
+
+        if (no->op == OP_CONSTANTE || no->op == OP_VARIAVEL) {
+            memcpy(texto, no->texto, no->tamanho_texto);
+        } else if (no->direito < 0) {
+            // função(argumento)
+            memcpy(texto, no->texto, no->tamanho_texto);
+            texto[no->tamanho_texto] = '(';
+            texto[comprimento[i] - 1] = ')';
+            posicao[esquerdo] = inicio + no->tamanho_texto + 1;
+        } else {
+            // esquerdo operador direito
+            size_t tamanho_esquerdo = comprimento[esquerdo] + 2 * (parenteses[esquerdo] & ENTRE_PARENTESES);
+            memcpy(texto + tamanho_esquerdo, no->texto, no->tamanho_texto);
+            posicao[esquerdo] = inicio;
+            posicao[direito] = inicio + tamanho_esquerdo + no->tamanho_texto;
+        }
+    }
+    saida[comprimento[n - 1]] = '\0';
+}
+
+/*
+ * gerar_infixa_subarvore
+ * ----------------------
+ * Gera o texto infixo de uma subárvore em tempo linear e sem recursão:
+ * 1) em ordem pós-fixa (filhos antes dos pais), calcula o tamanho do texto de
+ *    cada subárvore e decide quais filhos ficam entre parênteses (medir_infixa);
+ * 2) em ordem inversa (pais antes dos filhos), cada nó escreve seus próprios
+ *    caracteres e informa a cada filho a posição onde o texto dele começa
+ *    (escrever_infixa).
+ * Cada caractere da saída é escrito uma única vez.
+ *
+ * Parâmetros:
+ * - arvore: Árvore construída por construir_arvore.
+ * - raiz: Índice da raiz da subárvore (num_nos - 1 para a expressão inteira).
+ *
+ * Retorno:
+ * - String infixa alocada dinamicamente, ou NULL se faltar memória.
+ */
+char *gerar_infixa_subarvore(const ArvoreExpressao *arvore, int raiz) {
+    int n = arvore->nos[raiz].tamanho;
+    int base = raiz - n + 1; // A subárvore ocupa os nós [base, raiz]
+    const NoArvore *nos = arvore->nos + base;
+    INSTR_ALOCACOES(3);
+    size_t *comprimento = (size_t *)malloc(n * sizeof(size_t)); // Texto sem os parênteses externos
+    size_t *posicao = (size_t *)malloc(n * sizeof(size_t));     // Início do texto, com parênteses
+    unsigned char *parenteses = (unsigned char *)malloc(n);
+    char *saida = NULL;
+
+    if (n <= 0 || comprimento == NULL || posicao == NULL || parenteses == NULL) {
+        goto fim;
+    }
+
+    size_t total = medir_infixa(nos, n, base, comprimento, parenteses);
+    INSTR_ALOCACOES(1);
+    saida = (char *)malloc(total + 1);
+    if (saida == NULL) {
+        goto fim;
+    }
+    escrever_infixa(nos, n, base, comprimento, posicao, parenteses, saida);
+
+fim:
+    free(comprimento);
+    free(posicao);
+    free(parenteses);
+    return saida;
+}
+
+// Gera o texto infixo da expressão inteira (NULL se a árvore estiver vazia ou faltar memória)
+char *gerar_infixa(const ArvoreExpressao *arvore) {
+    if (arvore->num_nos <= 0) {
+        return NULL;
+    }
+    return gerar_infixa_subarvore(arvore, arvore->num_nos - 1);
+}
+
+// =================================================================================
+// FUNÇÕES PRINCIPAIS (expressao.h)
+// =================================================================================
+
+/*
+ * getValorPosFixaComModo
+ * ----------------------
+ * Calcula o valor numérico de uma expressão na notação pós-fixa sem nenhuma
+ * E/S: em caso de erro, informa o código e a posição do token responsável e
+ * soma o erro aos contadores (obterContadoresErro). Subexpressões só com
+ * literais inteiros e +, -, *, /, %, ^ são calculadas exatamente em int64 e
+ * arredondadas uma única vez para float (ex: "16777217 1 + 16777217 -" dá 1);
+ * transbordamentos e divisões não exatas continuam em float.
+ *
+ * Parâmetros:
+ * - StrPosFixa: String contendo a expressão pós-fixa (ex: "3 4 + 5 *").
+ * - modo: CALCULO_EXATO ou CALCULO_RAPIDO (funções aproximadas).
+ * - erro: Recebe ERRO_NENHUM ou a causa do erro.
+ *
+ * Retorno:
+ * - O valor numérico da expressão. Retorna NAN (Not a Number) em caso de erro.
+ */
+float getValorPosFixaComModo(const char *StrPosFixa, ModoCalculo modo, ErroExpressao *erro) {
+    INSTR_INICIO(inicio_medida);
+    ValorMisto buffer_pilha[CAPACIDADE_NUMEROS_LOCAL];
+    PilhaMista pilha;
+    inicializar_pilha_mista(&pilha, buffer_pilha, CAPACIDADE_NUMEROS_LOCAL);
+
+    // Percorre os tokens diretamente na string de entrada (sem cópia)
+    AnalisadorLexico lexico;
+    Token token;
+    CodigoErro codigo = ERRO_NENHUM;
+    float resultado = NAN;
+
+    iniciarAnalisadorLexico(&lexico, StrPosFixa);
+    while (proximoToken(&lexico, &token) != TOKEN_FIM) {
+        if (token.tipo == TOKEN_NUMERO) {
+            // É um número válido: literais inteiros ficam exatos em int64
+            INSTR_TOKEN(OP_CONSTANTE);
+            ValorMisto *valor = empilhar_misto(&pilha);
+            if (valor == NULL) {
+                codigo = ERRO_MEMORIA;
+                goto erro;
+            }
+            valor->eh_inteiro = ler_literal_inteiro(token.inicio, token.tamanho, &valor->inteiro);
+            valor->real = token.valor;
+            INSTR_ALTURA_PILHA(pilha.topo + 1);
+        } else if (token.tipo == TOKEN_OPERADOR && opcode_eh_binario(token.op)) {
+            // É um operador binário
+            INSTR_TOKEN(token.op);
+            if (pilha.topo < 0) {
+                codigo = ERRO_OPERADOR_SEM_OPERANDOS;
+                goto erro;
+            }
+            if (pilha.topo < 1) {
+                codigo = ERRO_OPERADOR_UM_OPERANDO;
+                goto erro;
+            }
+            // O resultado fica no lugar do primeiro operando
+            pilha.topo--;
+            if (!aplicar_operacao_mista(token.op, &pilha.dados[pilha.topo], &pilha.dados[pilha.topo + 1], &codigo)) {
+                goto erro;
+            }
+        } else if (token.tipo == TOKEN_OPERADOR) {
+            // É uma função unária (sempre em float)
+            INSTR_TOKEN(token.op);
+            if (pilha.topo < 0) {
+                codigo = ERRO_FUNCAO_SEM_OPERANDO;
+                goto erro;
+            }
+            ValorMisto *op1 = &pilha.dados[pilha.topo];
+            resultado = (modo == CALCULO_RAPIDO) ? aplicar_operacao_rapida(token.op, valor_real(op1), 0.0f, &codigo)
+                                                 : aplicar_operacao(token.op, valor_real(op1), 0.0f, &codigo);
+            if (isnan(resultado)) {
+                goto erro;
+            }
+            op1->real = resultado;
+            op1->eh_inteiro = 0;
+        } else {
+            // Token inválido (não é número nem operador)
+            codigo = ERRO_TOKEN_INVALIDO;
+            goto erro;
+        }
+    }
+
+    // Ao final, a pilha deve conter apenas o resultado
+    if (pilha.topo < 0) {
+        // Expressão vazia
+        codigo = ERRO_EXPRESSAO_VAZIA;
+        resultado = NAN;
+    } else if (pilha.topo > 0) {
+        codigo = ERRO_OPERANDOS_RESTANTES;
+        resultado = NAN;
+    } else {
+        resultado = valor_real(&pilha.dados[0]);
+    }
+
+    liberar_pilha_mista(&pilha);
+    registrar_erro(erro, codigo, -1);
+    INSTR_FIM(MEDIDA_VALOR_POSFIXA, inicio_medida);
+    return resultado;
+
+erro:
+    liberar_pilha_mista(&pilha);
+    registrar_erro(erro, codigo, (long)(token.inicio - StrPosFixa));
+    INSTR_FIM(MEDIDA_VALOR_POSFIXA, inicio_medida);
+    return NAN;
+}
+
+// Calcula o valor de uma expressão pós-fixa sem E/S (getValorPosFixaComModo exato)
+float getValorPosFixaComErro(const char *StrPosFixa, ErroExpressao *erro) {
+    return getValorPosFixaComModo(StrPosFixa, CALCULO_EXATO, erro);
+}
+
+/*
+ * getValorPosFixa
+ * ---------------
+ * Calcula o valor numérico de uma expressão na notação pós-fixa.
+ *
+ * Parâmetro:
+ * - StrPosFixa: String contendo a expressão pós-fixa (ex: "3 4 + 5 *").
+ *
+ * Retorno:
+ * - O valor numérico da expressão. Retorna NAN (Not a Number) em caso de erro,
+ *   com a mensagem correspondente em stderr.
+ */
+float getValorPosFixa(char *StrPosFixa) {
+    ErroExpressao erro;
+    float resultado = getValorPosFixaComErro(StrPosFixa, &erro);
+    if (erro.codigo != ERRO_NENHUM) {
+        imprimir_erro(StrPosFixa, &erro);
+    }
+    return resultado;
+}
+
+/*
+ * getFormaInFixaComErro
+ * ---------------------
+ * Converte uma expressão na notação pós-fixa para a notação infixa sem
+ * nenhuma E/S. A expressão vira uma árvore (construir_arvore) e o texto é
+ * gerado em uma passada linear (gerar_infixa), sem limite de tamanho e apenas
+ * com os parênteses exigidos pela precedência e associatividade dos operadores.
+ *
+ * Parâmetros:
+ * - Str: String contendo a expressão pós-fixa (ex: "3 4 + 5 *").
+ * - erro: Recebe ERRO_NENHUM ou a causa do erro.
+ *
+ * Retorno:
+ * - Ponteiro para a string infixa resultante (alocada dinamicamente).
+ * - NULL em caso de erro (ex: expressão pós-fixa inválida).
+ */
+char * getFormaInFixaComErro(const char *Str, ErroExpressao *erro) {
+    INSTR_INICIO(inicio_medida);
+    ArvoreExpressao arvore;
+    if (!construir_arvore(Str, 0, &arvore, erro)) {
+        registrar_erro(erro, erro->codigo, erro->posicao);
+        INSTR_FIM(MEDIDA_FORMA_INFIXA, inicio_medida);
+        return NULL;
+    }
+
+    char *resultado_infixa = gerar_infixa(&arvore);
+    liberar_arvore(&arvore);
+    registrar_erro(erro, (resultado_infixa == NULL) ? ERRO_MEMORIA : ERRO_NENHUM, -1);
+    INSTR_FIM(MEDIDA_FORMA_INFIXA, inicio_medida);
+    return resultado_infixa;
+}
+
+/*
+ * getFormaInFixa
+ * --------------
+ * Converte uma expressão na notação pós-fixa para a notação infixa
+ * (ver getFormaInFixaComErro), imprimindo a mensagem de erro em stderr.
+ *
+ * Parâmetro:
+ * - Str: String contendo a expressão pós-fixa (ex: "3 4 + 5 *").
+ *
+ * Retorno:
+ * - Ponteiro para a string infixa resultante (alocada dinamicamente).
+ * - NULL em caso de erro (ex: expressão pós-fixa inválida).
+ */
+char * getFormaInFixa(char *Str) {
+    ErroExpressao erro;
+    char *resultado_infixa = getFormaInFixaComErro(Str, &erro);
+    if (erro.codigo != ERRO_NENHUM) {
+        imprimir_erro(Str, &erro);
+    }
+    return resultado_infixa;
+}
+
+// =================================================================================
+// EXPRESSÃO COMPLETA (valor e forma infixa em uma passada, sem alocação)
+// =================================================================================
+
+// Tokens que cabem em Expressao.posFixa: separados por espaço e seguidos de '\0'
+#define MAX_TOKENS_EXPRESSAO ((int)((sizeof(((Expressao *)0)->posFixa) + 1) / 2))
+
+/*
+ * preencherExpressao
+ * ------------------
+ * Preenche inFixa e Valor a partir de posFixa em uma única leitura dos tokens:
+ * cada token vira um nó da árvore (como em construir_arvore) e, ao mesmo tempo,
+ * é aplicado à pilha mista (como em getValorPosFixaComModo). Como posFixa tem
+ * tamanho fixo, a árvore, a pilha e os vetores de gerar_infixa_subarvore cabem
+ * na pilha de execução, e o texto é escrito direto em inFixa: nenhum malloc.
+ *
+ * Parâmetros:
+ * - expressao: Registro com posFixa preenchido; recebe inFixa e Valor.
+ * - erro: Recebe o mesmo código e posição de getValorPosFixaComErro.
+ *
+ * Retorno:
+ * - 1 se inFixa recebeu a forma de getFormaInFixa (mesmo com erro de cálculo,
+ *   como em "5 0 /"); 0 se a expressão for inválida ou a forma infixa não couber
+ *   em inFixa (que fica vazia). Valor é NAN em qualquer erro.
+ */
+int preencherExpressao(Expressao *expressao, ErroExpressao *erro) {
+    NoArvore nos[MAX_TOKENS_EXPRESSAO];
+    ValorMisto pilha[MAX_TOKENS_EXPRESSAO];
+    size_t comprimento[MAX_TOKENS_EXPRESSAO];
+    size_t posicao[MAX_TOKENS_EXPRESSAO];
+    unsigned char parenteses[MAX_TOKENS_EXPRESSAO];
+    const char *str = expressao->posFixa;
+    AnalisadorLexico lexico;
+    Token token;
+    CodigoErro codigo = ERRO_NENHUM;       // Primeiro erro de cálculo
+    long posicao_erro = -1;
+    CodigoErro codigo_estrutura = ERRO_NENHUM;
+    int altura = 0;
+    int n = 0;
+
+    expressao->inFixa[0] = '\0';
+    expressao->Valor = NAN;
+    if (memchr(str, '\0', sizeof(expressao->posFixa)) == NULL) {
+        registrar_erro(erro, ERRO_TOKEN_INVALIDO, 0);
+        return 0;
+    }
+
+    iniciarAnalisadorLexico(&lexico, str);
+    while (proximoToken(&lexico, &token) != TOKEN_FIM) {
+        NoArvore *no = &nos[n];
+        no->texto = token.inicio;
+        no->tamanho_texto = token.tamanho;
+        no->esquerdo = -1;
+        no->direito = -1;
+        no->tamanho = 1;
+        no->op = token.op;
+
+        if (token.tipo == TOKEN_NUMERO) {
+            // Número: literais inteiros ficam exatos em int64
+            no->op = OP_CONSTANTE;
+            pilha[altura].eh_inteiro = ler_literal_inteiro(token.inicio, token.tamanho, &pilha[altura].inteiro);
+            pilha[altura].real = token.valor;
+            altura++;
+        } else if (token.tipo == TOKEN_OPERADOR && opcode_eh_binario(token.op)) {
+            // Operador binário: direito = nó anterior, esquerdo = antes da subárvore direita
+            if (altura < 2) {
+                codigo_estrutura = (altura == 0) ? ERRO_OPERADOR_SEM_OPERANDOS : ERRO_OPERADOR_UM_OPERANDO;
+                break;
+            }
+            no->direito = n - 1;
+            no->esquerdo = n - 1 - nos[n - 1].tamanho;
+            no->tamanho = 1 + nos[no->esquerdo].tamanho + nos[no->direito].tamanho;
+            altura--;
+            // Depois do primeiro erro de cálculo, só a árvore continua
+            if (codigo == ERRO_NENHUM && !aplicar_operacao_mista(token.op, &pilha[altura - 1], &pilha[altura], &codigo)) {
+                posicao_erro = (long)(token.inicio - str);
+            }
+        } else if (token.tipo == TOKEN_OPERADOR) {
+            // Função unária (sempre em float): o único filho é o nó anterior
+            if (altura == 0) {
+                codigo_estrutura = ERRO_FUNCAO_SEM_OPERANDO;
+                break;
+            }
+            no->esquerdo = n - 1;
+            no->tamanho = 1 + nos[n - 1].tamanho;
+            if (codigo == ERRO_NENHUM) {
+                ValorMisto *op1 = &pilha[altura - 1];
+                float resultado = aplicar_operacao(token.op, valor_real(op1), 0.0f, &codigo);
+                if (isnan(resultado)) {
+                    posicao_erro = (long)(token.inicio - str);
+                }
+                op1->real = resultado;
+                op1->eh_inteiro = 0;
+            }
+        } else {
+            // Token inválido (não é número nem operador)
+            codigo_estrutura = ERRO_TOKEN_INVALIDO;
+            break;
+        }
+        n++;
+    }
+
+    if (codigo_estrutura != ERRO_NENHUM) {
+        // Como em getValorPosFixaComErro, um erro de cálculo anterior prevalece
+        if (codigo == ERRO_NENHUM) {
+            codigo = codigo_estrutura;
+            posicao_erro = (long)(token.inicio - str);
+        }
+        registrar_erro(erro, codigo, posicao_erro);
+        return 0;
+    }
+    if (altura != 1) {
+        if (codigo == ERRO_NENHUM) {
+            codigo = (altura == 0) ? ERRO_EXPRESSAO_VAZIA : ERRO_OPERANDOS_RESTANTES;
+        }
+        registrar_erro(erro, codigo, posicao_erro);
+        return 0;
+    }
+
+    if (codigo == ERRO_NENHUM) {
+        expressao->Valor = valor_real(&pilha[0]);
+    }
+    registrar_erro(erro, codigo, posicao_erro);
+    if (medir_infixa(nos, n, 0, comprimento, parenteses) >= sizeof(expressao->inFixa)) {
+        return 0;
+    }
+    escrever_infixa(nos, n, 0, comprimento, posicao, parenteses, expressao->inFixa);
+    return 1;
+}
+
+// Aplica preencherExpressao a cada registro (erros pode ser NULL); retorna quantos
+// ficaram completos, com inFixa preenchida e sem erro
+size_t preencherExpressoes(Expressao *expressoes, size_t quantidade, ErroExpressao *erros) {
+    size_t completos = 0;
+    for (size_t i = 0; i < quantidade; i++) {
+        ErroExpressao erro;
+        int preenchida = preencherExpressao(&expressoes[i], &erro);
+        completos += (preenchida && erro.codigo == ERRO_NENHUM);
+        if (erros != NULL) {
+            erros[i] = erro;
+        }
+    }
+    return completos;
+}
+
+// =================================================================================
+// PRECISÃO NUMÉRICA (um avaliador por tipo, gerado por expressao_tipada.inc)
+// =================================================================================
+
+// float puro: números do analisador léxico e funções f de math.h (powf, sinf, ...)
+#define TIPO float
+#define NOME(x) x##_float
+#define MATEMATICA(funcao) funcao##f
+#define FUNCAO_AVALIACAO getValorPosFixaFloat
+#define VALOR_DO_TOKEN(token) ((token).valor)
+#include "expressao_tipada.inc"
+
+#define TIPO double
+#define NOME(x) x##_double
+#define MATEMATICA(funcao) funcao
+#define FUNCAO_AVALIACAO getValorPosFixaDouble
+#define MANTISSA_EXATA (1ull << DBL_MANT_DIG)
+#define EXPOENTE_EXATO 22
+#define CONVERTER_TEXTO strtod
+#include "expressao_tipada.inc"
+
+#define TIPO long double
+#define NOME(x) x##_long_double
+#define MATEMATICA(funcao) funcao##l
+#define FUNCAO_AVALIACAO getValorPosFixaLongDouble
+#if LDBL_MANT_DIG >= 64
+#define MANTISSA_EXATA ULLONG_MAX
+#define EXPOENTE_EXATO 27
+#else
+#define MANTISSA_EXATA (1ull << LDBL_MANT_DIG)
+#define EXPOENTE_EXATO 22
+#endif
+#define CONVERTER_TEXTO strtold
+#include "expressao_tipada.inc"
+
+// =================================================================================
+// COMPILAÇÃO NATIVA (JIT x86-64)
+// =================================================================================
+
+// ativarJit traduz as instruções de um programa em código de máquina linear,
+// sem laço nem despacho: a posição k da pilha vive no registrador xmm(k + 2),
+// as constantes ficam numa tabela logo antes do código (acesso relativo a rip)
+// e as variáveis são lidas de 'valores' (guardado em rbx). +, -, *, / e raiz
+// são instruções SSE escalares; %, ^, sen, cos, tg e log chamam operacao_nativa,
+// salvando antes na memória as posições da pilha abaixo do operando.
+//
+// O resultado é o mesmo de avaliarProgramaComVariaveis, bit a bit: as operações
+// são as mesmas, na mesma ordem e em float. No lugar da saída antecipada do
+// interpretador, um NAN intermediário se propaga até o fim e vira o NAN dele.
+
+typedef float (*FuncaoNativa)(const float *valores);
+typedef float (*FuncaoOperacaoNativa)(float op1, float op2, int op);
+
+struct CodigoNativo {
+    void *memoria;      // Tabela de constantes seguida do código (mmap, leitura e execução)
+    size_t tamanho;
+    FuncaoNativa funcao;
+    ModoCalculo modo;   // Modo com que as chamadas de operacao_nativa foram geradas
+};
+
+// Posições da pilha que cabem em registradores (xmm2..xmm15); acima disso, interpretador
+#define JIT_MAX_REGISTRADORES 14
+
+// Espaço para salvar as posições da pilha durante uma chamada (múltiplo de 16)
+#define JIT_AREA_SALVAMENTO 64
+
+// Pior caso de bytes por instrução (chamada salvando e restaurando 13 posições)
+#define JIT_BYTES_POR_INSTRUCAO 256
+
+// Liga/desliga o uso do código nativo (definirJitHabilitado)
+int jit_habilitado = 1;
+
+int jitDisponivel(void) {
+#ifdef JIT_X86_64
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+void definirJitHabilitado(int habilitado) {
+    __atomic_store_n(&jit_habilitado, habilitado != 0, __ATOMIC_RELAXED);
+}
+
+// Chamada do código nativo para %, ^, sen, cos, tg e log (op1 em xmm0, op2 em xmm1, op em edi)
+float operacao_nativa(float op1, float op2, int op) {
+    CodigoErro codigo;
+    // Mantém NAN como NAN (pow(NAN, 0) seria 1), no lugar da saída antecipada
+    if (isnan(op1) || isnan(op2)) {
+        return NAN;
+    }
+    return aplicar_operacao((Opcode)op, op1, op2, &codigo);
+}
+
+// Como operacao_nativa, com as funções aproximadas (CALCULO_RAPIDO)
+float operacao_nativa_rapida(float op1, float op2, int op) {
+    CodigoErro codigo;
+    if (isnan(op1) || isnan(op2)) {
+        return NAN;
+    }
+    return aplicar_operacao_rapida((Opcode)op, op1, op2, &codigo);
+}
+
+// Libera o código nativo de um programa (o programa volta ao interpretador)
+void liberar_codigo_nativo(ProgramaPosFixa *programa) {
+    if (programa->nativo == NULL) {
+        return;
+    }
+#ifdef JIT_X86_64
+    munmap(programa->nativo->memoria, programa->nativo->tamanho);
+#endif
+    free(programa->nativo);
+    programa->nativo = NULL;
+}
+
+#ifdef JIT_X86_64
+// Buffer de emissão com capacidade calculada antes (sem verificação por byte)
+typedef struct {
+    unsigned char *codigo;
+    size_t tamanho;
+} EmissorNativo;
+
+void emitir_byte(EmissorNativo *e, unsigned int byte) {
+    e->codigo[e->tamanho++] = (unsigned char)byte;
+}
+
+void emitir_32(EmissorNativo *e, unsigned int valor) {
+    for (int i = 0; i < 4; i++) {
+        emitir_byte(e, (valor >> (8 * i)) & 0xFFu);
+    }
+}
+
+// Prefixo, REX (se 'reg' ou 'rm' for xmm8..xmm15) e opcode 0F xx de uma instrução SSE
+void emitir_opcode_sse(EmissorNativo *e, unsigned int prefixo, unsigned int opcode, int reg, int rm) {
+    if (prefixo != 0) {
+        emitir_byte(e, prefixo);
+    }
+    if (reg >= 8 || rm >= 8) {
+        emitir_byte(e, 0x40u | ((reg >= 8) ? 0x4u : 0u) | ((rm >= 8) ? 0x1u : 0u));
+    }
+    emitir_byte(e, 0x0F);
+    emitir_byte(e, opcode);
+}
+
+// Instrução SSE entre registradores: 'destino' op= 'origem'
+void emitir_sse(EmissorNativo *e, unsigned int prefixo, unsigned int opcode, int destino, int origem) {
+    emitir_opcode_sse(e, prefixo, opcode, destino, origem);
+    emitir_byte(e, 0xC0u | ((unsigned int)(destino & 7) << 3) | (unsigned int)(origem & 7));
+}
+
+// movss entre xmm 'reg' e [rsp + deslocamento] (opcode 0x10 carrega, 0x11 guarda)
+void emitir_movss_rsp(EmissorNativo *e, unsigned int opcode, int reg, int deslocamento) {
+    emitir_opcode_sse(e, 0xF3, opcode, reg, 0);
+    emitir_byte(e, 0x44u | ((unsigned int)(reg & 7) << 3));
+    emitir_byte(e, 0x24);
+    emitir_byte(e, (unsigned int)deslocamento);
+}
+
+// Salva (0x11) ou restaura (0x10) as posições 0..quantidade-1 da pilha
+void emitir_salvamento(EmissorNativo *e, unsigned int opcode, int quantidade) {
+    for (int k = 0; k < quantidade; k++) {
+        emitir_movss_rsp(e, opcode, k + 2, 4 * k);
+    }
+}
+
+// Chama operacao_nativa(xmm0, xmm1, op) com o resultado em xmm(2 + posicao)
+void emitir_chamada(EmissorNativo *e, Opcode op, int posicao, int binario, FuncaoOperacaoNativa funcao) {
+    emitir_salvamento(e, 0x11, posicao);
+    emitir_sse(e, 0, 0x28, 0, posicao + 2);           // movaps xmm0, op1
+    if (binario) {
+        emitir_sse(e, 0, 0x28, 1, posicao + 3);       // movaps xmm1, op2
+    } else {
+        emitir_sse(e, 0, 0x57, 1, 1);                 // xorps xmm1, xmm1
+    }
+    emitir_byte(e, 0xBF);                             // mov edi, op
+    emitir_32(e, (unsigned int)op);
+    unsigned long long endereco = (unsigned long long)(uintptr_t)funcao;
+    emitir_byte(e, 0x48);                             // mov rax, funcao
+    emitir_byte(e, 0xB8);
+    emitir_32(e, (unsigned int)(endereco & 0xFFFFFFFFu));
+    emitir_32(e, (unsigned int)(endereco >> 32));
+    emitir_byte(e, 0xFF);                             // call rax
+    emitir_byte(e, 0xD0);
+    emitir_sse(e, 0, 0x28, posicao + 2, 0);           // movaps resultado, xmm0
+    emitir_salvamento(e, 0x10, posicao);
+}
+#endif
+
+int ativarJit(ProgramaPosFixa *programa) {
+#ifdef JIT_X86_64
+    if (programa->nativo != NULL && programa->nativo->modo == programa->modo) {
+        return 1;
+    }
+    liberar_codigo_nativo(programa);
+    if (!__atomic_load_n(&jit_habilitado, __ATOMIC_RELAXED) || programa->num_instrucoes == 0 ||
+        programa->profundidade_maxima > JIT_MAX_REGISTRADORES) {
+        return 0;
+    }
+
+    // Layout: constantes, um NAN (alinhados em 16) e depois o código, a partir de 'inicio'
+    size_t posicao_nan = (size_t)programa->num_constantes * sizeof(float);
+    size_t inicio = (posicao_nan + sizeof(float) + 15) & ~(size_t)15;
+    size_t capacidade = inicio + 32 + (size_t)programa->num_instrucoes * JIT_BYTES_POR_INSTRUCAO;
+    EmissorNativo e;
+    e.codigo = (unsigned char *)malloc(capacidade);
+    struct CodigoNativo *nativo = (struct CodigoNativo *)malloc(sizeof(struct CodigoNativo));
+    if (e.codigo == NULL || nativo == NULL) {
+        free(e.codigo);
+        free(nativo);
+        return 0;
+    }
+    memset(e.codigo, 0, inicio);
+    if (programa->num_constantes > 0) {
+        memcpy(e.codigo, programa->constantes, (size_t)programa->num_constantes * sizeof(float));
+    }
+    float nan_interpretador = NAN;
+    memcpy(e.codigo + posicao_nan, &nan_interpretador, sizeof(float));
+    e.tamanho = inicio;
+
+    FuncaoOperacaoNativa funcao = (programa->modo == CALCULO_RAPIDO) ? operacao_nativa_rapida : operacao_nativa;
+
+    emitir_byte(&e, 0x53);                                        // push rbx
+    emitir_byte(&e, 0x48); emitir_byte(&e, 0x89); emitir_byte(&e, 0xFB); // mov rbx, rdi
+    emitir_byte(&e, 0x48); emitir_byte(&e, 0x83); emitir_byte(&e, 0xEC); // sub rsp, area
+    emitir_byte(&e, JIT_AREA_SALVAMENTO);
+
+    int topo = -1;
+    for (int i = 0; i < programa->num_instrucoes; i++) {
+        unsigned int instr = programa->instrucoes[i];
+        Opcode op = OPCODE_DE(instr);
+        int reg = topo + 2; // Registrador do topo atual
+
+        switch (op) {
+            case OP_CONSTANTE: {
+                // movss xmm, [rip + deslocamento até a constante]
+                topo++;
+                emitir_opcode_sse(&e, 0xF3, 0x10, topo + 2, 0);
+                emitir_byte(&e, 0x05u | ((unsigned int)((topo + 2) & 7) << 3));
+                long deslocamento = (long)(ARGUMENTO_DE(instr) * sizeof(float)) - (long)(e.tamanho + 4);
+                emitir_32(&e, (unsigned int)deslocamento);
+                break;
+            }
+            case OP_VARIAVEL:
+                // movss xmm, [rbx + 4 * indice]
+                topo++;
+                emitir_opcode_sse(&e, 0xF3, 0x10, topo + 2, 0);
+                emitir_byte(&e, 0x83u | ((unsigned int)((topo + 2) & 7) << 3));
+                emitir_32(&e, ARGUMENTO_DE(instr) * (unsigned int)sizeof(float));
+                break;
+            case OP_SOMA: emitir_sse(&e, 0xF3, 0x58, reg - 1, reg); topo--; break;
+            case OP_SUBTRACAO: emitir_sse(&e, 0xF3, 0x5C, reg - 1, reg); topo--; break;
+            case OP_MULTIPLICACAO: emitir_sse(&e, 0xF3, 0x59, reg - 1, reg); topo--; break;
+            case OP_DIVISAO:
+                // Divisor zero vira NAN sem desvio: o resultado recebe OR com a máscara op2 == 0
+                emitir_sse(&e, 0, 0x57, 0, 0);                // xorps xmm0, xmm0
+                emitir_sse(&e, 0xF3, 0xC2, 0, reg);           // cmpeqss xmm0, op2
+                emitir_byte(&e, 0x00);
+                emitir_sse(&e, 0xF3, 0x5E, reg - 1, reg);     // divss op1, op2
+                emitir_sse(&e, 0, 0x56, reg - 1, 0);          // orps op1, xmm0
+                topo--;
+                break;
+            case OP_RAIZ:
+                // sqrtss: NAN para negativos e arredondamento correto, como sqrt em double
+                emitir_sse(&e, 0xF3, 0x51, reg, reg);
+                break;
+            case OP_MODULO:
+            case OP_POTENCIA:
+                emitir_chamada(&e, op, topo - 1, 1, funcao);
+                topo--;
+                break;
+            case OP_SENO:
+            case OP_COSSENO:
+            case OP_TANGENTE:
+            case OP_LOGARITMO:
+                emitir_chamada(&e, op, topo, 0, funcao);
+                break;
+            default:
+                free(e.codigo);
+                free(nativo);
+                return 0;
+        }
+    }
+
+    // O interpretador devolve sempre o mesmo NAN quando uma operação falha
+    if (programa->num_instrucoes > 1) {
+        emitir_sse(&e, 0, 0x2E, 2, 2);                                // ucomiss xmm2, xmm2
+        emitir_byte(&e, 0x7B); emitir_byte(&e, 0x08);                 // jnp +8
+        emitir_byte(&e, 0xF3); emitir_byte(&e, 0x0F); emitir_byte(&e, 0x10); // movss xmm2, [rip + NAN]
+        emitir_byte(&e, 0x15);
+        emitir_32(&e, (unsigned int)((long)posicao_nan - (long)(e.tamanho + 4)));
+    }
+    emitir_sse(&e, 0, 0x28, 0, 2);                                    // movaps xmm0, xmm2
+    emitir_byte(&e, 0x48); emitir_byte(&e, 0x83); emitir_byte(&e, 0xC4); // add rsp, area
+    emitir_byte(&e, JIT_AREA_SALVAMENTO);
+    emitir_byte(&e, 0x5B);                                            // pop rbx
+    emitir_byte(&e, 0xC3);                                            // ret
+
+    // Copia para páginas próprias e troca escrita por execução (nunca as duas ao mesmo tempo)
+    void *memoria = mmap(NULL, e.tamanho, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memoria == MAP_FAILED) {
+        free(e.codigo);
+        free(nativo);
+        return 0;
+    }
+    memcpy(memoria, e.codigo, e.tamanho);
+    free(e.codigo);
+    if (mprotect(memoria, e.tamanho, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memoria, e.tamanho);
+        free(nativo);
+        return 0;
+    }
+
+    nativo->memoria = memoria;
+    nativo->tamanho = e.tamanho;
+    nativo->funcao = (FuncaoNativa)(void *)((unsigned char *)memoria + inicio);
+    nativo->modo = programa->modo;
+    programa->nativo = nativo;
+    return 1;
+#else
+    (void)programa;
+    return 0;
+#endif
+}
+
+// =================================================================================
+// PROGRAMA PÓS-FIXO COMPILADO
+// =================================================================================
+
+// Núcleo de compilarPosFixa sem E/S: em erro, preenche *erro (sem contar nos
+// contadores de erro) e deixa o programa vazio
+int compilar_posfixa(const char *StrPosFixa, ProgramaPosFixa *programa, ErroExpressao *erro) {
+    AnalisadorLexico lexico;
+    Token token;
+
+    memset(programa, 0, sizeof(ProgramaPosFixa));
+    erro->codigo = ERRO_NENHUM;
+    erro->posicao = -1;
+
+    // Primeira passada: conta os tokens para alocar as tabelas de uma vez
+    int num_tokens = contar_tokens(StrPosFixa);
+    if (num_tokens == 0) {
+        erro->codigo = ERRO_EXPRESSAO_VAZIA;
+        return 0;
+    }
+
+    programa->instrucoes = (unsigned int *)malloc(num_tokens * sizeof(unsigned int));
+    programa->constantes = (float *)malloc(num_tokens * sizeof(float));
+    if (programa->instrucoes == NULL || programa->constantes == NULL) {
+        erro->codigo = ERRO_MEMORIA;
+        liberarPrograma(programa);
+        return 0;
+    }
+
+    // Segunda passada: gera as instruções acompanhando a altura da pilha
+    int altura = 0;
+    iniciarAnalisadorLexico(&lexico, StrPosFixa);
+    while (proximoToken(&lexico, &token) != TOKEN_FIM) {
+        Opcode op = token.op;
+
+        if (token.tipo == TOKEN_NUMERO) {
+            // Número: vira uma constante (o índice precisa caber no argumento da instrução)
+            if (programa->num_constantes >= MAX_ARGUMENTO_INSTRUCAO) {
+                erro->codigo = ERRO_PROGRAMA_GRANDE;
+                goto erro;
+            }
+            programa->constantes[programa->num_constantes] = token.valor;
+            programa->instrucoes[programa->num_instrucoes++] =
+                INSTRUCAO(OP_CONSTANTE, programa->num_constantes);
+            programa->num_constantes++;
+            altura++;
+        } else if (token.tipo == TOKEN_VARIAVEL) {
+            // Nome de variável: o valor é fornecido na avaliação
+            int indice = registrar_nome(&programa->nomes_variaveis, &programa->num_variaveis,
+                                        token.inicio, token.tamanho);
+            if (indice < 0 || indice >= MAX_ARGUMENTO_INSTRUCAO) {
+                erro->codigo = (indice < 0) ? ERRO_MEMORIA : ERRO_PROGRAMA_GRANDE;
+                goto erro;
+            }
+            programa->instrucoes[programa->num_instrucoes++] = INSTRUCAO(OP_VARIAVEL, indice);
+            altura++;
+        } else if (token.tipo == TOKEN_OPERADOR) {
+            if (opcode_eh_binario(op)) {
+                if (altura < 2) {
+                    erro->codigo = (altura == 0) ? ERRO_OPERADOR_SEM_OPERANDOS : ERRO_OPERADOR_UM_OPERANDO;
+                    goto erro;
+                }
+                altura--;
+            } else if (altura < 1) {
+                erro->codigo = ERRO_FUNCAO_SEM_OPERANDO;
+                goto erro;
+            }
+            programa->instrucoes[programa->num_instrucoes++] = INSTRUCAO(op, 0);
+        } else {
+            erro->codigo = ERRO_TOKEN_INVALIDO;
+            goto erro;
+        }
+
+        if (altura > programa->profundidade_maxima) {
+            programa->profundidade_maxima = altura;
+        }
+    }
+
+    if (altura != 1) {
+        erro->codigo = ERRO_OPERANDOS_RESTANTES;
+        goto erro;
+    }
+    return 1;
+
+erro:
+    if (erro->codigo != ERRO_OPERANDOS_RESTANTES) {
+        erro->posicao = (long)(token.inicio - StrPosFixa);
+    }
+    liberarPrograma(programa);
+    return 0;
+}
+
+/*
+ * compilarPosFixa
+ * ---------------
+ * Traduz uma expressão pós-fixa para um programa compacto de opcodes e constantes.
+ * Além de números, aceita variáveis (ex: "x y + 2 *"), cujos valores são
+ * fornecidos em avaliarProgramaComVariaveis ou avaliarProgramaEmLote.
+ * Toda a análise de texto (tokenização, conversão de números, reconhecimento de
+ * operadores) e a verificação da altura da pilha acontecem aqui, uma única vez.
+ *
+ * Parâmetros:
+ * - StrPosFixa: String contendo a expressão pós-fixa (ex: "3 4 + 5 *").
+ * - programa: Estrutura que recebe o programa compilado.
+ *
+ * Retorno:
+ * - 1 em caso de sucesso; 0 se a expressão for inválida (o programa fica vazio).
+ */
+int compilarPosFixa(const char *StrPosFixa, ProgramaPosFixa *programa) {
+    ErroExpressao erro;
+    if (compilar_posfixa(StrPosFixa, programa, &erro)) {
+        return 1;
+    }
+    // Mesmas mensagens de sempre: vazia e binário com um operando têm textos próprios aqui
+    if (erro.codigo == ERRO_EXPRESSAO_VAZIA) {
+        fprintf(stderr, "Erro: Expressao pos-fixa vazia.\n");
+    } else {
+        if (erro.codigo == ERRO_OPERADOR_UM_OPERANDO) {
+            erro.codigo = ERRO_OPERADOR_SEM_OPERANDOS;
+        }
+        imprimir_erro(StrPosFixa, &erro);
+    }
+    return 0;
+}
+
+/*
+ * avaliarProgramaComVariaveis
+ * ---------------------------
+ * Executa um programa gerado por compilarPosFixa (ou otimizarPrograma). Não há
+ * tratamento de texto nem alocação (exceto para programas com pilha e
+ * temporários acima de CAPACIDADE_NUMEROS_LOCAL): cada instrução é despachada
+ * por um único switch.
+ * raiz, sen, cos, tg e log seguem programa->modo. Tudo é calculado em float,
+ * inclusive operações entre inteiros (ao contrário de getValorPosFixa).
+ *
+ * Parâmetros:
+ * - programa: Programa compilado.
+ * - valores: Valor de cada variável, na ordem de nomes_variaveis (pode ser NULL
+ *   se o programa não tiver variáveis).
+ *
+ * Retorno:
+ * - O valor numérico da expressão. Retorna NAN em caso de erro (ex: divisão por zero).
+ */
+float avaliarProgramaComVariaveis(const ProgramaPosFixa *programa, const float *valores) {
+    float buffer_pilha[CAPACIDADE_NUMEROS_LOCAL];
+    PilhaNumerica p;
+    float resultado = NAN;
+    int topo = -1;
+    int rapido = (programa->modo == CALCULO_RAPIDO);
+
+    if (programa->num_instrucoes == 0 || (programa->num_variaveis > 0 && valores == NULL)) {
+        return NAN;
+    }
+
+    // Código nativo de ativarJit, enquanto o JIT estiver ligado e o modo não mudar
+    if (programa->nativo != NULL && programa->nativo->modo == programa->modo &&
+        __atomic_load_n(&jit_habilitado, __ATOMIC_RELAXED)) {
+        return programa->nativo->funcao(valores);
+    }
+
+    // A altura máxima é conhecida desde a compilação: reserva tudo de uma vez,
+    // com os temporários de otimizarPrograma logo depois da pilha
+    inicializar_pilha_numerica(&p, buffer_pilha, CAPACIDADE_NUMEROS_LOCAL);
+    if (!reservar_pilha_numerica(&p, programa->profundidade_maxima + programa->num_temporarios)) {
+        return NAN;
+    }
+    float *pilha = p.dados;
+    float *temporarios = p.dados + programa->profundidade_maxima;
+
+    for (int i = 0; i < programa->num_instrucoes; i++) {
+        unsigned int instr = programa->instrucoes[i];
+        float op1, op2, valor;
+
+        switch (OPCODE_DE(instr)) {
+            case OP_CONSTANTE:
+                pilha[++topo] = programa->constantes[ARGUMENTO_DE(instr)];
+                continue;
+            case OP_VARIAVEL:
+                pilha[++topo] = valores[ARGUMENTO_DE(instr)];
+                continue;
+            case OP_GUARDAR:
+                temporarios[ARGUMENTO_DE(instr)] = pilha[topo];
+                continue;
+            case OP_CARREGAR:
+                pilha[++topo] = temporarios[ARGUMENTO_DE(instr)];
+                continue;
+            case OP_SOMA:
+                op2 = pilha[topo--]; op1 = pilha[topo];
+                valor = op1 + op2;
+                break;
+            case OP_SUBTRACAO:
+                op2 = pilha[topo--]; op1 = pilha[topo];
+                valor = op1 - op2;
+                break;
+            case OP_MULTIPLICACAO:
+                op2 = pilha[topo--]; op1 = pilha[topo];
+                valor = op1 * op2;
+                break;
+            case OP_DIVISAO:
+                op2 = pilha[topo--]; op1 = pilha[topo];
+                valor = (op2 == 0.0) ? NAN : op1 / op2;
+                break;
+            case OP_MODULO:
+                op2 = pilha[topo--]; op1 = pilha[topo];
+                valor = (op2 == 0.0) ? NAN : fmod(op1, op2);
+                break;
+            case OP_POTENCIA:
+                op2 = pilha[topo--]; op1 = pilha[topo];
+                // pow(NAN, 0) seria 1: operandos NAN continuam sendo erro
+                valor = (isnan(op1) || isnan(op2)) ? NAN : pow(op1, op2);
+                break;
+            case OP_RAIZ:
+                op1 = pilha[topo];
+                valor = rapido ? raiz_rapida(op1) : (op1 < 0.0) ? NAN : sqrt(op1);
+                break;
+            case OP_SENO:
+                valor = rapido ? seno_graus_rapido(pilha[topo]) : sin(GRAUS_PARA_RADIANOS(pilha[topo]));
+                break;
+            case OP_COSSENO:
+                valor = rapido ? cosseno_graus_rapido(pilha[topo]) : cos(GRAUS_PARA_RADIANOS(pilha[topo]));
+                break;
+            case OP_TANGENTE:
+                valor = rapido ? tangente_graus_rapida(pilha[topo]) : tan(GRAUS_PARA_RADIANOS(pilha[topo]));
+                break;
+            case OP_LOGARITMO:
+                op1 = pilha[topo];
+                valor = rapido ? log10_rapido(op1) : (op1 <= 0.0) ? NAN : log10(op1);
+                break;
+            default:
+                valor = NAN;
+                break;
+        }
+
+        // Mesmo critério de getValorPosFixa: qualquer resultado NAN encerra a avaliação
+        if (isnan(valor)) {
+            goto fim;
+        }
+        pilha[topo] = valor;
+    }
+    resultado = pilha[0];
+
+fim:
+    liberar_pilha_numerica(&p);
+    return resultado;
+}
+
+// Avalia um programa compilado sem variáveis
+float avaliarPrograma(const ProgramaPosFixa *programa) {
+    return avaliarProgramaComVariaveis(programa, NULL);
+}
+
+// Retorna o índice da variável 'nome' no programa (-1 se ela não aparecer na expressão)
+int obterIndiceVariavel(const ProgramaPosFixa *programa, const char *nome) {
+    for (int i = 0; i < programa->num_variaveis; i++) {
+        if (strcmp(programa->nomes_variaveis[i], nome) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Libera a memória de um programa compilado e o deixa vazio
+void liberarPrograma(ProgramaPosFixa *programa) {
+    liberar_codigo_nativo(programa);
+    free(programa->instrucoes);
+    free(programa->constantes);
+    for (int i = 0; i < programa->num_variaveis; i++) {
+        free(programa->nomes_variaveis[i]);
+    }
+    free(programa->nomes_variaveis);
+    memset(programa, 0, sizeof(ProgramaPosFixa));
+}
+
+// =================================================================================
+// OTIMIZAÇÃO DO PROGRAMA (dobra de constantes, redução de força, subexpressões comuns)
+// =================================================================================
+
+// Pontos de teste de OTIMIZAR_CONFERIR e a tolerância relativa com OTIMIZAR_INEXATO
+#define PONTOS_CONFERENCIA 64
+#define TOLERANCIA_CONFERENCIA 1e-5f
+
+// Nó do grafo de otimizarPrograma: os operandos são sempre nós criados antes dele
+typedef struct {
+    Opcode op;
+    unsigned int argumento; // Bits da constante (OP_CONSTANTE) ou índice da variável
+    int esquerdo;           // -1 nas folhas
+    int direito;            // -1 nas folhas e nas funções
+} NoOtimizacao;
+
+typedef struct {
+    NoOtimizacao *nos;
+    int num_nos;
+    int *tabela;          // Nós por espalhamento (-1 = vaga); NULL sem OTIMIZAR_SUBEXPRESSOES
+    unsigned int mascara; // Tamanho da tabela - 1 (potência de 2)
+    int opcoes;
+    ModoCalculo modo;     // Modo usado na dobra de constantes
+} GrafoOtimizacao;
+
+// Espalhamento de um nó pelos seus quatro campos
+unsigned int espalhar_no(const NoOtimizacao *no) {
+    unsigned long long h = ((unsigned long long)no->op << 32) ^ no->argumento;
+    h = (h * 0x9E3779B97F4A7C15ull) ^ (unsigned int)no->esquerdo;
+    h = (h * 0x9E3779B97F4A7C15ull) ^ (unsigned int)no->direito;
+    h ^= h >> 31;
+    h *= 0xBF58476D1CE4E5B9ull;
+    return (unsigned int)(h >> 32);
+}
+
+// Retorna o nó pedido, reaproveitando um igual já criado quando há tabela
+int obter_no(GrafoOtimizacao *g, Opcode op, unsigned int argumento, int esquerdo, int direito) {
+    NoOtimizacao no = {op, argumento, esquerdo, direito};
+    if (g->tabela != NULL) {
+        unsigned int i = espalhar_no(&no) & g->mascara;
+        while (g->tabela[i] >= 0) {
+            const NoOtimizacao *outro = &g->nos[g->tabela[i]];
+            if (outro->op == op && outro->argumento == argumento &&
+                outro->esquerdo == esquerdo && outro->direito == direito) {
+                return g->tabela[i];
+            }
+            i = (i + 1) & g->mascara;
+        }
+        g->tabela[i] = g->num_nos;
+    }
+    g->nos[g->num_nos] = no;
+    return g->num_nos++;
+}
+
+int no_constante(GrafoOtimizacao *g, float valor) {
+    unsigned int bits;
+    memcpy(&bits, &valor, sizeof(bits));
+    return obter_no(g, OP_CONSTANTE, bits, -1, -1);
+}
+
+float valor_do_no(const NoOtimizacao *no) {
+    float valor;
+    memcpy(&valor, &no->argumento, sizeof(valor));
+    return valor;
+}
+
+/*
+ * no_operacao
+ * -----------
+ * Cria o nó de 'op' sobre os nós a e b (b = -1 nas funções) aplicando as
+ * transformações de g->opcoes. Uma subárvore só de constantes vira constante
+ * pela mesma aplicar_operacao (ou a variante rápida, conforme o modo) da
+ * avaliação, exceto quando o resultado é NAN: ela fica no programa, que falha
+ * como antes. As reduções exatas são s 2 ^ -> s s * (pow em double de um float
+ * ao quadrado é exato e arredonda uma vez, como o produto em float) e
+ * s c / -> s (1/c) * com c potência de 2 (1/c exato: mesmo valor real
+ * arredondado). Com OTIMIZAR_INEXATO, também s 3 ^, s 4 ^ e qualquer c com
+ * 1/c normal.
+ */
+int no_operacao(GrafoOtimizacao *g, Opcode op, int a, int b) {
+    const NoOtimizacao *na = &g->nos[a];
+    const NoOtimizacao *nb = (b >= 0) ? &g->nos[b] : NULL;
+
+    if ((g->opcoes & OTIMIZAR_CONSTANTES) && na->op == OP_CONSTANTE && (nb == NULL || nb->op == OP_CONSTANTE)) {
+        CodigoErro codigo = ERRO_NENHUM;
+        float x = valor_do_no(na);
+        float y = (nb != NULL) ? valor_do_no(nb) : 0.0f;
+        float r = (g->modo == CALCULO_RAPIDO) ? aplicar_operacao_rapida(op, x, y, &codigo)
+                                              : aplicar_operacao(op, x, y, &codigo);
+        if (!isnan(r)) {
+            return no_constante(g, r);
+        }
+    }
+
+    if ((g->opcoes & OTIMIZAR_REDUCOES) && nb != NULL && nb->op == OP_CONSTANTE) {
+        float c = valor_do_no(nb);
+        int inexato = (g->opcoes & OTIMIZAR_INEXATO) != 0;
+        if (op == OP_POTENCIA && c == 2.0f) {
+            return no_operacao(g, OP_MULTIPLICACAO, a, a);
+        }
+        if (op == OP_POTENCIA && inexato && (c == 3.0f || c == 4.0f)) {
+            int quadrado = no_operacao(g, OP_MULTIPLICACAO, a, a);
+            return no_operacao(g, OP_MULTIPLICACAO, quadrado, (c == 3.0f) ? a : quadrado);
+        }
+        if (op == OP_DIVISAO && c != 0.0f && isfinite(c)) {
+            int expoente;
+            float reciproco = 1.0f / c;
+            int exato = fabsf(frexpf(c, &expoente)) == 0.5f && isfinite(reciproco);
+            if (exato || (inexato && isnormal(reciproco))) {
+                return no_operacao(g, OP_MULTIPLICACAO, a, no_constante(g, reciproco));
+            }
+        }
+    }
+
+    // + e * são comutativos bit a bit: a ordem canônica junta "x y +" e "y x +"
+    if (g->tabela != NULL && (op == OP_SOMA || op == OP_MULTIPLICACAO) && a > b) {
+        int troca = a;
+        a = b;
+        b = troca;
+    }
+    return obter_no(g, op, 0, a, b);
+}
+
+// Monta o grafo de um programa (inclusive já otimizado); retorna a raiz ou -1 se ele for inválido
+int montar_grafo_otimizacao(GrafoOtimizacao *g, const ProgramaPosFixa *programa, int *pilha, int *temporarios) {
+    int topo = -1;
+    for (int t = 0; t < programa->num_temporarios; t++) {
+        temporarios[t] = -1;
+    }
+    for (int i = 0; i < programa->num_instrucoes; i++) {
+        unsigned int instr = programa->instrucoes[i];
+        Opcode op = OPCODE_DE(instr);
+        unsigned int argumento = ARGUMENTO_DE(instr);
+
+        if (op == OP_CONSTANTE && argumento < (unsigned int)programa->num_constantes) {
+            pilha[++topo] = no_constante(g, programa->constantes[argumento]);
+        } else if (op == OP_VARIAVEL && argumento < (unsigned int)programa->num_variaveis) {
+            pilha[++topo] = obter_no(g, OP_VARIAVEL, argumento, -1, -1);
+        } else if (op == OP_GUARDAR && topo >= 0 && argumento < (unsigned int)programa->num_temporarios) {
+            temporarios[argumento] = pilha[topo];
+        } else if (op == OP_CARREGAR && argumento < (unsigned int)programa->num_temporarios &&
+                   temporarios[argumento] >= 0) {
+            pilha[++topo] = temporarios[argumento];
+        } else if (op > OP_VARIAVEL && op < NUM_OPCODES && topo >= (opcode_eh_binario(op) ? 1 : 0)) {
+            int b = opcode_eh_binario(op) ? pilha[topo--] : -1;
+            pilha[topo] = no_operacao(g, op, pilha[topo], b);
+        } else {
+            return -1;
+        }
+    }
+    return (topo == 0) ? pilha[0] : -1;
+}
+
+/*
+ * emitir_grafo_otimizacao
+ * -----------------------
+ * Gera as instruções do grafo a partir da raiz, em ordem pós-fixa e sem
+ * recursão. Um operador com mais de um uso é calculado na primeira ocorrência
+ * e copiado para um temporário (OP_GUARDAR); as demais o empilham de volta
+ * (OP_CARREGAR). O temporário é liberado no último uso e reaproveitado.
+ * Folhas são repetidas, com uma entrada por constante distinta.
+ *
+ * Parâmetros:
+ * - usos: Referências a cada nó (consumidas aqui).
+ * - indice: -1 por nó; recebe o índice da constante ou do temporário.
+ * - pendentes: Pilha de trabalho com 2 * g->num_nos + 1 posições.
+ * - livres: Temporários liberados (g->num_nos posições).
+ * - saida: Programa com instrucoes e constantes já alocados e contadores zerados.
+ */
+void emitir_grafo_otimizacao(const GrafoOtimizacao *g, int raiz, int *usos, int *indice, int *pendentes,
+                             int *livres, ProgramaPosFixa *saida) {
+    int topo = 0, altura = 0, num_livres = 0;
+    pendentes[0] = raiz * 2;
+    while (topo >= 0) {
+        int v = pendentes[topo] >> 1;
+        int expandido = pendentes[topo] & 1;
+        const NoOtimizacao *no = &g->nos[v];
+        topo--;
+
+        if (no->op == OP_CONSTANTE) {
+            if (indice[v] < 0) {
+                indice[v] = saida->num_constantes++;
+                saida->constantes[indice[v]] = valor_do_no(no);
+            }
+            saida->instrucoes[saida->num_instrucoes++] = INSTRUCAO(OP_CONSTANTE, indice[v]);
+            altura++;
+        } else if (no->op == OP_VARIAVEL) {
+            saida->instrucoes[saida->num_instrucoes++] = INSTRUCAO(OP_VARIAVEL, no->argumento);
+            altura++;
+        } else if (!expandido && indice[v] >= 0) {
+            saida->instrucoes[saida->num_instrucoes++] = INSTRUCAO(OP_CARREGAR, indice[v]);
+            altura++;
+            if (--usos[v] == 0) {
+                livres[num_livres++] = indice[v];
+            }
+        } else if (!expandido) {
+            pendentes[++topo] = v * 2 + 1;
+            if (no->direito >= 0) {
+                pendentes[++topo] = no->direito * 2;
+            }
+            pendentes[++topo] = no->esquerdo * 2;
+        } else {
+            saida->instrucoes[saida->num_instrucoes++] = INSTRUCAO(no->op, 0);
+            if (no->direito >= 0) {
+                altura--;
+            }
+            if (usos[v] > 1) {
+                indice[v] = (num_livres > 0) ? livres[--num_livres] : saida->num_temporarios++;
+                saida->instrucoes[saida->num_instrucoes++] = INSTRUCAO(OP_GUARDAR, indice[v]);
+                usos[v]--;
+            }
+        }
+        if (altura > saida->profundidade_maxima) {
+            saida->profundidade_maxima = altura;
+        }
+    }
+}
+
+// Valor da variável 'variavel' no ponto 'ponto' de OTIMIZAR_CONFERIR: alguns casos
+// especiais e depois valores pseudoaleatórios em [-100, 100)
+float valor_conferencia(int ponto, int variavel) {
+    static const float especiais[] = {0.0f, 1.0f, -1.0f, 2.0f, 0.5f, -3.0f, 10.0f, 45.0f};
+    int num_especiais = (int)(sizeof(especiais) / sizeof(especiais[0]));
+    if (ponto < num_especiais) {
+        return especiais[(ponto + variavel) % num_especiais];
+    }
+    unsigned int x = ((unsigned int)ponto * 2654435761u) ^ ((unsigned int)(variavel + 1) * 2246822519u);
+    x ^= x >> 15;
+    x *= 2246822519u;
+    x ^= x >> 13;
+    return (float)(x % 20000u) * 0.01f - 100.0f;
+}
+
+// Ambos com erro (NAN) ou iguais bit a bit; com 'inexato', dentro da tolerância relativa
+int resultados_equivalentes(float a, float b, int inexato) {
+    if (isnan(a) || isnan(b)) {
+        return isnan(a) && isnan(b);
+    }
+    if (memcmp(&a, &b, sizeof(float)) == 0) {
+        return 1;
+    }
+    return inexato && fabsf(a - b) <= TOLERANCIA_CONFERENCIA * fmaxf(1.0f, fmaxf(fabsf(a), fabsf(b)));
+}
+
+// Avalia os dois programas em PONTOS_CONFERENCIA pontos (um só, sem variáveis); 0 na
+// primeira divergência, que é impressa, ou se faltar memória
+int conferir_otimizacao(const ProgramaPosFixa *original, const ProgramaPosFixa *otimizado, int inexato) {
+    float *valores = (float *)malloc(((size_t)original->num_variaveis + 1) * sizeof(float));
+    if (valores == NULL) {
+        return 0;
+    }
+    int pontos = (original->num_variaveis > 0) ? PONTOS_CONFERENCIA : 1;
+    int ok = 1;
+    for (int ponto = 0; ok && ponto < pontos; ponto++) {
+        for (int v = 0; v < original->num_variaveis; v++) {
+            valores[v] = valor_conferencia(ponto, v);
+        }
+        float a = avaliarProgramaComVariaveis(original, valores);
+        float b = avaliarProgramaComVariaveis(otimizado, valores);
+        if (!resultados_equivalentes(a, b, inexato)) {
+            fprintf(stderr, "Aviso: Otimizacao diverge do programa original (%.9g != %.9g); programa mantido.\n",
+                    a, b);
+            ok = 0;
+        }
+    }
+    free(valores);
+    return ok;
+}
+
+/*
+ * otimizarPrograma
+ * ----------------
+ * Reescreve um programa compilado antes da avaliação. O programa vira um grafo
+ * (uma única passada pelas instruções); cada nó criado passa pela dobra de
+ * constantes e pelas reduções de força, e nós iguais são reaproveitados
+ * (subárvores repetidas e, em + e *, também com os operandos trocados). O grafo
+ * é gerado de volta a partir da raiz, o que descarta o que foi dobrado e
+ * calcula cada subexpressão comum uma só vez. As constantes são calculadas no
+ * modo atual do programa: troque programa->modo antes de otimizar.
+ *
+ * Sem OTIMIZAR_INEXATO, o resultado é o mesmo bit a bit para quaisquer valores
+ * das variáveis, e os erros (divisão por zero, log de não positivo etc.)
+ * continuam sendo NAN nos mesmos casos. Programas com temporários (OP_GUARDAR)
+ * não passam pelo JIT. Não use em vistas de obterFormulaBiblioteca.
+ *
+ * Parâmetros:
+ * - programa: Programa compilado (substituído pelo otimizado em caso de sucesso).
+ * - opcoes: Combinação de OpcaoOtimizacao (ex: OTIMIZAR_PADRAO).
+ *
+ * Retorno:
+ * - 1 se o programa foi substituído; 0 se ele estiver vazio ou inválido, faltar
+ *   memória ou, com OTIMIZAR_CONFERIR, o resultado divergir (o programa não muda).
+ */
+int otimizarPrograma(ProgramaPosFixa *programa, int opcoes) {
+    int n = programa->num_instrucoes;
+    int sucesso = 0;
+    GrafoOtimizacao g;
+    ProgramaPosFixa otimizado;
+    int *usos = NULL, *indice = NULL, *pendentes = NULL, *livres = NULL;
+
+    memset(&g, 0, sizeof(g));
+    memset(&otimizado, 0, sizeof(otimizado));
+    if (n == 0 || n > MAX_ARGUMENTO_INSTRUCAO) {
+        return 0;
+    }
+    g.opcoes = opcoes;
+    g.modo = programa->modo;
+
+    // Cada instrução cria no máximo dois nós (redução: constante ou quadrado, mais a multiplicação)
+    size_t capacidade = 2 * (size_t)n;
+    int *pilha = (int *)malloc((size_t)n * sizeof(int));
+    int *temporarios = (int *)malloc(((size_t)programa->num_temporarios + 1) * sizeof(int));
+    g.nos = (NoOtimizacao *)malloc(capacidade * sizeof(NoOtimizacao));
+    if (opcoes & OTIMIZAR_SUBEXPRESSOES) {
+        size_t tamanho = 16;
+        while (tamanho < 2 * capacidade) {
+            tamanho *= 2;
+        }
+        g.mascara = (unsigned int)(tamanho - 1);
+        g.tabela = (int *)malloc(tamanho * sizeof(int));
+        if (g.tabela != NULL) {
+            memset(g.tabela, 0xFF, tamanho * sizeof(int));
+        }
+    }
+    if (pilha == NULL || temporarios == NULL || g.nos == NULL ||
+        ((opcoes & OTIMIZAR_SUBEXPRESSOES) && g.tabela == NULL)) {
+        goto fim;
+    }
+
+    int raiz = montar_grafo_otimizacao(&g, programa, pilha, temporarios);
+    if (raiz < 0) {
+        goto fim;
+    }
+
+    // Usos de cada nó alcançável: os pais vêm sempre depois dos filhos
+    usos = (int *)calloc((size_t)g.num_nos, sizeof(int));
+    indice = (int *)malloc((size_t)g.num_nos * sizeof(int));
+    pendentes = (int *)malloc((2 * (size_t)g.num_nos + 1) * sizeof(int));
+    livres = (int *)malloc((size_t)g.num_nos * sizeof(int));
+    if (usos == NULL || indice == NULL || pendentes == NULL || livres == NULL) {
+        goto fim;
+    }
+    usos[raiz] = 1;
+    size_t num_instrucoes = 0, num_constantes = 0;
+    for (int v = g.num_nos - 1; v >= 0; v--) {
+        indice[v] = -1;
+        if (usos[v] == 0) {
+            continue;
+        }
+        if (g.nos[v].esquerdo < 0) {
+            num_instrucoes += (size_t)usos[v];
+            num_constantes += (g.nos[v].op == OP_CONSTANTE);
+            continue;
+        }
+        // O operador, mais OP_GUARDAR e um OP_CARREGAR por uso adicional
+        num_instrucoes += (usos[v] > 1) ? (size_t)usos[v] + 1 : 1;
+        usos[g.nos[v].esquerdo]++;
+        if (g.nos[v].direito >= 0) {
+            usos[g.nos[v].direito]++;
+        }
+    }
+
+    otimizado.instrucoes = (unsigned int *)malloc(num_instrucoes * sizeof(unsigned int));
+    otimizado.constantes = (float *)malloc((num_constantes + 1) * sizeof(float));
+    if (otimizado.instrucoes == NULL || otimizado.constantes == NULL) {
+        goto fim;
+    }
+    emitir_grafo_otimizacao(&g, raiz, usos, indice, pendentes, livres, &otimizado);
+    otimizado.nomes_variaveis = programa->nomes_variaveis;
+    otimizado.num_variaveis = programa->num_variaveis;
+    otimizado.modo = programa->modo;
+
+    if ((opcoes & OTIMIZAR_CONFERIR) &&
+        !conferir_otimizacao(programa, &otimizado, (opcoes & OTIMIZAR_INEXATO) != 0)) {
+        goto fim;
+    }
+
+    liberar_codigo_nativo(programa);
+    free(programa->instrucoes);
+    free(programa->constantes);
+    programa->instrucoes = otimizado.instrucoes;
+    programa->constantes = otimizado.constantes;
+    programa->num_instrucoes = otimizado.num_instrucoes;
+    programa->num_constantes = otimizado.num_constantes;
+    programa->profundidade_maxima = otimizado.profundidade_maxima;
+    programa->num_temporarios = otimizado.num_temporarios;
+    otimizado.instrucoes = NULL;
+    otimizado.constantes = NULL;
+    sucesso = 1;
+
+fim:
+    free(otimizado.instrucoes);
+    free(otimizado.constantes);
+    free(usos);
+    free(indice);
+    free(pendentes);
+    free(livres);
+    free(pilha);
+    free(temporarios);
+    free(g.nos);
+    free(g.tabela);
+    return sucesso;
+}
+
+// =================================================================================
+// AVALIAÇÃO EM LOTE (colunas de variáveis, núcleos SIMD)
+// =================================================================================
+
+// Linhas processadas por vez: cada posição da pilha vira um bloco desse tamanho
+#define TAMANHO_BLOCO_LOTE 256
+// Altura de pilha atendida pela área local (8 blocos = 8 KB)
+#define PROFUNDIDADE_LOTE_LOCAL 8
+
+// Núcleo vetorial: destino[i] = a[i] (op) b[i], para i em [0, n)
+typedef void (*NucleoLote)(float *destino, const float *a, const float *b, size_t n);
+
+// Conjunto de núcleos para as operações com instrução SIMD correspondente
+typedef struct {
+    NucleoLote soma;
+    NucleoLote subtracao;
+    NucleoLote multiplicacao;
+    NucleoLote divisao;
+    NucleoLote raiz; // Usa apenas 'a'
+    // CALCULO_RAPIDO (usam apenas 'a'; mesmos resultados das versões escalares)
+    NucleoLote seno_rapido;
+    NucleoLote cosseno_rapido;
+    NucleoLote tangente_rapida;
+    NucleoLote logaritmo_rapido;
+    // Cópia do resultado (usa apenas 'a'): todo NaN vira o NAN de avaliarProgramaComVariaveis,
+    // já que as instruções SIMD produzem o NaN padrão do x86 (com sinal) e o propagam
+    NucleoLote resultado;
+} NucleosLote;
+
+// Versões escalares: referência e tratamento das sobras de cada bloco
+void nucleo_soma_escalar(float *d, const float *a, const float *b, size_t n) {
+    for (size_t i = 0; i < n; i++) d[i] = a[i] + b[i];
+}
+
+void nucleo_subtracao_escalar(float *d, const float *a, const float *b, size_t n) {
+    for (size_t i = 0; i < n; i++) d[i] = a[i] - b[i];
+}
+
+void nucleo_multiplicacao_escalar(float *d, const float *a, const float *b, size_t n) {
+    for (size_t i = 0; i < n; i++) d[i] = a[i] * b[i];
+}
+
+void nucleo_divisao_escalar(float *d, const float *a, const float *b, size_t n) {
+    for (size_t i = 0; i < n; i++) d[i] = (b[i] == 0.0f) ? NAN : a[i] / b[i];
+}
+
+void nucleo_raiz_escalar(float *d, const float *a, const float *b, size_t n) {
+    (void)b;
+    for (size_t i = 0; i < n; i++) d[i] = (a[i] < 0.0f) ? NAN : sqrtf(a[i]);
+}
+
+void nucleo_seno_rapido_escalar(float *d, const float *a, const float *b, size_t n) {
+    (void)b;
+    for (size_t i = 0; i < n; i++) d[i] = seno_graus_rapido(a[i]);
+}
+
+void nucleo_cosseno_rapido_escalar(float *d, const float *a, const float *b, size_t n) {
+    (void)b;
+    for (size_t i = 0; i < n; i++) d[i] = cosseno_graus_rapido(a[i]);
+}
+
+void nucleo_tangente_rapida_escalar(float *d, const float *a, const float *b, size_t n) {
+    (void)b;
+    for (size_t i = 0; i < n; i++) d[i] = tangente_graus_rapida(a[i]);
+}
+
+void nucleo_logaritmo_rapido_escalar(float *d, const float *a, const float *b, size_t n) {
+    (void)b;
+    for (size_t i = 0; i < n; i++) d[i] = log10_rapido(a[i]);
+}
+
+void nucleo_resultado_escalar(float *d, const float *a, const float *b, size_t n) {
+    (void)b;
+    for (size_t i = 0; i < n; i++) d[i] = isnan(a[i]) ? NAN : a[i];
+}
+
+#ifdef LOTE_X86_64
+// SSE2: faz parte da base do x86-64, sempre disponível
+void nucleo_soma_sse(float *d, const float *a, const float *b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(d + i, _mm_add_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    nucleo_soma_escalar(d + i, a + i, b + i, n - i);
+}
+
+void nucleo_subtracao_sse(float *d, const float *a, const float *b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(d + i, _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    nucleo_subtracao_escalar(d + i, a + i, b + i, n - i);
+}
+
+void nucleo_multiplicacao_sse(float *d, const float *a, const float *b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(d + i, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    nucleo_multiplicacao_escalar(d + i, a + i, b + i, n - i);
+}
+
+void nucleo_divisao_sse(float *d, const float *a, const float *b, size_t n) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 nan = _mm_set1_ps(NAN);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 vb = _mm_loadu_ps(b + i);
+        __m128 q = _mm_div_ps(_mm_loadu_ps(a + i), vb);
+        __m128 divisor_zero = _mm_cmpeq_ps(vb, zero);
+        _mm_storeu_ps(d + i, _mm_or_ps(_mm_andnot_ps(divisor_zero, q), _mm_and_ps(divisor_zero, nan)));
+    }
+    nucleo_divisao_escalar(d + i, a + i, b + i, n - i);
+}
+
+void nucleo_raiz_sse(float *d, const float *a, const float *b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        // sqrt de negativo já resulta em NAN
+        _mm_storeu_ps(d + i, _mm_sqrt_ps(_mm_loadu_ps(a + i)));
+    }
+    nucleo_raiz_escalar(d + i, a + i, b, n - i);
+}
+
+void nucleo_resultado_sse(float *d, const float *a, const float *b, size_t n) {
+    const __m128 nan = _mm_set1_ps(NAN);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(a + i);
+        __m128 erro = _mm_cmpunord_ps(v, v);
+        _mm_storeu_ps(d + i, _mm_or_ps(_mm_andnot_ps(erro, v), _mm_and_ps(erro, nan)));
+    }
+    nucleo_resultado_escalar(d + i, a + i, b, n - i);
+}
+
+// Redução em graus e polinômios de reduzir_graus, 4 valores por vez; retorna q
+__m128i reduzir_graus_sse(__m128 x, __m128 *s, __m128 *c) {
+    __m128 modulo = _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+    if (_mm_movemask_ps(_mm_cmpnlt_ps(modulo, _mm_set1_ps(LIMITE_REDUCAO_GRAUS))) != 0) {
+        // Raro: valores enormes, infinitos ou NAN passam por fmodf um a um
+        float v[4];
+        _mm_storeu_ps(v, x);
+        for (int i = 0; i < 4; i++) {
+            if (!(fabsf(v[i]) < LIMITE_REDUCAO_GRAUS)) v[i] = fmodf(v[i], 360.0f);
+        }
+        x = _mm_loadu_ps(v);
+    }
+    __m128i q = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.0f / 90.0f)));
+    __m128 k = _mm_cvtepi32_ps(q);
+    __m128 t = _mm_mul_ps(_mm_sub_ps(x, _mm_mul_ps(k, _mm_set1_ps(90.0f))), _mm_set1_ps(GRAUS_PARA_RADIANOS_F));
+    __m128 z = _mm_mul_ps(t, t);
+    __m128 ps = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(SENO_C3), z), _mm_set1_ps(SENO_C2)), z),
+                           _mm_set1_ps(SENO_C1));
+    __m128 pc = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(COSSENO_C3), z), _mm_set1_ps(COSSENO_C2)), z),
+                           _mm_set1_ps(COSSENO_C1));
+    *s = _mm_add_ps(t, _mm_mul_ps(_mm_mul_ps(t, z), ps));
+    *c = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), z)), _mm_mul_ps(_mm_mul_ps(z, z), pc));
+    return q;
+}
+
+// (q & 1) ? c : s, com o sinal trocado quando q & 2
+__m128 quadrante_sse(__m128i q, __m128 s, __m128 c) {
+    __m128 impar = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+    __m128 v = _mm_or_ps(_mm_and_ps(impar, c), _mm_andnot_ps(impar, s));
+    return _mm_xor_ps(v, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), 30)));
+}
+
+void nucleo_seno_rapido_sse(float *d, const float *a, const float *b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 s, c;
+        __m128i q = reduzir_graus_sse(_mm_loadu_ps(a + i), &s, &c);
+        _mm_storeu_ps(d + i, quadrante_sse(q, s, c));
+    }
+    nucleo_seno_rapido_escalar(d + i, a + i, b, n - i);
+}
+
+void nucleo_cosseno_rapido_sse(float *d, const float *a, const float *b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 s, c;
+        __m128i q = reduzir_graus_sse(_mm_loadu_ps(a + i), &s, &c);
+        _mm_storeu_ps(d + i, quadrante_sse(_mm_add_epi32(q, _mm_set1_epi32(1)), s, c));
+    }
+    nucleo_cosseno_rapido_escalar(d + i, a + i, b, n - i);
+}
+
+void nucleo_tangente_rapida_sse(float *d, const float *a, const float *b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 s, c;
+        __m128i q = reduzir_graus_sse(_mm_loadu_ps(a + i), &s, &c);
+        __m128i bit = _mm_and_si128(q, _mm_set1_epi32(1));
+        __m128 impar = _mm_castsi128_ps(_mm_cmpeq_epi32(bit, _mm_set1_epi32(1)));
+        __m128 num = _mm_or_ps(_mm_and_ps(impar, c), _mm_andnot_ps(impar, s));
+        __m128 den = _mm_or_ps(_mm_and_ps(impar, s), _mm_andnot_ps(impar, c));
+        _mm_storeu_ps(d + i, _mm_xor_ps(_mm_div_ps(num, den), _mm_castsi128_ps(_mm_slli_epi32(bit, 31))));
+    }
+    nucleo_tangente_rapida_escalar(d + i, a + i, b, n - i);
+}
+
+// log10_rapido, 4 valores por vez
+__m128 log10_rapido_sse(__m128 x) {
+    __m128 subnormal = _mm_cmplt_ps(x, _mm_set1_ps(FLT_MIN));
+    __m128 y = _mm_or_ps(_mm_and_ps(subnormal, _mm_mul_ps(x, _mm_set1_ps(8388608.0f))), _mm_andnot_ps(subnormal, x));
+    __m128i bits = _mm_castps_si128(y);
+    __m128i e = _mm_and_si128(_mm_castps_si128(subnormal), _mm_set1_epi32(-23));
+    e = _mm_add_epi32(e, _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+    __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x7FFFFF)), _mm_set1_epi32(0x3F800000)));
+    __m128 grande = _mm_cmpgt_ps(m, _mm_set1_ps(RAIZ_2_F));
+    m = _mm_or_ps(_mm_and_ps(grande, _mm_mul_ps(m, _mm_set1_ps(0.5f))), _mm_andnot_ps(grande, m));
+    e = _mm_sub_epi32(e, _mm_castps_si128(grande));
+    __m128 f = _mm_sub_ps(m, _mm_set1_ps(1.0f));
+    __m128 z = _mm_mul_ps(f, f);
+    __m128 p = _mm_set1_ps(LOG_C8);
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(LOG_C7));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(LOG_C6));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(LOG_C5));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(LOG_C4));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(LOG_C3));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(LOG_C2));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(LOG_C1));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(LOG_C0));
+    __m128 ln = _mm_add_ps(f, _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(p, f), z), _mm_mul_ps(_mm_set1_ps(0.5f), z)));
+    __m128 r = _mm_add_ps(_mm_mul_ps(ln, _mm_set1_ps(LOG10_E_F)), _mm_mul_ps(_mm_cvtepi32_ps(e), _mm_set1_ps(LOG10_2_F)));
+    __m128 infinito = _mm_cmpeq_ps(x, _mm_set1_ps(INFINITY));
+    r = _mm_or_ps(_mm_and_ps(infinito, x), _mm_andnot_ps(infinito, r));
+    __m128 positivo = _mm_cmpgt_ps(x, _mm_setzero_ps());
+    return _mm_or_ps(_mm_and_ps(positivo, r), _mm_andnot_ps(positivo, _mm_set1_ps(NAN)));
+}
+
+void nucleo_logaritmo_rapido_sse(float *d, const float *a, const float *b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(d + i, log10_rapido_sse(_mm_loadu_ps(a + i)));
+    }
+    nucleo_logaritmo_rapido_escalar(d + i, a + i, b, n - i);
+}
+
+// AVX2: compilado à parte e escolhido em tempo de execução se a CPU suportar
+__attribute__((target("avx2")))
+void nucleo_soma_avx2(float *d, const float *a, const float *b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(d + i, _mm256_add_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    }
+    nucleo_soma_escalar(d + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+void nucleo_subtracao_avx2(float *d, const float *a, const float *b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(d + i, _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    }
+    nucleo_subtracao_escalar(d + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+void nucleo_multiplicacao_avx2(float *d, const float *a, const float *b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(d + i, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    }
+    nucleo_multiplicacao_escalar(d + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+void nucleo_divisao_avx2(float *d, const float *a, const float *b, size_t n) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 nan = _mm256_set1_ps(NAN);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 vb = _mm256_loadu_ps(b + i);
+        __m256 q = _mm256_div_ps(_mm256_loadu_ps(a + i), vb);
+        __m256 divisor_zero = _mm256_cmp_ps(vb, zero, _CMP_EQ_OQ);
+        _mm256_storeu_ps(d + i, _mm256_blendv_ps(q, nan, divisor_zero));
+    }
+    nucleo_divisao_escalar(d + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+void nucleo_raiz_avx2(float *d, const float *a, const float *b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(d + i, _mm256_sqrt_ps(_mm256_loadu_ps(a + i)));
+    }
+    nucleo_raiz_escalar(d + i, a + i, b, n - i);
+}
+
+__attribute__((target("avx2")))
+void nucleo_resultado_avx2(float *d, const float *a, const float *b, size_t n) {
+    const __m256 nan = _mm256_set1_ps(NAN);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_loadu_ps(a + i);
+        _mm256_storeu_ps(d + i, _mm256_blendv_ps(v, nan, _mm256_cmp_ps(v, v, _CMP_UNORD_Q)));
+    }
+    nucleo_resultado_escalar(d + i, a + i, b, n - i);
+}
+
+__attribute__((target("avx2")))
+__m256i reduzir_graus_avx2(__m256 x, __m256 *s, __m256 *c) {
+    __m256 modulo = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x);
+    if (_mm256_movemask_ps(_mm256_cmp_ps(modulo, _mm256_set1_ps(LIMITE_REDUCAO_GRAUS), _CMP_NLT_UQ)) != 0) {
+        float v[8];
+        _mm256_storeu_ps(v, x);
+        for (int i = 0; i < 8; i++) {
+            if (!(fabsf(v[i]) < LIMITE_REDUCAO_GRAUS)) v[i] = fmodf(v[i], 360.0f);
+        }
+        x = _mm256_loadu_ps(v);
+    }
+    __m256i q = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(1.0f / 90.0f)));
+    __m256 k = _mm256_cvtepi32_ps(q);
+    __m256 t = _mm256_mul_ps(_mm256_sub_ps(x, _mm256_mul_ps(k, _mm256_set1_ps(90.0f))),
+                             _mm256_set1_ps(GRAUS_PARA_RADIANOS_F));
+    __m256 z = _mm256_mul_ps(t, t);
+    __m256 ps = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(SENO_C3), z),
+                                                          _mm256_set1_ps(SENO_C2)), z), _mm256_set1_ps(SENO_C1));
+    __m256 pc = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(COSSENO_C3), z),
+                                                          _mm256_set1_ps(COSSENO_C2)), z), _mm256_set1_ps(COSSENO_C1));
+    *s = _mm256_add_ps(t, _mm256_mul_ps(_mm256_mul_ps(t, z), ps));
+    *c = _mm256_add_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(_mm256_set1_ps(0.5f), z)),
+                       _mm256_mul_ps(_mm256_mul_ps(z, z), pc));
+    return q;
+}
+
+__attribute__((target("avx2")))
+__m256 quadrante_avx2(__m256i q, __m256 s, __m256 c) {
+    __m256 impar = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+    __m256 v = _mm256_blendv_ps(s, c, impar);
+    return _mm256_xor_ps(v, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(q, _mm256_set1_epi32(2)), 30)));
+}
+
+__attribute__((target("avx2")))
+void nucleo_seno_rapido_avx2(float *d, const float *a, const float *b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 s, c;
+        __m256i q = reduzir_graus_avx2(_mm256_loadu_ps(a + i), &s, &c);
+        _mm256_storeu_ps(d + i, quadrante_avx2(q, s, c));
+    }
+    nucleo_seno_rapido_escalar(d + i, a + i, b, n - i);
+}
+
+__attribute__((target("avx2")))
+void nucleo_cosseno_rapido_avx2(float *d, const float *a, const float *b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 s, c;
+        __m256i q = reduzir_graus_avx2(_mm256_loadu_ps(a + i), &s, &c);
+        _mm256_storeu_ps(d + i, quadrante_avx2(_mm256_add_epi32(q, _mm256_set1_epi32(1)), s, c));
+    }
+    nucleo_cosseno_rapido_escalar(d + i, a + i, b, n - i);
+}
+
+__attribute__((target("avx2")))
+void nucleo_tangente_rapida_avx2(float *d, const float *a, const float *b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 s, c;
+        __m256i q = reduzir_graus_avx2(_mm256_loadu_ps(a + i), &s, &c);
+        __m256i bit = _mm256_and_si256(q, _mm256_set1_epi32(1));
+        __m256 impar = _mm256_castsi256_ps(_mm256_cmpeq_epi32(bit, _mm256_set1_epi32(1)));
+        __m256 quociente = _mm256_div_ps(_mm256_blendv_ps(s, c, impar), _mm256_blendv_ps(c, s, impar));
+        _mm256_storeu_ps(d + i, _mm256_xor_ps(quociente, _mm256_castsi256_ps(_mm256_slli_epi32(bit, 31))));
+    }
+    nucleo_tangente_rapida_escalar(d + i, a + i, b, n - i);
+}
+
+__attribute__((target("avx2")))
+__m256 log10_rapido_avx2(__m256 x) {
+    __m256 subnormal = _mm256_cmp_ps(x, _mm256_set1_ps(FLT_MIN), _CMP_LT_OQ);
+    __m256 y = _mm256_blendv_ps(x, _mm256_mul_ps(x, _mm256_set1_ps(8388608.0f)), subnormal);
+    __m256i bits = _mm256_castps_si256(y);
+    __m256i e = _mm256_and_si256(_mm256_castps_si256(subnormal), _mm256_set1_epi32(-23));
+    e = _mm256_add_epi32(e, _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+    __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x7FFFFF)),
+                                                   _mm256_set1_epi32(0x3F800000)));
+    __m256 grande = _mm256_cmp_ps(m, _mm256_set1_ps(RAIZ_2_F), _CMP_GT_OQ);
+    m = _mm256_blendv_ps(m, _mm256_mul_ps(m, _mm256_set1_ps(0.5f)), grande);
+    e = _mm256_sub_epi32(e, _mm256_castps_si256(grande));
+    __m256 f = _mm256_sub_ps(m, _mm256_set1_ps(1.0f));
+    __m256 z = _mm256_mul_ps(f, f);
+    __m256 p = _mm256_set1_ps(LOG_C8);
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(LOG_C7));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(LOG_C6));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(LOG_C5));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(LOG_C4));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(LOG_C3));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(LOG_C2));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(LOG_C1));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(LOG_C0));
+    __m256 ln = _mm256_add_ps(f, _mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(p, f), z),
+                                               _mm256_mul_ps(_mm256_set1_ps(0.5f), z)));
+    __m256 r = _mm256_add_ps(_mm256_mul_ps(ln, _mm256_set1_ps(LOG10_E_F)),
+                             _mm256_mul_ps(_mm256_cvtepi32_ps(e), _mm256_set1_ps(LOG10_2_F)));
+    r = _mm256_blendv_ps(r, x, _mm256_cmp_ps(x, _mm256_set1_ps(INFINITY), _CMP_EQ_OQ));
+    return _mm256_blendv_ps(_mm256_set1_ps(NAN), r, _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_GT_OQ));
+}
+
+__attribute__((target("avx2")))
+void nucleo_logaritmo_rapido_avx2(float *d, const float *a, const float *b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(d + i, log10_rapido_avx2(_mm256_loadu_ps(a + i)));
+    }
+    nucleo_logaritmo_rapido_escalar(d + i, a + i, b, n - i);
+}
+#endif
+
+// Escolhe a melhor implementação dos núcleos disponível nesta CPU
+const NucleosLote *selecionar_nucleos_lote(void) {
+#ifdef LOTE_X86_64
+    static const NucleosLote sse = {
+        nucleo_soma_sse, nucleo_subtracao_sse, nucleo_multiplicacao_sse,
+        nucleo_divisao_sse, nucleo_raiz_sse,
+        nucleo_seno_rapido_sse, nucleo_cosseno_rapido_sse, nucleo_tangente_rapida_sse,
+        nucleo_logaritmo_rapido_sse, nucleo_resultado_sse
+    };
+    static const NucleosLote avx2 = {
+        nucleo_soma_avx2, nucleo_subtracao_avx2, nucleo_multiplicacao_avx2,
+        nucleo_divisao_avx2, nucleo_raiz_avx2,
+        nucleo_seno_rapido_avx2, nucleo_cosseno_rapido_avx2, nucleo_tangente_rapida_avx2,
+        nucleo_logaritmo_rapido_avx2, nucleo_resultado_avx2
+    };
+    if (__builtin_cpu_supports("avx2")) {
+        return &avx2;
+    }
+    return &sse;
+#else
+    static const NucleosLote escalares = {
+        nucleo_soma_escalar, nucleo_subtracao_escalar, nucleo_multiplicacao_escalar,
+        nucleo_divisao_escalar, nucleo_raiz_escalar,
+        nucleo_seno_rapido_escalar, nucleo_cosseno_rapido_escalar, nucleo_tangente_rapida_escalar,
+        nucleo_logaritmo_rapido_escalar, nucleo_resultado_escalar
+    };
+    return &escalares;
+#endif
+}
+
+/*
+ * avaliarProgramaEmLote
+ * ---------------------
+ * Avalia o mesmo programa para várias linhas de dados (estrutura de arrays).
+ * A pilha guarda blocos de TAMANHO_BLOCO_LOTE linhas e cada instrução é aplicada
+ * ao bloco inteiro: + - * / e raiz usam núcleos SSE/AVX2 (com versão escalar de
+ * reserva); % ^ e as funções trigonométricas/log usam laços escalares com a
+ * mesma semântica de avaliarProgramaComVariaveis. Com programa->modo igual a
+ * CALCULO_RAPIDO, sen, cos, tg e log também usam núcleos SSE/AVX2.
+ *
+ * Parâmetros:
+ * - programa: Programa compilado.
+ * - colunas: colunas[i] aponta para os num_linhas valores da variável i
+ *   (ordem de nomes_variaveis). Pode ser NULL se não houver variáveis.
+ * - num_linhas: Quantidade de linhas a avaliar.
+ * - saida: Recebe num_linhas resultados, iguais bit a bit aos de
+ *   avaliarProgramaComVariaveis (o mesmo NAN nas linhas com erro).
+ *
+ * Retorno:
+ * - 1 em caso de sucesso; 0 se o programa estiver vazio ou faltar memória.
+ */
+int avaliarProgramaEmLote(const ProgramaPosFixa *programa, const float *const *colunas,
+                          size_t num_linhas, float *saida) {
+    float area_local[PROFUNDIDADE_LOTE_LOCAL * TAMANHO_BLOCO_LOTE];
+    const float *operandos_local[PROFUNDIDADE_LOTE_LOCAL];
+    float *area = area_local;
+    const float **operandos = operandos_local;
+    int profundidade = programa->profundidade_maxima;
+    int blocos = profundidade + programa->num_temporarios; // Temporários depois da pilha
+
+    if (programa->num_instrucoes == 0 || (programa->num_variaveis > 0 && colunas == NULL)) {
+        return 0;
+    }
+    if (blocos > PROFUNDIDADE_LOTE_LOCAL) {
+        area = (float *)malloc((size_t)blocos * TAMANHO_BLOCO_LOTE * sizeof(float));
+        operandos = (const float **)malloc(profundidade * sizeof(const float *));
+        if (area == NULL || operandos == NULL) {
+            free(area);
+            free(operandos);
+            return 0;
+        }
+    }
+
+    const NucleosLote *nucleos = selecionar_nucleos_lote();
+    int rapido = (programa->modo == CALCULO_RAPIDO);
+
+    for (size_t base = 0; base < num_linhas; base += TAMANHO_BLOCO_LOTE) {
+        size_t n = num_linhas - base;
+        if (n > TAMANHO_BLOCO_LOTE) {
+            n = TAMANHO_BLOCO_LOTE;
+        }
+        int topo = -1;
+
+        for (int k = 0; k < programa->num_instrucoes; k++) {
+            unsigned int instr = programa->instrucoes[k];
+            Opcode op = OPCODE_DE(instr);
+
+            // Variáveis não são copiadas: a pilha aponta direto para a coluna
+            if (op == OP_VARIAVEL) {
+                operandos[++topo] = colunas[ARGUMENTO_DE(instr)] + base;
+                continue;
+            }
+            if (op == OP_CONSTANTE) {
+                float *d = area + (size_t)(++topo) * TAMANHO_BLOCO_LOTE;
+                float c = programa->constantes[ARGUMENTO_DE(instr)];
+                for (size_t i = 0; i < n; i++) d[i] = c;
+                operandos[topo] = d;
+                continue;
+            }
+            if (op == OP_GUARDAR) {
+                float *t = area + (size_t)(profundidade + (int)ARGUMENTO_DE(instr)) * TAMANHO_BLOCO_LOTE;
+                memcpy(t, operandos[topo], n * sizeof(float));
+                continue;
+            }
+            if (op == OP_CARREGAR) {
+                // Copiado: o temporário pode ser reaproveitado enquanto o valor ainda está na pilha
+                float *d = area + (size_t)(++topo) * TAMANHO_BLOCO_LOTE;
+                memcpy(d, area + (size_t)(profundidade + (int)ARGUMENTO_DE(instr)) * TAMANHO_BLOCO_LOTE,
+                       n * sizeof(float));
+                operandos[topo] = d;
+                continue;
+            }
+
+            const float *b = NULL;
+            if (opcode_eh_binario(op)) {
+                b = operandos[topo--];
+            }
+            const float *a = operandos[topo];
+            float *d = area + (size_t)topo * TAMANHO_BLOCO_LOTE;
+
+            switch (op) {
+                case OP_SOMA: nucleos->soma(d, a, b, n); break;
+                case OP_SUBTRACAO: nucleos->subtracao(d, a, b, n); break;
+                case OP_MULTIPLICACAO: nucleos->multiplicacao(d, a, b, n); break;
+                case OP_DIVISAO: nucleos->divisao(d, a, b, n); break;
+                case OP_RAIZ: nucleos->raiz(d, a, NULL, n); break;
+                case OP_MODULO:
+                    for (size_t i = 0; i < n; i++) d[i] = (b[i] == 0.0f) ? NAN : fmod(a[i], b[i]);
+                    break;
+                case OP_POTENCIA:
+                    for (size_t i = 0; i < n; i++) {
+                        d[i] = (isnan(a[i]) || isnan(b[i])) ? NAN : pow(a[i], b[i]);
+                    }
+                    break;
+                case OP_SENO:
+                    if (rapido) {
+                        nucleos->seno_rapido(d, a, NULL, n);
+                        break;
+                    }
+                    for (size_t i = 0; i < n; i++) d[i] = sin(GRAUS_PARA_RADIANOS(a[i]));
+                    break;
+                case OP_COSSENO:
+                    if (rapido) {
+                        nucleos->cosseno_rapido(d, a, NULL, n);
+                        break;
+                    }
+                    for (size_t i = 0; i < n; i++) d[i] = cos(GRAUS_PARA_RADIANOS(a[i]));
+                    break;
+                case OP_TANGENTE:
+                    if (rapido) {
+                        nucleos->tangente_rapida(d, a, NULL, n);
+                        break;
+                    }
+                    for (size_t i = 0; i < n; i++) d[i] = tan(GRAUS_PARA_RADIANOS(a[i]));
+                    break;
+                case OP_LOGARITMO:
+                    if (rapido) {
+                        nucleos->logaritmo_rapido(d, a, NULL, n);
+                        break;
+                    }
+                    for (size_t i = 0; i < n; i++) d[i] = (a[i] <= 0.0f) ? NAN : log10(a[i]);
+                    break;
+                default:
+                    for (size_t i = 0; i < n; i++) d[i] = NAN;
+                    break;
+            }
+            operandos[topo] = d;
+        }
+
+        nucleos->resultado(saida + base, operandos[0], NULL, n);
+    }
+
+    if (area != area_local) {
+        free(area);
+        free(operandos);
+    }
+    return 1;
+}
+
+// =================================================================================
+// POOL DE TRABALHO (roubo de trabalho)
+// =================================================================================
+
+// Faixa de índices de tarefas ainda não executadas de um trabalhador.
+// O dono consome pelo início; ladrões levam a metade final.
+typedef struct {
+    pthread_mutex_t trava;
+    size_t inicio;
+    size_t fim;
+    char preenchimento[64]; // Evita falso compartilhamento entre faixas vizinhas
+} FaixaTarefas;
+
+struct PoolTrabalho {
+    int num_trabalhadores;    // Threads criadas + a thread chamadora (trabalhador 0)
+    pthread_t *threads;
+    FaixaTarefas *faixas;
+    pthread_mutex_t trava;
+    pthread_cond_t cond_trabalho; // Sinaliza uma nova rodada (ou o encerramento)
+    pthread_cond_t cond_fim;      // Sinaliza que todos os trabalhadores terminaram
+    unsigned long rodada;
+    int ativos;
+    int encerrar;
+    FuncaoTarefa funcao;
+    void *contexto;
+};
+
+// Parâmetros de cada thread do pool
+typedef struct {
+    PoolTrabalho *pool;
+    int id;
+} ArgumentoTrabalhador;
+
+// Retira a próxima tarefa da própria faixa; retorna 0 se ela estiver vazia
+int retirar_tarefa(FaixaTarefas *faixa, size_t *indice) {
+    int achou = 0;
+    pthread_mutex_lock(&faixa->trava);
+    if (faixa->inicio < faixa->fim) {
+        *indice = faixa->inicio++;
+        achou = 1;
+    }
+    pthread_mutex_unlock(&faixa->trava);
+    return achou;
+}
+
+// Rouba a metade final da faixa de outro trabalhador para a faixa de 'id'
+int roubar_tarefas(PoolTrabalho *pool, int id) {
+    for (int k = 1; k < pool->num_trabalhadores; k++) {
+        FaixaTarefas *vitima = &pool->faixas[(id + k) % pool->num_trabalhadores];
+        size_t inicio = 0, fim = 0;
+
+        pthread_mutex_lock(&vitima->trava);
+        if (vitima->inicio < vitima->fim) {
+            size_t meio = vitima->inicio + (vitima->fim - vitima->inicio) / 2;
+            inicio = meio;
+            fim = vitima->fim;
+            vitima->fim = meio;
+        }
+        pthread_mutex_unlock(&vitima->trava);
+
+        if (inicio < fim) {
+            FaixaTarefas *propria = &pool->faixas[id];
+            pthread_mutex_lock(&propria->trava);
+            propria->inicio = inicio;
+            propria->fim = fim;
+            pthread_mutex_unlock(&propria->trava);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Executa tarefas até não restar nenhuma em nenhuma faixa
+void trabalhar(PoolTrabalho *pool, int id) {
+    size_t indice;
+    do {
+        while (retirar_tarefa(&pool->faixas[id], &indice)) {
+            pool->funcao(pool->contexto, indice, id);
+        }
+    } while (roubar_tarefas(pool, id));
+}
+
+// Laço de cada thread do pool: espera uma rodada, trabalha e avisa o fim
+void *laco_trabalhador(void *argumento) {
+    ArgumentoTrabalhador arg = *(ArgumentoTrabalhador *)argumento;
+    PoolTrabalho *pool = arg.pool;
+    unsigned long rodada_vista = 0;
+    free(argumento);
+
+    for (;;) {
+        pthread_mutex_lock(&pool->trava);
+        while (!pool->encerrar && pool->rodada == rodada_vista) {
+            pthread_cond_wait(&pool->cond_trabalho, &pool->trava);
+        }
+        if (pool->encerrar) {
+            pthread_mutex_unlock(&pool->trava);
+            return NULL;
+        }
+        rodada_vista = pool->rodada;
+        pthread_mutex_unlock(&pool->trava);
+
+        trabalhar(pool, arg.id);
+
+        pthread_mutex_lock(&pool->trava);
+        if (--pool->ativos == 0) {
+            pthread_cond_signal(&pool->cond_fim);
+        }
+        pthread_mutex_unlock(&pool->trava);
+    }
+}
+
+// Número de núcleos disponíveis (1 se não for possível descobrir)
+int numero_nucleos(void) {
+#ifdef _SC_NPROCESSORS_ONLN
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (int)n : 1;
+#else
+    return 1;
+#endif
+}
+
+/*
+ * criarPoolTrabalho
+ * -----------------
+ * Cria um pool com num_threads trabalhadores: a thread chamadora conta como o
+ * trabalhador 0, então são criadas num_threads - 1 threads.
+ *
+ * Parâmetro:
+ * - num_threads: Quantidade de trabalhadores (<= 0 usa um por núcleo).
+ *
+ * Retorno:
+ * - Ponteiro para o pool, ou NULL em caso de erro.
+ */
+PoolTrabalho *criarPoolTrabalho(int num_threads) {
+    if (num_threads <= 0) {
+        num_threads = numero_nucleos();
+    }
+    PoolTrabalho *pool = (PoolTrabalho *)calloc(1, sizeof(PoolTrabalho));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->faixas = (FaixaTarefas *)calloc(num_threads, sizeof(FaixaTarefas));
+    pool->threads = (pthread_t *)calloc(num_threads, sizeof(pthread_t));
+    if (pool->faixas == NULL || pool->threads == NULL) {
+        free(pool->faixas);
+        free(pool->threads);
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->trava, NULL);
+    pthread_cond_init(&pool->cond_trabalho, NULL);
+    pthread_cond_init(&pool->cond_fim, NULL);
+
+    // O trabalhador 0 é quem chama executarNoPool
+    pthread_mutex_init(&pool->faixas[0].trava, NULL);
+    pool->num_trabalhadores = 1;
+    for (int i = 1; i < num_threads; i++) {
+        ArgumentoTrabalhador *arg = (ArgumentoTrabalhador *)malloc(sizeof(ArgumentoTrabalhador));
+        if (arg == NULL) {
+            break;
+        }
+        arg->pool = pool;
+        arg->id = i;
+        pthread_mutex_init(&pool->faixas[i].trava, NULL);
+        if (pthread_create(&pool->threads[i], NULL, laco_trabalhador, arg) != 0) {
+            // Continua com os trabalhadores já criados
+            pthread_mutex_destroy(&pool->faixas[i].trava);
+            free(arg);
+            break;
+        }
+        pool->num_trabalhadores++;
+    }
+    return pool;
+}
+
+// Número de trabalhadores do pool (incluindo a thread chamadora)
+int numeroTrabalhadores(const PoolTrabalho *pool) {
+    return pool->num_trabalhadores;
+}
+
+/*
+ * executarNoPool
+ * --------------
+ * Executa funcao(contexto, i, trabalhador) para i em [0, num_tarefas), dividindo
+ * os índices em faixas contíguas entre os trabalhadores; quem esvazia a própria
+ * faixa rouba a metade final da faixa de outro. Retorna quando todas as tarefas
+ * terminaram. Não deve ser chamada por duas threads ao mesmo tempo no mesmo pool.
+ *
+ * Parâmetros:
+ * - pool: Pool criado por criarPoolTrabalho.
+ * - num_tarefas: Quantidade de tarefas.
+ * - funcao: Função executada para cada tarefa.
+ * - contexto: Ponteiro repassado a cada chamada de funcao.
+ */
+void executarNoPool(PoolTrabalho *pool, size_t num_tarefas, FuncaoTarefa funcao, void *contexto) {
+    int n = pool->num_trabalhadores;
+    if (num_tarefas == 0) {
+        return;
+    }
+    if (n == 1 || num_tarefas == 1) {
+        for (size_t i = 0; i < num_tarefas; i++) {
+            funcao(contexto, i, 0);
+        }
+        return;
+    }
+
+    // Distribui as tarefas em faixas iguais antes de acordar os trabalhadores
+    for (int i = 0; i < n; i++) {
+        pool->faixas[i].inicio = num_tarefas * i / n;
+        pool->faixas[i].fim = num_tarefas * (i + 1) / n;
+    }
+
+    pthread_mutex_lock(&pool->trava);
+    pool->funcao = funcao;
+    pool->contexto = contexto;
+    pool->ativos = n - 1;
+    pool->rodada++;
+    pthread_cond_broadcast(&pool->cond_trabalho);
+    pthread_mutex_unlock(&pool->trava);
+
+    trabalhar(pool, 0);
+
+    pthread_mutex_lock(&pool->trava);
+    while (pool->ativos > 0) {
+        pthread_cond_wait(&pool->cond_fim, &pool->trava);
+    }
+    pthread_mutex_unlock(&pool->trava);
+}
+
+// Encerra as threads e libera o pool
+void destruirPoolTrabalho(PoolTrabalho *pool) {
+    if (pool == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->trava);
+    pool->encerrar = 1;
+    pthread_cond_broadcast(&pool->cond_trabalho);
+    pthread_mutex_unlock(&pool->trava);
+
+    for (int i = 1; i < pool->num_trabalhadores; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    for (int i = 0; i < pool->num_trabalhadores; i++) {
+        pthread_mutex_destroy(&pool->faixas[i].trava);
+    }
+    pthread_mutex_destroy(&pool->trava);
+    pthread_cond_destroy(&pool->cond_trabalho);
+    pthread_cond_destroy(&pool->cond_fim);
+    free(pool->faixas);
+    free(pool->threads);
+    free(pool);
+}
+
+// =================================================================================
+// PROCESSAMENTO DE ARQUIVOS EM LOTE
+// =================================================================================
+
+// Tamanho aproximado (em bytes de entrada) de cada bloco de linhas
+#define BYTES_POR_BLOCO_ARQUIVO (256 * 1024)
+// Blocos por rodada, por trabalhador: limita a memória de saída pendente
+#define BLOCOS_POR_TRABALHADOR 8
+
+// Trecho de linhas completas da entrada e o texto de saída correspondente
+typedef struct {
+    const char *inicio;
+    const char *fim;
+    char *saida;
+    size_t tamanho_saida;
+    size_t capacidade_saida;
+    long num_linhas;
+} BlocoArquivo;
+
+// Estado compartilhado pelas tarefas de uma rodada
+typedef struct {
+    BlocoArquivo *blocos;
+    char **linhas;             // Buffer de linha (terminada em '\0') de cada trabalhador
+    size_t *capacidades_linha;
+    int falha_memoria;         // Escrito por qualquer trabalhador (acesso atômico)
+} ContextoArquivo;
+
+// Mapeia o arquivo inteiro para leitura (mmap; leitura completa no Windows)
+const char *mapear_arquivo(const char *caminho, size_t *tamanho) {
+#ifndef _WIN32
+    int fd = open(caminho, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return NULL;
+    }
+    *tamanho = (size_t)info.st_size;
+    if (*tamanho == 0) {
+        close(fd);
+        return "";
+    }
+    void *dados = mmap(NULL, *tamanho, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (dados == MAP_FAILED) {
+        return NULL;
+    }
+    madvise(dados, *tamanho, MADV_SEQUENTIAL);
+    return (const char *)dados;
+#else
+    FILE *arquivo = fopen(caminho, "rb");
+    if (arquivo == NULL) {
+        return NULL;
+    }
+    fseek(arquivo, 0, SEEK_END);
+    long fim = ftell(arquivo);
+    fseek(arquivo, 0, SEEK_SET);
+    char *dados = (char *)malloc(fim > 0 ? (size_t)fim : 1);
+    if (dados == NULL || fread(dados, 1, (size_t)fim, arquivo) != (size_t)fim) {
+        free(dados);
+        fclose(arquivo);
+        return NULL;
+    }
+    fclose(arquivo);
+    *tamanho = (size_t)fim;
+    return dados;
+#endif
+}
+
+// Desfaz mapear_arquivo
+void desmapear_arquivo(const char *dados, size_t tamanho) {
+#ifndef _WIN32
+    if (tamanho > 0) {
+        munmap((void *)dados, tamanho);
+    }
+#else
+    (void)tamanho;
+    free((void *)dados);
+#endif
+}
+
+// Acrescenta 'tamanho' bytes ao texto de saída do bloco
+int anexar_saida(BlocoArquivo *bloco, const char *texto, size_t tamanho) {
+    if (bloco->tamanho_saida + tamanho > bloco->capacidade_saida) {
+        size_t nova_capacidade = bloco->capacidade_saida * 2 + tamanho + 256;
+        char *nova = (char *)realloc(bloco->saida, nova_capacidade);
+        if (nova == NULL) {
+            return 0;
+        }
+        bloco->saida = nova;
+        bloco->capacidade_saida = nova_capacidade;
+    }
+    memcpy(bloco->saida + bloco->tamanho_saida, texto, tamanho);
+    bloco->tamanho_saida += tamanho;
+    return 1;
+}
+
+// Tarefa do pool: avalia e converte todas as linhas de um bloco
+void processar_bloco_arquivo(void *contexto, size_t indice, int trabalhador) {
+    ContextoArquivo *ctx = (ContextoArquivo *)contexto;
+    BlocoArquivo *bloco = &ctx->blocos[indice];
+    const char *linha = bloco->inicio;
+
+    bloco->tamanho_saida = 0;
+    bloco->num_linhas = 0;
+    while (linha < bloco->fim) {
+        const char *fim_linha = (const char *)memchr(linha, '\n', bloco->fim - linha);
+        if (fim_linha == NULL) {
+            fim_linha = bloco->fim;
+        }
+        size_t tamanho = fim_linha - linha;
+        if (tamanho > 0 && linha[tamanho - 1] == '\r') {
+            tamanho--;
+        }
+
+        // As funções principais esperam uma string terminada em '\0'
+        if (tamanho + 1 > ctx->capacidades_linha[trabalhador]) {
+            size_t nova_capacidade = (tamanho + 1) * 2;
+            char *nova = (char *)realloc(ctx->linhas[trabalhador], nova_capacidade);
+            if (nova == NULL) {
+                __atomic_store_n(&ctx->falha_memoria, 1, __ATOMIC_RELAXED);
+                return;
+            }
+            ctx->linhas[trabalhador] = nova;
+            ctx->capacidades_linha[trabalhador] = nova_capacidade;
+        }
+        char *copia = ctx->linhas[trabalhador];
+        memcpy(copia, linha, tamanho);
+        copia[tamanho] = '\0';
+
+        // Variantes sem E/S: linhas inválidas viram "ERRO" e entram nos contadores de erro
+        char valor[32];
+        ErroExpressao erro;
+        float resultado = getValorPosFixaComErro(copia, &erro);
+        int tamanho_valor = isnan(resultado) ? snprintf(valor, sizeof(valor), "ERRO\t")
+                                             : snprintf(valor, sizeof(valor), "%.9g\t", resultado);
+        char *infixa = getFormaInFixaComErro(copia, &erro);
+        const char *texto_infixa = (infixa != NULL) ? infixa : "ERRO";
+
+        if (!anexar_saida(bloco, valor, tamanho_valor) ||
+            !anexar_saida(bloco, texto_infixa, strlen(texto_infixa)) ||
+            !anexar_saida(bloco, "\n", 1)) {
+            __atomic_store_n(&ctx->falha_memoria, 1, __ATOMIC_RELAXED);
+        }
+        free(infixa);
+        bloco->num_linhas++;
+        linha = fim_linha + 1;
+    }
+}
+
+/*
+ * processarArquivoExpressoes
+ * --------------------------
+ * Processa um arquivo com uma expressão pós-fixa por linha (formato de
+ * CasoTeste.posFixa). A entrada é mapeada em memória e dividida em blocos de
+ * linhas completas, que são distribuídos entre as threads de um PoolTrabalho.
+ * Cada rodada processa alguns blocos por trabalhador e grava as saídas na ordem
+ * da entrada, de modo que a memória pendente não cresce com o arquivo.
+ * Linhas inválidas não geram mensagens: são contadas em obterContadoresErro.
+ *
+ * Parâmetros:
+ * - caminho_entrada: Arquivo de expressões pós-fixas.
+ * - caminho_saida: Arquivo de saída ("valor<TAB>infixa" por linha; "ERRO" em erro).
+ * - num_threads: Quantidade de threads (<= 0 usa uma por núcleo).
+ *
+ * Retorno:
+ * - Número de linhas processadas, ou -1 em caso de erro de E/S ou memória.
+ */
+long processarArquivoExpressoes(const char *caminho_entrada, const char *caminho_saida, int num_threads) {
+    size_t tamanho;
+    const char *dados = mapear_arquivo(caminho_entrada, &tamanho);
+    if (dados == NULL) {
+        fprintf(stderr, "Erro: Nao foi possivel abrir %s.\n", caminho_entrada);
+        return -1;
+    }
+    FILE *saida = fopen(caminho_saida, "wb");
+    if (saida == NULL) {
+        fprintf(stderr, "Erro: Nao foi possivel criar %s.\n", caminho_saida);
+        desmapear_arquivo(dados, tamanho);
+        return -1;
+    }
+
+    PoolTrabalho *pool = criarPoolTrabalho(num_threads);
+    long num_linhas = -1;
+    ContextoArquivo ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    if (pool == NULL) {
+        goto fim;
+    }
+
+    int trabalhadores = numeroTrabalhadores(pool);
+    size_t blocos_por_rodada = (size_t)trabalhadores * BLOCOS_POR_TRABALHADOR;
+    ctx.blocos = (BlocoArquivo *)calloc(blocos_por_rodada, sizeof(BlocoArquivo));
+    ctx.linhas = (char **)calloc(trabalhadores, sizeof(char *));
+    ctx.capacidades_linha = (size_t *)calloc(trabalhadores, sizeof(size_t));
+    if (ctx.blocos == NULL || ctx.linhas == NULL || ctx.capacidades_linha == NULL) {
+        goto fim;
+    }
+
+    num_linhas = 0;
+    const char *posicao = dados;
+    const char *fim_dados = dados + tamanho;
+    while (posicao < fim_dados) {
+        // Corta a próxima rodada em blocos que terminam em fim de linha
+        size_t num_blocos = 0;
+        while (num_blocos < blocos_por_rodada && posicao < fim_dados) {
+            const char *corte = posicao + BYTES_POR_BLOCO_ARQUIVO;
+            if (corte >= fim_dados) {
+                corte = fim_dados;
+            } else {
+                const char *quebra = (const char *)memchr(corte, '\n', fim_dados - corte);
+                corte = (quebra != NULL) ? quebra + 1 : fim_dados;
+            }
+            ctx.blocos[num_blocos].inicio = posicao;
+            ctx.blocos[num_blocos].fim = corte;
+            num_blocos++;
+            posicao = corte;
+        }
+
+        executarNoPool(pool, num_blocos, processar_bloco_arquivo, &ctx);
+        if (__atomic_load_n(&ctx.falha_memoria, __ATOMIC_RELAXED)) {
+            fprintf(stderr, "Erro de alocacao de memoria.\n");
+            num_linhas = -1;
+            goto fim;
+        }
+
+        // Grava na ordem da entrada
+        for (size_t i = 0; i < num_blocos; i++) {
+            BlocoArquivo *bloco = &ctx.blocos[i];
+            if (fwrite(bloco->saida, 1, bloco->tamanho_saida, saida) != bloco->tamanho_saida) {
+                fprintf(stderr, "Erro: Falha ao gravar %s.\n", caminho_saida);
+                num_linhas = -1;
+                goto fim;
+            }
+            num_linhas += bloco->num_linhas;
+        }
+    }
+
+fim:
+    if (ctx.blocos != NULL) {
+        for (size_t i = 0; i < (size_t)numeroTrabalhadores(pool) * BLOCOS_POR_TRABALHADOR; i++) {
+            free(ctx.blocos[i].saida);
+        }
+    }
+    if (ctx.linhas != NULL) {
+        for (int i = 0; pool != NULL && i < numeroTrabalhadores(pool); i++) {
+            free(ctx.linhas[i]);
+        }
+    }
+    free(ctx.blocos);
+    free(ctx.linhas);
+    free(ctx.capacidades_linha);
+    destruirPoolTrabalho(pool);
+    if (fclose(saida) != 0) {
+        num_linhas = -1;
+    }
+    desmapear_arquivo(dados, tamanho);
+    return num_linhas;
+}
+
+// =================================================================================
+// AVALIAÇÃO PARALELA DE UMA EXPRESSÃO (fork-join sobre a árvore)
+// =================================================================================
+
+// Tokens mínimos de uma subárvore para virar tarefa (limiar <= 0 em getValorPosFixaParalelo)
+#define LIMIAR_PARALELO_PADRAO 65536
+// Tarefas por trabalhador: subárvores de tamanhos desiguais se equilibram pelo roubo
+#define TAREFAS_POR_TRABALHADOR 8
+
+// Token da expressão na avaliação paralela: posição no texto e tamanho da subárvore
+// que termina nele. A aridade sai dos tamanhos: 1 nos operandos, 1 + o do token
+// anterior nas funções e mais que isso nos operadores binários.
+typedef struct {
+    unsigned int posicao;
+    int tamanho;
+} TokenParalelo;
+
+// Subárvore avaliada por uma tarefa: os tokens [inicio, raiz], em ordem pós-fixa
+typedef struct {
+    int inicio;
+    int raiz;
+    ValorMisto valor;
+    CodigoErro codigo; // Primeiro erro de cálculo na subárvore
+    long posicao;
+} SubarvoreParalela;
+
+// Estado compartilhado pelas tarefas de getValorPosFixaParalelo
+typedef struct {
+    const char *str;
+    const TokenParalelo *tokens;
+    SubarvoreParalela *subarvores;
+} ContextoParalelo;
+
+// Aridade de um token pelo texto, com as mesmas regras de classificar_token para os
+// operadores; números, variáveis e tokens inválidos contam como operandos
+int aridade_token(const char *p, size_t tamanho) {
+    if (tamanho == 1 && (p[0] == '+' || p[0] == '-' || p[0] == '*' || p[0] == '/' || p[0] == '%' || p[0] == '^')) {
+        return 2;
+    }
+    return (EH_LETRA(p[0]) && funcao_do_nome(p, tamanho) != NUM_OPCODES) ? 1 : 0;
+}
+
+/*
+ * medir_subarvores
+ * ----------------
+ * Primeira passada (sequencial) de getValorPosFixaParalelo: separa os tokens,
+ * decide a aridade de cada um e calcula o tamanho da subárvore que termina em
+ * cada token, como construir_arvore, mas sem converter os números (o trabalho
+ * mais caro fica para as tarefas).
+ *
+ * Os tamanhos dos operandos pendentes ficam em uma pilha própria: o filho
+ * esquerdo de um operador pode estar longe no vetor de tokens, mas está sempre
+ * logo abaixo do topo da pilha.
+ *
+ * Parâmetros:
+ * - str: Expressão pós-fixa.
+ * - tokens: Recebe os tokens (espaço para pelo menos contar_tokens(str)).
+ * - pilha: Área auxiliar do mesmo número de elementos.
+ *
+ * Retorno:
+ * - O número de tokens se a estrutura for válida (cada operador com seus
+ *   operandos e uma única raiz); 0 caso contrário.
+ */
+int medir_subarvores(const char *str, TokenParalelo *tokens, int *pilha) {
+    const char *p = str;
+    int altura = 0;
+    int n = 0;
+    for (;;) {
+        while (EH_ESPACO(*p)) p++;
+        if (*p == '\0') {
+            return (altura == 1) ? n : 0;
+        }
+        const char *fim = p;
+        while (*fim != '\0' && !EH_ESPACO(*fim)) fim++;
+
+        int aridade = aridade_token(p, (size_t)(fim - p));
+        if (altura < aridade) {
+            return 0;
+        }
+        if (aridade == 0) {
+            pilha[altura++] = 1;
+        } else if (aridade == 1) {
+            pilha[altura - 1]++;
+        } else {
+            altura--;
+            pilha[altura - 1] += pilha[altura] + 1;
+        }
+        tokens[n].posicao = (unsigned int)(p - str);
+        tokens[n].tamanho = pilha[altura - 1];
+        n++;
+        p = fim;
+    }
+}
+
+/*
+ * avaliar_tokens_mistos
+ * ---------------------
+ * Avalia os tokens [inicio, fim] (uma subárvore inteira, de estrutura já
+ * validada por medir_subarvores) em ordem pós-fixa, com a mesma pilha mista e
+ * as mesmas operações de getValorPosFixaComModo (exato). Cada subárvore de
+ * 'subarvores' (ordenadas e disjuntas) entra na pilha com o valor já calculado
+ * por uma tarefa, sem percorrer os seus tokens. Como o valor de uma subárvore
+ * só depende dos seus tokens, o resultado é o da avaliação direta.
+ *
+ * Parâmetros:
+ * - str: Expressão original.
+ * - tokens: Tokens medidos por medir_subarvores.
+ * - inicio, fim: Trecho avaliado.
+ * - subarvores, num_subarvores: Subárvores já avaliadas dentro do trecho.
+ * - resultado: Recebe o valor do trecho.
+ * - codigo, posicao: Recebem o primeiro erro em ordem pós-fixa.
+ *
+ * Retorno:
+ * - 1 em sucesso; 0 em erro.
+ */
+int avaliar_tokens_mistos(const char *str, const TokenParalelo *tokens, int inicio, int fim,
+                          const SubarvoreParalela *subarvores, int num_subarvores, ValorMisto *resultado,
+                          CodigoErro *codigo, long *posicao) {
+    ValorMisto buffer_pilha[CAPACIDADE_NUMEROS_LOCAL];
+    PilhaMista pilha;
+    inicializar_pilha_mista(&pilha, buffer_pilha, CAPACIDADE_NUMEROS_LOCAL);
+    int proxima = 0;
+
+    for (int i = inicio; i <= fim; i++) {
+        const char *p = str + tokens[i].posicao;
+        *posicao = (long)tokens[i].posicao;
+        if (proxima < num_subarvores && subarvores[proxima].inicio == i) {
+            // Subárvore calculada por uma tarefa: o primeiro erro dela é o primeiro daqui
+            const SubarvoreParalela *subarvore = &subarvores[proxima++];
+            if (subarvore->codigo != ERRO_NENHUM) {
+                *codigo = subarvore->codigo;
+                *posicao = subarvore->posicao;
+                goto erro;
+            }
+            ValorMisto *valor = empilhar_misto(&pilha);
+            if (valor == NULL) {
+                *codigo = ERRO_MEMORIA;
+                goto erro;
+            }
+            *valor = subarvore->valor;
+            i = subarvore->raiz;
+            continue;
+        }
+
+        size_t tamanho = 0;
+        while (p[tamanho] != '\0' && !EH_ESPACO(p[tamanho])) tamanho++;
+        Token token;
+        token.op = NUM_OPCODES;
+        token.valor = 0.0f;
+        TipoToken tipo = classificar_token(p, tamanho, &token);
+        if (tipo == TOKEN_NUMERO) {
+            ValorMisto *valor = empilhar_misto(&pilha);
+            if (valor == NULL) {
+                *codigo = ERRO_MEMORIA;
+                goto erro;
+            }
+            valor->eh_inteiro = ler_literal_inteiro(p, tamanho, &valor->inteiro);
+            valor->real = token.valor;
+        } else if (tipo != TOKEN_OPERADOR) {
+            // Variável ou token inválido
+            *codigo = ERRO_TOKEN_INVALIDO;
+            goto erro;
+        } else if (opcode_eh_binario(token.op)) {
+            // Operador binário (a estrutura é válida: há dois operandos)
+            pilha.topo--;
+            if (!aplicar_operacao_mista(token.op, &pilha.dados[pilha.topo], &pilha.dados[pilha.topo + 1], codigo)) {
+                goto erro;
+            }
+        } else {
+            // Função unária (sempre em float)
+            ValorMisto *op1 = &pilha.dados[pilha.topo];
+            op1->real = aplicar_operacao(token.op, valor_real(op1), 0.0f, codigo);
+            op1->eh_inteiro = 0;
+            if (isnan(op1->real)) {
+                goto erro;
+            }
+        }
+    }
+
+    *resultado = pilha.dados[pilha.topo];
+    *posicao = -1;
+    liberar_pilha_mista(&pilha);
+    return 1;
+
+erro:
+    liberar_pilha_mista(&pilha);
+    return 0;
+}
+
+// Tarefa do pool: avalia uma subárvore inteira
+void avaliar_subarvore_paralela(void *contexto, size_t indice, int trabalhador) {
+    (void)trabalhador;
+    ContextoParalelo *ctx = (ContextoParalelo *)contexto;
+    SubarvoreParalela *subarvore = &ctx->subarvores[indice];
+    subarvore->codigo = ERRO_NENHUM;
+    avaliar_tokens_mistos(ctx->str, ctx->tokens, subarvore->inicio, subarvore->raiz, NULL, 0, &subarvore->valor,
+                          &subarvore->codigo, &subarvore->posicao);
+}
+
+// Ordem crescente de início das subárvores (qsort)
+int comparar_subarvores(const void *a, const void *b) {
+    int x = ((const SubarvoreParalela *)a)->inicio;
+    int y = ((const SubarvoreParalela *)b)->inicio;
+    return (x > y) - (x < y);
+}
+
+/*
+ * getValorPosFixaParalelo
+ * -----------------------
+ * Calcula o valor de uma expressão pós-fixa muito grande usando os núcleos do
+ * pool. Uma passada sequencial barata (medir_subarvores) valida a estrutura e
+ * mede o tamanho de cada subárvore; descendo da raiz, toda subárvore com até
+ * 'grao' tokens (grao = n / (trabalhadores * TAREFAS_POR_TRABALHADOR), no
+ * mínimo o limiar) e pelo menos 'limiar' tokens vira uma tarefa. As tarefas
+ * convertem os números e calculam as suas subárvores em uma rodada do pool
+ * (fork); a parte de cima da árvore, com as subárvores menores que o limiar, é
+ * avaliada depois com os valores das tarefas (join).
+ *
+ * O resultado, o código e a posição do erro são os de getValorPosFixaComErro,
+ * bit a bit. Expressões com menos tokens que o limiar, pool NULL ou com um
+ * único trabalhador e expressões com erro de estrutura vão direto para o
+ * caminho sequencial.
+ *
+ * Parâmetros:
+ * - pool: Pool criado por criarPoolTrabalho (ou NULL).
+ * - StrPosFixa: String contendo a expressão pós-fixa.
+ * - limiar: Tamanho mínimo, em tokens, de uma subárvore paralela (<= 0 usa
+ *   LIMIAR_PARALELO_PADRAO).
+ * - erro: Recebe ERRO_NENHUM ou a causa do erro.
+ *
+ * Retorno:
+ * - O valor numérico da expressão. Retorna NAN em caso de erro.
+ */
+float getValorPosFixaParalelo(PoolTrabalho *pool, const char *StrPosFixa, int limiar, ErroExpressao *erro) {
+    if (limiar <= 0) {
+        limiar = LIMIAR_PARALELO_PADRAO;
+    }
+    // Os tokens são separados por espaço: no máximo (tamanho + 1) / 2. As páginas do
+    // vetor que sobram nunca são tocadas, então o limite custa só espaço de endereços.
+    size_t tamanho = strlen(StrPosFixa);
+    size_t max_tokens = (tamanho + 1) / 2;
+    if (pool == NULL || pool->num_trabalhadores == 1 || max_tokens < (size_t)limiar || tamanho > UINT_MAX / 2) {
+        return getValorPosFixaComErro(StrPosFixa, erro);
+    }
+
+    TokenParalelo *tokens = (TokenParalelo *)malloc(max_tokens * sizeof(TokenParalelo));
+    int *pendentes = (int *)malloc(max_tokens * sizeof(int));
+    int n = (tokens != NULL && pendentes != NULL) ? medir_subarvores(StrPosFixa, tokens, pendentes) : 0;
+    SubarvoreParalela *subarvores = NULL;
+    if (n >= limiar) {
+        subarvores = (SubarvoreParalela *)malloc((n / limiar + 1) * sizeof(SubarvoreParalela));
+    }
+    if (subarvores == NULL) {
+        // Pequena, sem memória ou com erro de estrutura: o caminho sequencial acha o mesmo primeiro erro
+        free(tokens);
+        free(pendentes);
+        return getValorPosFixaComErro(StrPosFixa, erro);
+    }
+    int grao = n / (pool->num_trabalhadores * TAREFAS_POR_TRABALHADOR);
+    if (grao < limiar) {
+        grao = limiar;
+    }
+
+    // Desce da raiz até as subárvores com no máximo 'grao' tokens (reaproveita a pilha)
+    int num_pendentes = 0;
+    int num_subarvores = 0;
+    pendentes[num_pendentes++] = n - 1;
+    while (num_pendentes > 0) {
+        int raiz = pendentes[--num_pendentes];
+        const TokenParalelo *token = &tokens[raiz];
+        if (token->tamanho <= grao) {
+            if (token->tamanho >= limiar) {
+                subarvores[num_subarvores].inicio = raiz - token->tamanho + 1;
+                subarvores[num_subarvores].raiz = raiz;
+                num_subarvores++;
+            }
+            continue;
+        }
+        // Filhos: o token anterior e, nos binários, o que vem antes da subárvore dele
+        pendentes[num_pendentes++] = raiz - 1;
+        if (token->tamanho > 1 + tokens[raiz - 1].tamanho) {
+            pendentes[num_pendentes++] = raiz - 1 - tokens[raiz - 1].tamanho;
+        }
+    }
+    free(pendentes);
+    qsort(subarvores, num_subarvores, sizeof(SubarvoreParalela), comparar_subarvores);
+
+    ContextoParalelo ctx = {StrPosFixa, tokens, subarvores};
+    executarNoPool(pool, num_subarvores, avaliar_subarvore_paralela, &ctx);
+
+    ValorMisto resultado;
+    CodigoErro codigo = ERRO_NENHUM;
+    long posicao = -1;
+    float valor = NAN;
+    if (avaliar_tokens_mistos(StrPosFixa, tokens, 0, n - 1, subarvores, num_subarvores, &resultado, &codigo,
+                              &posicao)) {
+        valor = valor_real(&resultado);
+    }
+    free(subarvores);
+    free(tokens);
+    registrar_erro(erro, codigo, posicao);
+    return valor;
+}
+
+// =================================================================================
+// CONVERSÃO INFIXA -> PÓS-FIXA (shunting-yard)
+// =================================================================================
+
+// Tipos de item na pilha de operadores do shunting-yard
+#define ITEM_PARENTESE 0 // '(' comum
+#define ITEM_FUNCAO 1    // "nome(" de uma função unária
+#define ITEM_BINARIO 2   // Operador binário
+#define ITEM_NEGACAO 3   // Menos unário
+
+#define CAPACIDADE_OPERADORES_LOCAL 64
+
+typedef struct {
+    unsigned char tipo;
+    unsigned char op; // Opcode (ITEM_BINARIO e ITEM_FUNCAO)
+} ItemOperador;
+
+// Destino da conversão: um programa compilado ou o texto pós-fixo canônico
+typedef struct {
+    ProgramaPosFixa *programa; // NULL ao gerar texto
+    int capacidade_instrucoes;
+    int capacidade_constantes;
+    int altura;
+    char *texto;               // Usado quando programa == NULL
+    size_t usado;
+    size_t capacidade_texto;
+    int grande_demais;         // Passou de MAX_ARGUMENTO_INSTRUCAO constantes ou variáveis
+} SaidaPosFixa;
+
+// Garante espaço para mais 'extra' bytes no texto de saída
+int reservar_saida_texto(SaidaPosFixa *saida, size_t extra) {
+    if (saida->usado + extra <= saida->capacidade_texto) {
+        return 1;
+    }
+    size_t nova_capacidade = saida->capacidade_texto * 2 + extra + 64;
+    char *novo = (char *)realloc(saida->texto, nova_capacidade);
+    if (novo == NULL) {
+        return 0;
+    }
+    saida->texto = novo;
+    saida->capacidade_texto = nova_capacidade;
+    return 1;
+}
+
+// Acrescenta um token ao texto de saída, separado do anterior por um espaço
+int emitir_texto(SaidaPosFixa *saida, const char *prefixo, const char *token, size_t tamanho) {
+    size_t tamanho_prefixo = strlen(prefixo);
+    if (!reservar_saida_texto(saida, tamanho_prefixo + tamanho + 2)) {
+        return 0;
+    }
+    if (saida->usado > 0) {
+        saida->texto[saida->usado++] = ' ';
+    }
+    memcpy(saida->texto + saida->usado, prefixo, tamanho_prefixo);
+    saida->usado += tamanho_prefixo;
+    memcpy(saida->texto + saida->usado, token, tamanho);
+    saida->usado += tamanho;
+    return 1;
+}
+
+// Acrescenta uma instrução ao programa, atualizando a altura da pilha
+int emitir_instrucao(SaidaPosFixa *saida, unsigned int instrucao, int variacao_altura) {
+    ProgramaPosFixa *programa = saida->programa;
+    if (programa->num_instrucoes == saida->capacidade_instrucoes) {
+        int nova_capacidade = saida->capacidade_instrucoes * 2 + 16;
+        unsigned int *novas = (unsigned int *)realloc(programa->instrucoes, nova_capacidade * sizeof(unsigned int));
+        if (novas == NULL) {
+            return 0;
+        }
+        programa->instrucoes = novas;
+        saida->capacidade_instrucoes = nova_capacidade;
+    }
+    programa->instrucoes[programa->num_instrucoes++] = instrucao;
+    saida->altura += variacao_altura;
+    if (saida->altura > programa->profundidade_maxima) {
+        programa->profundidade_maxima = saida->altura;
+    }
+    return 1;
+}
+
+// Emite uma constante; 'texto' é o número como escrito (sem o sinal)
+int emitir_constante(SaidaPosFixa *saida, float valor, int negativo, const char *texto, size_t tamanho) {
+    if (saida->programa == NULL) {
+        return emitir_texto(saida, negativo ? "-" : "", texto, tamanho);
+    }
+    ProgramaPosFixa *programa = saida->programa;
+    if (programa->num_constantes >= MAX_ARGUMENTO_INSTRUCAO) {
+        saida->grande_demais = 1;
+        return 0;
+    }
+    if (programa->num_constantes == saida->capacidade_constantes) {
+        int nova_capacidade = saida->capacidade_constantes * 2 + 16;
+        float *novas = (float *)realloc(programa->constantes, nova_capacidade * sizeof(float));
+        if (novas == NULL) {
+            return 0;
+        }
+        programa->constantes = novas;
+        saida->capacidade_constantes = nova_capacidade;
+    }
+    programa->constantes[programa->num_constantes] = negativo ? -valor : valor;
+    return emitir_instrucao(saida, INSTRUCAO(OP_CONSTANTE, programa->num_constantes++), 1);
+}
+
+// Emite uma variável
+int emitir_variavel(SaidaPosFixa *saida, const char *nome, size_t tamanho) {
+    if (saida->programa == NULL) {
+        return emitir_texto(saida, "", nome, tamanho);
+    }
+    ProgramaPosFixa *programa = saida->programa;
+    int indice = registrar_nome(&programa->nomes_variaveis, &programa->num_variaveis, nome, tamanho);
+    if (indice >= MAX_ARGUMENTO_INSTRUCAO) {
+        saida->grande_demais = 1;
+        return 0;
+    }
+    return indice >= 0 && emitir_instrucao(saida, INSTRUCAO(OP_VARIAVEL, indice), 1);
+}
+
+// Mensagem de uma falha ao emitir na saída: programa grande demais ou falta de memória
+void imprimir_falha_saida(const SaidaPosFixa *saida) {
+    fprintf(stderr, "%s\n", saida->grande_demais ? descricoes_erro[ERRO_PROGRAMA_GRANDE].mensagem
+                                                 : descricoes_erro[ERRO_MEMORIA].mensagem);
+}
+
+// Emite o item retirado da pilha de operadores (o menos unário vira "-1 *")
+int emitir_item(SaidaPosFixa *saida, ItemOperador item) {
+    if (item.tipo == ITEM_NEGACAO) {
+        return emitir_constante(saida, 1.0f, 1, "1", 1) && emitir_item(saida, (ItemOperador){ITEM_BINARIO, OP_MULTIPLICACAO});
+    }
+    Opcode op = (Opcode)item.op;
+    if (saida->programa == NULL) {
+        const char *texto = texto_do_opcode(op);
+        return emitir_texto(saida, "", texto, strlen(texto));
+    }
+    return emitir_instrucao(saida, INSTRUCAO(op, 0), opcode_eh_binario(op) ? -1 : 0);
+}
+
+// Precedência de um item na pilha: + - (1), * / % (2), menos unário (3), ^ (4)
+int precedencia_item(ItemOperador item) {
+    if (item.tipo == ITEM_NEGACAO) {
+        return 3;
+    }
+    switch ((Opcode)item.op) {
+        case OP_SOMA:
+        case OP_SUBTRACAO:
+            return 1;
+        case OP_POTENCIA:
+            return 4;
+        default:
+            return 2;
+    }
+}
+
+// Verifica se há um número começando em p (dígito, ou ponto seguido de dígito)
+int inicia_numero(const char *p) {
+    return EH_DIGITO(p[0]) || (p[0] == '.' && EH_DIGITO(p[1]));
+}
+
+/*
+ * converter_infixa
+ * ----------------
+ * Converte uma expressão infixa com o algoritmo shunting-yard, emitindo cada
+ * operando e operador diretamente na saída (programa ou texto), sem criar
+ * strings intermediárias para os tokens. Aceita + - * / % ^, menos unário,
+ * parênteses, variáveis e as funções raiz, sen, cos, tg e log com chamada
+ * "nome(...)". Um número com sinal logo após um operador ou '(' vira uma
+ * constante negativa, exceto quando é base de ^ (-4^2 = -(4^2)).
+ *
+ * Retorno:
+ * - 1 em caso de sucesso; 0 se a expressão for inválida (mensagem em stderr).
+ */
+int converter_infixa(const char *str, SaidaPosFixa *saida) {
+    ItemOperador pilha_local[CAPACIDADE_OPERADORES_LOCAL];
+    ItemOperador *pilha = pilha_local;
+    int capacidade = CAPACIDADE_OPERADORES_LOCAL;
+    int topo = -1;
+    int esperando_operando = 1;
+    const char *p = str;
+    int ok = 0;
+
+    for (;;) {
+        while (EH_ESPACO(*p)) p++;
+        char c = *p;
+        if (c == '\0') {
+            break;
+        }
+
+        // Garante espaço para mais um item na pilha de operadores
+        if (topo + 1 >= capacidade) {
+            ItemOperador *nova = (ItemOperador *)malloc(2 * capacidade * sizeof(ItemOperador));
+            if (nova == NULL) {
+                fprintf(stderr, "Erro de alocacao de memoria.\n");
+                goto fim;
+            }
+            memcpy(nova, pilha, (topo + 1) * sizeof(ItemOperador));
+            if (pilha != pilha_local) {
+                free(pilha);
+            }
+            pilha = nova;
+            capacidade *= 2;
+        }
+
+        if (esperando_operando) {
+            if (inicia_numero(p) ||
+                ((c == '-' || c == '+') && inicia_numero(p + 1))) {
+                // Número, possivelmente com sinal
+                int com_sinal = (c == '-' || c == '+');
+                float valor;
+                const char *fim_numero = ler_numero(p + com_sinal, &valor);
+                const char *depois = fim_numero;
+                while (EH_ESPACO(*depois)) depois++;
+
+                if (com_sinal && *depois == '^') {
+                    // -4^2: o sinal vale para a potência inteira
+                    if (c == '-') {
+                        pilha[++topo] = (ItemOperador){ITEM_NEGACAO, 0};
+                    }
+                    p++;
+                    continue;
+                }
+                if (!emitir_constante(saida, valor, c == '-', p + com_sinal, fim_numero - (p + com_sinal))) {
+                    imprimir_falha_saida(saida);
+                    goto fim;
+                }
+                p = fim_numero;
+                esperando_operando = 0;
+            } else if (c == '-' || c == '+') {
+                // Sinal aplicado a uma sub-expressão: só o menos altera o valor
+                if (c == '-') {
+                    pilha[++topo] = (ItemOperador){ITEM_NEGACAO, 0};
+                }
+                p++;
+            } else if (c == '(') {
+                pilha[++topo] = (ItemOperador){ITEM_PARENTESE, 0};
+                p++;
+            } else if (EH_LETRA(c)) {
+                const char *nome = p;
+                while (EH_LETRA(*p) || EH_DIGITO(*p)) p++;
+                size_t tamanho = p - nome;
+                Opcode funcao = funcao_do_nome(nome, tamanho);
+
+                if (funcao != NUM_OPCODES) {
+                    while (EH_ESPACO(*p)) p++;
+                    if (*p != '(') {
+                        fprintf(stderr, "Erro: Expressao infixa invalida (funcao %.*s sem '(' na posicao %ld).\n",
+                                (int)tamanho, nome, (long)(p - str));
+                        goto fim;
+                    }
+                    pilha[++topo] = (ItemOperador){ITEM_FUNCAO, (unsigned char)funcao};
+                    p++;
+                } else {
+                    if (!emitir_variavel(saida, nome, tamanho)) {
+                        imprimir_falha_saida(saida);
+                        goto fim;
+                    }
+                    esperando_operando = 0;
+                }
+            } else {
+                fprintf(stderr, "Erro: Expressao infixa invalida (operando esperado na posicao %ld).\n",
+                        (long)(p - str));
+                goto fim;
+            }
+        } else {
+            Opcode op = NUM_OPCODES;
+            switch (c) {
+                case '+': op = OP_SOMA; break;
+                case '-': op = OP_SUBTRACAO; break;
+                case '*': op = OP_MULTIPLICACAO; break;
+                case '/': op = OP_DIVISAO; break;
+                case '%': op = OP_MODULO; break;
+                case '^': op = OP_POTENCIA; break;
+                default: break;
+            }
+
+            if (op != NUM_OPCODES) {
+                // Desempilha quem tem precedência maior (ou igual, se op associa à esquerda)
+                ItemOperador novo = {ITEM_BINARIO, (unsigned char)op};
+                int prec = precedencia_item(novo);
+                while (topo >= 0 && pilha[topo].tipo >= ITEM_BINARIO) {
+                    int prec_topo = precedencia_item(pilha[topo]);
+                    if (prec_topo < prec || (prec_topo == prec && op == OP_POTENCIA)) {
+                        break;
+                    }
+                    if (!emitir_item(saida, pilha[topo--])) {
+                        imprimir_falha_saida(saida);
+                        goto fim;
+                    }
+                }
+                pilha[++topo] = novo;
+                esperando_operando = 1;
+                p++;
+            } else if (c == ')') {
+                while (topo >= 0 && pilha[topo].tipo >= ITEM_BINARIO) {
+                    if (!emitir_item(saida, pilha[topo--])) {
+                        imprimir_falha_saida(saida);
+                        goto fim;
+                    }
+                }
+                if (topo < 0) {
+                    fprintf(stderr, "Erro: Expressao infixa invalida (')' sem '(' na posicao %ld).\n",
+                            (long)(p - str));
+                    goto fim;
+                }
+                ItemOperador abertura = pilha[topo--];
+                if (abertura.tipo == ITEM_FUNCAO && !emitir_item(saida, abertura)) {
+                    imprimir_falha_saida(saida);
+                    goto fim;
+                }
+                p++;
+            } else {
+                fprintf(stderr, "Erro: Expressao infixa invalida (operador esperado na posicao %ld).\n",
+                        (long)(p - str));
+                goto fim;
+            }
+        }
+    }
+
+    if (esperando_operando) {
+        fprintf(stderr, "Erro: Expressao infixa invalida (expressao vazia ou incompleta).\n");
+        goto fim;
+    }
+    while (topo >= 0) {
+        ItemOperador item = pilha[topo--];
+        if (item.tipo < ITEM_BINARIO) {
+            fprintf(stderr, "Erro: Expressao infixa invalida ('(' sem ')').\n");
+            goto fim;
+        }
+        if (!emitir_item(saida, item)) {
+            imprimir_falha_saida(saida);
+            goto fim;
+        }
+    }
+    ok = 1;
+
+fim:
+    if (pilha != pilha_local) {
+        free(pilha);
+    }
+    return ok;
+}
+
+/*
+ * compilarInFixa
+ * --------------
+ * Compila uma expressão infixa (ex: "3*(12+4)") diretamente para um programa,
+ * equivalente a compilarPosFixa(getFormaPosFixa(...)) sem o texto intermediário.
+ *
+ * Parâmetros:
+ * - StrInFixa: String contendo a expressão infixa.
+ * - programa: Estrutura que recebe o programa compilado.
+ *
+ * Retorno:
+ * - 1 em caso de sucesso; 0 se a expressão for inválida (o programa fica vazio).
+ */
+int compilarInFixa(const char *StrInFixa, ProgramaPosFixa *programa) {
+    SaidaPosFixa saida;
+    memset(&saida, 0, sizeof(saida));
+    memset(programa, 0, sizeof(ProgramaPosFixa));
+    saida.programa = programa;
+
+    if (!converter_infixa(StrInFixa, &saida)) {
+        liberarPrograma(programa);
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * getFormaPosFixa
+ * ---------------
+ * Converte uma expressão infixa para a forma pós-fixa canônica: tokens
+ * separados por um espaço, números como escritos na entrada.
+ *
+ * Parâmetro:
+ * - StrInFixa: String contendo a expressão infixa (ex: "3*(12+4)").
+ *
+ * Retorno:
+ * - Ponteiro para a string pós-fixa (alocada dinamicamente), como "3 12 4 + *".
+ * - NULL em caso de erro.
+ */
+char * getFormaPosFixa(const char *StrInFixa) {
+    SaidaPosFixa saida;
+    memset(&saida, 0, sizeof(saida));
+
+    if (!converter_infixa(StrInFixa, &saida) || !reservar_saida_texto(&saida, 1)) {
+        free(saida.texto);
+        return NULL;
+    }
+    saida.texto[saida.usado] = '\0';
+    return saida.texto;
+}
+
+// =================================================================================
+// CACHE DE EXPRESSÕES
+// =================================================================================
+
+#define NUM_FRAGMENTOS_CACHE 16            // Cada fragmento tem sua própria trava de leitura/escrita
+#define TAMANHO_MAXIMO_SUBARVORE_CACHE 64 // Subexpressões maiores não são guardadas
+#define BASE_HASH_TOKENS 0x9E3779B97F4A7C15ull
+
+// Expressão guardada: a chave é o hash da sequência de tokens, confirmado pela forma canônica
+typedef struct {
+    unsigned long long chave;
+    char *canonica;              // Tokens separados por um único espaço
+    size_t tamanho_canonica;
+    char *infixa;
+    ValorMisto valor;            // Exato em int64 como na pilha de getValorPosFixa
+    int proxima;                 // Próxima entrada do mesmo balde (-1 = fim)
+    unsigned char referenciada;  // Bit de uso do CLOCK (escrito também sob trava de leitura)
+} EntradaCache;
+
+typedef struct {
+    pthread_rwlock_t trava;
+    EntradaCache *entradas;
+    int *baldes;                 // Primeira entrada de cada balde (-1 = vazio)
+    int capacidade;
+    int mascara_baldes;          // Número de baldes - 1 (potência de 2)
+    int num_entradas;
+    int ponteiro_clock;
+    // Porteiro das subárvores: uma subárvore só entra no cache na segunda vez em que é vista
+    unsigned long long *vistas;
+    int mascara_vistas;          // Número de bits - 1 (potência de 2)
+    int num_vistas;              // Bits marcados desde a última limpeza
+    // Contadores atualizados atomicamente, sem exigir a trava de escrita
+    unsigned long long acertos;
+    unsigned long long faltas;
+    unsigned long long acertos_subarvores;
+    unsigned long long insercoes;
+    unsigned long long remocoes;
+    char preenchimento[64];      // Evita falso compartilhamento entre fragmentos vizinhos
+} FragmentoCache;
+
+struct CacheExpressoes {
+    FragmentoCache fragmentos[NUM_FRAGMENTOS_CACHE];
+    int tamanho_minimo_subarvore;
+    unsigned long long potencias[TAMANHO_MAXIMO_SUBARVORE_CACHE + 1]; // BASE_HASH_TOKENS^k
+};
+
+// Passos do hash de um token: junta 8 bytes por palavra e só multiplica por palavra
+#define MISTURAR_PALAVRA_TOKEN(h, palavra) ((h) = ((h) ^ (palavra)) * 0xFF51AFD7ED558CCDull)
+#define FINALIZAR_HASH_TOKEN(h, palavra, tamanho) \
+    (MISTURAR_PALAVRA_TOKEN(h, (palavra) ^ ((unsigned long long)(tamanho) << 56)), (h) ^ ((h) >> 32))
+
+// Hash dos caracteres de um token
+unsigned long long hash_token(const char *texto, size_t tamanho) {
+    unsigned long long h = 0;
+    unsigned long long palavra = 0;
+    for (size_t i = 0; i < tamanho; i++) {
+        palavra = (palavra << 8) | (unsigned char)texto[i];
+        if ((i & 7) == 7) {
+            MISTURAR_PALAVRA_TOKEN(h, palavra);
+            palavra = 0;
+        }
+    }
+    return FINALIZAR_HASH_TOKEN(h, palavra, tamanho);
+}
+
+// Mistura final (splitmix64): combina o hash polinomial com o número de tokens
+unsigned long long finalizar_hash(unsigned long long h, size_t num_tokens) {
+    h ^= num_tokens * 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBull;
+    h ^= h >> 31;
+    return h;
+}
+
+/*
+ * hash_expressao
+ * --------------
+ * Hash canônico da sequência de tokens: soma polinomial dos hashes dos tokens,
+ * indiferente ao espaçamento. Como os nós da árvore ficam na ordem dos tokens,
+ * o hash de uma subárvore sai dos prefixos em O(1) com a mesma definição.
+ * *canonica indica se str já está na forma canônica (tokens separados por um
+ * único espaço), caso em que a confirmação é um memcmp.
+ */
+unsigned long long hash_expressao(const char *str, size_t *num_tokens, size_t *tamanho_canonica,
+                                  int *canonica) {
+    unsigned long long h = 0;
+    size_t tokens = 0;
+    size_t caracteres = 0;
+    int separadores_simples = 1;
+    const char *p = str;
+
+    for (;;) {
+        const char *espacos = p;
+        while (EH_ESPACO(*p)) p++;
+        if (*p == '\0') {
+            separadores_simples &= (p == espacos);
+            break;
+        }
+        separadores_simples &= (tokens == 0) ? (p == espacos) : (p == espacos + 1 && *espacos == ' ');
+        // Mesmo cálculo de hash_token, feito durante a própria varredura do token
+        const char *inicio = p;
+        unsigned long long h_token = 0;
+        unsigned long long palavra = 0;
+        for (; *p != '\0' && !EH_ESPACO(*p); p++) {
+            palavra = (palavra << 8) | (unsigned char)*p;
+            if (((p - inicio) & 7) == 7) {
+                MISTURAR_PALAVRA_TOKEN(h_token, palavra);
+                palavra = 0;
+            }
+        }
+        h = h * BASE_HASH_TOKENS + FINALIZAR_HASH_TOKEN(h_token, palavra, p - inicio);
+        caracteres += (size_t)(p - inicio);
+        tokens++;
+    }
+    *num_tokens = tokens;
+    *tamanho_canonica = (tokens > 0) ? caracteres + tokens - 1 : 0;
+    *canonica = separadores_simples;
+    return finalizar_hash(h, tokens);
+}
+
+// Compara os tokens de str com uma forma canônica (tokens separados por um espaço)
+int tokens_iguais_canonica(const char *str, const char *canonica, size_t tamanho) {
+    const char *p = str;
+    size_t j = 0;
+
+    for (;;) {
+        while (EH_ESPACO(*p)) p++;
+        if (*p == '\0') {
+            return j == tamanho;
+        }
+        if (j > 0) {
+            if (j >= tamanho || canonica[j] != ' ') {
+                return 0;
+            }
+            j++;
+        }
+        while (*p != '\0' && !EH_ESPACO(*p)) {
+            if (j >= tamanho || canonica[j] != *p) {
+                return 0;
+            }
+            p++;
+            j++;
+        }
+    }
+}
+
+// Procura uma entrada; 'texto' é a forma canônica (canonico = 1) ou a expressão original
+EntradaCache *procurar_entrada(FragmentoCache *fragmento, unsigned long long chave,
+                               const char *texto, size_t tamanho, int canonico) {
+    int i = fragmento->baldes[chave & (unsigned long long)fragmento->mascara_baldes];
+    while (i >= 0) {
+        EntradaCache *entrada = &fragmento->entradas[i];
+        if (entrada->chave == chave && entrada->tamanho_canonica == tamanho &&
+            (canonico ? memcmp(entrada->canonica, texto, tamanho) == 0
+                      : tokens_iguais_canonica(texto, entrada->canonica, tamanho))) {
+            return entrada;
+        }
+        i = entrada->proxima;
+    }
+    return NULL;
+}
+
+FragmentoCache *fragmento_da_chave(CacheExpressoes *cache, unsigned long long chave) {
+    return &cache->fragmentos[chave >> 60];
+}
+
+/*
+ * consultar_cache
+ * ---------------
+ * Caminho de acerto: só a trava de leitura do fragmento é tomada, e o bit do
+ * CLOCK é marcado com uma escrita atômica. Copia o valor e, se pedido, a infixa.
+ *
+ * Retorno:
+ * - 1 se a expressão estava no cache; 0 caso contrário (ou se faltar memória).
+ */
+int consultar_cache(CacheExpressoes *cache, unsigned long long chave, const char *texto,
+                    size_t tamanho, int canonico, ValorMisto *valor, char **infixa) {
+    FragmentoCache *fragmento = fragmento_da_chave(cache, chave);
+    int encontrado = 0;
+
+    pthread_rwlock_rdlock(&fragmento->trava);
+    EntradaCache *entrada = procurar_entrada(fragmento, chave, texto, tamanho, canonico);
+    if (entrada != NULL) {
+        __atomic_store_n(&entrada->referenciada, 1, __ATOMIC_RELAXED);
+        *valor = entrada->valor;
+        encontrado = 1;
+        if (infixa != NULL) {
+            *infixa = strdup(entrada->infixa);
+            encontrado = (*infixa != NULL);
+        }
+    }
+    pthread_rwlock_unlock(&fragmento->trava);
+    return encontrado;
+}
+
+/*
+ * inserir_no_cache
+ * ----------------
+ * Guarda uma expressão, assumindo a posse de 'canonica' e 'infixa'. Com o
+ * fragmento cheio, o ponteiro do CLOCK percorre as entradas limpando os bits
+ * de uso e descarta a primeira entrada não usada desde a última volta.
+ */
+void inserir_no_cache(CacheExpressoes *cache, unsigned long long chave, char *canonica,
+                      size_t tamanho, char *infixa, ValorMisto valor) {
+    FragmentoCache *fragmento = fragmento_da_chave(cache, chave);
+    int indice;
+
+    pthread_rwlock_wrlock(&fragmento->trava);
+    if (procurar_entrada(fragmento, chave, canonica, tamanho, 1) != NULL) {
+        // Outra thread inseriu a mesma expressão enquanto esta calculava
+        pthread_rwlock_unlock(&fragmento->trava);
+        free(canonica);
+        free(infixa);
+        return;
+    }
+
+    if (fragmento->num_entradas < fragmento->capacidade) {
+        indice = fragmento->num_entradas++;
+    } else {
+        for (;;) {
+            EntradaCache *vitima = &fragmento->entradas[fragmento->ponteiro_clock];
+            if (!vitima->referenciada) {
+                break;
+            }
+            vitima->referenciada = 0;
+            fragmento->ponteiro_clock = (fragmento->ponteiro_clock + 1) % fragmento->capacidade;
+        }
+        indice = fragmento->ponteiro_clock;
+        fragmento->ponteiro_clock = (fragmento->ponteiro_clock + 1) % fragmento->capacidade;
+
+        // Remove a vítima do seu balde
+        EntradaCache *vitima = &fragmento->entradas[indice];
+        int *elo = &fragmento->baldes[vitima->chave & (unsigned long long)fragmento->mascara_baldes];
+        while (*elo != indice) {
+            elo = &fragmento->entradas[*elo].proxima;
+        }
+        *elo = vitima->proxima;
+        free(vitima->canonica);
+        free(vitima->infixa);
+        __atomic_fetch_add(&fragmento->remocoes, 1, __ATOMIC_RELAXED);
+    }
+
+    EntradaCache *entrada = &fragmento->entradas[indice];
+    int *balde = &fragmento->baldes[chave & (unsigned long long)fragmento->mascara_baldes];
+    entrada->chave = chave;
+    entrada->canonica = canonica;
+    entrada->tamanho_canonica = tamanho;
+    entrada->infixa = infixa;
+    entrada->valor = valor;
+    entrada->referenciada = 0;
+    entrada->proxima = *balde;
+    *balde = indice;
+    __atomic_fetch_add(&fragmento->insercoes, 1, __ATOMIC_RELAXED);
+    pthread_rwlock_unlock(&fragmento->trava);
+}
+
+// Decide se uma subárvore calculada deve ser guardada: na primeira vez só é
+// anotada no porteiro, para que subexpressões únicas não expulsem as repetidas
+int admitir_subarvore(CacheExpressoes *cache, unsigned long long chave) {
+    FragmentoCache *fragmento = fragmento_da_chave(cache, chave);
+    unsigned int bit = (unsigned int)(chave >> 24) & (unsigned int)fragmento->mascara_vistas;
+    unsigned long long marca = 1ull << (bit & 63);
+    int admitida;
+
+    pthread_rwlock_wrlock(&fragmento->trava);
+    admitida = (fragmento->vistas[bit >> 6] & marca) != 0;
+    if (!admitida) {
+        fragmento->vistas[bit >> 6] |= marca;
+        if (++fragmento->num_vistas > fragmento->mascara_vistas / 2) {
+            // Porteiro saturado: recomeça, para que o histórico antigo não admita tudo
+            memset(fragmento->vistas, 0, (size_t)(fragmento->mascara_vistas / 64 + 1) * sizeof(unsigned long long));
+            fragmento->num_vistas = 0;
+        }
+    }
+    pthread_rwlock_unlock(&fragmento->trava);
+    return admitida;
+}
+
+// Escreve a forma canônica dos nós [inicio, fim] (sem '\0'); retorna o tamanho
+size_t escrever_canonica(const NoArvore *nos, int inicio, int fim, char *destino) {
+    size_t j = 0;
+    for (int i = inicio; i <= fim; i++) {
+        if (i > inicio) {
+            destino[j++] = ' ';
+        }
+        memcpy(destino + j, nos[i].texto, nos[i].tamanho_texto);
+        j += nos[i].tamanho_texto;
+    }
+    return j;
+}
+
+/*
+ * resolver_falta
+ * --------------
+ * Calcula uma expressão que não estava no cache e a guarda. Com subárvores
+ * habilitadas, os nós são visitados da raiz para as folhas: uma subárvore
+ * encontrada no cache fornece seu valor e todo o intervalo de nós dela é
+ * pulado. Em seguida os nós restantes são avaliados em ordem pós-fixa e as
+ * subárvores calculadas (dentro dos limites de tamanho) são inseridas a
+ * partir da segunda vez em que aparecem.
+ * Os valores seguem a pilha mista de getValorPosFixa (int64 exato enquanto
+ * possível, float depois), inclusive os guardados para as subárvores.
+ * Uma expressão com erro de avaliação é guardada com valor NAN (a infixa
+ * continua válida), mas suas subárvores não.
+ *
+ * Retorno:
+ * - 1 se a árvore foi construída (valor real NAN em erro); 0 se a expressão
+ *   é inválida (nada é impresso).
+ */
+int resolver_falta(CacheExpressoes *cache, const char *str, unsigned long long chave,
+                   size_t tamanho_canonica, ValorMisto *valor, char **infixa) {
+    ArvoreExpressao arvore;
+    ErroExpressao erro_arvore;
+    if (!construir_arvore(str, 0, &arvore, &erro_arvore)) {
+        return 0;
+    }
+
+    int n = arvore.num_nos;
+    const NoArvore *nos = arvore.nos;
+    ValorMisto *valores = (ValorMisto *)malloc(n * sizeof(ValorMisto));
+    unsigned char *estado = (unsigned char *)calloc(n, 1); // 0 = calcular, 1 = do cache, 2 = pular
+    unsigned long long *prefixos = (unsigned long long *)malloc(n * sizeof(unsigned long long));
+    char *canonica = (char *)malloc(tamanho_canonica + 1);
+    char buffer_subarvore[TAMANHO_MAXIMO_SUBARVORE_CACHE * 32];
+    int minimo = cache->tamanho_minimo_subarvore;
+    int erro = 0;
+    int ok = 0;
+
+    valor->eh_inteiro = 0;
+    valor->real = NAN;
+    *infixa = NULL;
+    if (n <= 0 || valores == NULL || estado == NULL || prefixos == NULL || canonica == NULL) {
+        fprintf(stderr, "Erro de alocacao de memoria.\n");
+        goto fim;
+    }
+
+    // Hash de cada subárvore: prefixos[i] cobre os tokens 0..i
+    for (int i = 0; i < n; i++) {
+        unsigned long long anterior = (i > 0) ? prefixos[i - 1] : 0;
+        prefixos[i] = anterior * BASE_HASH_TOKENS + hash_token(nos[i].texto, nos[i].tamanho_texto);
+    }
+
+    // Da raiz para as folhas: reaproveita subárvores já guardadas
+    if (minimo > 0) {
+        for (int i = n - 2; i >= 0;) {
+            int tamanho = nos[i].tamanho;
+            int inicio = i - tamanho + 1;
+            size_t tamanho_texto = 0;
+            if (tamanho >= minimo && tamanho > 1 && tamanho <= TAMANHO_MAXIMO_SUBARVORE_CACHE) {
+                for (int k = inicio; k <= i; k++) {
+                    tamanho_texto += nos[k].tamanho_texto + 1;
+                }
+            }
+            if (tamanho_texto > 0 && tamanho_texto <= sizeof(buffer_subarvore)) {
+                unsigned long long h = prefixos[i] - ((inicio > 0) ? prefixos[inicio - 1] * cache->potencias[tamanho] : 0);
+                unsigned long long chave_subarvore = finalizar_hash(h, (size_t)tamanho);
+                size_t tamanho_subarvore = escrever_canonica(nos, inicio, i, buffer_subarvore);
+                if (consultar_cache(cache, chave_subarvore, buffer_subarvore, tamanho_subarvore, 1,
+                                    &valores[i], NULL)) {
+                    __atomic_fetch_add(&fragmento_da_chave(cache, chave_subarvore)->acertos_subarvores, 1,
+                                       __ATOMIC_RELAXED);
+                    estado[i] = 1;
+                    memset(estado + inicio, 2, tamanho - 1);
+                    i = inicio - 1;
+                    continue;
+                }
+            }
+            i--;
+        }
+    }
+
+    // Das folhas para a raiz: avalia o que não veio do cache
+    for (int i = 0; i < n; i++) {
+        const NoArvore *no = &nos[i];
+        if (estado[i] != 0) {
+            continue;
+        }
+        CodigoErro codigo;
+        if (no->op == OP_CONSTANTE) {
+            // Mesma pilha de getValorPosFixa: literais inteiros ficam exatos
+            valores[i].eh_inteiro = ler_literal_inteiro(no->texto, no->tamanho_texto, &valores[i].inteiro);
+            valores[i].real = no->valor;
+        } else if (no->direito >= 0) {
+            valores[i] = valores[no->esquerdo];
+            if (!aplicar_operacao_mista(no->op, &valores[i], &valores[no->direito], &codigo)) {
+                // Erro de avaliação: a expressão é guardada com valor NAN, sem subárvores
+                erro = 1;
+                break;
+            }
+        } else {
+            valores[i].real = aplicar_operacao(no->op, valor_real(&valores[no->esquerdo]), 0.0f, &codigo);
+            valores[i].eh_inteiro = 0;
+            if (isnan(valores[i].real)) {
+                erro = 1;
+                break;
+            }
+        }
+    }
+
+    // Guarda as subárvores calculadas
+    if (minimo > 0 && !erro) {
+        for (int i = 0; i < n - 1; i++) {
+            int tamanho = nos[i].tamanho;
+            int inicio = i - tamanho + 1;
+            if (estado[i] != 0 || tamanho < minimo || tamanho <= 1 || tamanho > TAMANHO_MAXIMO_SUBARVORE_CACHE) {
+                continue;
+            }
+            unsigned long long h = prefixos[i] - ((inicio > 0) ? prefixos[inicio - 1] * cache->potencias[tamanho] : 0);
+            unsigned long long chave_subarvore = finalizar_hash(h, (size_t)tamanho);
+            if (!admitir_subarvore(cache, chave_subarvore)) {
+                continue;
+            }
+            size_t tamanho_texto = 0;
+            for (int k = inicio; k <= i; k++) {
+                tamanho_texto += nos[k].tamanho_texto + 1;
+            }
+            char *canonica_subarvore = (char *)malloc(tamanho_texto);
+            char *infixa_subarvore = gerar_infixa_subarvore(&arvore, i);
+            if (canonica_subarvore == NULL || infixa_subarvore == NULL) {
+                free(canonica_subarvore);
+                free(infixa_subarvore);
+                continue;
+            }
+            size_t tamanho_subarvore = escrever_canonica(nos, inicio, i, canonica_subarvore);
+            canonica_subarvore[tamanho_subarvore] = '\0';
+            inserir_no_cache(cache, chave_subarvore, canonica_subarvore, tamanho_subarvore,
+                             infixa_subarvore, valores[i]);
+        }
+    }
+
+    // Guarda a expressão inteira (o cache fica com uma cópia da infixa)
+    if (!erro) {
+        *valor = valores[n - 1];
+    }
+    *infixa = gerar_infixa(&arvore);
+    if (*infixa == NULL) {
+        fprintf(stderr, "Erro de alocacao de memoria para o resultado.\n");
+        goto fim;
+    }
+    char *infixa_guardada = strdup(*infixa);
+    if (infixa_guardada != NULL) {
+        size_t tamanho = escrever_canonica(nos, 0, n - 1, canonica);
+        canonica[tamanho] = '\0';
+        inserir_no_cache(cache, chave, canonica, tamanho, infixa_guardada, *valor);
+        canonica = NULL;
+    }
+    ok = 1;
+
+fim:
+    free(valores);
+    free(estado);
+    free(prefixos);
+    free(canonica);
+    liberar_arvore(&arvore);
+    return ok;
+}
+
+/*
+ * criarCacheExpressoes
+ * --------------------
+ * Cria um cache para getValorPosFixaCache e getFormaInFixaCache. As entradas
+ * ficam divididas em fragmentos por hash, cada um com sua trava de
+ * leitura/escrita: consultas a fragmentos diferentes nunca disputam a mesma
+ * trava, e consultas ao mesmo fragmento só disputam com inserções.
+ *
+ * Parâmetros:
+ * - capacidade: Máximo de entradas (expressões e subexpressões).
+ * - tamanho_minimo_subarvore: Subexpressões com esse número de tokens ou mais
+ *   (ex: 3 para "45 60 +") também são guardadas e reaproveitadas; 0 desativa.
+ *
+ * Retorno:
+ * - Ponteiro para o cache, ou NULL em erro.
+ */
+CacheExpressoes *criarCacheExpressoes(size_t capacidade, int tamanho_minimo_subarvore) {
+    if (capacidade == 0 || capacidade > (size_t)INT_MAX / 2) {
+        return NULL;
+    }
+    CacheExpressoes *cache = (CacheExpressoes *)calloc(1, sizeof(CacheExpressoes));
+    if (cache == NULL) {
+        return NULL;
+    }
+    int capacidade_fragmento = (int)((capacidade + NUM_FRAGMENTOS_CACHE - 1) / NUM_FRAGMENTOS_CACHE);
+    int num_baldes = 1;
+    while (num_baldes < capacidade_fragmento) {
+        num_baldes *= 2;
+    }
+    int num_vistas = (num_baldes < 8) ? 64 : 8 * num_baldes; // Bits do porteiro
+
+    cache->tamanho_minimo_subarvore = (tamanho_minimo_subarvore > 0) ? tamanho_minimo_subarvore : 0;
+    cache->potencias[0] = 1;
+    for (int k = 1; k <= TAMANHO_MAXIMO_SUBARVORE_CACHE; k++) {
+        cache->potencias[k] = cache->potencias[k - 1] * BASE_HASH_TOKENS;
+    }
+
+    for (int f = 0; f < NUM_FRAGMENTOS_CACHE; f++) {
+        FragmentoCache *fragmento = &cache->fragmentos[f];
+        fragmento->entradas = (EntradaCache *)calloc(capacidade_fragmento, sizeof(EntradaCache));
+        fragmento->baldes = (int *)malloc(num_baldes * sizeof(int));
+        fragmento->vistas = (unsigned long long *)calloc(num_vistas / 64, sizeof(unsigned long long));
+        if (fragmento->entradas == NULL || fragmento->baldes == NULL || fragmento->vistas == NULL ||
+            pthread_rwlock_init(&fragmento->trava, NULL) != 0) {
+            free(fragmento->entradas);
+            free(fragmento->baldes);
+            free(fragmento->vistas);
+            fragmento->entradas = NULL;
+            destruirCacheExpressoes(cache);
+            return NULL;
+        }
+        memset(fragmento->baldes, 0xff, num_baldes * sizeof(int)); // Todos -1
+        fragmento->capacidade = capacidade_fragmento;
+        fragmento->mascara_baldes = num_baldes - 1;
+        fragmento->mascara_vistas = num_vistas - 1;
+    }
+    return cache;
+}
+
+/*
+ * getValorPosFixaCache
+ * --------------------
+ * Igual a getValorPosFixa (mesma aritmética: int64 exato enquanto possível,
+ * depois float), mas consulta o cache antes de calcular. No acerto,
+ * o texto é percorrido uma vez para o hash e outra para confirmar os tokens;
+ * não há árvore, alocação nem trava exclusiva. Expressões com erro de
+ * avaliação ficam no cache (para getFormaInFixaCache), mas são recalculadas
+ * por getValorPosFixa, que imprime as mensagens e conta os erros.
+ *
+ * Retorno:
+ * - O valor numérico da expressão, ou NAN em caso de erro.
+ */
+float getValorPosFixaCache(CacheExpressoes *cache, const char *StrPosFixa) {
+    if (cache == NULL) {
+        return getValorPosFixa((char *)StrPosFixa);
+    }
+
+    size_t num_tokens, tamanho_canonica;
+    int canonica;
+    unsigned long long chave = hash_expressao(StrPosFixa, &num_tokens, &tamanho_canonica, &canonica);
+    FragmentoCache *fragmento = fragmento_da_chave(cache, chave);
+    ValorMisto valor;
+
+    if (num_tokens > 0 &&
+        consultar_cache(cache, chave, StrPosFixa, tamanho_canonica, canonica, &valor, NULL)) {
+        __atomic_fetch_add(&fragmento->acertos, 1, __ATOMIC_RELAXED);
+        return isnan(valor_real(&valor)) ? getValorPosFixa((char *)StrPosFixa) : valor_real(&valor);
+    }
+    __atomic_fetch_add(&fragmento->faltas, 1, __ATOMIC_RELAXED);
+
+    char *infixa;
+    if (num_tokens == 0 || !resolver_falta(cache, StrPosFixa, chave, tamanho_canonica, &valor, &infixa)) {
+        return getValorPosFixa((char *)StrPosFixa);
+    }
+    free(infixa);
+    if (isnan(valor_real(&valor))) {
+        return getValorPosFixa((char *)StrPosFixa);
+    }
+    return valor_real(&valor);
+}
+
+/*
+ * getFormaInFixaCache
+ * -------------------
+ * Igual a getFormaInFixa, mas consulta o cache antes de converter.
+ *
+ * Retorno:
+ * - String infixa alocada dinamicamente (liberar com free), ou NULL em erro.
+ */
+char * getFormaInFixaCache(CacheExpressoes *cache, const char *StrPosFixa) {
+    if (cache == NULL) {
+        return getFormaInFixa((char *)StrPosFixa);
+    }
+
+    size_t num_tokens, tamanho_canonica;
+    int canonica;
+    unsigned long long chave = hash_expressao(StrPosFixa, &num_tokens, &tamanho_canonica, &canonica);
+    FragmentoCache *fragmento = fragmento_da_chave(cache, chave);
+    ValorMisto valor;
+    char *infixa = NULL;
+
+    if (num_tokens > 0 &&
+        consultar_cache(cache, chave, StrPosFixa, tamanho_canonica, canonica, &valor, &infixa)) {
+        __atomic_fetch_add(&fragmento->acertos, 1, __ATOMIC_RELAXED);
+        return infixa;
+    }
+    __atomic_fetch_add(&fragmento->faltas, 1, __ATOMIC_RELAXED);
+
+    if (num_tokens == 0 || !resolver_falta(cache, StrPosFixa, chave, tamanho_canonica, &valor, &infixa)) {
+        // Expressão inválida: a função original informa o erro
+        return getFormaInFixa((char *)StrPosFixa);
+    }
+    return infixa;
+}
+
+// Soma os contadores de todos os fragmentos
+void obterEstatisticasCache(CacheExpressoes *cache, EstatisticasCache *estatisticas) {
+    memset(estatisticas, 0, sizeof(EstatisticasCache));
+    if (cache == NULL) {
+        return;
+    }
+    for (int f = 0; f < NUM_FRAGMENTOS_CACHE; f++) {
+        FragmentoCache *fragmento = &cache->fragmentos[f];
+        estatisticas->acertos += __atomic_load_n(&fragmento->acertos, __ATOMIC_RELAXED);
+        estatisticas->faltas += __atomic_load_n(&fragmento->faltas, __ATOMIC_RELAXED);
+        estatisticas->acertos_subarvores += __atomic_load_n(&fragmento->acertos_subarvores, __ATOMIC_RELAXED);
+        estatisticas->insercoes += __atomic_load_n(&fragmento->insercoes, __ATOMIC_RELAXED);
+        estatisticas->remocoes += __atomic_load_n(&fragmento->remocoes, __ATOMIC_RELAXED);
+        pthread_rwlock_rdlock(&fragmento->trava);
+        estatisticas->entradas += (size_t)fragmento->num_entradas;
+        pthread_rwlock_unlock(&fragmento->trava);
+        estatisticas->capacidade += (size_t)fragmento->capacidade;
+    }
+}
+
+// Libera todas as entradas e o cache
+void destruirCacheExpressoes(CacheExpressoes *cache) {
+    if (cache == NULL) {
+        return;
+    }
+    for (int f = 0; f < NUM_FRAGMENTOS_CACHE; f++) {
+        FragmentoCache *fragmento = &cache->fragmentos[f];
+        if (fragmento->entradas == NULL) {
+            break; // Fragmentos seguintes não chegaram a ser criados
+        }
+        for (int i = 0; i < fragmento->num_entradas; i++) {
+            free(fragmento->entradas[i].canonica);
+            free(fragmento->entradas[i].infixa);
+        }
+        free(fragmento->entradas);
+        free(fragmento->baldes);
+        free(fragmento->vistas);
+        pthread_rwlock_destroy(&fragmento->trava);
+    }
+    free(cache);
+}
+
+// =================================================================================
+// AVALIAÇÃO INCREMENTAL
+// =================================================================================
+
+// Árvore persistente sobre as instruções de um programa compilado: o nó i é a
+// instrução i, o filho direito de um operador é sempre o nó i - 1 e todo pai
+// tem índice maior que os filhos. Cada nó guarda o último valor calculado.
+// Uma atualização marca os ancestrais das folhas alteradas, parando no primeiro
+// já marcado (ancestrais comuns entram uma vez só), e recalcula os marcados em
+// ordem crescente de índice, ou seja, filhos antes dos pais. Um nó cujo valor
+// não mudou não propaga o recálculo para o pai.
+
+// Estado de um nó durante uma atualização
+enum {
+    NO_LIMPO = 0,
+    NO_PENDENTE, // Ancestral de uma folha alterada, ainda não recalculado
+    NO_ALTERADO  // Valor diferente do anterior
+};
+
+struct AvaliacaoIncremental {
+    ProgramaPosFixa programa; // Instruções, constantes e nomes das entradas
+    int *pai;                 // Pai de cada nó (-1 na raiz)
+    int *esquerdo;            // Filho esquerdo dos operadores binários (-1 nos demais nós)
+    float *valores;           // Valor em cache de cada nó
+    unsigned char *estado;
+    int *pendentes;           // Nós marcados na atualização corrente
+    int *folhas;              // Folhas da entrada v: folhas[inicio_folhas[v] .. inicio_folhas[v + 1])
+    int *inicio_folhas;
+    int recalculados;         // Operadores recalculados na última atualização
+};
+
+// Compara dois floats bit a bit (NAN igual a NAN, 0 diferente de -0)
+int mesmos_bits(float a, float b) {
+    return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+// Ordem crescente de índices de nós (qsort)
+int comparar_indices_nos(const void *a, const void *b) {
+    int x = *(const int *)a;
+    int y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// Valor do operador i a partir dos valores em cache dos filhos. Como no
+// interpretador, um operando NAN (erro anterior) mantém o resultado NAN.
+float calcular_no_incremental(const AvaliacaoIncremental *avaliacao, int i) {
+    Opcode op = OPCODE_DE(avaliacao->programa.instrucoes[i]);
+    CodigoErro codigo;
+    float op2 = avaliacao->valores[i - 1];
+    float resultado;
+    if (opcode_eh_binario(op)) {
+        float op1 = avaliacao->valores[avaliacao->esquerdo[i]];
+        resultado = (isnan(op1) || isnan(op2)) ? NAN : aplicar_operacao(op, op1, op2, &codigo);
+    } else {
+        resultado = isnan(op2) ? NAN : aplicar_operacao(op, op2, 0.0f, &codigo);
+    }
+    return isnan(resultado) ? NAN : resultado;
+}
+
+AvaliacaoIncremental *criarAvaliacaoIncremental(const char *StrPosFixa, const float *entradas) {
+    AvaliacaoIncremental *avaliacao = (AvaliacaoIncremental *)calloc(1, sizeof(AvaliacaoIncremental));
+    if (avaliacao == NULL) {
+        return NULL;
+    }
+    ProgramaPosFixa *programa = &avaliacao->programa;
+    if (!compilarPosFixa(StrPosFixa, programa) || (programa->num_variaveis > 0 && entradas == NULL)) {
+        destruirAvaliacaoIncremental(avaliacao);
+        return NULL;
+    }
+    size_t n = (size_t)programa->num_instrucoes;
+    avaliacao->pai = (int *)malloc(n * sizeof(int));
+    avaliacao->esquerdo = (int *)malloc(n * sizeof(int));
+    avaliacao->valores = (float *)malloc(n * sizeof(float));
+    avaliacao->estado = (unsigned char *)calloc(n, 1);
+    avaliacao->pendentes = (int *)malloc(n * sizeof(int));
+    avaliacao->folhas = (int *)malloc(n * sizeof(int));
+    avaliacao->inicio_folhas = (int *)calloc((size_t)programa->num_variaveis + 1, sizeof(int));
+    if (avaliacao->pai == NULL || avaliacao->esquerdo == NULL || avaliacao->valores == NULL ||
+        avaliacao->estado == NULL || avaliacao->pendentes == NULL || avaliacao->folhas == NULL ||
+        avaliacao->inicio_folhas == NULL) {
+        destruirAvaliacaoIncremental(avaliacao);
+        return NULL;
+    }
+
+    // Pais e filhos esquerdos com uma pilha de índices de nós (a compilação já
+    // garantiu operandos suficientes); conta as folhas de cada entrada
+    int *pilha = avaliacao->pendentes;
+    int *inicio_folhas = avaliacao->inicio_folhas;
+    int topo = -1;
+    for (int i = 0; i < programa->num_instrucoes; i++) {
+        unsigned int instr = programa->instrucoes[i];
+        Opcode op = OPCODE_DE(instr);
+        avaliacao->pai[i] = -1;
+        avaliacao->esquerdo[i] = -1;
+        if (op == OP_CONSTANTE || op == OP_VARIAVEL) {
+            if (op == OP_VARIAVEL) {
+                inicio_folhas[ARGUMENTO_DE(instr) + 1]++;
+            }
+            pilha[++topo] = i;
+        } else if (opcode_eh_binario(op)) {
+            int direito = pilha[topo--];
+            avaliacao->pai[direito] = i;
+            avaliacao->pai[pilha[topo]] = i;
+            avaliacao->esquerdo[i] = pilha[topo];
+            pilha[topo] = i;
+        } else {
+            avaliacao->pai[pilha[topo]] = i;
+            pilha[topo] = i;
+        }
+    }
+
+    // Folhas agrupadas por entrada: inicio_folhas[v] avança enquanto as folhas
+    // de v são gravadas e depois é deslocado de volta para o início do grupo
+    for (int v = 0; v < programa->num_variaveis; v++) {
+        inicio_folhas[v + 1] += inicio_folhas[v];
+    }
+    for (int i = 0; i < programa->num_instrucoes; i++) {
+        unsigned int instr = programa->instrucoes[i];
+        if (OPCODE_DE(instr) == OP_VARIAVEL) {
+            avaliacao->folhas[inicio_folhas[ARGUMENTO_DE(instr)]++] = i;
+        }
+    }
+    for (int v = programa->num_variaveis; v > 0; v--) {
+        inicio_folhas[v] = inicio_folhas[v - 1];
+    }
+    inicio_folhas[0] = 0;
+
+    // Avaliação completa inicial, na ordem das instruções
+    for (int i = 0; i < programa->num_instrucoes; i++) {
+        unsigned int instr = programa->instrucoes[i];
+        switch (OPCODE_DE(instr)) {
+            case OP_CONSTANTE: avaliacao->valores[i] = programa->constantes[ARGUMENTO_DE(instr)]; break;
+            case OP_VARIAVEL: avaliacao->valores[i] = entradas[ARGUMENTO_DE(instr)]; break;
+            default: avaliacao->valores[i] = calcular_no_incremental(avaliacao, i); break;
+        }
+    }
+    avaliacao->recalculados = programa->num_instrucoes;
+    return avaliacao;
+}
+
+float atualizarEntradasIncremental(AvaliacaoIncremental *avaliacao, const int *indices, const float *valores,
+                                   size_t quantidade) {
+    int num_pendentes = 0;
+    int *pendentes = avaliacao->pendentes;
+    unsigned char *estado = avaliacao->estado;
+
+    // Grava as folhas e marca seus ancestrais até o primeiro já marcado
+    for (size_t k = 0; k < quantidade; k++) {
+        if (indices[k] < 0 || indices[k] >= avaliacao->programa.num_variaveis) {
+            continue;
+        }
+        for (int f = avaliacao->inicio_folhas[indices[k]]; f < avaliacao->inicio_folhas[indices[k] + 1]; f++) {
+            int folha = avaliacao->folhas[f];
+            if (mesmos_bits(avaliacao->valores[folha], valores[k])) {
+                continue;
+            }
+            avaliacao->valores[folha] = valores[k];
+            if (estado[folha] != NO_LIMPO) {
+                continue; // Entrada repetida no lote: os ancestrais já estão marcados
+            }
+            estado[folha] = NO_ALTERADO;
+            pendentes[num_pendentes++] = folha;
+            for (int no = avaliacao->pai[folha]; no >= 0 && estado[no] == NO_LIMPO; no = avaliacao->pai[no]) {
+                estado[no] = NO_PENDENTE;
+                pendentes[num_pendentes++] = no;
+            }
+        }
+    }
+
+    // Filhos antes dos pais; só recalcula quem tem um filho alterado
+    qsort(pendentes, (size_t)num_pendentes, sizeof(int), comparar_indices_nos);
+    int recalculados = 0;
+    for (int k = 0; k < num_pendentes; k++) {
+        int no = pendentes[k];
+        if (estado[no] != NO_PENDENTE) {
+            continue;
+        }
+        int esquerdo = avaliacao->esquerdo[no];
+        if (estado[no - 1] == NO_ALTERADO || (esquerdo >= 0 && estado[esquerdo] == NO_ALTERADO)) {
+            float valor = calcular_no_incremental(avaliacao, no);
+            recalculados++;
+            if (!mesmos_bits(valor, avaliacao->valores[no])) {
+                avaliacao->valores[no] = valor;
+                estado[no] = NO_ALTERADO;
+            }
+        }
+    }
+    for (int k = 0; k < num_pendentes; k++) {
+        estado[pendentes[k]] = NO_LIMPO;
+    }
+    avaliacao->recalculados = recalculados;
+    return avaliacao->valores[avaliacao->programa.num_instrucoes - 1];
+}
+
+float atualizarEntradaIncremental(AvaliacaoIncremental *avaliacao, int indice, float valor) {
+    return atualizarEntradasIncremental(avaliacao, &indice, &valor, 1);
+}
+
+float valorAvaliacaoIncremental(const AvaliacaoIncremental *avaliacao) {
+    return avaliacao->valores[avaliacao->programa.num_instrucoes - 1];
+}
+
+int indiceEntradaIncremental(const AvaliacaoIncremental *avaliacao, const char *nome) {
+    return obterIndiceVariavel(&avaliacao->programa, nome);
+}
+
+int nosRecalculadosIncremental(const AvaliacaoIncremental *avaliacao) {
+    return avaliacao->recalculados;
+}
+
+void destruirAvaliacaoIncremental(AvaliacaoIncremental *avaliacao) {
+    if (avaliacao == NULL) {
+        return;
+    }
+    liberarPrograma(&avaliacao->programa);
+    free(avaliacao->pai);
+    free(avaliacao->esquerdo);
+    free(avaliacao->valores);
+    free(avaliacao->estado);
+    free(avaliacao->pendentes);
+    free(avaliacao->folhas);
+    free(avaliacao->inicio_folhas);
+    free(avaliacao);
+}
+
+// =================================================================================
+// AVALIAÇÃO EM FLUXO (FILE*, descritor ou função de leitura)
+// =================================================================================
+
+// A entrada passa por um buffer de tamanho fixo: os tokens são classificados no
+// próprio buffer e um token cortado no fim do buffer é movido para o início
+// antes da próxima leitura. Um token maior que o buffer é inválido.
+#define TAMANHO_BUFFER_FLUXO 65536
+
+typedef struct {
+    FuncaoLeitura ler;
+    void *contexto;
+    char *buffer;      // TAMANHO_BUFFER_FLUXO bytes + '\0' depois dos dados lidos
+    size_t inicio;     // Próximo byte a analisar
+    size_t fim;        // Fim dos dados lidos
+    long deslocamento; // Posição de buffer[0] na entrada
+    int terminou;      // A fonte não tem mais dados
+    int falhou;        // A fonte devolveu erro (ERRO_ENTRADA_SAIDA)
+} LeitorFluxo;
+
+int iniciar_leitor_fluxo(LeitorFluxo *leitor, FuncaoLeitura ler, void *contexto) {
+    memset(leitor, 0, sizeof(LeitorFluxo));
+    leitor->ler = ler;
+    leitor->contexto = contexto;
+    leitor->buffer = (char *)malloc(TAMANHO_BUFFER_FLUXO + 1);
+    return leitor->buffer != NULL;
+}
+
+// Lê mais dados depois de buffer[fim] (o trecho [inicio, fim) é preservado no início)
+void recarregar_leitor_fluxo(LeitorFluxo *leitor) {
+    size_t restante = leitor->fim - leitor->inicio;
+    memmove(leitor->buffer, leitor->buffer + leitor->inicio, restante);
+    leitor->deslocamento += (long)leitor->inicio;
+    leitor->inicio = 0;
+    leitor->fim = restante;
+
+    long lidos = leitor->ler(leitor->contexto, leitor->buffer + leitor->fim, TAMANHO_BUFFER_FLUXO - leitor->fim);
+    if (lidos <= 0) {
+        leitor->terminou = 1;
+        leitor->falhou = (lidos < 0);
+    } else {
+        leitor->fim += (size_t)lidos;
+    }
+    leitor->buffer[leitor->fim] = '\0'; // Sentinela para ler_numero
+}
+
+// Como proximoToken, sobre o fluxo; 'posicao' recebe o deslocamento do token na entrada
+TipoToken proximo_token_fluxo(LeitorFluxo *leitor, Token *token, long *posicao) {
+    for (;;) {
+        while (leitor->inicio < leitor->fim && EH_ESPACO(leitor->buffer[leitor->inicio])) {
+            leitor->inicio++;
+        }
+        if (leitor->inicio == leitor->fim) {
+            if (leitor->terminou) {
+                *posicao = leitor->deslocamento + (long)leitor->fim;
+                return TOKEN_FIM;
+            }
+            recarregar_leitor_fluxo(leitor);
+            continue;
+        }
+
+        size_t fim = leitor->inicio;
+        while (fim < leitor->fim && !EH_ESPACO(leitor->buffer[fim])) {
+            fim++;
+        }
+        *posicao = leitor->deslocamento + (long)leitor->inicio;
+        if (fim == leitor->fim && !leitor->terminou) {
+            // O token pode continuar na próxima leitura
+            if (leitor->inicio == 0 && leitor->fim == TAMANHO_BUFFER_FLUXO) {
+                return TOKEN_INVALIDO; // Maior que o buffer
+            }
+            recarregar_leitor_fluxo(leitor);
+            continue;
+        }
+
+        token->inicio = leitor->buffer + leitor->inicio;
+        token->tamanho = fim - leitor->inicio;
+        token->tipo = classificar_token(token->inicio, token->tamanho, token);
+        leitor->inicio = fim;
+        return token->tipo;
+    }
+}
+
+// Fonte FILE* (contexto) para as funções de fluxo
+long ler_arquivo_fluxo(void *contexto, char *destino, size_t tamanho) {
+    FILE *arquivo = (FILE *)contexto;
+    size_t lidos = fread(destino, 1, tamanho, arquivo);
+    if (lidos == 0 && ferror(arquivo)) {
+        return -1;
+    }
+    return (long)lidos;
+}
+
+// Fonte descritor (contexto aponta para o int) para as funções de fluxo
+long ler_descritor_fluxo(void *contexto, char *destino, size_t tamanho) {
+    int fd = *(const int *)contexto;
+    for (;;) {
+        ssize_t lidos = read(fd, destino, tamanho);
+        if (lidos >= 0) {
+            return (long)lidos;
+        }
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+}
+
+float avaliarPosFixaStream(FuncaoLeitura ler, void *contexto, ErroExpressao *erro) {
+    ValorMisto buffer_pilha[CAPACIDADE_NUMEROS_LOCAL];
+    PilhaMista pilha;
+    LeitorFluxo leitor;
+    Token token;
+    long posicao = -1;
+    CodigoErro codigo = ERRO_NENHUM;
+    float resultado = NAN;
+
+    inicializar_pilha_mista(&pilha, buffer_pilha, CAPACIDADE_NUMEROS_LOCAL);
+    if (!iniciar_leitor_fluxo(&leitor, ler, contexto)) {
+        registrar_erro(erro, ERRO_MEMORIA, -1);
+        return NAN;
+    }
+
+    // Mesmo laço de getValorPosFixaComErro, com os tokens vindos do buffer
+    TipoToken tipo;
+    while ((tipo = proximo_token_fluxo(&leitor, &token, &posicao)) != TOKEN_FIM) {
+        if (tipo == TOKEN_NUMERO) {
+            ValorMisto *valor = empilhar_misto(&pilha);
+            if (valor == NULL) {
+                codigo = ERRO_MEMORIA;
+                goto erro;
+            }
+            valor->eh_inteiro = ler_literal_inteiro(token.inicio, token.tamanho, &valor->inteiro);
+            valor->real = token.valor;
+        } else if (tipo == TOKEN_OPERADOR && opcode_eh_binario(token.op)) {
+            if (pilha.topo < 0) {
+                codigo = ERRO_OPERADOR_SEM_OPERANDOS;
+                goto erro;
+            }
+            if (pilha.topo < 1) {
+                codigo = ERRO_OPERADOR_UM_OPERANDO;
+                goto erro;
+            }
+            pilha.topo--;
+            if (!aplicar_operacao_mista(token.op, &pilha.dados[pilha.topo], &pilha.dados[pilha.topo + 1], &codigo)) {
+                goto erro;
+            }
+        } else if (tipo == TOKEN_OPERADOR) {
+            if (pilha.topo < 0) {
+                codigo = ERRO_FUNCAO_SEM_OPERANDO;
+                goto erro;
+            }
+            ValorMisto *op1 = &pilha.dados[pilha.topo];
+            op1->real = aplicar_operacao(token.op, valor_real(op1), 0.0f, &codigo);
+            op1->eh_inteiro = 0;
+            if (isnan(op1->real)) {
+                goto erro;
+            }
+        } else {
+            codigo = ERRO_TOKEN_INVALIDO;
+            goto erro;
+        }
+    }
+
+    if (leitor.falhou) {
+        codigo = ERRO_ENTRADA_SAIDA;
+        goto erro;
+    }
+    if (pilha.topo < 0) {
+        codigo = ERRO_EXPRESSAO_VAZIA;
+        resultado = NAN;
+    } else if (pilha.topo > 0) {
+        codigo = ERRO_OPERANDOS_RESTANTES;
+        resultado = NAN;
+    } else {
+        resultado = valor_real(&pilha.dados[0]);
+    }
+    free(leitor.buffer);
+    liberar_pilha_mista(&pilha);
+    registrar_erro(erro, codigo, -1);
+    return resultado;
+
+erro:
+    if (leitor.falhou) {
+        codigo = ERRO_ENTRADA_SAIDA; // O erro de leitura pode ter cortado o último token
+    }
+    free(leitor.buffer);
+    liberar_pilha_mista(&pilha);
+    registrar_erro(erro, codigo, posicao);
+    return NAN;
+}
+
+float avaliarPosFixaArquivo(FILE *entrada, ErroExpressao *erro) {
+    return avaliarPosFixaStream(ler_arquivo_fluxo, entrada, erro);
+}
+
+float avaliarPosFixaDescritor(int fd, ErroExpressao *erro) {
+    return avaliarPosFixaStream(ler_descritor_fluxo, &fd, erro);
+}
+
+// Árvore compacta para a forma infixa: por nó, o opcode (com NO_COM_SINAL quando
+// o texto começa com sinal, como "-4" e "-4*3") e o tamanho da subárvore; os textos dos números ficam
+// em sequência, cada um terminado em '\0', na ordem em que aparecem na entrada.
+#define NO_COM_SINAL 0x80u
+
+typedef struct {
+    unsigned char *ops;
+    int *tamanhos;
+    size_t num_nos;
+    size_t capacidade_nos;
+    char *textos;
+    size_t usado_textos;
+    size_t capacidade_textos;
+} ArvoreFluxo;
+
+// Acrescenta um nó (e o texto, nos números); 0 se faltar memória
+int anexar_no_fluxo(ArvoreFluxo *arvore, unsigned int op, int tamanho, const char *texto, size_t tamanho_texto) {
+    if (arvore->num_nos == arvore->capacidade_nos) {
+        size_t nova_capacidade = arvore->capacidade_nos * 2 + 1024;
+        if (nova_capacidade > (size_t)INT_MAX) {
+            return 0;
+        }
+        unsigned char *ops = (unsigned char *)realloc(arvore->ops, nova_capacidade);
+        if (ops == NULL) {
+            return 0;
+        }
+        arvore->ops = ops;
+        int *tamanhos = (int *)realloc(arvore->tamanhos, nova_capacidade * sizeof(int));
+        if (tamanhos == NULL) {
+            return 0;
+        }
+        arvore->tamanhos = tamanhos;
+        arvore->capacidade_nos = nova_capacidade;
+    }
+    if (texto != NULL) {
+        if (arvore->usado_textos + tamanho_texto + 1 > arvore->capacidade_textos) {
+            size_t nova_capacidade = arvore->capacidade_textos * 2 + tamanho_texto + 4096;
+            char *textos = (char *)realloc(arvore->textos, nova_capacidade);
+            if (textos == NULL) {
+                return 0;
+            }
+            arvore->textos = textos;
+            arvore->capacidade_textos = nova_capacidade;
+        }
+        memcpy(arvore->textos + arvore->usado_textos, texto, tamanho_texto);
+        arvore->usado_textos += tamanho_texto;
+        arvore->textos[arvore->usado_textos++] = '\0';
+    }
+    arvore->ops[arvore->num_nos] = (unsigned char)op;
+    arvore->tamanhos[arvore->num_nos] = tamanho;
+    arvore->num_nos++;
+    return 1;
+}
+
+// Parte da forma infixa ainda por escrever: um nó (no >= 0) ou um texto fixo
+typedef struct {
+    long no;
+    int parenteses;
+    const char *texto;
+} PendenteInfixa;
+
+// Empilha uma parte pendente; 0 se faltar memória
+int empilhar_pendente(PendenteInfixa **pilha, size_t *topo, size_t *capacidade, long no, int parenteses,
+                      const char *texto) {
+    if (*topo == *capacidade) {
+        size_t nova_capacidade = *capacidade * 2 + 64;
+        PendenteInfixa *nova = (PendenteInfixa *)realloc(*pilha, nova_capacidade * sizeof(PendenteInfixa));
+        if (nova == NULL) {
+            return 0;
+        }
+        *pilha = nova;
+        *capacidade = nova_capacidade;
+    }
+    (*pilha)[*topo].no = no;
+    (*pilha)[*topo].parenteses = parenteses;
+    (*pilha)[*topo].texto = texto;
+    (*topo)++;
+    return 1;
+}
+
+// Escreve a forma infixa da árvore em 'saida' à medida que a percorre (mesmo texto de
+// gerar_infixa); a pilha de partes pendentes cresce com a profundidade, não com a saída
+CodigoErro escrever_infixa_fluxo(const ArvoreFluxo *arvore, FILE *saida) {
+    PendenteInfixa *pilha = NULL;
+    size_t topo = 0;
+    size_t capacidade = 0;
+    const char *proximo_texto = arvore->textos; // Os números saem na ordem da entrada
+    int ok = empilhar_pendente(&pilha, &topo, &capacidade, (long)arvore->num_nos - 1, 0, NULL);
+
+    while (ok && topo > 0) {
+        PendenteInfixa item = pilha[--topo];
+        if (item.no < 0) {
+            fputs(item.texto, saida);
+            continue;
+        }
+        Opcode op = (Opcode)(arvore->ops[item.no] & ~NO_COM_SINAL);
+        if (item.parenteses) {
+            fputc('(', saida);
+            ok = empilhar_pendente(&pilha, &topo, &capacidade, -1, 0, ")");
+        }
+        if (op == OP_CONSTANTE) {
+            fputs(proximo_texto, saida);
+            proximo_texto += strlen(proximo_texto) + 1;
+        } else if (!opcode_eh_binario(op)) {
+            // função(argumento)
+            fputs(texto_do_opcode(op), saida);
+            fputc('(', saida);
+            ok = ok && empilhar_pendente(&pilha, &topo, &capacidade, -1, 0, ")") &&
+                 empilhar_pendente(&pilha, &topo, &capacidade, item.no - 1, 0, NULL);
+        } else {
+            // esquerdo operador direito (empilhados na ordem inversa)
+            long direito = item.no - 1;
+            long esquerdo = direito - arvore->tamanhos[direito];
+            unsigned int op_direito = arvore->ops[direito];
+            unsigned int op_esquerdo = arvore->ops[esquerdo];
+            ok = ok &&
+                 empilhar_pendente(&pilha, &topo, &capacidade, direito,
+                                   precisa_parenteses_opcodes(op, (Opcode)(op_direito & ~NO_COM_SINAL),
+                                                              (op_direito & NO_COM_SINAL) != 0, 1), NULL) &&
+                 empilhar_pendente(&pilha, &topo, &capacidade, -1, 0, texto_do_opcode(op)) &&
+                 empilhar_pendente(&pilha, &topo, &capacidade, esquerdo,
+                                   precisa_parenteses_opcodes(op, (Opcode)(op_esquerdo & ~NO_COM_SINAL),
+                                                              (op_esquerdo & NO_COM_SINAL) != 0, 0), NULL);
+        }
+    }
+    free(pilha);
+    if (!ok) {
+        return ERRO_MEMORIA;
+    }
+    return ferror(saida) ? ERRO_ENTRADA_SAIDA : ERRO_NENHUM;
+}
+
+int escreverInFixaStream(FuncaoLeitura ler, void *contexto, FILE *saida, ErroExpressao *erro) {
+    ArvoreFluxo arvore;
+    LeitorFluxo leitor;
+    Token token;
+    long posicao = -1;
+    long altura = 0;
+    CodigoErro codigo = ERRO_NENHUM;
+
+    memset(&arvore, 0, sizeof(ArvoreFluxo));
+    if (!iniciar_leitor_fluxo(&leitor, ler, contexto)) {
+        registrar_erro(erro, ERRO_MEMORIA, -1);
+        return 0;
+    }
+
+    // Mesma validação de construir_arvore (sem variáveis), guardando só a árvore compacta
+    TipoToken tipo;
+    while ((tipo = proximo_token_fluxo(&leitor, &token, &posicao)) != TOKEN_FIM) {
+        size_t i = arvore.num_nos;
+        int ok;
+        if (tipo == TOKEN_NUMERO) {
+            unsigned int sinal = (token.inicio[0] == '-' || token.inicio[0] == '+') ? NO_COM_SINAL : 0u;
+            ok = anexar_no_fluxo(&arvore, OP_CONSTANTE | sinal, 1, token.inicio, token.tamanho);
+            altura++;
+        } else if (tipo == TOKEN_OPERADOR && opcode_eh_binario(token.op)) {
+            if (altura < 2) {
+                codigo = (altura == 0) ? ERRO_OPERADOR_SEM_OPERANDOS : ERRO_OPERADOR_UM_OPERANDO;
+                goto fim;
+            }
+            size_t esquerdo = i - 1 - (size_t)arvore.tamanhos[i - 1];
+            // O texto começa com sinal se o do operando esquerdo começar e ficar sem parênteses
+            unsigned int op_esquerdo = arvore.ops[esquerdo];
+            unsigned int sinal = ((op_esquerdo & NO_COM_SINAL) &&
+                                  !precisa_parenteses_opcodes(token.op, (Opcode)(op_esquerdo & ~NO_COM_SINAL), 1, 0))
+                                     ? NO_COM_SINAL : 0u;
+            ok = anexar_no_fluxo(&arvore, token.op | sinal, 1 + arvore.tamanhos[i - 1] + arvore.tamanhos[esquerdo],
+                                 NULL, 0);
+            altura--;
+        } else if (tipo == TOKEN_OPERADOR) {
+            if (altura == 0) {
+                codigo = ERRO_FUNCAO_SEM_OPERANDO;
+                goto fim;
+            }
+            ok = anexar_no_fluxo(&arvore, token.op, 1 + arvore.tamanhos[i - 1], NULL, 0);
+        } else {
+            codigo = ERRO_TOKEN_INVALIDO;
+            goto fim;
+        }
+        if (!ok) {
+            codigo = ERRO_MEMORIA;
+            goto fim;
+        }
+    }
+    posicao = -1;
+    if (leitor.falhou) {
+        codigo = ERRO_ENTRADA_SAIDA;
+    } else if (altura == 0) {
+        codigo = ERRO_EXPRESSAO_VAZIA;
+    } else if (altura != 1) {
+        codigo = ERRO_OPERANDOS_RESTANTES;
+    } else {
+        codigo = escrever_infixa_fluxo(&arvore, saida);
+    }
+
+fim:
+    if (leitor.falhou) {
+        codigo = ERRO_ENTRADA_SAIDA; // O erro de leitura pode ter cortado o último token
+    }
+    free(leitor.buffer);
+    free(arvore.ops);
+    free(arvore.tamanhos);
+    free(arvore.textos);
+    registrar_erro(erro, codigo, posicao);
+    return codigo == ERRO_NENHUM;
+}
+
+int escreverInFixaArquivo(FILE *entrada, FILE *saida, ErroExpressao *erro) {
+    return escreverInFixaStream(ler_arquivo_fluxo, entrada, saida, erro);
+}
+
+int escreverInFixaDescritor(int fd, FILE *saida, ErroExpressao *erro) {
+    return escreverInFixaStream(ler_descritor_fluxo, &fd, saida, erro);
+}
+
+// =================================================================================
+// BIBLIOTECA BINÁRIA DE EXPRESSÕES (mmap, avaliação no lugar)
+// =================================================================================
+
+/*
+ * Formato do arquivo (little-endian, versão 1):
+ *
+ *   [CabecalhoBiblioteca: 64 bytes]
+ *   [EntradaBiblioteca x num_formulas: 32 bytes cada, id = posição]
+ *   [registros, cada um alinhado em 16 bytes:
+ *      instruções (uint32 x num_instrucoes) | constantes (float x num_constantes) |
+ *      nomes das variáveis (tamanho_nomes bytes, cada nome terminado em '\0')]
+ *   [preenchimento com zeros até múltiplo de 8]
+ *
+ * As instruções e constantes têm o mesmo formato de ProgramaPosFixa, então um
+ * programa da biblioteca é só uma vista sobre o arquivo mapeado. Linhas
+ * inválidas na conversão viram entradas com num_instrucoes = 0, para que o id
+ * continue igual ao número da linha (a partir de 0).
+ */
+
+#define MAGICO_BIBLIOTECA "EXPRBIB"          // 8 bytes com o '\0'
+#define VERSAO_BIBLIOTECA 1
+#define ORDEM_BYTES_BIBLIOTECA 0x01020304u   // Lido ao contrário em máquinas big-endian
+#define ALINHAMENTO_REGISTRO_BIBLIOTECA 16
+
+typedef struct {
+    char magico[8];
+    uint32_t versao;
+    uint32_t ordem_bytes;
+    uint32_t tamanho_cabecalho;
+    uint32_t tamanho_entrada;
+    uint32_t num_formulas;
+    uint32_t reservado;
+    uint64_t tamanho_arquivo;
+    uint64_t deslocamento_indice;
+    uint64_t soma_verificacao;    // soma_biblioteca do arquivo inteiro com este campo zerado
+    uint64_t reservado_extra;
+} CabecalhoBiblioteca;
+
+typedef struct {
+    uint64_t deslocamento;        // Início do registro (0 nas linhas inválidas)
+    uint32_t num_instrucoes;
+    uint32_t num_constantes;
+    uint32_t num_variaveis;
+    uint32_t profundidade_maxima;
+    uint32_t tamanho_nomes;
+    uint32_t reservado;
+} EntradaBiblioteca;
+
+struct BibliotecaExpressoes {
+    const char *dados;            // Arquivo mapeado (somente leitura)
+    size_t tamanho;
+    const EntradaBiblioteca *indice;
+    size_t num_formulas;
+};
+
+// Texto a gravar, montado em memória antes de calcular a soma de verificação
+typedef struct {
+    char *dados;
+    size_t tamanho;
+    size_t capacidade;
+} ImagemBiblioteca;
+
+// Soma de verificação: FNV-1a sobre palavras de 64 bits (o tamanho é múltiplo de 8)
+uint64_t soma_biblioteca(const char *dados, size_t tamanho) {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i + 8 <= tamanho; i += 8) {
+        uint64_t palavra;
+        memcpy(&palavra, dados + i, sizeof(palavra));
+        h = (h ^ palavra) * 1099511628211ull;
+    }
+    return h ^ (h >> 29);
+}
+
+// Soma do arquivo inteiro, com o campo soma_verificacao do cabeçalho tratado como zero
+uint64_t soma_arquivo_biblioteca(const char *dados, size_t tamanho) {
+    CabecalhoBiblioteca cabecalho;
+    memcpy(&cabecalho, dados, sizeof(cabecalho));
+    cabecalho.soma_verificacao = 0;
+    uint64_t h = soma_biblioteca((const char *)&cabecalho, sizeof(cabecalho));
+    return h ^ soma_biblioteca(dados + sizeof(cabecalho), tamanho - sizeof(cabecalho)) * 31;
+}
+
+// Garante espaço para mais 'extra' bytes (zerados) na imagem; 0 se faltar memória
+int reservar_imagem(ImagemBiblioteca *imagem, size_t extra) {
+    if (imagem->tamanho + extra > imagem->capacidade) {
+        size_t nova_capacidade = imagem->capacidade * 2 + extra + 4096;
+        char *novos = (char *)realloc(imagem->dados, nova_capacidade);
+        if (novos == NULL) {
+            return 0;
+        }
+        memset(novos + imagem->capacidade, 0, nova_capacidade - imagem->capacidade);
+        imagem->dados = novos;
+        imagem->capacidade = nova_capacidade;
+    }
+    return 1;
+}
+
+// Acrescenta o registro de um programa compilado e preenche sua entrada no índice
+int anexar_registro_biblioteca(ImagemBiblioteca *imagem, const ProgramaPosFixa *programa, size_t id) {
+    size_t tamanho_nomes = 0;
+    for (int i = 0; i < programa->num_variaveis; i++) {
+        tamanho_nomes += strlen(programa->nomes_variaveis[i]) + 1;
+    }
+    size_t inicio = (imagem->tamanho + ALINHAMENTO_REGISTRO_BIBLIOTECA - 1) & ~(size_t)(ALINHAMENTO_REGISTRO_BIBLIOTECA - 1);
+    size_t tamanho = (size_t)programa->num_instrucoes * 4 + (size_t)programa->num_constantes * 4 + tamanho_nomes;
+    if (!reservar_imagem(imagem, inicio - imagem->tamanho + tamanho)) {
+        return 0;
+    }
+
+    char *p = imagem->dados + inicio;
+    memcpy(p, programa->instrucoes, (size_t)programa->num_instrucoes * 4);
+    p += (size_t)programa->num_instrucoes * 4;
+    memcpy(p, programa->constantes, (size_t)programa->num_constantes * 4);
+    p += (size_t)programa->num_constantes * 4;
+    for (int i = 0; i < programa->num_variaveis; i++) {
+        size_t n = strlen(programa->nomes_variaveis[i]) + 1;
+        memcpy(p, programa->nomes_variaveis[i], n);
+        p += n;
+    }
+    imagem->tamanho = inicio + tamanho;
+
+    EntradaBiblioteca entrada;
+    memset(&entrada, 0, sizeof(entrada));
+    entrada.deslocamento = inicio;
+    entrada.num_instrucoes = (uint32_t)programa->num_instrucoes;
+    entrada.num_constantes = (uint32_t)programa->num_constantes;
+    entrada.num_variaveis = (uint32_t)programa->num_variaveis;
+    entrada.profundidade_maxima = (uint32_t)programa->profundidade_maxima;
+    entrada.tamanho_nomes = (uint32_t)tamanho_nomes;
+    memcpy(imagem->dados + sizeof(CabecalhoBiblioteca) + id * sizeof(EntradaBiblioteca), &entrada, sizeof(entrada));
+    return 1;
+}
+
+/*
+ * gravarBibliotecaExpressoes
+ * --------------------------
+ * Compila cada linha de um arquivo de expressões pós-fixas (mesmo formato de
+ * processarArquivoExpressoes; variáveis são aceitas) e grava a biblioteca
+ * binária que abrirBibliotecaExpressoes mapeia sem desserializar.
+ *
+ * Parâmetros:
+ * - caminho_entrada: Arquivo de expressões pós-fixas, uma por linha.
+ * - caminho_saida: Arquivo da biblioteca.
+ * - num_invalidas: Recebe o número de linhas inválidas (pode ser NULL).
+ *
+ * Retorno:
+ * - Número de fórmulas gravadas (todas as linhas), ou -1 em erro de E/S ou memória.
+ */
+long gravarBibliotecaExpressoes(const char *caminho_entrada, const char *caminho_saida, long *num_invalidas) {
+    size_t tamanho;
+    const char *dados = mapear_arquivo(caminho_entrada, &tamanho);
+    if (dados == NULL) {
+        fprintf(stderr, "Erro: Nao foi possivel abrir %s.\n", caminho_entrada);
+        return -1;
+    }
+
+    // O índice tem uma entrada por linha: conta as linhas antes de montar a imagem
+    size_t num_formulas = 0;
+    for (const char *p = dados; p < dados + tamanho; num_formulas++) {
+        const char *quebra = (const char *)memchr(p, '\n', dados + tamanho - p);
+        p = (quebra != NULL) ? quebra + 1 : dados + tamanho;
+    }
+
+    long resultado = -1;
+    long invalidas = 0;
+    char *linha = NULL;
+    size_t capacidade_linha = 0;
+    ImagemBiblioteca imagem = {NULL, 0, 0};
+    if (num_formulas > UINT32_MAX ||
+        !reservar_imagem(&imagem, sizeof(CabecalhoBiblioteca) + num_formulas * sizeof(EntradaBiblioteca))) {
+        fprintf(stderr, "Erro de alocacao de memoria.\n");
+        goto fim;
+    }
+    imagem.tamanho = sizeof(CabecalhoBiblioteca) + num_formulas * sizeof(EntradaBiblioteca);
+
+    const char *p = dados;
+    for (size_t id = 0; id < num_formulas; id++) {
+        const char *quebra = (const char *)memchr(p, '\n', dados + tamanho - p);
+        const char *fim_linha = (quebra != NULL) ? quebra : dados + tamanho;
+        size_t n = fim_linha - p;
+        if (n > 0 && p[n - 1] == '\r') {
+            n--;
+        }
+        if (n + 1 > capacidade_linha) {
+            char *nova = (char *)realloc(linha, (n + 1) * 2);
+            if (nova == NULL) {
+                fprintf(stderr, "Erro de alocacao de memoria.\n");
+                goto fim;
+            }
+            linha = nova;
+            capacidade_linha = (n + 1) * 2;
+        }
+        memcpy(linha, p, n);
+        linha[n] = '\0';
+        p = fim_linha + 1;
+
+        ProgramaPosFixa programa;
+        ErroExpressao erro;
+        if (!compilar_posfixa(linha, &programa, &erro)) {
+            if (erro.codigo == ERRO_MEMORIA) {
+                fprintf(stderr, "Erro de alocacao de memoria.\n");
+                goto fim;
+            }
+            invalidas++;
+            continue;
+        }
+        int ok = anexar_registro_biblioteca(&imagem, &programa, id);
+        liberarPrograma(&programa);
+        if (!ok) {
+            fprintf(stderr, "Erro de alocacao de memoria.\n");
+            goto fim;
+        }
+    }
+
+    // Completa até múltiplo de 8 e fecha o cabeçalho com a soma de verificação
+    size_t tamanho_final = (imagem.tamanho + 7) & ~(size_t)7;
+    if (!reservar_imagem(&imagem, tamanho_final - imagem.tamanho)) {
+        fprintf(stderr, "Erro de alocacao de memoria.\n");
+        goto fim;
+    }
+    imagem.tamanho = tamanho_final;
+    CabecalhoBiblioteca cabecalho;
+    memset(&cabecalho, 0, sizeof(cabecalho));
+    memcpy(cabecalho.magico, MAGICO_BIBLIOTECA, sizeof(cabecalho.magico));
+    cabecalho.versao = VERSAO_BIBLIOTECA;
+    cabecalho.ordem_bytes = ORDEM_BYTES_BIBLIOTECA;
+    cabecalho.tamanho_cabecalho = sizeof(CabecalhoBiblioteca);
+    cabecalho.tamanho_entrada = sizeof(EntradaBiblioteca);
+    cabecalho.num_formulas = (uint32_t)num_formulas;
+    cabecalho.tamanho_arquivo = imagem.tamanho;
+    cabecalho.deslocamento_indice = sizeof(CabecalhoBiblioteca);
+    memcpy(imagem.dados, &cabecalho, sizeof(cabecalho));
+    cabecalho.soma_verificacao = soma_arquivo_biblioteca(imagem.dados, imagem.tamanho);
+    memcpy(imagem.dados, &cabecalho, sizeof(cabecalho));
+
+    FILE *saida = fopen(caminho_saida, "wb");
+    if (saida == NULL) {
+        fprintf(stderr, "Erro: Nao foi possivel criar %s.\n", caminho_saida);
+        goto fim;
+    }
+    int gravou = (fwrite(imagem.dados, 1, imagem.tamanho, saida) == imagem.tamanho);
+    if (fclose(saida) != 0 || !gravou) {
+        fprintf(stderr, "Erro: Falha ao gravar %s.\n", caminho_saida);
+        goto fim;
+    }
+    resultado = (long)num_formulas;
+    if (num_invalidas != NULL) {
+        *num_invalidas = invalidas;
+    }
+
+fim:
+    free(linha);
+    free(imagem.dados);
+    desmapear_arquivo(dados, tamanho);
+    return resultado;
+}
+
+// Confere se o registro de uma entrada fica entre o fim do índice ('inicio_registros')
+// e o fim do arquivo e se o programa é bem formado (opcodes, argumentos, nomes e
+// altura da pilha), para que a avaliação no lugar nunca leia fora do mapeamento.
+// As contas não transbordam: o deslocamento é conferido antes de ser somado.
+int validar_entrada_biblioteca(const char *dados, size_t tamanho, uint64_t inicio_registros,
+                               const EntradaBiblioteca *entrada) {
+    if (entrada->num_instrucoes == 0) {
+        return entrada->deslocamento == 0 && entrada->num_constantes == 0 && entrada->num_variaveis == 0;
+    }
+    if (entrada->deslocamento < inicio_registros || entrada->deslocamento > tamanho) {
+        return 0;
+    }
+    uint64_t tamanho_registro = 4 * ((uint64_t)entrada->num_instrucoes + entrada->num_constantes) +
+                                entrada->tamanho_nomes;
+    if (entrada->deslocamento % ALINHAMENTO_REGISTRO_BIBLIOTECA != 0 ||
+        tamanho_registro > tamanho - entrada->deslocamento ||
+        entrada->num_instrucoes > (uint32_t)MAX_ARGUMENTO_INSTRUCAO || entrada->profundidade_maxima > entrada->num_instrucoes) {
+        return 0;
+    }
+
+    const char *registro = dados + entrada->deslocamento;
+    const char *nomes = registro + 4 * ((size_t)entrada->num_instrucoes + entrada->num_constantes);
+    uint32_t terminadores = 0;
+    for (uint32_t i = 0; i < entrada->tamanho_nomes; i++) {
+        terminadores += (nomes[i] == '\0');
+    }
+    if (terminadores != entrada->num_variaveis ||
+        (entrada->tamanho_nomes > 0 && nomes[entrada->tamanho_nomes - 1] != '\0')) {
+        return 0;
+    }
+
+    const unsigned int *instrucoes = (const unsigned int *)registro;
+    uint32_t altura = 0;
+    uint32_t maxima = 0;
+    for (uint32_t i = 0; i < entrada->num_instrucoes; i++) {
+        Opcode op = OPCODE_DE(instrucoes[i]);
+        if (op == OP_CONSTANTE || op == OP_VARIAVEL) {
+            uint32_t limite = (op == OP_CONSTANTE) ? entrada->num_constantes : entrada->num_variaveis;
+            if (ARGUMENTO_DE(instrucoes[i]) >= limite) {
+                return 0;
+            }
+            altura++;
+        } else if (op >= NUM_OPCODES || altura < (opcode_eh_binario(op) ? 2u : 1u)) {
+            return 0;
+        } else {
+            altura -= opcode_eh_binario(op);
+        }
+        maxima = (altura > maxima) ? altura : maxima;
+    }
+    return altura == 1 && maxima == entrada->profundidade_maxima;
+}
+
+/*
+ * abrirBibliotecaExpressoes
+ * -------------------------
+ * Mapeia uma biblioteca gravada por gravarBibliotecaExpressoes. O cabeçalho
+ * (mágico, versão, ordem dos bytes, tamanhos), a soma de verificação e cada
+ * programa são conferidos uma vez aqui; depois disso as fórmulas são avaliadas
+ * direto do mapeamento, sem cópia nem alocação.
+ *
+ * Retorno:
+ * - A biblioteca aberta; NULL se o arquivo não puder ser lido ou for inválido.
+ */
+BibliotecaExpressoes *abrirBibliotecaExpressoes(const char *caminho) {
+    size_t tamanho;
+    const char *dados = mapear_arquivo(caminho, &tamanho);
+    if (dados == NULL) {
+        fprintf(stderr, "Erro: Nao foi possivel abrir %s.\n", caminho);
+        return NULL;
+    }
+
+    CabecalhoBiblioteca cabecalho;
+    if (tamanho < sizeof(cabecalho) || tamanho % 8 != 0) {
+        goto invalida;
+    }
+    memcpy(&cabecalho, dados, sizeof(cabecalho));
+    if (memcmp(cabecalho.magico, MAGICO_BIBLIOTECA, sizeof(cabecalho.magico)) != 0 ||
+        cabecalho.versao != VERSAO_BIBLIOTECA || cabecalho.ordem_bytes != ORDEM_BYTES_BIBLIOTECA ||
+        cabecalho.tamanho_cabecalho != sizeof(CabecalhoBiblioteca) ||
+        cabecalho.tamanho_entrada != sizeof(EntradaBiblioteca) || cabecalho.tamanho_arquivo != tamanho ||
+        cabecalho.deslocamento_indice != sizeof(CabecalhoBiblioteca) ||
+        (tamanho - sizeof(cabecalho)) / sizeof(EntradaBiblioteca) < cabecalho.num_formulas ||
+        soma_arquivo_biblioteca(dados, tamanho) != cabecalho.soma_verificacao) {
+        goto invalida;
+    }
+    const EntradaBiblioteca *indice = (const EntradaBiblioteca *)(dados + cabecalho.deslocamento_indice);
+    uint64_t inicio_registros = cabecalho.deslocamento_indice +
+                                (uint64_t)cabecalho.num_formulas * sizeof(EntradaBiblioteca);
+    for (uint32_t i = 0; i < cabecalho.num_formulas; i++) {
+        if (!validar_entrada_biblioteca(dados, tamanho, inicio_registros, &indice[i])) {
+            goto invalida;
+        }
+    }
+
+    BibliotecaExpressoes *biblioteca = (BibliotecaExpressoes *)malloc(sizeof(BibliotecaExpressoes));
+    if (biblioteca == NULL) {
+        fprintf(stderr, "Erro de alocacao de memoria.\n");
+        desmapear_arquivo(dados, tamanho);
+        return NULL;
+    }
+    biblioteca->dados = dados;
+    biblioteca->tamanho = tamanho;
+    biblioteca->indice = indice;
+    biblioteca->num_formulas = cabecalho.num_formulas;
+    return biblioteca;
+
+invalida:
+    fprintf(stderr, "Erro: %s nao e uma biblioteca de expressoes valida.\n", caminho);
+    desmapear_arquivo(dados, tamanho);
+    return NULL;
+}
+
+size_t numeroFormulasBiblioteca(const BibliotecaExpressoes *biblioteca) {
+    return biblioteca->num_formulas;
+}
+
+// Preenche *programa com uma vista (sem cópia) da fórmula 'id'; 0 se o id não
+// existir ou a linha de origem era inválida. Não chame liberarPrograma na vista.
+int obterFormulaBiblioteca(const BibliotecaExpressoes *biblioteca, size_t id, ProgramaPosFixa *programa) {
+    memset(programa, 0, sizeof(ProgramaPosFixa));
+    if (id >= biblioteca->num_formulas || biblioteca->indice[id].num_instrucoes == 0) {
+        return 0;
+    }
+    const EntradaBiblioteca *entrada = &biblioteca->indice[id];
+    const char *registro = biblioteca->dados + entrada->deslocamento;
+    programa->instrucoes = (unsigned int *)registro;
+    programa->constantes = (float *)(registro + 4 * (size_t)entrada->num_instrucoes);
+    programa->num_instrucoes = (int)entrada->num_instrucoes;
+    programa->num_constantes = (int)entrada->num_constantes;
+    programa->num_variaveis = (int)entrada->num_variaveis;
+    programa->profundidade_maxima = (int)entrada->profundidade_maxima;
+    return 1;
+}
+
+// Avalia a fórmula 'id' direto do mapeamento (NAN se o id for inválido ou em erro)
+float avaliarFormulaBiblioteca(const BibliotecaExpressoes *biblioteca, size_t id, const float *valores) {
+    ProgramaPosFixa programa;
+    if (!obterFormulaBiblioteca(biblioteca, id, &programa)) {
+        return NAN;
+    }
+    return avaliarProgramaComVariaveis(&programa, valores);
+}
+
+// Índice da variável 'nome' na fórmula 'id' (-1 se não existir)
+int indiceVariavelBiblioteca(const BibliotecaExpressoes *biblioteca, size_t id, const char *nome) {
+    if (id >= biblioteca->num_formulas || biblioteca->indice[id].num_instrucoes == 0) {
+        return -1;
+    }
+    const EntradaBiblioteca *entrada = &biblioteca->indice[id];
+    const char *p = biblioteca->dados + entrada->deslocamento +
+                    4 * ((size_t)entrada->num_instrucoes + entrada->num_constantes);
+    for (int i = 0; i < (int)entrada->num_variaveis; i++) {
+        if (strcmp(p, nome) == 0) {
+            return i;
+        }
+        p += strlen(p) + 1;
+    }
+    return -1;
+}
+
+void fecharBibliotecaExpressoes(BibliotecaExpressoes *biblioteca) {
+    if (biblioteca == NULL) {
+        return;
+    }
+    desmapear_arquivo(biblioteca->dados, biblioteca->tamanho);
+    free(biblioteca);
 }
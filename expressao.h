@@ -1,6 +1,9 @@
 #ifndef EXPRESSAO_H
 #define EXPRESSAO_H
 
+#include <stddef.h>
+#include <stdio.h>
+
 typedef struct {
     char posFixa[512]; // Expressão na forma pos-fixa, como 3 12 4 + *
     char inFixa[512]; // Expressão na forma infixa, como 3*(12+4)
@@ -10,4 +13,332 @@ typedef struct {
 char * getFormaInFixa(char *Str); // Retorna a forma inFixa de Str (posFixa)
 float getValorPosFixa(char *StrPosFixa); // Calcula o valor de Str (na forma posFixa)
 
+// =================================================================================
+// ERROS SEM E/S (variantes silenciosas das funções principais)
+// =================================================================================
+
+typedef enum {
+    ERRO_NENHUM = 0,
+    ERRO_DIVISAO_POR_ZERO,
+    ERRO_MODULO_POR_ZERO,
+    ERRO_RAIZ_NEGATIVA,
+    ERRO_LOGARITMO_NAO_POSITIVO,
+    ERRO_RESULTADO_INVALIDO,      // Outro resultado NAN (ex: (-8)^0.5)
+    ERRO_TOKEN_INVALIDO,
+    ERRO_OPERADOR_SEM_OPERANDOS,  // Operador binário com a pilha vazia
+    ERRO_OPERADOR_UM_OPERANDO,    // Operador binário com apenas um operando
+    ERRO_FUNCAO_SEM_OPERANDO,
+    ERRO_OPERANDOS_RESTANTES,
+    ERRO_EXPRESSAO_VAZIA,
+    ERRO_MEMORIA,
+    ERRO_ENTRADA_SAIDA,           // Falha de leitura ou escrita nas funções de fluxo
+    ERRO_PROGRAMA_GRANDE,         // Programa compilado com constantes ou variáveis além de MAX_ARGUMENTO_INSTRUCAO
+    NUM_CODIGOS_ERRO
+} CodigoErro;
+
+typedef struct {
+    CodigoErro codigo;
+    long posicao; // Deslocamento (em bytes) do token que causou o erro; -1 se não houver
+} ErroExpressao;
+
+float getValorPosFixaComErro(const char *StrPosFixa, ErroExpressao *erro); // Como getValorPosFixa, sem E/S
+char * getFormaInFixaComErro(const char *StrPosFixa, ErroExpressao *erro); // Como getFormaInFixa, sem E/S
+const char *nomeCodigoErro(CodigoErro codigo); // Nome curto e estável (ex: "divisao_por_zero")
+void obterContadoresErro(unsigned long long contadores[NUM_CODIGOS_ERRO]); // Erros por código desde o início
+
+// =================================================================================
+// EXPRESSÃO COMPLETA (valor e forma infixa em uma passada, sem alocação)
+// =================================================================================
+
+// Lê posFixa uma vez e preenche Valor (getValorPosFixaComErro, mesmo erro) e inFixa
+// (getFormaInFixa, escrita no próprio registro). 1 se inFixa foi preenchida; 0 se a
+// expressão for inválida ou a forma infixa não couber (inFixa vazia).
+int preencherExpressao(Expressao *expressao, ErroExpressao *erro);
+size_t preencherExpressoes(Expressao *expressoes, size_t quantidade,
+                           ErroExpressao *erros); // Lote (erros pode ser NULL); retorna quantos ficaram sem erro
+
+// =================================================================================
+// PRECISÃO NUMÉRICA (mesma semântica de getValorPosFixaComErro, em cada tipo)
+// =================================================================================
+
+// getValorPosFixa arredonda para float resultados calculados em double (e faz
+// as subexpressões só com inteiros exatamente, em int64); estas variantes
+// fazem números, pilha e operações inteiramente no tipo escolhido.
+float getValorPosFixaFloat(const char *StrPosFixa, ErroExpressao *erro);
+double getValorPosFixaDouble(const char *StrPosFixa, ErroExpressao *erro);
+long double getValorPosFixaLongDouble(const char *StrPosFixa, ErroExpressao *erro);
+
+// =================================================================================
+// PROGRAMA PÓS-FIXO COMPILADO (compila uma vez, avalia muitas vezes)
+// =================================================================================
+
+// Códigos de operação do programa compilado
+typedef enum {
+    OP_CONSTANTE = 0, // Empilha constantes[argumento]
+    OP_VARIAVEL,      // Empilha o valor da variável de índice argumento
+    OP_SOMA,          // +
+    OP_SUBTRACAO,     // -
+    OP_MULTIPLICACAO, // *
+    OP_DIVISAO,       // /
+    OP_MODULO,        // %
+    OP_POTENCIA,      // ^
+    OP_RAIZ,          // raiz
+    OP_SENO,          // sen (graus)
+    OP_COSSENO,       // cos (graus)
+    OP_TANGENTE,      // tg (graus)
+    OP_LOGARITMO,     // log (base 10)
+    NUM_OPCODES,
+    // Só em programas de otimizarPrograma (subexpressões comuns)
+    OP_GUARDAR,       // Copia o topo para o temporário de índice argumento (sem desempilhar)
+    OP_CARREGAR       // Empilha o temporário de índice argumento
+} Opcode;
+
+// Cada instrução ocupa 32 bits: opcode nos 8 bits baixos e argumento nos 24 altos
+#define INSTRUCAO(op, arg) ((unsigned int)(op) | ((unsigned int)(arg) << 8))
+#define OPCODE_DE(instr) ((Opcode)((instr) & 0xFFu))
+#define ARGUMENTO_DE(instr) ((instr) >> 8)
+#define MAX_ARGUMENTO_INSTRUCAO (1 << 24) // Limite de constantes, variáveis e instruções de um programa
+
+// Cálculo de raiz, sen, cos, tg e log. No modo rápido, sen/cos/tg reduzem o
+// argumento em graus de forma exata e usam polinômios em float (erro absoluto
+// <= 1e-7 em sen/cos; em tg, <= 2.5e-7 relativo ou absoluto abaixo de 1), log
+// usa um polinômio sobre a mantissa (erro relativo <= 2e-7) e raiz usa sqrt em
+// float (arredondamento correto). As demais operações não mudam.
+typedef enum {
+    CALCULO_EXATO = 0, // libm em double, como getValorPosFixa
+    CALCULO_RAPIDO
+} ModoCalculo;
+
+typedef struct {
+    unsigned int *instrucoes; // Sequência de instruções na ordem pós-fixa
+    float *constantes;        // Tabela de constantes numéricas
+    int num_instrucoes;
+    int num_constantes;
+    int profundidade_maxima;  // Maior altura que a pilha atinge durante a avaliação
+    int num_temporarios;      // Temporários de OP_GUARDAR/OP_CARREGAR (0 sem otimizarPrograma)
+    char **nomes_variaveis;   // Nomes das variáveis (ex: "x"), na ordem da primeira ocorrência
+    int num_variaveis;
+    ModoCalculo modo;         // CALCULO_EXATO ao compilar; pode ser trocado antes de avaliar
+    struct CodigoNativo *nativo; // Código gerado por ativarJit (NULL = interpretador)
+} ProgramaPosFixa;
+
+// Programas compilados calculam sempre em float (constantes guardadas como float),
+// sem a etapa exata em int64 de getValorPosFixa: acima de 2^24 os resultados
+// podem diferir (ex: "16777217 16777215 -" dá 2 em getValorPosFixa e 1 aqui).
+int compilarPosFixa(const char *StrPosFixa, ProgramaPosFixa *programa); // Compila Str (posFixa); retorna 1 em sucesso, 0 em erro
+float avaliarPrograma(const ProgramaPosFixa *programa); // Avalia um programa compilado (NAN em caso de erro)
+void liberarPrograma(ProgramaPosFixa *programa); // Libera a memória de um programa compilado
+int obterIndiceVariavel(const ProgramaPosFixa *programa, const char *nome); // Índice da variável (-1 se não existir)
+float avaliarProgramaComVariaveis(const ProgramaPosFixa *programa, const float *valores); // valores[i] = variável i
+int avaliarProgramaEmLote(const ProgramaPosFixa *programa, const float *const *colunas,
+                          size_t num_linhas, float *saida); // colunas[i][linha] = variável i; 1 em sucesso
+float getValorPosFixaComModo(const char *StrPosFixa, ModoCalculo modo, ErroExpressao *erro); // ComErro com modo por chamada
+
+// =================================================================================
+// OTIMIZAÇÃO DO PROGRAMA (dobra de constantes, redução de força, subexpressões comuns)
+// =================================================================================
+
+// Transformações de otimizarPrograma. Sem OTIMIZAR_INEXATO, o programa otimizado dá
+// o mesmo resultado bit a bit e falha (NAN) nos mesmos casos que o original.
+typedef enum {
+    OTIMIZAR_CONSTANTES = 1,    // Subárvores só de constantes viram constantes ("10 log", "45 60 +")
+    OTIMIZAR_REDUCOES = 2,      // s 2 ^ -> s s *; s c / -> s (1/c) * com c potência de 2
+    OTIMIZAR_SUBEXPRESSOES = 4, // Subárvores repetidas calculadas uma vez (OP_GUARDAR/OP_CARREGAR)
+    OTIMIZAR_INEXATO = 8,       // Também s 3 ^, s 4 ^ e s c / com qualquer c (difere no último bit)
+    OTIMIZAR_CONFERIR = 16,     // Compara com o original em 64 pontos; se divergir, não substitui
+    OTIMIZAR_PADRAO = OTIMIZAR_CONSTANTES | OTIMIZAR_REDUCOES | OTIMIZAR_SUBEXPRESSOES
+} OpcaoOtimizacao;
+
+int otimizarPrograma(ProgramaPosFixa *programa, int opcoes); // 1 se o programa foi substituído pelo otimizado
+
+// =================================================================================
+// COMPILAÇÃO NATIVA (JIT x86-64)
+// =================================================================================
+
+// ativarJit gera código de máquina para um programa que será avaliado muitas
+// vezes; avaliarProgramaComVariaveis passa a usá-lo sem mudança de resultado.
+// Sem suporte (outra arquitetura, Windows ou EXPRESSAO_SEM_JIT definida), com o
+// JIT desligado, com pilha acima de 14 posições ou com temporários (OP_GUARDAR),
+// o interpretador continua.
+int jitDisponivel(void); // 1 se a biblioteca foi compilada com o JIT
+void definirJitHabilitado(int habilitado); // Liga (padrão) ou desliga o uso do código nativo
+int ativarJit(ProgramaPosFixa *programa); // 1 se gerou código nativo; liberado por liberarPrograma
+
+// =================================================================================
+// ANÁLISE LÉXICA
+// =================================================================================
+
+typedef enum {
+    TOKEN_FIM = 0,
+    TOKEN_NUMERO,   // Literal decimal (valor em Token.valor)
+    TOKEN_VARIAVEL, // Nome que não é função
+    TOKEN_OPERADOR, // Operador ou função (opcode em Token.op)
+    TOKEN_INVALIDO
+} TipoToken;
+
+typedef struct {
+    TipoToken tipo;
+    Opcode op;          // Opcode de TOKEN_OPERADOR
+    float valor;        // Valor de TOKEN_NUMERO
+    const char *inicio; // Trecho do token no texto original (sem cópia, não termina em '\0')
+    size_t tamanho;
+} Token;
+
+typedef struct {
+    const char *inicio; // Início do texto analisado
+    const char *cursor; // Próximo caractere a ler
+} AnalisadorLexico;
+
+void iniciarAnalisadorLexico(AnalisadorLexico *lexico, const char *texto); // Posiciona no início do texto
+TipoToken proximoToken(AnalisadorLexico *lexico, Token *token); // Lê o próximo token pós-fixo
+
+// =================================================================================
+// CONVERSÃO INFIXA -> PÓS-FIXA
+// =================================================================================
+
+int compilarInFixa(const char *StrInFixa, ProgramaPosFixa *programa); // Compila Str (inFixa) direto para um programa
+char * getFormaPosFixa(const char *StrInFixa); // Retorna a forma posFixa canônica de Str (inFixa); NULL em erro
+
+// =================================================================================
+// PROCESSAMENTO PARALELO
+// =================================================================================
+
+// Pool de threads persistente com roubo de trabalho (work stealing)
+typedef struct PoolTrabalho PoolTrabalho;
+// Tarefa de índice 'indice', executada pela thread 'trabalhador' (0 = thread chamadora)
+typedef void (*FuncaoTarefa)(void *contexto, size_t indice, int trabalhador);
+
+PoolTrabalho *criarPoolTrabalho(int num_threads); // num_threads <= 0: uma por núcleo; NULL em erro
+int numeroTrabalhadores(const PoolTrabalho *pool); // Inclui a thread chamadora
+void executarNoPool(PoolTrabalho *pool, size_t num_tarefas, FuncaoTarefa funcao, void *contexto); // Bloqueia até o fim
+void destruirPoolTrabalho(PoolTrabalho *pool);
+
+// Avalia cada linha pós-fixa do arquivo de entrada e grava "valor<TAB>infixa" por linha,
+// na ordem da entrada. Retorna o número de linhas processadas ou -1 em erro.
+long processarArquivoExpressoes(const char *caminho_entrada, const char *caminho_saida, int num_threads);
+
+// Como getValorPosFixaComErro (mesmo resultado, bit a bit), avaliando em paralelo no pool
+// as subárvores independentes com pelo menos 'limiar' tokens (<= 0: 65536) de uma
+// expressão muito grande. Abaixo do limiar, ou com pool NULL, o caminho é o sequencial.
+float getValorPosFixaParalelo(PoolTrabalho *pool, const char *StrPosFixa, int limiar, ErroExpressao *erro);
+
+// =================================================================================
+// CACHE DE EXPRESSÕES
+// =================================================================================
+
+// Cache limitado (substituição CLOCK) de valores e formas infixas, seguro entre threads
+typedef struct CacheExpressoes CacheExpressoes;
+
+typedef struct {
+    unsigned long long acertos;            // Expressões inteiras encontradas no cache
+    unsigned long long faltas;             // Expressões inteiras recalculadas
+    unsigned long long acertos_subarvores; // Subexpressões reaproveitadas durante uma falta
+    unsigned long long insercoes;
+    unsigned long long remocoes;           // Entradas descartadas para abrir espaço
+    size_t entradas;                       // Entradas presentes
+    size_t capacidade;
+} EstatisticasCache;
+
+// capacidade: máximo de entradas; tamanho_minimo_subarvore: subexpressões com pelo menos
+// esse número de tokens também são guardadas (0 = só expressões inteiras). NULL em erro.
+CacheExpressoes *criarCacheExpressoes(size_t capacidade, int tamanho_minimo_subarvore);
+float getValorPosFixaCache(CacheExpressoes *cache, const char *StrPosFixa); // Como getValorPosFixa (mesma aritmética int64/float)
+char * getFormaInFixaCache(CacheExpressoes *cache, const char *StrPosFixa); // Como getFormaInFixa (liberar com free)
+void obterEstatisticasCache(CacheExpressoes *cache, EstatisticasCache *estatisticas);
+void destruirCacheExpressoes(CacheExpressoes *cache);
+
+// =================================================================================
+// AVALIAÇÃO INCREMENTAL (recalcula só o caminho das entradas alteradas)
+// =================================================================================
+
+// Árvore persistente da expressão pós-fixa com o valor de cada nó em cache. As
+// folhas com variáveis são as entradas; atualizar entradas recalcula apenas os
+// seus ancestrais (O(profundidade) por entrada), e em um lote cada ancestral
+// comum é recalculado uma única vez. Os valores são os de avaliarProgramaComVariaveis.
+typedef struct AvaliacaoIncremental AvaliacaoIncremental;
+
+// entradas[i] = valor inicial da variável i (pode ser NULL sem variáveis). NULL em erro.
+AvaliacaoIncremental *criarAvaliacaoIncremental(const char *StrPosFixa, const float *entradas);
+int indiceEntradaIncremental(const AvaliacaoIncremental *avaliacao, const char *nome); // -1 se não existir
+float atualizarEntradaIncremental(AvaliacaoIncremental *avaliacao, int indice, float valor); // Novo valor (NAN em erro)
+float atualizarEntradasIncremental(AvaliacaoIncremental *avaliacao, const int *indices, const float *valores,
+                                   size_t quantidade); // Lote; índices inválidos são ignorados
+float valorAvaliacaoIncremental(const AvaliacaoIncremental *avaliacao); // Valor atual da expressão
+int nosRecalculadosIncremental(const AvaliacaoIncremental *avaliacao); // Operadores recalculados na última atualização
+void destruirAvaliacaoIncremental(AvaliacaoIncremental *avaliacao);
+
+// =================================================================================
+// AVALIAÇÃO EM FLUXO (entradas de qualquer tamanho, sem a string inteira em memória)
+// =================================================================================
+
+// Fonte de dados: copia até 'tamanho' bytes para 'destino' e retorna quantos
+// copiou, 0 no fim da entrada ou -1 em erro.
+typedef long (*FuncaoLeitura)(void *contexto, char *destino, size_t tamanho);
+
+// Como getValorPosFixaComErro, lendo a expressão por um buffer fixo de 64 KiB
+// (tokens maiores são inválidos); a memória depende só da altura da pilha.
+// erro->posicao é o deslocamento do token na entrada.
+float avaliarPosFixaStream(FuncaoLeitura ler, void *contexto, ErroExpressao *erro);
+float avaliarPosFixaArquivo(FILE *entrada, ErroExpressao *erro);
+float avaliarPosFixaDescritor(int fd, ErroExpressao *erro);
+
+// Como getFormaInFixaComErro, escrevendo a forma infixa em 'saida' aos poucos, sem
+// montar o texto. A ordem infixa só é conhecida no fim da entrada, então guarda
+// uma árvore compacta (5 bytes por token mais o texto dos números). 1 em sucesso.
+int escreverInFixaStream(FuncaoLeitura ler, void *contexto, FILE *saida, ErroExpressao *erro);
+int escreverInFixaArquivo(FILE *entrada, FILE *saida, ErroExpressao *erro);
+int escreverInFixaDescritor(int fd, FILE *saida, ErroExpressao *erro);
+
+// =================================================================================
+// BIBLIOTECA BINÁRIA DE EXPRESSÕES (compilada uma vez, mapeada na inicialização)
+// =================================================================================
+
+// Arquivo versionado, com soma de verificação e registros alinhados, com os
+// programas de um arquivo de expressões (id = número da linha, a partir de 0).
+// Abrir custa uma leitura sequencial para verificação; depois, cada fórmula é
+// encontrada em O(1) e avaliada direto do arquivo mapeado, sem desserializar.
+typedef struct BibliotecaExpressoes BibliotecaExpressoes;
+
+long gravarBibliotecaExpressoes(const char *caminho_entrada, const char *caminho_saida,
+                                long *num_invalidas); // Fórmulas gravadas (-1 em erro)
+BibliotecaExpressoes *abrirBibliotecaExpressoes(const char *caminho); // NULL se ilegível ou inválida
+size_t numeroFormulasBiblioteca(const BibliotecaExpressoes *biblioteca);
+int obterFormulaBiblioteca(const BibliotecaExpressoes *biblioteca, size_t id,
+                           ProgramaPosFixa *programa); // Vista sem cópia (não liberar); 0 se id inválido
+float avaliarFormulaBiblioteca(const BibliotecaExpressoes *biblioteca, size_t id,
+                               const float *valores); // Como avaliarProgramaComVariaveis
+int indiceVariavelBiblioteca(const BibliotecaExpressoes *biblioteca, size_t id, const char *nome); // -1 se não existir
+void fecharBibliotecaExpressoes(BibliotecaExpressoes *biblioteca);
+
+// =================================================================================
+// INSTRUMENTAÇÃO (compile com -DEXPRESSAO_INSTRUMENTACAO para ligar)
+// =================================================================================
+
+// Funções medidas pelos histogramas de latência
+typedef enum {
+    MEDIDA_VALOR_POSFIXA = 0, // getValorPosFixa / getValorPosFixaComErro
+    MEDIDA_FORMA_INFIXA,      // getFormaInFixa / getFormaInFixaComErro
+    NUM_FUNCOES_MEDIDAS
+} FuncaoMedida;
+
+// Faixa i do histograma: latências em [2^i, 2^(i+1)) ns (a última acumula o resto)
+#define NUM_FAIXAS_LATENCIA 32
+
+typedef struct {
+    unsigned long long tokens[NUM_OPCODES];  // Tokens avaliados por getValorPosFixa (números em OP_CONSTANTE)
+    unsigned long long alocacoes;            // Alocações da pilha, da árvore e do texto infixo
+    int altura_maxima_pilha;                 // Maior altura da pilha numérica em uma avaliação
+    unsigned long long chamadas[NUM_FUNCOES_MEDIDAS];
+    unsigned long long latencia[NUM_FUNCOES_MEDIDAS][NUM_FAIXAS_LATENCIA];
+} MetricasExpressao;
+
+typedef enum {
+    METRICAS_TEXTO = 0,
+    METRICAS_JSON
+} FormatoMetricas;
+
+int instrumentacaoAtiva(void); // 1 se a biblioteca foi compilada com EXPRESSAO_INSTRUMENTACAO
+void obterMetricasExpressao(MetricasExpressao *metricas); // Soma das threads (zeros se desligada)
+int escreverMetricasExpressao(FILE *saida, FormatoMetricas formato); // 1 em sucesso, 0 em erro de escrita
+
 #endif
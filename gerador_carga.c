@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "expressao.h"
+#include "protocolo.h"
+
+/*
+ * Gerador de carga para o servidor de expressões (servidor.c).
+ *
+ * Compilação: gcc -O2 expressao.c gerador_carga.c -o gerador_carga.exe -lm -lpthread
+ * Uso: gerador_carga.exe <caminho_socket> [conexoes] [requisicoes_por_conexao] [janela]
+ *
+ * Cada conexão roda em uma thread e mantém até 'janela' requisições em voo
+ * (pipelining), percorrendo uma lista fixa de expressões ora como
+ * PROTOCOLO_VALOR, ora como PROTOCOLO_INFIXA. Cada resposta é conferida com o
+ * cálculo local e a latência (do envio até a chegada da resposta) entra nos
+ * percentis. Ao final, imprime requisições por segundo, p50, p99 e o número
+ * de respostas divergentes.
+ */
+
+// Fórmulas pequenas (inclusive com erro), o caso em que a latência mais importa
+const char *expressoes[] = {
+    "3 4 + 5 *",
+    "7 2 * 4 +",
+    "8 5 2 4 + * +",
+    "6 2 / 3 + 4 *",
+    "9 5 2 8 * 4 + * +",
+    "2 3 + log 5 /",
+    "10 log 3 ^ 2 +",
+    "45 60 + 30 cos *",
+    "0.5 45 sen 2 ^ +",
+    "3 45 tg * 2 raiz +",
+    "1 0 /",
+    "-4 raiz",
+    "3 + 4"
+};
+#define NUM_EXPRESSOES ((int)(sizeof(expressoes) / sizeof(expressoes[0])))
+
+// Respostas esperadas, calculadas localmente com as mesmas funções do servidor
+CodigoErro codigo_valor[NUM_EXPRESSOES];
+float valor_esperado[NUM_EXPRESSOES];
+CodigoErro codigo_infixa[NUM_EXPRESSOES];
+char *infixa_esperada[NUM_EXPRESSOES];
+
+typedef struct {
+    const char *caminho;
+    long num_requisicoes;
+    int janela;
+    double *latencias; // Instante do envio, depois substituído pela latência
+    long divergencias;
+    int falhou;
+} TrabalhoConexao;
+
+double agora(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+unsigned int ler_u32(const unsigned char *p) {
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+void escrever_u32(unsigned char *p, unsigned int valor) {
+    p[0] = (unsigned char)valor;
+    p[1] = (unsigned char)(valor >> 8);
+    p[2] = (unsigned char)(valor >> 16);
+    p[3] = (unsigned char)(valor >> 24);
+}
+
+// Requisição de índice i: expressão i % NUM_EXPRESSOES, tipo alternando a cada volta na lista
+int tipo_da_requisicao(long i) {
+    return ((i / NUM_EXPRESSOES) % 2 == 0) ? PROTOCOLO_VALOR : PROTOCOLO_INFIXA;
+}
+
+// Confere a resposta da requisição 'id' (carga com 'tamanho' bytes)
+int resposta_correta(long id, unsigned char codigo, const unsigned char *carga, size_t tamanho) {
+    int e = (int)(id % NUM_EXPRESSOES);
+    if (tipo_da_requisicao(id) == PROTOCOLO_VALOR) {
+        unsigned int bits = ler_u32(carga);
+        float valor;
+        memcpy(&valor, &bits, sizeof(valor));
+        return codigo == codigo_valor[e] && tamanho == sizeof(float) &&
+               (memcmp(&valor, &valor_esperado[e], sizeof(float)) == 0 || (isnan(valor) && isnan(valor_esperado[e])));
+    }
+    if (infixa_esperada[e] == NULL) {
+        return codigo == codigo_infixa[e] && tamanho == 0;
+    }
+    return codigo == codigo_infixa[e] && tamanho == strlen(infixa_esperada[e]) &&
+           memcmp(carga, infixa_esperada[e], tamanho) == 0;
+}
+
+// Escreve 'tamanho' bytes, repetindo em escritas parciais; 0 em erro
+int escrever_tudo(int fd, const unsigned char *dados, size_t tamanho) {
+    while (tamanho > 0) {
+        ssize_t n = write(fd, dados, tamanho);
+        if (n <= 0) {
+            return 0;
+        }
+        dados += n;
+        tamanho -= (size_t)n;
+    }
+    return 1;
+}
+
+void *executar_conexao(void *argumento) {
+    TrabalhoConexao *trabalho = (TrabalhoConexao *)argumento;
+    size_t capacidade_saida = (size_t)trabalho->janela * (PROTOCOLO_TAMANHO_COMPRIMENTO + PROTOCOLO_TAMANHO_CABECALHO + 64);
+    size_t capacidade_entrada = 1 << 20;
+    unsigned char *saida = (unsigned char *)malloc(capacidade_saida);
+    unsigned char *entrada = (unsigned char *)malloc(capacidade_entrada);
+    size_t usado_entrada = 0;
+    long enviadas = 0;
+    long recebidas = 0;
+
+    struct sockaddr_un endereco;
+    memset(&endereco, 0, sizeof(endereco));
+    endereco.sun_family = AF_UNIX;
+    strncpy(endereco.sun_path, trabalho->caminho, sizeof(endereco.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (saida == NULL || entrada == NULL || fd < 0 ||
+        connect(fd, (struct sockaddr *)&endereco, sizeof(endereco)) != 0) {
+        trabalho->falhou = 1;
+        goto fim;
+    }
+
+    while (recebidas < trabalho->num_requisicoes) {
+        // Completa a janela com novas requisições, enviadas de uma vez
+        size_t usado_saida = 0;
+        while (enviadas < trabalho->num_requisicoes && enviadas - recebidas < trabalho->janela) {
+            const char *texto = expressoes[enviadas % NUM_EXPRESSOES];
+            size_t tamanho = strlen(texto);
+            unsigned char *p = saida + usado_saida;
+            escrever_u32(p, (unsigned int)(PROTOCOLO_TAMANHO_CABECALHO + tamanho));
+            escrever_u32(p + 4, (unsigned int)enviadas);
+            p[8] = (unsigned char)tipo_da_requisicao(enviadas);
+            memcpy(p + 9, texto, tamanho);
+            usado_saida += PROTOCOLO_TAMANHO_COMPRIMENTO + PROTOCOLO_TAMANHO_CABECALHO + tamanho;
+            trabalho->latencias[enviadas++] = agora();
+        }
+        if (usado_saida > 0 && !escrever_tudo(fd, saida, usado_saida)) {
+            trabalho->falhou = 1;
+            break;
+        }
+
+        // Lê o que houver e confere cada resposta completa
+        ssize_t n = read(fd, entrada + usado_entrada, capacidade_entrada - usado_entrada);
+        if (n <= 0) {
+            trabalho->falhou = 1;
+            break;
+        }
+        usado_entrada += (size_t)n;
+        double chegada = agora();
+        size_t p = 0;
+        while (usado_entrada - p >= PROTOCOLO_TAMANHO_COMPRIMENTO) {
+            unsigned int comprimento = ler_u32(entrada + p);
+            if (comprimento < PROTOCOLO_TAMANHO_CABECALHO || comprimento > capacidade_entrada - PROTOCOLO_TAMANHO_COMPRIMENTO) {
+                trabalho->falhou = 1;
+                goto fim;
+            }
+            if (usado_entrada - p - PROTOCOLO_TAMANHO_COMPRIMENTO < comprimento) {
+                break;
+            }
+            const unsigned char *mensagem = entrada + p + PROTOCOLO_TAMANHO_COMPRIMENTO;
+            long id = (long)ler_u32(mensagem);
+            // As respostas de uma conexão chegam na ordem das requisições
+            if (id != recebidas || !resposta_correta(id, mensagem[4], mensagem + PROTOCOLO_TAMANHO_CABECALHO,
+                                                     comprimento - PROTOCOLO_TAMANHO_CABECALHO)) {
+                trabalho->divergencias++;
+            }
+            if (id >= 0 && id < enviadas) {
+                trabalho->latencias[id] = chegada - trabalho->latencias[id];
+            }
+            recebidas++;
+            p += PROTOCOLO_TAMANHO_COMPRIMENTO + comprimento;
+        }
+        memmove(entrada, entrada + p, usado_entrada - p);
+        usado_entrada -= p;
+    }
+
+fim:
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(saida);
+    free(entrada);
+    return NULL;
+}
+
+int comparar_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Uso: %s <caminho_socket> [conexoes] [requisicoes_por_conexao] [janela]\n", argv[0]);
+        return 1;
+    }
+    int num_conexoes = (argc > 2) ? atoi(argv[2]) : 4;
+    long por_conexao = (argc > 3) ? atol(argv[3]) : 100000;
+    int janela = (argc > 4) ? atoi(argv[4]) : 32;
+    if (num_conexoes <= 0 || por_conexao <= 0 || janela <= 0) {
+        fprintf(stderr, "Uso: %s <caminho_socket> [conexoes] [requisicoes_por_conexao] [janela]\n", argv[0]);
+        return 1;
+    }
+
+    for (int e = 0; e < NUM_EXPRESSOES; e++) {
+        ErroExpressao erro;
+        valor_esperado[e] = getValorPosFixaComErro(expressoes[e], &erro);
+        codigo_valor[e] = erro.codigo;
+        infixa_esperada[e] = getFormaInFixaComErro(expressoes[e], &erro);
+        codigo_infixa[e] = erro.codigo;
+    }
+
+    long total = (long)num_conexoes * por_conexao;
+    double *latencias = (double *)malloc((size_t)total * sizeof(double));
+    TrabalhoConexao *trabalhos = (TrabalhoConexao *)calloc((size_t)num_conexoes, sizeof(TrabalhoConexao));
+    pthread_t *threads = (pthread_t *)malloc((size_t)num_conexoes * sizeof(pthread_t));
+    if (latencias == NULL || trabalhos == NULL || threads == NULL) {
+        fprintf(stderr, "Erro de alocacao de memoria.\n");
+        return 1;
+    }
+
+    double inicio = agora();
+    for (int c = 0; c < num_conexoes; c++) {
+        trabalhos[c].caminho = argv[1];
+        trabalhos[c].num_requisicoes = por_conexao;
+        trabalhos[c].janela = janela;
+        trabalhos[c].latencias = latencias + (size_t)c * (size_t)por_conexao;
+        pthread_create(&threads[c], NULL, executar_conexao, &trabalhos[c]);
+    }
+    long divergencias = 0;
+    int falhas = 0;
+    for (int c = 0; c < num_conexoes; c++) {
+        pthread_join(threads[c], NULL);
+        divergencias += trabalhos[c].divergencias;
+        falhas += trabalhos[c].falhou;
+    }
+    double tempo = agora() - inicio;
+    if (falhas > 0) {
+        fprintf(stderr, "Erro: %d conexoes falharam (o servidor esta rodando em %s?).\n", falhas, argv[1]);
+        return 1;
+    }
+
+    qsort(latencias, (size_t)total, sizeof(double), comparar_double);
+    printf("%d conexoes x %ld requisicoes (janela %d): %.2f s\n", num_conexoes, por_conexao, janela, tempo);
+    printf("  Requisicoes/s: %.0f\n", (double)total / tempo);
+    printf("  Latencia p50:  %.1f us\n", latencias[(size_t)(0.50 * (double)(total - 1))] * 1e6);
+    printf("  Latencia p99:  %.1f us\n", latencias[(size_t)(0.99 * (double)(total - 1))] * 1e6);
+    printf("  Latencia max:  %.1f us\n", latencias[total - 1] * 1e6);
+    printf("  Divergencias:  %ld\n", divergencias);
+
+    for (int e = 0; e < NUM_EXPRESSOES; e++) {
+        free(infixa_esperada[e]);
+    }
+    free(latencias);
+    free(trabalhos);
+    free(threads);
+    return divergencias == 0 ? 0 : 1;
+}
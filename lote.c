@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "expressao.h"
+
+/*
+ * Processador em lote de arquivos de expressões pós-fixas.
+ *
+ * Compilação: gcc expressao.c lote.c -o lote.exe -lm -lpthread
+ * (com -DEXPRESSAO_INSTRUMENTACAO, as métricas do processamento vão para stderr)
+ * Uso: lote.exe <entrada> <saida> [threads]
+ *
+ * Cada linha da entrada é uma expressão pós-fixa (como "3 4 + 5 *"); cada linha
+ * da saída, na mesma ordem, contém "valor<TAB>infixa" ("ERRO" quando inválida).
+ * Ao final, imprime quantos erros de cada tipo foram encontrados.
+ */
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Uso: %s <entrada> <saida> [threads]\n", argv[0]);
+        return 1;
+    }
+    int num_threads = (argc > 3) ? atoi(argv[3]) : 0;
+
+    long linhas = processarArquivoExpressoes(argv[1], argv[2], num_threads);
+    if (linhas < 0) {
+        return 1;
+    }
+    printf("%ld linhas processadas.\n", linhas);
+
+    // Resumo dos erros encontrados (as linhas inválidas não geram mensagens)
+    unsigned long long contadores[NUM_CODIGOS_ERRO];
+    obterContadoresErro(contadores);
+    for (int i = 1; i < NUM_CODIGOS_ERRO; i++) {
+        if (contadores[i] > 0) {
+            printf("  %-24s %llu\n", nomeCodigoErro((CodigoErro)i), contadores[i]);
+        }
+    }
+    if (instrumentacaoAtiva()) {
+        escreverMetricasExpressao(stderr, METRICAS_TEXTO);
+    }
+    return 0;
+}
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <unistd.h>
 #include "expressao.h"
 
 // Estrutura para armazenar um caso de teste
@@ -48,6 +49,1423 @@ void executar_teste(int id, CasoTeste teste) {
     }
 }
 
+// Função para executar um caso de teste pelo caminho compilado (compilarPosFixa + avaliarPrograma)
+void executar_teste_programa(int id, CasoTeste teste) {
+    printf("\n--- Teste Compilado %d ---\n", id);
+    printf("Pos-Fixa: %s\n", teste.posFixa);
+
+    ProgramaPosFixa programa;
+    if (!compilarPosFixa(teste.posFixa, &programa)) {
+        // Expressões estruturalmente inválidas são rejeitadas já na compilação
+        printf("Compilacao: ERRO (Expressao Invalida)\n");
+        return;
+    }
+
+    float valor_calculado = avaliarPrograma(&programa);
+    if (isnan(valor_calculado)) {
+        printf("Avaliacao: ERRO (Expressao Invalida)\n");
+    } else if (fabs(valor_calculado - teste.valor_esperado) < teste.tolerancia) {
+        printf("Avaliacao: OK. Valor Calculado: %.2f (Esperado: %.2f)\n", valor_calculado, teste.valor_esperado);
+    } else {
+        printf("Avaliacao: FALHA. Valor Calculado: %.10f (Esperado: %.10f)\n", valor_calculado, teste.valor_esperado);
+    }
+    liberarPrograma(&programa);
+}
+
+// Mesmo valor bit a bit (inclusive o NAN de erro)
+int mesmo_float(float a, float b) {
+    return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+// Compara a avaliação em lote com a avaliação linha a linha (bit a bit) para uma expressão com variáveis
+void executar_teste_lote(int id, const char *posFixa) {
+    printf("\n--- Teste Lote %d ---\n", id);
+    printf("Pos-Fixa: %s\n", posFixa);
+
+    ProgramaPosFixa programa;
+    if (!compilarPosFixa(posFixa, &programa)) {
+        printf("Compilacao: ERRO (Expressao Invalida)\n");
+        return;
+    }
+
+    // Colunas de teste: x percorre [-50, 50) e y alterna entre 0 e valores positivos
+    enum { NUM_LINHAS = 1000 };
+    static float x[NUM_LINHAS], y[NUM_LINHAS], saida[NUM_LINHAS];
+    for (int i = 0; i < NUM_LINHAS; i++) {
+        x[i] = (float)(i % 100) - 50.0f;
+        y[i] = (float)(i % 7);
+    }
+    const float *colunas[2];
+    int ix = obterIndiceVariavel(&programa, "x");
+    int iy = obterIndiceVariavel(&programa, "y");
+    if (ix >= 0) colunas[ix] = x;
+    if (iy >= 0) colunas[iy] = y;
+
+    if (!avaliarProgramaEmLote(&programa, colunas, NUM_LINHAS, saida)) {
+        printf("Lote: ERRO\n");
+        liberarPrograma(&programa);
+        return;
+    }
+
+    int divergencias = 0;
+    for (int i = 0; i < NUM_LINHAS; i++) {
+        float valores[2];
+        if (ix >= 0) valores[ix] = x[i];
+        if (iy >= 0) valores[iy] = y[i];
+        float esperado = avaliarProgramaComVariaveis(&programa, valores);
+        divergencias += !mesmo_float(esperado, saida[i]);
+    }
+    if (divergencias == 0) {
+        printf("Lote: OK. %d linhas identicas a avaliacao individual\n", NUM_LINHAS);
+    } else {
+        printf("Lote: FALHA. %d de %d linhas divergentes\n", divergencias, NUM_LINHAS);
+    }
+    liberarPrograma(&programa);
+}
+
+// Processa um arquivo com os casos de teste usando várias threads e confere a ordem da saída
+void executar_teste_arquivo(CasoTeste *testes, size_t num_testes) {
+    const char *entrada = "teste_lote_entrada.txt";
+    const char *saida = "teste_lote_saida.txt";
+    enum { REPETICOES = 2000 };
+
+    printf("\n--- Teste Arquivo em Lote ---\n");
+    FILE *arquivo = fopen(entrada, "w");
+    if (arquivo == NULL) {
+        printf("Arquivo: ERRO (nao foi possivel criar %s)\n", entrada);
+        return;
+    }
+    for (int r = 0; r < REPETICOES; r++) {
+        for (size_t i = 0; i < num_testes; i++) {
+            fprintf(arquivo, "%s\n", testes[i].posFixa);
+        }
+    }
+    fclose(arquivo);
+
+    long linhas = processarArquivoExpressoes(entrada, saida, 4);
+    int divergencias = 0;
+    arquivo = fopen(saida, "r");
+    if (linhas != (long)(REPETICOES * num_testes) || arquivo == NULL) {
+        divergencias = 1;
+    } else {
+        char linha[1200];
+        for (long k = 0; k < linhas && fgets(linha, sizeof(linha), arquivo) != NULL; k++) {
+            CasoTeste *teste = &testes[k % num_testes];
+            char *infixa = getFormaInFixa(teste->posFixa);
+            char esperada[1200];
+            float valor = getValorPosFixa(teste->posFixa);
+            if (isnan(valor)) {
+                snprintf(esperada, sizeof(esperada), "ERRO\t%s\n", infixa != NULL ? infixa : "ERRO");
+            } else {
+                snprintf(esperada, sizeof(esperada), "%.9g\t%s\n", valor, infixa != NULL ? infixa : "ERRO");
+            }
+            divergencias += (strcmp(linha, esperada) != 0);
+            free(infixa);
+        }
+    }
+    if (arquivo != NULL) {
+        fclose(arquivo);
+    }
+    remove(entrada);
+    remove(saida);
+
+    if (divergencias == 0) {
+        printf("Arquivo: OK. %ld linhas na ordem da entrada\n", linhas);
+    } else {
+        printf("Arquivo: FALHA. %d linhas divergentes (%ld processadas)\n", divergencias, linhas);
+    }
+}
+
+// Converte uma expressão pós-fixa muito longa (muito além dos 512 caracteres de Expressao)
+void executar_teste_expressao_longa(void) {
+    enum { NUM_SOMAS = 100000 };
+    printf("\n--- Teste Expressao Longa (%d operadores) ---\n", NUM_SOMAS);
+
+    // "1 1 + 1 + 1 + ..." -> "1+1+1+..."
+    char *posFixa = (char *)malloc(4 * NUM_SOMAS + 2);
+    if (posFixa == NULL) {
+        printf("Conversao: ERRO (memoria)\n");
+        return;
+    }
+    strcpy(posFixa, "1");
+    char *fim = posFixa + 1;
+    for (int i = 0; i < NUM_SOMAS; i++) {
+        memcpy(fim, " 1 +", 4);
+        fim += 4;
+    }
+    *fim = '\0';
+
+    char *infixa = getFormaInFixa(posFixa);
+    size_t esperado = 2 * NUM_SOMAS + 1;
+    if (infixa != NULL && strlen(infixa) == esperado && strchr(infixa, '(') == NULL) {
+        printf("Conversao: OK. %zu caracteres, sem parenteses\n", strlen(infixa));
+    } else {
+        printf("Conversao: FALHA. Esperados %zu caracteres sem parenteses\n", esperado);
+    }
+    free(infixa);
+    free(posFixa);
+}
+
+// Programa com mais constantes do que cabem no argumento de 24 bits: a compilação
+// (pós-fixa e infixa) falha em vez de reaproveitar índices de constantes
+void executar_teste_programa_grande(void) {
+    enum { NUM_SOMAS = MAX_ARGUMENTO_INSTRUCAO + 10 };
+    printf("\n--- Teste Programa Grande (%d constantes) ---\n", NUM_SOMAS + 1);
+
+    // "1e30 0 + 0 + ..." e "1e30+0+0..."
+    char *texto = (char *)malloc(4 * (size_t)NUM_SOMAS + 8);
+    if (texto == NULL) {
+        printf("Compilacao: ERRO (memoria)\n");
+        return;
+    }
+    strcpy(texto, "1e30");
+    char *fim = texto + 4;
+    for (int i = 0; i < NUM_SOMAS; i++) {
+        memcpy(fim, " 0 +", 4);
+        fim += 4;
+    }
+    *fim = '\0';
+    ProgramaPosFixa programa;
+    int ok = !compilarPosFixa(texto, &programa) && programa.num_instrucoes == 0;
+
+    fim = texto + 4;
+    for (int i = 0; i < NUM_SOMAS; i++) {
+        memcpy(fim, "+0", 2);
+        fim += 2;
+    }
+    *fim = '\0';
+    ok = ok && !compilarInFixa(texto, &programa) && programa.num_instrucoes == 0;
+    printf("Compilacao recusada: %s\n", ok ? "OK" : "FALHA");
+    free(texto);
+}
+
+// Converte a infixa para pós-fixa e compila a infixa diretamente, comparando com o esperado
+void executar_teste_infixa(int id, const char *inFixa, const char *posfixa_esperada, float valor_esperado) {
+    printf("\n--- Teste Infixa %d ---\n", id);
+    printf("In-Fixa: %s\n", inFixa);
+
+    char *posFixa = getFormaPosFixa(inFixa);
+    if (posFixa == NULL || posfixa_esperada == NULL) {
+        printf("Conversao: %s\n", (posFixa == NULL && posfixa_esperada == NULL) ? "OK (Expressao Invalida)" : "FALHA");
+        free(posFixa);
+        return;
+    }
+    printf("Conversao: %s. Pos-Fixa Calculada: %s (Esperada: %s)\n",
+           strcmp(posFixa, posfixa_esperada) == 0 ? "OK" : "FALHA", posFixa, posfixa_esperada);
+    free(posFixa);
+
+    ProgramaPosFixa programa;
+    if (!compilarInFixa(inFixa, &programa)) {
+        printf("Compilacao: FALHA\n");
+        return;
+    }
+    float valor = avaliarPrograma(&programa);
+    if (isnan(valor) && isnan(valor_esperado)) {
+        printf("Avaliacao: OK (Erro esperado)\n");
+    } else if (fabs(valor - valor_esperado) < 0.0001) {
+        printf("Avaliacao: OK. Valor Calculado: %.4f\n", valor);
+    } else {
+        printf("Avaliacao: FALHA. Valor Calculado: %.10f (Esperado: %.10f)\n", valor, valor_esperado);
+    }
+    liberarPrograma(&programa);
+}
+
+// Contexto do teste de cache com várias threads
+typedef struct {
+    CacheExpressoes *cache;
+    CasoTeste *testes;
+    size_t num_testes;
+    int divergencias; // Atualizado atomicamente
+} ContextoTesteCache;
+
+// Compara o resultado com e sem cache (o valor deve ser idêntico, inclusive NAN)
+int resultado_cache_confere(CacheExpressoes *cache, CasoTeste *teste) {
+    float valor = getValorPosFixaCache(cache, teste->posFixa);
+    float esperado = getValorPosFixa(teste->posFixa);
+    char *infixa = getFormaInFixaCache(cache, teste->posFixa);
+    char *infixa_esperada = getFormaInFixa(teste->posFixa);
+    int confere = (isnan(valor) ? isnan(esperado) : memcmp(&valor, &esperado, sizeof(float)) == 0) &&
+                  ((infixa == NULL && infixa_esperada == NULL) ||
+                   (infixa != NULL && infixa_esperada != NULL && strcmp(infixa, infixa_esperada) == 0));
+    free(infixa);
+    free(infixa_esperada);
+    return confere;
+}
+
+void tarefa_teste_cache(void *contexto, size_t indice, int trabalhador) {
+    ContextoTesteCache *ctx = (ContextoTesteCache *)contexto;
+    (void)trabalhador;
+    if (!resultado_cache_confere(ctx->cache, &ctx->testes[indice % ctx->num_testes])) {
+        __atomic_fetch_add(&ctx->divergencias, 1, __ATOMIC_RELAXED);
+    }
+}
+
+// Consulta o cache duas vezes por expressão (falta e acerto) e depois com várias threads
+void executar_teste_cache(CasoTeste *testes, size_t num_testes) {
+    printf("\n--- Teste Cache ---\n");
+    CacheExpressoes *cache = criarCacheExpressoes(256, 3);
+    if (cache == NULL) {
+        printf("Cache: ERRO (criacao)\n");
+        return;
+    }
+
+    int divergencias = 0;
+    for (int passada = 0; passada < 2; passada++) {
+        for (size_t i = 0; i < num_testes; i++) {
+            divergencias += !resultado_cache_confere(cache, &testes[i]);
+        }
+    }
+    // "45 60 +" entra no cache na segunda vez em que aparece e é reaproveitado na terceira
+    EstatisticasCache estatisticas;
+    obterEstatisticasCache(cache, &estatisticas);
+    unsigned long long subexpressoes_antes = estatisticas.acertos_subarvores;
+    float subexpressao = getValorPosFixaCache(cache, "45 60 + 2 *") + getValorPosFixaCache(cache, "45 60 + 3 *") +
+                         getValorPosFixaCache(cache, "45   60\t+ 4 *");
+    obterEstatisticasCache(cache, &estatisticas);
+    printf("Cache: %s. %d divergencias, %llu acertos, %llu faltas, %llu subexpressoes reaproveitadas\n",
+           (divergencias == 0 && estatisticas.acertos >= num_testes && subexpressao == 945.0f &&
+            estatisticas.acertos_subarvores > subexpressoes_antes) ? "OK" : "FALHA",
+           divergencias, estatisticas.acertos, estatisticas.faltas, estatisticas.acertos_subarvores);
+    destruirCacheExpressoes(cache);
+
+    // Cache pequeno (descartes frequentes) disputado por várias threads
+    ContextoTesteCache ctx = {criarCacheExpressoes(16, 3), testes, num_testes, 0};
+    PoolTrabalho *pool = criarPoolTrabalho(4);
+    if (ctx.cache == NULL || pool == NULL) {
+        printf("Cache concorrente: ERRO (criacao)\n");
+    } else {
+        executarNoPool(pool, 20000, tarefa_teste_cache, &ctx);
+        obterEstatisticasCache(ctx.cache, &estatisticas);
+        printf("Cache concorrente: %s. %d divergencias, %llu remocoes, %zu/%zu entradas\n",
+               (ctx.divergencias == 0 && estatisticas.entradas <= estatisticas.capacidade) ? "OK" : "FALHA",
+               ctx.divergencias, estatisticas.remocoes, estatisticas.entradas, estatisticas.capacidade);
+    }
+    destruirPoolTrabalho(pool);
+    destruirCacheExpressoes(ctx.cache);
+}
+
+// Confere o código e a posição informados pelas variantes sem E/S e os contadores de erro
+void executar_teste_erros(void) {
+    struct {
+        const char *posFixa;
+        CodigoErro codigo;
+        long posicao;
+        int erro_na_conversao; // 1 se getFormaInFixaComErro também falha
+    } casos[] = {
+        {"3 4 +", ERRO_NENHUM, -1, 0},
+        {"5 0 /", ERRO_DIVISAO_POR_ZERO, 4, 0},
+        {"10 0 %", ERRO_MODULO_POR_ZERO, 5, 0},
+        {"-4 raiz", ERRO_RAIZ_NEGATIVA, 3, 0},
+        {"0 log", ERRO_LOGARITMO_NAO_POSITIVO, 2, 0},
+        {"-8 0.5 ^", ERRO_RESULTADO_INVALIDO, 7, 0},
+        {"1 x +", ERRO_TOKEN_INVALIDO, 2, 1},
+        {"+ 5 3", ERRO_OPERADOR_SEM_OPERANDOS, 0, 1},
+        {"5 +", ERRO_OPERADOR_UM_OPERANDO, 2, 1},
+        {"sen", ERRO_FUNCAO_SEM_OPERANDO, 0, 1},
+        {"5 3 + 2", ERRO_OPERANDOS_RESTANTES, -1, 1},
+        {" \t ", ERRO_EXPRESSAO_VAZIA, -1, 1}
+    };
+    size_t num_casos = sizeof(casos) / sizeof(casos[0]);
+    unsigned long long antes[NUM_CODIGOS_ERRO], depois[NUM_CODIGOS_ERRO];
+    unsigned long long esperados[NUM_CODIGOS_ERRO] = {0};
+
+    printf("\n--- Teste Erros sem E/S ---\n");
+    obterContadoresErro(antes);
+    for (size_t i = 0; i < num_casos; i++) {
+        ErroExpressao erro, erro_conversao;
+        float valor = getValorPosFixaComErro(casos[i].posFixa, &erro);
+        char *infixa = getFormaInFixaComErro(casos[i].posFixa, &erro_conversao);
+        int ok = erro.codigo == casos[i].codigo && erro.posicao == casos[i].posicao &&
+                 isnan(valor) == (casos[i].codigo != ERRO_NENHUM) &&
+                 (infixa == NULL) == casos[i].erro_na_conversao &&
+                 (casos[i].erro_na_conversao ? erro_conversao.codigo == casos[i].codigo
+                                             : erro_conversao.codigo == ERRO_NENHUM);
+        printf("\"%s\": %s. %s na posicao %ld\n", casos[i].posFixa, ok ? "OK" : "FALHA",
+               nomeCodigoErro(erro.codigo), erro.posicao);
+        esperados[casos[i].codigo] += 1 + casos[i].erro_na_conversao;
+        free(infixa);
+    }
+    obterContadoresErro(depois);
+
+    int contadores_ok = 1;
+    for (int c = 1; c < NUM_CODIGOS_ERRO; c++) {
+        contadores_ok &= (depois[c] - antes[c] == esperados[c]);
+    }
+    printf("Contadores de erro: %s\n", contadores_ok ? "OK" : "FALHA");
+}
+
+// Confere os avaliadores float, double e long double contra os valores esperados e
+// contra os códigos de erro de getValorPosFixaComErro
+void executar_teste_precisao(CasoTeste *testes, size_t num_testes) {
+    printf("\n--- Teste Precisao ---\n");
+    int falhas = 0;
+    for (size_t i = 0; i < num_testes; i++) {
+        ErroExpressao referencia, erro_f, erro_d, erro_ld;
+        float v = getValorPosFixaComErro(testes[i].posFixa, &referencia);
+        float vf = getValorPosFixaFloat(testes[i].posFixa, &erro_f);
+        double vd = getValorPosFixaDouble(testes[i].posFixa, &erro_d);
+        long double vld = getValorPosFixaLongDouble(testes[i].posFixa, &erro_ld);
+        int ok = erro_f.codigo == referencia.codigo && erro_f.posicao == referencia.posicao &&
+                 erro_d.codigo == referencia.codigo && erro_d.posicao == referencia.posicao &&
+                 erro_ld.codigo == referencia.codigo && erro_ld.posicao == referencia.posicao;
+        if (ok && !isnan(v)) {
+            ok = fabs(vf - testes[i].valor_esperado) < testes[i].tolerancia &&
+                 fabs(vd - testes[i].valor_esperado) < testes[i].tolerancia &&
+                 fabsl(vld - testes[i].valor_esperado) < testes[i].tolerancia;
+        }
+        if (!ok) {
+            printf("\"%s\": FALHA (%.9g %.17g %.21Lg, %s)\n", testes[i].posFixa, vf, vd, vld,
+                   nomeCodigoErro(erro_d.codigo));
+            falhas++;
+        }
+    }
+    printf("Casos em float, double e long double: %s (%d falhas)\n", falhas == 0 ? "OK" : "FALHA", falhas);
+}
+
+// Diferenças entre os tipos que só a precisão maior resolve
+void executar_teste_precisao_tipos(void) {
+    ErroExpressao erro;
+    int ok = getValorPosFixaFloat("16777217 1 +", &erro) == 16777216.0f &&
+             getValorPosFixaDouble("16777217 1 +", &erro) == 16777218.0 &&
+             getValorPosFixaDouble("0.1 0.2 +", &erro) == 0.1 + 0.2 &&
+             getValorPosFixaDouble("1e300 1e-300 *", &erro) == 1e300 * 1e-300 &&
+             getValorPosFixaLongDouble("1 3 /", &erro) == 1.0L / 3.0L &&
+             getValorPosFixaLongDouble("123456789012345678 1 +", &erro) == 123456789012345679.0L;
+    printf("Precisao por tipo: %s\n", ok ? "OK" : "FALHA");
+}
+
+// Casos de teste no modo rápido (por chamada e por programa compilado)
+void executar_teste_modo_rapido(CasoTeste *testes, size_t num_testes) {
+    printf("\n--- Teste Modo Rapido ---\n");
+    int falhas = 0;
+    for (size_t i = 0; i < num_testes; i++) {
+        ErroExpressao exato, rapido;
+        float v = getValorPosFixaComErro(testes[i].posFixa, &exato);
+        float r = getValorPosFixaComModo(testes[i].posFixa, CALCULO_RAPIDO, &rapido);
+        int ok = rapido.codigo == exato.codigo && rapido.posicao == exato.posicao &&
+                 (isnan(v) || fabs(r - testes[i].valor_esperado) < testes[i].tolerancia);
+
+        ProgramaPosFixa programa;
+        if (ok && !isnan(v) && compilarPosFixa(testes[i].posFixa, &programa)) {
+            programa.modo = CALCULO_RAPIDO;
+            ok = fabs(avaliarPrograma(&programa) - testes[i].valor_esperado) < testes[i].tolerancia;
+            liberarPrograma(&programa);
+        }
+        if (!ok) {
+            printf("\"%s\": FALHA (%.9g, %s)\n", testes[i].posFixa, r, nomeCodigoErro(rapido.codigo));
+            falhas++;
+        }
+    }
+    printf("Casos no modo rapido: %s (%d falhas)\n", falhas == 0 ? "OK" : "FALHA", falhas);
+}
+
+// Casos de teste pelo código nativo (ativarJit) contra o interpretador, nos dois modos
+void executar_teste_jit(CasoTeste *testes, size_t num_testes) {
+    printf("\n--- Teste JIT ---\n");
+    int falhas = 0;
+    for (size_t i = 0; i < num_testes; i++) {
+        for (int modo = CALCULO_EXATO; modo <= CALCULO_RAPIDO; modo++) {
+            ProgramaPosFixa interpretado, nativo;
+            if (!compilarPosFixa(testes[i].posFixa, &interpretado)) {
+                continue;
+            }
+            compilarPosFixa(testes[i].posFixa, &nativo);
+            interpretado.modo = nativo.modo = (ModoCalculo)modo;
+            int gerado = ativarJit(&nativo);
+            float v = avaliarPrograma(&interpretado);
+            float n = avaliarPrograma(&nativo);
+            if (gerado != jitDisponivel() || !mesmo_float(v, n)) {
+                printf("\"%s\": FALHA (%.9g, nativo %.9g)\n", testes[i].posFixa, v, n);
+                falhas++;
+            }
+            liberarPrograma(&interpretado);
+            liberarPrograma(&nativo);
+        }
+    }
+    printf("Casos pelo JIT: %s (%d falhas)\n", falhas == 0 ? "OK" : "FALHA", falhas);
+}
+
+// Código nativo com variáveis, chamadas com a pilha cheia (14 posições), queda para o
+// interpretador (15 posições), troca de modo e JIT desligado
+void executar_teste_jit_variaveis(void) {
+    const char *expressoes[] = {
+        "x y + 2 *",
+        "x y / x y - *",
+        "x y % x 3 ^ +",
+        "x raiz y log + x sen x cos * + x tg -",
+        "x y 2 x 3 y 4 x 5 y 6 x 7 y log % ^ + sen * - / cos + tg * + - % * +",
+        "1 x y 2 x 3 y 4 x 5 y 6 x 7 y log % ^ + sen * - / cos + tg * + - % * + +"
+    };
+    const float valores_x[] = {-50.0f, -1.5f, 0.0f, -0.0f, 0.5f, 2.0f, 45.0f, 90.0f, 1e30f, INFINITY, NAN};
+    const float valores_y[] = {0.0f, 1.0f, 3.0f, -2.0f, 7.5f, NAN};
+    size_t num_x = sizeof(valores_x) / sizeof(valores_x[0]);
+    size_t num_y = sizeof(valores_y) / sizeof(valores_y[0]);
+
+    printf("\n--- Teste JIT com Variaveis (%s) ---\n", jitDisponivel() ? "disponivel" : "indisponivel");
+    for (size_t e = 0; e < sizeof(expressoes) / sizeof(expressoes[0]); e++) {
+        ProgramaPosFixa interpretado, nativo;
+        if (!compilarPosFixa(expressoes[e], &interpretado) || !compilarPosFixa(expressoes[e], &nativo)) {
+            printf("%s: ERRO (compilacao)\n", expressoes[e]);
+            continue;
+        }
+        int esperado = jitDisponivel() && nativo.profundidade_maxima <= 14;
+        int ok = ativarJit(&nativo) == esperado;
+        for (int modo = CALCULO_EXATO; ok && modo <= CALCULO_RAPIDO; modo++) {
+            interpretado.modo = nativo.modo = (ModoCalculo)modo;
+            // Trocar o modo invalida o código gerado até a próxima ativação
+            ok = ativarJit(&nativo) == esperado;
+            int ix = obterIndiceVariavel(&nativo, "x");
+            int iy = obterIndiceVariavel(&nativo, "y");
+            for (size_t i = 0; ok && i < num_x * num_y; i++) {
+                float valores[2];
+                valores[ix] = valores_x[i % num_x];
+                if (iy >= 0) valores[iy] = valores_y[i / num_x];
+                ok = mesmo_float(avaliarProgramaComVariaveis(&interpretado, valores),
+                                 avaliarProgramaComVariaveis(&nativo, valores));
+            }
+        }
+        printf("%s: %s\n", expressoes[e], ok ? "OK" : "FALHA");
+        liberarPrograma(&interpretado);
+        liberarPrograma(&nativo);
+    }
+
+    // Desligado, ativarJit não gera código e programas já ativados voltam ao interpretador
+    ProgramaPosFixa programa;
+    int ok = compilarPosFixa("x 2 ^ 1 +", &programa);
+    int gerado = ok && ativarJit(&programa);
+    float x = 3.0f;
+    definirJitHabilitado(0);
+    ok = ok && avaliarProgramaComVariaveis(&programa, &x) == 10.0f;
+    liberarPrograma(&programa);
+    ok = ok && compilarPosFixa("x 2 ^ 1 +", &programa) && !ativarJit(&programa) &&
+         avaliarProgramaComVariaveis(&programa, &x) == 10.0f;
+    definirJitHabilitado(1);
+    ok = ok && ativarJit(&programa) == jitDisponivel() && gerado == jitDisponivel() &&
+         avaliarProgramaComVariaveis(&programa, &x) == 10.0f;
+    liberarPrograma(&programa);
+    printf("JIT desligado e religado: %s\n", ok ? "OK" : "FALHA");
+}
+
+// Anexa a 'texto' a forma pós-fixa de uma árvore balanceada sobre as variáveis x<inicio>..x<fim - 1>
+void gerar_arvore_balanceada(char *texto, int inicio, int fim) {
+    static const char *operadores[] = {"+", "*", "-", "/", "+", "^"};
+    if (fim - inicio == 1) {
+        sprintf(texto + strlen(texto), "x%d ", inicio);
+        return;
+    }
+    int meio = (inicio + fim) / 2;
+    gerar_arvore_balanceada(texto, inicio, meio);
+    gerar_arvore_balanceada(texto, meio, fim);
+    strcat(texto, operadores[(inicio + fim) % 6]);
+    strcat(texto, (fim - inicio) % 8 == 0 ? " sen " : " ");
+}
+
+// Avaliação incremental contra a avaliação completa após atualizações isoladas e em lote
+void executar_teste_incremental(void) {
+    enum { NUM_ENTRADAS = 64 };
+    static char texto[4096];
+    float entradas[NUM_ENTRADAS];
+    texto[0] = '\0';
+    gerar_arvore_balanceada(texto, 0, NUM_ENTRADAS);
+    for (int i = 0; i < NUM_ENTRADAS; i++) {
+        entradas[i] = (float)(i % 5) + 0.5f;
+    }
+
+    printf("\n--- Teste Avaliacao Incremental ---\n");
+    ProgramaPosFixa programa;
+    AvaliacaoIncremental *avaliacao = criarAvaliacaoIncremental(texto, entradas);
+    if (avaliacao == NULL || !compilarPosFixa(texto, &programa)) {
+        printf("Criacao: FALHA\n");
+        destruirAvaliacaoIncremental(avaliacao);
+        return;
+    }
+    // As entradas do programa seguem a mesma ordem (primeira ocorrência)
+    int ok = indiceEntradaIncremental(avaliacao, "x7") == obterIndiceVariavel(&programa, "x7") &&
+             mesmo_float(valorAvaliacaoIncremental(avaliacao), avaliarProgramaComVariaveis(&programa, entradas));
+
+    // Atualizações isoladas: recalcula no máximo o caminho até a raiz (6 operadores e 4 funções)
+    unsigned int semente = 12345;
+    int recalculados_maximo = 0;
+    for (int k = 0; ok && k < 500; k++) {
+        semente = semente * 1103515245u + 12345u;
+        int indice = (int)((semente >> 16) % NUM_ENTRADAS);
+        float valor = (float)((semente >> 8) % 9) - 4.0f; // Inclui zeros (divisão por zero)
+        float v = atualizarEntradaIncremental(avaliacao, indice, valor);
+        entradas[indice] = valor;
+        ok = mesmo_float(v, avaliarProgramaComVariaveis(&programa, entradas));
+        if (nosRecalculadosIncremental(avaliacao) > recalculados_maximo) {
+            recalculados_maximo = nosRecalculadosIncremental(avaliacao);
+        }
+    }
+    ok = ok && recalculados_maximo <= 10;
+    printf("Atualizacoes isoladas: %s (no maximo %d nos recalculados)\n", ok ? "OK" : "FALHA", recalculados_maximo);
+
+    // Lotes com índices repetidos e inválidos; ancestrais comuns recalculados uma vez
+    int lote_ok = 1;
+    for (int k = 0; lote_ok && k < 100; k++) {
+        int indices[16];
+        float valores[16];
+        for (int j = 0; j < 16; j++) {
+            semente = semente * 1103515245u + 12345u;
+            indices[j] = (j == 15) ? NUM_ENTRADAS : (int)((semente >> 16) % NUM_ENTRADAS);
+            valores[j] = (float)((semente >> 8) % 9) - 4.0f;
+            if (j < 15) {
+                entradas[indices[j]] = valores[j];
+            }
+        }
+        float v = atualizarEntradasIncremental(avaliacao, indices, valores, 16);
+        lote_ok = mesmo_float(v, avaliarProgramaComVariaveis(&programa, entradas)) &&
+                  nosRecalculadosIncremental(avaliacao) <= programa.num_instrucoes - NUM_ENTRADAS;
+    }
+    int todas[NUM_ENTRADAS];
+    float valores[NUM_ENTRADAS];
+    for (int i = 0; i < NUM_ENTRADAS; i++) {
+        todas[i] = i;
+        valores[i] = entradas[i] = 1.0f + (float)i / 64.0f;
+    }
+    lote_ok = lote_ok && mesmo_float(atualizarEntradasIncremental(avaliacao, todas, valores, NUM_ENTRADAS),
+                                     avaliarProgramaComVariaveis(&programa, entradas)) &&
+              nosRecalculadosIncremental(avaliacao) == programa.num_instrucoes - NUM_ENTRADAS;
+    printf("Atualizacoes em lote: %s\n", lote_ok ? "OK" : "FALHA");
+    destruirAvaliacaoIncremental(avaliacao);
+    liberarPrograma(&programa);
+
+    // Variável repetida, erro e recuperação, entrada sem efeito e expressões inválidas
+    float x = 2.0f;
+    avaliacao = criarAvaliacaoIncremental("x x * 1 x - /", &x);
+    ok = avaliacao != NULL && valorAvaliacaoIncremental(avaliacao) == -4.0f &&
+         isnan(atualizarEntradaIncremental(avaliacao, 0, 1.0f)) &&
+         atualizarEntradaIncremental(avaliacao, 0, 3.0f) == -4.5f &&
+         atualizarEntradaIncremental(avaliacao, 0, 3.0f) == -4.5f && nosRecalculadosIncremental(avaliacao) == 0 &&
+         criarAvaliacaoIncremental("x +", &x) == NULL && criarAvaliacaoIncremental("x 1 +", NULL) == NULL;
+    printf("Variavel repetida, erro e entradas invalidas: %s\n", ok ? "OK" : "FALHA");
+    destruirAvaliacaoIncremental(avaliacao);
+}
+
+// Fonte de teste para as funções de fluxo: entrega o texto em pedaços de tamanho fixo
+typedef struct {
+    const char *texto;
+    size_t posicao;
+    size_t tamanho_pedaco;
+    int falhar; // Devolve erro depois do primeiro pedaço
+} FonteTeste;
+
+long ler_fonte_teste(void *contexto, char *destino, size_t tamanho) {
+    FonteTeste *fonte = (FonteTeste *)contexto;
+    if (fonte->falhar && fonte->posicao > 0) {
+        return -1;
+    }
+    size_t restante = strlen(fonte->texto + fonte->posicao);
+    size_t n = restante < tamanho ? restante : tamanho;
+    n = n < fonte->tamanho_pedaco ? n : fonte->tamanho_pedaco;
+    memcpy(destino, fonte->texto + fonte->posicao, n);
+    fonte->posicao += n;
+    return (long)n;
+}
+
+// Avaliação e forma infixa em fluxo (pedaços de 1 a 7 bytes) contra as funções de string
+void executar_teste_fluxo_casos(CasoTeste *testes, size_t num_testes) {
+    printf("\n--- Teste Fluxo ---\n");
+    int falhas = 0;
+    for (size_t i = 0; i < num_testes; i++) {
+        for (size_t pedaco = 1; pedaco <= 7; pedaco += 3) {
+            ErroExpressao esperado, obtido;
+            FonteTeste fonte = {testes[i].posFixa, 0, pedaco, 0};
+            float v = getValorPosFixaComErro(testes[i].posFixa, &esperado);
+            float f = avaliarPosFixaStream(ler_fonte_teste, &fonte, &obtido);
+            int ok = mesmo_float(v, f) && esperado.codigo == obtido.codigo && esperado.posicao == obtido.posicao;
+
+            char *infixa = getFormaInFixaComErro(testes[i].posFixa, &esperado);
+            char *texto = NULL;
+            size_t tamanho = 0;
+            FILE *saida = open_memstream(&texto, &tamanho);
+            fonte.posicao = 0;
+            int escrita = saida != NULL && escreverInFixaStream(ler_fonte_teste, &fonte, saida, &obtido);
+            if (saida != NULL) {
+                fclose(saida);
+            }
+            ok = ok && escrita == (infixa != NULL) && esperado.codigo == obtido.codigo &&
+                 esperado.posicao == obtido.posicao && (infixa == NULL || strcmp(infixa, texto) == 0);
+            if (!ok) {
+                printf("\"%s\" (pedacos de %zu): FALHA (%.9g, %s)\n", testes[i].posFixa, pedaco, f,
+                       nomeCodigoErro(obtido.codigo));
+                falhas++;
+            }
+            free(infixa);
+            free(texto);
+        }
+    }
+    printf("Casos em fluxo: %s (%d falhas)\n", falhas == 0 ? "OK" : "FALHA", falhas);
+}
+
+// Entradas maiores que o buffer, token maior que o buffer, FILE*, descritor e erro de leitura
+void executar_teste_fluxo(void) {
+    enum { NUM_SOMAS = 100000, TAMANHO_NUMERO = 70000 };
+    // "1 1 + 1 + ... 1 +" com 400 KB, bem maior que o buffer de 64 KiB
+    char *texto = (char *)malloc(4 * NUM_SOMAS + 2);
+    char *numero = (char *)malloc(TAMANHO_NUMERO + 4);
+    if (texto == NULL || numero == NULL) {
+        printf("Fluxo: ERRO (memoria)\n");
+        free(texto);
+        free(numero);
+        return;
+    }
+    strcpy(texto, "1");
+    for (int i = 0; i < NUM_SOMAS; i++) {
+        memcpy(texto + 1 + 4 * i, " 1 +", 5);
+    }
+
+    ErroExpressao erro;
+    FonteTeste fonte = {texto, 0, 4093, 0};
+    int ok = avaliarPosFixaStream(ler_fonte_teste, &fonte, &erro) == (float)(NUM_SOMAS + 1) && erro.codigo == ERRO_NENHUM;
+    printf("Entrada de %zu bytes: %s\n", strlen(texto), ok ? "OK" : "FALHA");
+
+    // Token maior que o buffer: inválido, na posição em que começa
+    memcpy(numero, "2 ", 2);
+    memset(numero + 2, '7', TAMANHO_NUMERO);
+    numero[TAMANHO_NUMERO + 2] = '\0';
+    fonte = (FonteTeste){numero, 0, 100000, 0};
+    ok = isnan(avaliarPosFixaStream(ler_fonte_teste, &fonte, &erro)) && erro.codigo == ERRO_TOKEN_INVALIDO &&
+         erro.posicao == 2;
+    fonte = (FonteTeste){"3 4 + 5 *", 0, 3, 1};
+    ok = ok && isnan(avaliarPosFixaStream(ler_fonte_teste, &fonte, &erro)) && erro.codigo == ERRO_ENTRADA_SAIDA;
+    printf("Token longo e erro de leitura: %s\n", ok ? "OK" : "FALHA");
+
+    // FILE* e descritor sobre o mesmo arquivo temporário
+    FILE *arquivo = tmpfile();
+    ok = arquivo != NULL && fputs("3 4 -5 * +\n", arquivo) >= 0 && fflush(arquivo) == 0;
+    if (ok) {
+        rewind(arquivo);
+        ok = avaliarPosFixaArquivo(arquivo, &erro) == -17.0f;
+        ok = ok && lseek(fileno(arquivo), 0, SEEK_SET) == 0 &&
+             avaliarPosFixaDescritor(fileno(arquivo), &erro) == -17.0f;
+        char *infixa = NULL;
+        size_t tamanho = 0;
+        FILE *saida = open_memstream(&infixa, &tamanho);
+        rewind(arquivo);
+        ok = ok && saida != NULL && escreverInFixaArquivo(arquivo, saida, &erro);
+        if (saida != NULL) {
+            fclose(saida);
+        }
+        ok = ok && strcmp(infixa, "3+4*(-5)") == 0;
+        free(infixa);
+    }
+    if (arquivo != NULL) {
+        fclose(arquivo);
+    }
+    printf("FILE* e descritor: %s\n", ok ? "OK" : "FALHA");
+    free(texto);
+    free(numero);
+}
+
+// Caminho inteiro de getValorPosFixa: exato acima de 2^24 (também pelo cache),
+// volta ao float em transbordamento e divisão não exata, e idêntico bit a bit ao
+// cálculo em float (programa compilado) enquanto os inteiros couberem em um float
+void executar_teste_inteiros(void) {
+    struct {
+        const char *posFixa;
+        float esperado;
+    } casos[] = {
+        {"16777217 1 + 16777217 -", 1.0f},
+        {"16777217 16777215 -", 2.0f},
+        {"123456789 987654321 * 987654321 /", 123456789.0f},
+        {"3 39 ^ 3 38 ^ -", (float)(2.0 * 1350851717672992089.0)},
+        {"2 62 ^ 2 62 ^ +", 9223372036854775808.0f},
+        {"7 2 /", 3.5f},
+        {"2 -1 ^", 0.5f},
+        {"-7 3 %", -1.0f},
+        {"-6 3 %", -0.0f},
+        {"0 -3 *", -0.0f},
+        {"0 -5 /", -0.0f},
+        {"-0 5 *", -0.0f},
+        {"0 0 ^", 1.0f}
+    };
+    printf("\n--- Teste Inteiros Exatos ---\n");
+    CacheExpressoes *cache = criarCacheExpressoes(64, 3);
+    int falhas = 0;
+    for (size_t i = 0; i < sizeof(casos) / sizeof(casos[0]); i++) {
+        ErroExpressao erro;
+        float v = getValorPosFixaComErro(casos[i].posFixa, &erro);
+        FonteTeste fonte = {casos[i].posFixa, 0, 3, 0};
+        float f = avaliarPosFixaStream(ler_fonte_teste, &fonte, &erro);
+        float falta = getValorPosFixaCache(cache, casos[i].posFixa);
+        float acerto = getValorPosFixaCache(cache, casos[i].posFixa);
+        if (!mesmo_float(v, casos[i].esperado) || !mesmo_float(f, v) || !mesmo_float(falta, v) ||
+            !mesmo_float(acerto, v)) {
+            printf("\"%s\": FALHA (%.9g, fluxo %.9g, cache %.9g/%.9g, esperado %.9g)\n", casos[i].posFixa, v, f,
+                   falta, acerto, casos[i].esperado);
+            falhas++;
+        }
+    }
+    printf("Casos inteiros: %s (%d falhas)\n", falhas == 0 ? "OK" : "FALHA", falhas);
+
+    // Subárvore exata guardada no cache e reaproveitada; o programa compilado calcula em float
+    EstatisticasCache estatisticas;
+    float subarvores = getValorPosFixaCache(cache, "16777219 16777215 - 1 *") +
+                       getValorPosFixaCache(cache, "16777219 16777215 - 2 *") +
+                       getValorPosFixaCache(cache, "16777219 16777215 - 3 *");
+    obterEstatisticasCache(cache, &estatisticas);
+    ProgramaPosFixa programa;
+    float compilado = compilarPosFixa("16777217 16777215 -", &programa) ? avaliarPrograma(&programa) : NAN;
+    printf("Cache e programa compilado acima de 2^24: %s (subarvores %.9g, %llu reaproveitadas; compilado %.9g)\n",
+           (cache != NULL && subarvores == 24.0f && estatisticas.acertos_subarvores > 0 && compilado == 1.0f)
+               ? "OK" : "FALHA",
+           subarvores, estatisticas.acertos_subarvores, compilado);
+    liberarPrograma(&programa);
+    destruirCacheExpressoes(cache);
+
+    // Expressões sorteadas com 2 a 6 operandos em [-9, 9]: nunca passam de 2^24
+    static const char *operadores[] = {"+", "-", "*", "/", "%"};
+    unsigned int estado = 12345u;
+    int divergencias = 0;
+    for (int k = 0; k < 20000; k++) {
+        char texto[128];
+        size_t usado = 0;
+        int altura = 0;
+        estado ^= estado << 13; estado ^= estado >> 17; estado ^= estado << 5;
+        int restantes = 2 + (int)(estado % 5);
+        while (restantes > 0 || altura > 1) {
+            estado ^= estado << 13; estado ^= estado >> 17; estado ^= estado << 5;
+            if (restantes > 0 && (altura < 2 || estado % 2 == 0)) {
+                usado += snprintf(texto + usado, sizeof(texto) - usado, "%d ", (int)((estado >> 8) % 19) - 9);
+                restantes--;
+                altura++;
+            } else {
+                usado += snprintf(texto + usado, sizeof(texto) - usado, "%s ", operadores[(estado >> 8) % 5]);
+                altura--;
+            }
+        }
+        ErroExpressao erro;
+        ProgramaPosFixa programa;
+        float v = getValorPosFixaComErro(texto, &erro);
+        if (compilarPosFixa(texto, &programa)) {
+            divergencias += !mesmo_float(v, avaliarPrograma(&programa));
+            liberarPrograma(&programa);
+        }
+    }
+    const char *potencias[] = {"3 4 ^", "-2 3 ^", "-2 4 ^", "5 0 ^", "2 23 ^", "-1 99 ^", "0 7 ^", "10 6 ^ 7 %"};
+    for (size_t i = 0; i < sizeof(potencias) / sizeof(potencias[0]); i++) {
+        ErroExpressao erro;
+        ProgramaPosFixa programa;
+        if (compilarPosFixa(potencias[i], &programa)) {
+            divergencias += !mesmo_float(getValorPosFixaComErro(potencias[i], &erro), avaliarPrograma(&programa));
+            liberarPrograma(&programa);
+        }
+    }
+    printf("Inteiros x float bit a bit: %s (%d divergencias)\n", divergencias == 0 ? "OK" : "FALHA", divergencias);
+}
+
+// FNV-1a sobre palavras de 64 bits, como a soma de verificação da biblioteca
+unsigned long long soma_teste_biblioteca(const unsigned char *dados, size_t tamanho) {
+    unsigned long long h = 14695981039346656037ull;
+    for (size_t i = 0; i + 8 <= tamanho; i += 8) {
+        unsigned long long palavra;
+        memcpy(&palavra, dados + i, sizeof(palavra));
+        h = (h ^ palavra) * 1099511628211ull;
+    }
+    return h ^ (h >> 29);
+}
+
+// Troca o deslocamento e o número de instruções da entrada 0 de uma biblioteca
+// (cabeçalho de 64 bytes, entradas de 32 bytes), recalcula a soma de verificação
+// e tenta abrir o arquivo forjado; 1 se a abertura o recusou
+int recusa_biblioteca_forjada(const char *caminho, const unsigned char *original, size_t tamanho,
+                              unsigned long long deslocamento, unsigned int num_instrucoes) {
+    unsigned char *dados = (unsigned char *)malloc(tamanho);
+    if (dados == NULL || tamanho < 96) {
+        free(dados);
+        return 0;
+    }
+    memcpy(dados, original, tamanho);
+    memcpy(dados + 64, &deslocamento, sizeof(deslocamento));
+    memcpy(dados + 72, &num_instrucoes, sizeof(num_instrucoes));
+    unsigned long long soma = 0;
+    memcpy(dados + 48, &soma, sizeof(soma));
+    soma = soma_teste_biblioteca(dados, 64) ^ soma_teste_biblioteca(dados + 64, tamanho - 64) * 31;
+    memcpy(dados + 48, &soma, sizeof(soma));
+
+    FILE *arquivo = fopen(caminho, "wb");
+    int gravou = arquivo != NULL && fwrite(dados, 1, tamanho, arquivo) == tamanho;
+    if (arquivo != NULL) {
+        fclose(arquivo);
+    }
+    free(dados);
+    BibliotecaExpressoes *biblioteca = gravou ? abrirBibliotecaExpressoes(caminho) : NULL;
+    fecharBibliotecaExpressoes(biblioteca);
+    return gravou && biblioteca == NULL;
+}
+
+// Grava os casos em uma biblioteca binária, reabre e compara cada fórmula com a
+// avaliação do texto; arquivos corrompidos ou truncados devem ser recusados
+void executar_teste_biblioteca(CasoTeste *testes, size_t num_testes) {
+    const char *entrada = "teste_biblioteca.txt";
+    const char *caminho = "teste_biblioteca.bib";
+
+    FILE *arquivo = fopen(entrada, "w");
+    if (arquivo == NULL) {
+        printf("Biblioteca: ERRO (nao foi possivel criar %s)\n", entrada);
+        return;
+    }
+    // Uma fórmula por linha: casos com quebra de linha no texto ficam de fora
+    const char *linhas[64];
+    size_t num_linhas = 0;
+    for (size_t i = 0; i < num_testes && num_linhas < 64; i++) {
+        if (strchr(testes[i].posFixa, '\n') == NULL) {
+            linhas[num_linhas++] = testes[i].posFixa;
+            fprintf(arquivo, "%s\n", testes[i].posFixa);
+        }
+    }
+    fprintf(arquivo, "\r\nx y + raiz preco *\r\n");
+    fclose(arquivo);
+
+    long invalidas = 0;
+    long formulas = gravarBibliotecaExpressoes(entrada, caminho, &invalidas);
+    BibliotecaExpressoes *biblioteca = abrirBibliotecaExpressoes(caminho);
+    int falhas = 0;
+    if (formulas != (long)num_linhas + 2 || biblioteca == NULL || numeroFormulasBiblioteca(biblioteca) != (size_t)formulas) {
+        falhas++;
+    } else {
+        int esperadas_invalidas = 1; // A linha vazia
+        for (size_t i = 0; i < num_linhas; i++) {
+            ErroExpressao erro;
+            float esperado = getValorPosFixaComErro(linhas[i], &erro);
+            ProgramaPosFixa vista;
+            int valida = obterFormulaBiblioteca(biblioteca, i, &vista);
+            esperadas_invalidas += !valida;
+            // Só erros de sintaxe tornam a linha inválida; erros de cálculo dão NAN na avaliação
+            int sintaxe = erro.codigo >= ERRO_TOKEN_INVALIDO;
+            if (valida == sintaxe || !mesmo_float(avaliarFormulaBiblioteca(biblioteca, i, NULL), esperado)) {
+                printf("  Formula %zu (\"%s\"): FALHA\n", i, linhas[i]);
+                falhas++;
+            }
+        }
+        float valores[3] = {7.0f, 9.0f, 2.5f};
+        int preco = indiceVariavelBiblioteca(biblioteca, num_linhas + 1, "preco");
+        falhas += (invalidas != esperadas_invalidas || isfinite(avaliarFormulaBiblioteca(biblioteca, num_linhas, NULL)) ||
+                   preco != 2 || indiceVariavelBiblioteca(biblioteca, num_linhas + 1, "z") != -1 ||
+                   avaliarFormulaBiblioteca(biblioteca, num_linhas + 1, valores) != 10.0f ||
+                   !isnan(avaliarFormulaBiblioteca(biblioteca, (size_t)formulas, valores)));
+    }
+    fecharBibliotecaExpressoes(biblioteca);
+    printf("Biblioteca com %ld formulas (%ld invalidas): %s\n", formulas, invalidas, falhas == 0 ? "OK" : "FALHA");
+
+    // Entradas forjadas com a soma de verificação correta: registro que dá a volta
+    // no uint64, que começa dentro do índice ou que passa do fim do arquivo
+    unsigned char *original = NULL;
+    long tamanho = -1;
+    arquivo = fopen(caminho, "rb");
+    if (arquivo != NULL && fseek(arquivo, 0, SEEK_END) == 0 && (tamanho = ftell(arquivo)) > 0) {
+        original = (unsigned char *)malloc((size_t)tamanho);
+        rewind(arquivo);
+        if (original != NULL && fread(original, 1, (size_t)tamanho, arquivo) != (size_t)tamanho) {
+            free(original);
+            original = NULL;
+        }
+    }
+    if (arquivo != NULL) {
+        fclose(arquivo);
+    }
+    int forjadas = 0;
+    if (original != NULL) {
+        forjadas += recusa_biblioteca_forjada(caminho, original, (size_t)tamanho, 0xFFFFFFFFFFFFFFF0ull, 8);
+        forjadas += recusa_biblioteca_forjada(caminho, original, (size_t)tamanho, 0ull - (1ull << 25), 1u << 23);
+        forjadas += recusa_biblioteca_forjada(caminho, original, (size_t)tamanho, 64, 1);
+        forjadas += recusa_biblioteca_forjada(caminho, original, (size_t)tamanho,
+                                              ((unsigned long long)tamanho - 16) & ~15ull, 8);
+        // O original regravado pelo mesmo caminho continua aceito
+        FILE *copia = fopen(caminho, "wb");
+        if (copia != NULL) {
+            fwrite(original, 1, (size_t)tamanho, copia);
+            fclose(copia);
+        }
+        biblioteca = abrirBibliotecaExpressoes(caminho);
+        forjadas += (biblioteca != NULL);
+        fecharBibliotecaExpressoes(biblioteca);
+    }
+    free(original);
+    printf("Biblioteca com entradas forjadas: %s\n", forjadas == 5 ? "OK" : "FALHA");
+
+    // Um byte trocado no meio e o arquivo truncado: a abertura recusa os dois
+    int recusou = 0;
+    arquivo = fopen(caminho, "r+b");
+    if (arquivo != NULL && fseek(arquivo, -12, SEEK_END) == 0) {
+        int c = fgetc(arquivo);
+        fseek(arquivo, -12, SEEK_END);
+        fputc(c ^ 0x10, arquivo);
+        fclose(arquivo);
+        biblioteca = abrirBibliotecaExpressoes(caminho);
+        recusou += (biblioteca == NULL);
+        fecharBibliotecaExpressoes(biblioteca);
+    } else if (arquivo != NULL) {
+        fclose(arquivo);
+    }
+    arquivo = fopen(caminho, "wb");
+    if (arquivo != NULL) {
+        fwrite("EXPRBIB", 1, 8, arquivo);
+        fclose(arquivo);
+        biblioteca = abrirBibliotecaExpressoes(caminho);
+        recusou += (biblioteca == NULL);
+        fecharBibliotecaExpressoes(biblioteca);
+    }
+    printf("Biblioteca corrompida e truncada: %s\n", recusou == 2 ? "OK" : "FALHA");
+    remove(entrada);
+    remove(caminho);
+}
+
+// preencherExpressao contra getValorPosFixaComErro e getFormaInFixaComErro, em lote,
+// com forma infixa maior que inFixa, sem '\0' em posFixa e sem alocações
+void executar_teste_expressao_completa(CasoTeste *testes, size_t num_testes) {
+    const char *extras[] = {"1 0 / +", "2 0 % raiz", "-4 raiz 1 1", "", "3 x +", "16777217 1 + 16777217 -"};
+    size_t num_extras = sizeof(extras) / sizeof(extras[0]);
+    size_t total = num_testes + num_extras;
+    Expressao *expressoes = (Expressao *)calloc(total, sizeof(Expressao));
+    ErroExpressao *erros = (ErroExpressao *)malloc(total * sizeof(ErroExpressao));
+    if (expressoes == NULL || erros == NULL) {
+        printf("Expressao completa: ERRO (memoria)\n");
+        free(expressoes);
+        free(erros);
+        return;
+    }
+    for (size_t i = 0; i < total; i++) {
+        strcpy(expressoes[i].posFixa, i < num_testes ? testes[i].posFixa : extras[i - num_testes]);
+    }
+
+    MetricasExpressao antes, depois;
+    obterMetricasExpressao(&antes);
+    size_t completos = preencherExpressoes(expressoes, total, erros);
+    obterMetricasExpressao(&depois);
+
+    int falhas = 0;
+    size_t esperados = 0;
+    for (size_t i = 0; i < total; i++) {
+        ErroExpressao erro_valor, erro_infixa;
+        float valor = getValorPosFixaComErro(expressoes[i].posFixa, &erro_valor);
+        char *infixa = getFormaInFixaComErro(expressoes[i].posFixa, &erro_infixa);
+        esperados += (erro_valor.codigo == ERRO_NENHUM);
+        if (!mesmo_float(valor, expressoes[i].Valor) || erro_valor.codigo != erros[i].codigo ||
+            erro_valor.posicao != erros[i].posicao || strcmp(infixa != NULL ? infixa : "", expressoes[i].inFixa) != 0) {
+            printf("\"%s\": FALHA (%.9g, \"%s\", %s)\n", expressoes[i].posFixa, expressoes[i].Valor,
+                   expressoes[i].inFixa, nomeCodigoErro(erros[i].codigo));
+            falhas++;
+        }
+        free(infixa);
+    }
+    printf("Expressoes completas em lote: %s (%zu de %zu sem erro, %d falhas)\n",
+           (falhas == 0 && completos == esperados) ? "OK" : "FALHA", completos, total, falhas);
+    printf("Sem alocacoes: %s\n", (!instrumentacaoAtiva() || depois.alocacoes == antes.alocacoes) ? "OK" : "FALHA");
+
+    // "1 sen sen ... sen" cabe em posFixa, mas a forma infixa não cabe em inFixa
+    Expressao longa;
+    ErroExpressao erro;
+    strcpy(longa.posFixa, "1");
+    while (strlen(longa.posFixa) + 4 < sizeof(longa.posFixa)) {
+        strcat(longa.posFixa, " sen");
+    }
+    int preenchida = preencherExpressao(&longa, &erro);
+    int ok = !preenchida && longa.inFixa[0] == '\0' && erro.codigo == ERRO_NENHUM &&
+             mesmo_float(longa.Valor, getValorPosFixaComErro(longa.posFixa, &erro));
+
+    // posFixa sem '\0': inválida, sem ler além do registro
+    memset(longa.posFixa, '1', sizeof(longa.posFixa));
+    ok = ok && !preencherExpressao(&longa, &erro) && isnan(longa.Valor) && erro.codigo == ERRO_TOKEN_INVALIDO;
+    printf("Forma infixa maior que inFixa e posFixa sem terminador: %s\n", ok ? "OK" : "FALHA");
+    free(expressoes);
+    free(erros);
+}
+
+// Avaliação paralela contra a sequencial (valor bit a bit, código e posição do erro)
+int paralela_confere(PoolTrabalho *pool, const char *posFixa, int limiar) {
+    ErroExpressao esperado, obtido;
+    float v = getValorPosFixaComErro(posFixa, &esperado);
+    float p = getValorPosFixaParalelo(pool, posFixa, limiar, &obtido);
+    return mesmo_float(v, p) && esperado.codigo == obtido.codigo && esperado.posicao == obtido.posicao;
+}
+
+// Casos de teste e expressões sorteadas com 60000 operandos (sem erro, só inteiros, com
+// erro de cálculo no meio ou no fim, token inválido e operando restante), em vários limiares
+void executar_teste_paralelo(CasoTeste *testes, size_t num_testes) {
+    enum { NUM_OPERANDOS = 60000 };
+    static const char *reais[] = {"3", "-7", "2.5", "9", "1e3", "-4", "0.125", "6"};
+    static const char *inteiros[] = {"3", "-7", "123456789", "9", "1000000", "-4", "16777217", "6"};
+    static const char *operadores[] = {"+", "-", "*", "+", "-", "sen", "cos"};
+    printf("\n--- Teste Avaliacao Paralela ---\n");
+    PoolTrabalho *pool = criarPoolTrabalho(4);
+    char *texto = (char *)malloc(NUM_OPERANDOS * 12 + 16);
+    if (pool == NULL || texto == NULL) {
+        printf("Paralela: ERRO (memoria)\n");
+        destruirPoolTrabalho(pool);
+        free(texto);
+        return;
+    }
+
+    int falhas = 0;
+    for (size_t i = 0; i < num_testes; i++) {
+        falhas += !paralela_confere(pool, testes[i].posFixa, 1);
+    }
+    printf("Casos de teste (limiar 1): %s (%d falhas)\n", falhas == 0 ? "OK" : "FALHA", falhas);
+
+    unsigned int estado = 2024u;
+    falhas = 0;
+    for (int variante = 0; variante < 6; variante++) {
+        const char **operandos = (variante == 1) ? inteiros : reais;
+        int num_operadores = (variante == 1) ? 2 : 7; // Inteiros só com + e -: exatos em int64
+        size_t usado = 0;
+        int altura = 0;
+        int restantes = NUM_OPERANDOS;
+        while (restantes > 0 || altura > 1) {
+            estado ^= estado << 13; estado ^= estado >> 17; estado ^= estado << 5;
+            if (restantes > 0 && (altura < 2 || estado % 2 == 0)) {
+                // Erro dentro de uma subárvore: de cálculo no meio ou perto do fim, token inválido
+                static const char *com_erro[] = {"0 log", "5 0 /", "x"};
+                const char *operando = operandos[(estado >> 8) % 8];
+                if (variante >= 2 && variante <= 4 && restantes == ((variante == 3) ? 100 : NUM_OPERANDOS / 2)) {
+                    operando = com_erro[variante - 2];
+                }
+                usado += sprintf(texto + usado, "%s ", operando);
+                restantes--;
+                altura++;
+            } else {
+                const char *operador = operadores[(estado >> 8) % num_operadores];
+                usado += sprintf(texto + usado, "%s ", operador);
+                altura -= (operador[0] != 's' && operador[0] != 'c');
+            }
+        }
+        if (variante == 5) {
+            usado += sprintf(texto + usado, "5"); // Operando restante no fim
+        }
+        texto[usado] = '\0';
+        int limiares[] = {16, 1000, 0};
+        for (int l = 0; l < 3; l++) {
+            if (!paralela_confere(pool, texto, limiares[l])) {
+                printf("  Variante %d, limiar %d: FALHA\n", variante, limiares[l]);
+                falhas++;
+            }
+        }
+    }
+    destruirPoolTrabalho(pool);
+
+    // Um trabalhador só ou sem pool: caminho sequencial
+    pool = criarPoolTrabalho(1);
+    falhas += pool == NULL || !paralela_confere(pool, texto, 16) || !paralela_confere(NULL, texto, 16);
+    destruirPoolTrabalho(pool);
+    printf("Expressoes sorteadas com %d operandos: %s (%d falhas)\n", NUM_OPERANDOS, falhas == 0 ? "OK" : "FALHA",
+           falhas);
+    free(texto);
+}
+
+// Conta as instruções de um programa com o opcode 'op'
+int contar_opcode(const ProgramaPosFixa *programa, Opcode op) {
+    int n = 0;
+    for (int i = 0; i < programa->num_instrucoes; i++) {
+        n += OPCODE_DE(programa->instrucoes[i]) == op;
+    }
+    return n;
+}
+
+// Compila 'posFixa', otimiza com 'opcoes' e confere o tamanho do resultado, a ausência
+// do opcode 'removido' (NUM_OPCODES = nenhum), os temporários e o valor em x = 3, y = 5
+int otimizacao_confere(const char *posFixa, int opcoes, int instrucoes, Opcode removido, int temporarios) {
+    ProgramaPosFixa original, otimizado;
+    if (!compilarPosFixa(posFixa, &original) || !compilarPosFixa(posFixa, &otimizado)) {
+        return 0;
+    }
+    float valores[2] = {3.0f, 5.0f};
+    int ok = otimizarPrograma(&otimizado, opcoes) && otimizado.num_instrucoes == instrucoes &&
+             (removido == NUM_OPCODES || contar_opcode(&otimizado, removido) == 0) &&
+             otimizado.num_temporarios == temporarios;
+    float a = avaliarProgramaComVariaveis(&original, valores);
+    float b = avaliarProgramaComVariaveis(&otimizado, valores);
+    ok = ok && ((opcoes & OTIMIZAR_INEXATO) ? fabsf(a - b) <= 1e-5f * fabsf(a) : mesmo_float(a, b));
+    if (!ok) {
+        printf("\"%s\": FALHA (%d instrucoes, %d temporarios)\n", posFixa, otimizado.num_instrucoes,
+               otimizado.num_temporarios);
+    }
+    liberarPrograma(&original);
+    liberarPrograma(&otimizado);
+    return ok;
+}
+
+// Programa otimizado (OTIMIZAR_PADRAO) contra o original: mesmo valor bit a bit pelo
+// interpretador, pelo lote e, sem temporários, pelo JIT, nos dois modos
+int otimizado_identico(const char *posFixa, const float *valores_x, size_t num_valores) {
+    int ok = 1;
+    for (int modo = CALCULO_EXATO; ok && modo <= CALCULO_RAPIDO; modo++) {
+        ProgramaPosFixa original, otimizado;
+        if (!compilarPosFixa(posFixa, &original)) {
+            return 1; // Inválidas já são rejeitadas na compilação
+        }
+        compilarPosFixa(posFixa, &otimizado);
+        original.modo = otimizado.modo = (ModoCalculo)modo;
+        ok = otimizarPrograma(&otimizado, OTIMIZAR_PADRAO | OTIMIZAR_CONFERIR);
+        int nativo = ativarJit(&otimizado);
+        ok = ok && nativo == (jitDisponivel() && otimizado.num_temporarios == 0 &&
+                              otimizado.profundidade_maxima <= 14);
+
+        // x, y e z nas colunas (y e z derivados de x), com as mesmas linhas uma a uma
+        enum { MAX_LINHAS = 64 };
+        float colunas_dados[3][MAX_LINHAS], saida_original[MAX_LINHAS], saida_otimizado[MAX_LINHAS];
+        const float *colunas[3];
+        size_t linhas = (num_valores < MAX_LINHAS) ? num_valores : MAX_LINHAS;
+        for (size_t i = 0; i < linhas; i++) {
+            colunas_dados[0][i] = valores_x[i];
+            colunas_dados[1][i] = valores_x[(i * 7 + 3) % num_valores];
+            colunas_dados[2][i] = valores_x[(i * 5 + 1) % num_valores];
+        }
+        const char *nomes[3] = {"x", "y", "z"};
+        for (int v = 0; v < 3; v++) {
+            int indice = obterIndiceVariavel(&original, nomes[v]);
+            if (indice >= 0) colunas[indice] = colunas_dados[v];
+        }
+        for (size_t i = 0; ok && i < linhas; i++) {
+            float valores[3];
+            for (int v = 0; v < original.num_variaveis; v++) valores[v] = colunas[v][i];
+            ok = mesmo_float(avaliarProgramaComVariaveis(&original, valores),
+                             avaliarProgramaComVariaveis(&otimizado, valores));
+        }
+        ok = ok && avaliarProgramaEmLote(&original, colunas, linhas, saida_original) &&
+             avaliarProgramaEmLote(&otimizado, colunas, linhas, saida_otimizado);
+        for (size_t i = 0; ok && i < linhas; i++) {
+            ok = mesmo_float(saida_original[i], saida_otimizado[i]);
+        }
+        liberarPrograma(&original);
+        liberarPrograma(&otimizado);
+    }
+    return ok;
+}
+
+// Valores de x nos testes de otimização (y e z são tirados da mesma lista)
+const float valores_otimizacao[] = {-50.0f, -1.5f, 0.0f, -0.0f, 0.5f, 2.0f, 3.0f, 45.0f, 90.0f,
+                                    1e30f, -1e-30f, INFINITY, NAN, 7.25f, -3.0f, 100.0f};
+#define NUM_VALORES_OTIMIZACAO (sizeof(valores_otimizacao) / sizeof(valores_otimizacao[0]))
+
+// Casos de teste otimizados contra os originais
+void executar_teste_otimizacao_casos(CasoTeste *testes, size_t num_testes) {
+    printf("\n--- Teste Otimizacao (casos) ---\n");
+    int falhas = 0;
+    for (size_t i = 0; i < num_testes; i++) {
+        if (!otimizado_identico(testes[i].posFixa, valores_otimizacao, NUM_VALORES_OTIMIZACAO)) {
+            printf("\"%s\": FALHA\n", testes[i].posFixa);
+            falhas++;
+        }
+    }
+    printf("Casos de teste otimizados: %s (%d falhas)\n", falhas == 0 ? "OK" : "FALHA", falhas);
+}
+
+// Transformações esperadas, expressões sorteadas com subárvores repetidas, modo inexato
+// e a conferência com o original
+void executar_teste_otimizacao(void) {
+    printf("\n--- Teste Otimizacao ---\n");
+
+    // Dobra, reduções e subexpressões comuns; erros (NAN) não são dobrados
+    int ok = otimizacao_confere("10 log 45 60 + * 2 /", OTIMIZAR_PADRAO, 1, OP_LOGARITMO, 0) &&
+             otimizacao_confere("x 2 ^ 1 +", OTIMIZAR_PADRAO, 5, OP_POTENCIA, 0) &&
+             otimizacao_confere("x y + 2 ^", OTIMIZAR_PADRAO, 6, OP_POTENCIA, 1) &&
+             otimizacao_confere("x 4 /", OTIMIZAR_PADRAO, 3, OP_DIVISAO, 0) &&
+             otimizacao_confere("x 3 /", OTIMIZAR_PADRAO, 3, OP_MULTIPLICACAO, 0) &&
+             otimizacao_confere("x y + raiz y x + raiz * x y + raiz -", OTIMIZAR_PADRAO, 9, NUM_OPCODES, 1) &&
+             otimizacao_confere("x y + raiz y x + raiz *", OTIMIZAR_CONSTANTES, 9, NUM_OPCODES, 0) &&
+             otimizacao_confere("1 0 / x +", OTIMIZAR_PADRAO, 5, NUM_OPCODES, 0) &&
+             otimizacao_confere("0 log 2 3 + +", OTIMIZAR_PADRAO, 4, NUM_OPCODES, 0) &&
+             otimizacao_confere("x 3 ^ y 4 ^ + x 3 / +", OTIMIZAR_PADRAO | OTIMIZAR_INEXATO, 16, OP_DIVISAO, 1);
+    printf("Dobra, reducoes e subexpressoes comuns: %s\n", ok ? "OK" : "FALHA");
+
+    // Expressões sorteadas com peças repetidas: viram subexpressões comuns, às vezes aninhadas
+    static const char *pecas[] = {"x y +", "x 2 ^", "y 3 /", "x raiz", "10 log", "45 60 +", "z 4 /",
+                                  "y x *", "x y * z +", "x 2 ^ y 2 ^ + raiz", "z sen", "2 0.5 ^"};
+    static const char *operadores[] = {"+", "-", "*", "/", "%", "^", "+", "*"};
+    static const char *funcoes[] = {"raiz", "sen", "cos", "tg", "log"};
+    char texto[4096];
+    char repetida[512];
+    unsigned int estado = 777u;
+    int falhas = 0;
+    for (int e = 0; e < 200; e++) {
+        size_t usado = 0;
+        int altura = 0, restantes = 4 + e % 12;
+        repetida[0] = '\0';
+        while (restantes > 0 || altura > 1) {
+            estado ^= estado << 13; estado ^= estado >> 17; estado ^= estado << 5;
+            if (restantes > 0 && (altura < 2 || estado % 3 == 0)) {
+                const char *peca = pecas[(estado >> 8) % 12];
+                // A primeira subárvore composta é repetida algumas vezes, inteira
+                if (repetida[0] != '\0' && (estado >> 4) % 4 == 0) {
+                    peca = repetida;
+                }
+                usado += (size_t)snprintf(texto + usado, sizeof(texto) - usado, "%s ", peca);
+                restantes--;
+                altura++;
+            } else if ((estado >> 8) % 6 == 0) {
+                usado += (size_t)snprintf(texto + usado, sizeof(texto) - usado, "%s ", funcoes[(estado >> 12) % 5]);
+            } else {
+                usado += (size_t)snprintf(texto + usado, sizeof(texto) - usado, "%s ", operadores[(estado >> 12) % 8]);
+                altura--;
+                if (repetida[0] == '\0' && usado < sizeof(repetida)) {
+                    memcpy(repetida, texto, usado - 1);
+                    repetida[usado - 1] = '\0';
+                    // Só vale como operando se for uma subárvore completa
+                    if (altura != 1) repetida[0] = '\0';
+                }
+            }
+        }
+        texto[usado - 1] = '\0';
+        if (!otimizado_identico(texto, valores_otimizacao, NUM_VALORES_OTIMIZACAO)) {
+            printf("\"%s\": FALHA\n", texto);
+            falhas++;
+        }
+    }
+    printf("Expressoes sorteadas (200): %s (%d falhas)\n", falhas == 0 ? "OK" : "FALHA", falhas);
+
+    // Otimizar de novo um programa otimizado (com temporários) e uma cadeia longa (sem recursão)
+    enum { NUM_ELOS = 200000 };
+    char *cadeia = (char *)malloc(NUM_ELOS * 4 + 8);
+    ProgramaPosFixa programa;
+    float x = 2.0f;
+    ok = cadeia != NULL && compilarPosFixa("x y + raiz x y + raiz * x 2 ^ +", &programa);
+    if (ok) {
+        float valores[2] = {3.0f, 5.0f};
+        float antes = avaliarProgramaComVariaveis(&programa, valores);
+        ok = otimizarPrograma(&programa, OTIMIZAR_PADRAO) && otimizarPrograma(&programa, OTIMIZAR_PADRAO) &&
+             programa.num_temporarios == 1 && mesmo_float(avaliarProgramaComVariaveis(&programa, valores), antes);
+        liberarPrograma(&programa);
+    }
+    if (ok) {
+        size_t usado = (size_t)sprintf(cadeia, "x");
+        for (int i = 0; i < NUM_ELOS; i++) usado += (size_t)sprintf(cadeia + usado, " 1 +");
+        ok = compilarPosFixa(cadeia, &programa);
+        float antes = avaliarProgramaComVariaveis(&programa, &x);
+        ok = ok && otimizarPrograma(&programa, OTIMIZAR_PADRAO) && programa.num_constantes == 1 &&
+             mesmo_float(avaliarProgramaComVariaveis(&programa, &x), antes);
+        liberarPrograma(&programa);
+    }
+    free(cadeia);
+    printf("Reotimizacao e cadeia com %d operadores: %s\n", NUM_ELOS, ok ? "OK" : "FALHA");
+
+    // Conferência: com o modo inexato, o cancelamento amplia a diferença e o programa é mantido
+    ok = compilarPosFixa("x 3 / x 0.333333343 * - 1e8 *", &programa);
+    int instrucoes = programa.num_instrucoes;
+    ok = ok && !otimizarPrograma(&programa, OTIMIZAR_PADRAO | OTIMIZAR_INEXATO | OTIMIZAR_CONFERIR) &&
+         programa.num_instrucoes == instrucoes && contar_opcode(&programa, OP_DIVISAO) == 1 &&
+         otimizarPrograma(&programa, OTIMIZAR_PADRAO | OTIMIZAR_CONFERIR);
+    liberarPrograma(&programa);
+    printf("Conferencia com o original: %s\n", ok ? "OK" : "FALHA");
+}
+
+// Erro das funções aproximadas contra as exatas e lote (SIMD) contra avaliação escalar
+void executar_teste_funcoes_rapidas(void) {
+    const char *expressoes[] = {"x sen", "x cos", "x tg", "x log"};
+    const float limites[] = {2e-7f, 2e-7f, 4e-7f, 3e-7f}; // Erros documentados + arredondamento do exato
+    enum { N = 2011 };
+    static float x[N], lote[N];
+    for (int i = 0; i < N - 5; i++) {
+        x[i] = -1000.0f + i * 0.9973f;
+    }
+    x[N - 5] = 123456789.0f;
+    x[N - 4] = -3e30f;
+    x[N - 3] = INFINITY;
+    x[N - 2] = NAN;
+    x[N - 1] = 1e-40f; // Subnormal
+
+    printf("\n--- Teste Funcoes Rapidas ---\n");
+    for (int e = 0; e < 4; e++) {
+        ProgramaPosFixa exato, rapido;
+        if (!compilarPosFixa(expressoes[e], &exato) || !compilarPosFixa(expressoes[e], &rapido)) {
+            printf("%s: ERRO (compilacao)\n", expressoes[e]);
+            continue;
+        }
+        rapido.modo = CALCULO_RAPIDO;
+        const float *colunas[1] = {x};
+        int ok = avaliarProgramaEmLote(&rapido, colunas, N, lote);
+        float erro_maximo = 0.0f;
+        for (int i = 0; ok && i < N; i++) {
+            float r = avaliarProgramaComVariaveis(&rapido, &x[i]);
+            float v = avaliarProgramaComVariaveis(&exato, &x[i]);
+            // Lote e escalar fazem as mesmas operações na mesma ordem
+            ok = r == lote[i] || (isnan(r) && isnan(lote[i])) || fabsf(r - lote[i]) <= 1e-6f * fmaxf(1.0f, fabsf(r));
+            if (ok && !isnan(v) && fabsf(v) < 1e4f && fabsf(x[i]) < 1e6f) {
+                float erro = fabsf(r - v) / fmaxf(1.0f, (e >= 2) ? fabsf(v) : 1.0f);
+                erro_maximo = fmaxf(erro_maximo, erro);
+            }
+            ok = ok && (isnan(r) == isnan(v) || fabsf(v) >= 1e4f);
+        }
+        ok = ok && erro_maximo <= limites[e];
+        printf("%s: %s (erro maximo %.3g)\n", expressoes[e], ok ? "OK" : "FALHA", erro_maximo);
+        liberarPrograma(&exato);
+        liberarPrograma(&rapido);
+    }
+}
+
+// Tarefa do pool: avalia "1 2 +" em uma thread de trabalho
+void tarefa_teste_metricas(void *contexto, size_t indice, int trabalhador) {
+    (void)contexto;
+    (void)indice;
+    (void)trabalhador;
+    getValorPosFixa("1 2 +");
+}
+
+// Confere os contadores da instrumentação (ou que tudo é zero quando desligada)
+void executar_teste_instrumentacao(void) {
+    MetricasExpressao antes, depois, final;
+    char profunda[1024];
+    size_t usado = 0;
+    for (int i = 0; i < 100; i++) {
+        usado += sprintf(profunda + usado, "1 ");
+    }
+    for (int i = 0; i < 99; i++) {
+        usado += sprintf(profunda + usado, "+ ");
+    }
+
+    printf("\n--- Teste Instrumentacao (%s) ---\n", instrumentacaoAtiva() ? "ligada" : "desligada");
+    obterMetricasExpressao(&antes);
+    getValorPosFixa("3 4 + 5 * raiz");
+    getValorPosFixa(profunda);
+    free(getFormaInFixa("3 4 + 5 *"));
+    obterMetricasExpressao(&depois);
+
+    PoolTrabalho *pool = criarPoolTrabalho(4);
+    if (pool != NULL) {
+        executarNoPool(pool, 1000, tarefa_teste_metricas, NULL);
+        destruirPoolTrabalho(pool);
+    }
+    obterMetricasExpressao(&final);
+
+    int ok;
+    if (instrumentacaoAtiva()) {
+        unsigned long long faixas = 0;
+        for (int i = 0; i < NUM_FAIXAS_LATENCIA; i++) {
+            faixas += depois.latencia[MEDIDA_VALOR_POSFIXA][i] - antes.latencia[MEDIDA_VALOR_POSFIXA][i];
+        }
+        ok = depois.tokens[OP_CONSTANTE] - antes.tokens[OP_CONSTANTE] == 103 &&
+             depois.tokens[OP_SOMA] - antes.tokens[OP_SOMA] == 100 &&
+             depois.tokens[OP_MULTIPLICACAO] - antes.tokens[OP_MULTIPLICACAO] == 1 &&
+             depois.tokens[OP_RAIZ] - antes.tokens[OP_RAIZ] == 1 &&
+             depois.chamadas[MEDIDA_VALOR_POSFIXA] - antes.chamadas[MEDIDA_VALOR_POSFIXA] == 2 &&
+             depois.chamadas[MEDIDA_FORMA_INFIXA] - antes.chamadas[MEDIDA_FORMA_INFIXA] == 1 &&
+             faixas == 2 && depois.altura_maxima_pilha >= 100 &&
+             depois.alocacoes - antes.alocacoes >= 6;
+        printf("Contadores da thread principal: %s\n", ok ? "OK" : "FALHA");
+        ok = (pool == NULL) || final.tokens[OP_SOMA] - depois.tokens[OP_SOMA] == 1000;
+        printf("Soma das threads do pool: %s\n", ok ? "OK" : "FALHA");
+    } else {
+        ok = final.tokens[OP_CONSTANTE] == 0 && final.chamadas[MEDIDA_VALOR_POSFIXA] == 0 &&
+             final.alocacoes == 0 && final.altura_maxima_pilha == 0;
+        printf("Metricas zeradas: %s\n", ok ? "OK" : "FALHA");
+    }
+
+    char texto[4096] = "";
+    FILE *arquivo = tmpfile();
+    ok = arquivo != NULL && escreverMetricasExpressao(arquivo, METRICAS_JSON);
+    if (ok) {
+        rewind(arquivo);
+        size_t lidos = fread(texto, 1, sizeof(texto) - 1, arquivo);
+        texto[lidos] = '\0';
+        ok = texto[0] == '{' && strstr(texto, "\"getFormaInFixa\"") != NULL &&
+             strstr(texto, instrumentacaoAtiva() ? "\"instrumentacao\": true" : "\"instrumentacao\": false") != NULL;
+    }
+    if (arquivo != NULL) {
+        fclose(arquivo);
+    }
+    printf("Metricas em JSON: %s\n", ok ? "OK" : "FALHA");
+}
+
 int main() {
     // Casos de teste obrigatórios do PDF
     // Nota sobre a infixa esperada: O PDF fornece a infixa com parênteses e espaços.
@@ -57,21 +1475,21 @@ int main() {
         // Teste 1: 3 4 + 5 * -> (3 + 4) * 5 -> 35
         {"3 4 + 5 *", "(3+4)*5", 35.0, 0.0001},
         // Teste 2: 7 2 * 4 + -> 7 * 2 + 4 -> 18
-        {"7 2 * 4 +", "(7*2)+4", 18.0, 0.0001},
+        {"7 2 * 4 +", "7*2+4", 18.0, 0.0001},
         // Teste 3: 8 5 2 4 + * + -> 8 + (5 * (2 + 4)) -> 38
-        {"8 5 2 4 + * +", "8+(5*(2+4))", 38.0, 0.0001},
+        {"8 5 2 4 + * +", "8+5*(2+4)", 38.0, 0.0001},
         // Teste 4: 6 2 / 3 + 4 * -> (6 / 2 + 3) * 4 -> 24
-        {"6 2 / 3 + 4 *", "((6/2)+3)*4", 24.0, 0.0001},
+        {"6 2 / 3 + 4 *", "(6/2+3)*4", 24.0, 0.0001},
         // Teste 5: 9 5 2 8 * 4 + * + -> 9 + (5 * (4 + 8 * 2)) -> 109
-        {"9 5 2 8 * 4 + * +", "9+(5*((2*8)+4))", 109.0, 0.0001}, // Corrigido: 8*2 -> 2*8 na posfixa
+        {"9 5 2 8 * 4 + * +", "9+5*(2*8+4)", 109.0, 0.0001}, // Corrigido: 8*2 -> 2*8 na posfixa
         // Teste 6: 2 3 + log 5 / -> log(2 + 3) / 5 -> Aprox. 0.14
-        {"2 3 + log 5 /", "log((2+3))/5", 0.139794, 0.0001}, // log10(5)/5
+        {"2 3 + log 5 /", "log(2+3)/5", 0.139794, 0.0001}, // log10(5)/5
         // Teste 7: 10 log 3 ^ 2 + -> (log10)^3 + 2 -> 3
-        {"10 log 3 ^ 2 +", "(log(10)^3)+2", 3.0, 0.0001}, // (1^3) + 2 = 3
+        {"10 log 3 ^ 2 +", "log(10)^3+2", 3.0, 0.0001}, // (1^3) + 2 = 3
         // Teste 8: 45 60 + 30 cos * -> (45 + 60) * cos(30) -> Aprox. 90,93
         {"45 60 + 30 cos *", "(45+60)*cos(30)", 90.9326, 0.0001}, // 105 * cos(30)
         // Teste 9: 0.5 45 sen 2 ^ + -> sen(45) ^2 + 0,5 -> 1
-        {"0.5 45 sen 2 ^ +", "0.5+(sen(45)^2)", 1.0, 0.0001} // 0.5 + (sqrt(2)/2)^2 = 0.5 + 0.5 = 1
+        {"0.5 45 sen 2 ^ +", "0.5+sen(45)^2", 1.0, 0.0001} // 0.5 + (sqrt(2)/2)^2 = 0.5 + 0.5 = 1
     };
 
     // Casos de teste adicionais (robustez e erros)
@@ -95,7 +1513,24 @@ int main() {
         // Teste I: Expressão com ^ (potência)
         {"2 3 ^", "2^3", 8.0, 0.0001},
         // Teste J: Expressão complexa com funções e binários
-        {"1 2 + 3 * 4 5 - / sen", "sen((((1+2)*3)/(4-5)))", -0.1564344615, 0.0001} // sen(9/-1) = sen(-9) graus
+        {"1 2 + 3 * 4 5 - / sen", "sen((1+2)*3/(4-5))", -0.1564344615, 0.0001}, // sen(9/-1) = sen(-9) graus
+        // Teste K: Associatividade à esquerda de - e à direita de ^
+        {"1 2 3 - -", "1-(2-3)", 2.0, 0.0001},
+        {"1 2 - 3 -", "1-2-3", -4.0, 0.0001},
+        {"2 3 ^ 2 ^", "(2^3)^2", 64.0, 0.0001},
+        {"2 3 2 ^ ^", "2^3^2", 512.0, 0.0001},
+        {"6 2 3 * /", "6/(2*3)", 1.0, 0.0001},
+        // Teste L: Números negativos como operandos
+        {"3 -4 -", "3-(-4)", 7.0, 0.0001},
+        {"-4 2 ^", "(-4)^2", 16.0, 0.0001},
+        {"1 -4 3 * -", "1-(-4*3)", 13.0, 0.0001},
+        {"1 -4 3 * 2 * +", "1+(-4*3*2)", -23.0, 0.0001},
+        {"-4 3 * 1 -", "-4*3-1", -13.0, 0.0001},
+        {"2 -4 3 ^ *", "2*(-4)^3", -128.0, 0.0001},
+        // Teste M: Tabulações e quebras de linha como separadores, literais com expoente
+        {"2.5e1\t4\n/", "2.5e1/4", 6.25, 0.0001},
+        {" 1e-1  5. + ", "1e-1+5.", 5.1, 0.0001},
+        {"0x10 1 +", "0x10+1", NAN, 0.0001} // Hexadecimal não é literal válido
     };
 
     printf("==================================================================\n");
@@ -112,5 +1547,132 @@ int main() {
         executar_teste(i + 10, testes_adicionais[i]);
     }
 
+    executar_teste_expressao_longa();
+    executar_teste_programa_grande();
+    executar_teste_erros();
+    executar_teste_instrumentacao();
+
+    printf("\n==================================================================\n");
+    printf("        TESTES DO PROGRAMA COMPILADO (compilar uma vez)           \n");
+    printf("==================================================================\n");
+    for (size_t i = 0; i < sizeof(testes_obrigatorios) / sizeof(CasoTeste); i++) {
+        executar_teste_programa(i + 1, testes_obrigatorios[i]);
+    }
+    for (size_t i = 0; i < sizeof(testes_adicionais) / sizeof(CasoTeste); i++) {
+        executar_teste_programa(i + 10, testes_adicionais[i]);
+    }
+
+    printf("\n==================================================================\n");
+    printf("              TESTES DE CONVERSAO INFIXA -> POS-FIXA              \n");
+    printf("==================================================================\n");
+    // As infixas esperadas dos casos válidos devem voltar exatamente à pós-fixa original
+    int id_infixa = 1;
+    for (size_t i = 0; i < sizeof(testes_obrigatorios) / sizeof(CasoTeste); i++) {
+        executar_teste_infixa(id_infixa++, testes_obrigatorios[i].infixa_esperada,
+                              testes_obrigatorios[i].posFixa, testes_obrigatorios[i].valor_esperado);
+    }
+    executar_teste_infixa(id_infixa++, "3*(12+4)", "3 12 4 + *", 48.0);
+    executar_teste_infixa(id_infixa++, "-4^2", "4 2 ^ -1 *", -16.0);
+    executar_teste_infixa(id_infixa++, "2^-1", "2 -1 ^", 0.5);
+    executar_teste_infixa(id_infixa++, " -( 2 + 3 ) * raiz ( 16 ) ", "2 3 + -1 * 16 raiz *", -20.0);
+    executar_teste_infixa(id_infixa++, "(1+2", NULL, NAN);
+    executar_teste_infixa(id_infixa++, "1+", NULL, NAN);
+    executar_teste_infixa(id_infixa++, "log 3", NULL, NAN);
+    executar_teste_infixa(id_infixa++, "2 3", NULL, NAN);
+
+    printf("\n==================================================================\n");
+    printf("           TESTES DE VARIAVEIS E AVALIACAO EM LOTE                \n");
+    printf("==================================================================\n");
+    {
+        // x=3, y=4: (3+4)*2 = 14
+        ProgramaPosFixa programa;
+        float valores[2] = {3.0f, 4.0f};
+        if (compilarPosFixa("x y + 2 *", &programa)) {
+            float v = avaliarProgramaComVariaveis(&programa, valores);
+            printf("\nVariaveis x=3 y=4 em \"x y + 2 *\": %s (%.2f)\n",
+                   fabs(v - 14.0f) < 0.0001 ? "OK" : "FALHA", v);
+            liberarPrograma(&programa);
+        }
+    }
+    const char *expressoes_lote[] = {
+        "x y + 2 *",
+        "x y / x y - *",
+        "x y % x 3 ^ +",
+        "x raiz y log + x sen x cos * + x tg -",
+        "x raiz",
+        "1e30 x * 1e30 * 0 *" // inf * 0 nas linhas com x != 0
+    };
+    for (size_t i = 0; i < sizeof(expressoes_lote) / sizeof(expressoes_lote[0]); i++) {
+        executar_teste_lote(i + 1, expressoes_lote[i]);
+    }
+
+    printf("\n==================================================================\n");
+    printf("              TESTES DE PROCESSAMENTO DE ARQUIVOS                 \n");
+    printf("==================================================================\n");
+    executar_teste_arquivo(testes_obrigatorios, sizeof(testes_obrigatorios) / sizeof(CasoTeste));
+
+    printf("\n==================================================================\n");
+    printf("                      TESTES DE CACHE                             \n");
+    printf("==================================================================\n");
+    executar_teste_cache(testes_obrigatorios, sizeof(testes_obrigatorios) / sizeof(CasoTeste));
+    executar_teste_cache(testes_adicionais, sizeof(testes_adicionais) / sizeof(CasoTeste));
+
+    printf("\n==================================================================\n");
+    printf("       TESTES DE PRECISAO (float, double, long double)            \n");
+    printf("==================================================================\n");
+    executar_teste_precisao(testes_obrigatorios, sizeof(testes_obrigatorios) / sizeof(CasoTeste));
+    executar_teste_precisao(testes_adicionais, sizeof(testes_adicionais) / sizeof(CasoTeste));
+    executar_teste_precisao_tipos();
+    executar_teste_inteiros();
+
+    printf("\n==================================================================\n");
+    printf("             TESTES DO MODO RAPIDO (funcoes aproximadas)          \n");
+    printf("==================================================================\n");
+    executar_teste_modo_rapido(testes_obrigatorios, sizeof(testes_obrigatorios) / sizeof(CasoTeste));
+    executar_teste_modo_rapido(testes_adicionais, sizeof(testes_adicionais) / sizeof(CasoTeste));
+    executar_teste_funcoes_rapidas();
+
+    printf("\n==================================================================\n");
+    printf("                TESTES DO JIT (codigo nativo x86-64)              \n");
+    printf("==================================================================\n");
+    executar_teste_jit(testes_obrigatorios, sizeof(testes_obrigatorios) / sizeof(CasoTeste));
+    executar_teste_jit(testes_adicionais, sizeof(testes_adicionais) / sizeof(CasoTeste));
+    executar_teste_jit_variaveis();
+
+    printf("\n==================================================================\n");
+    printf("                  TESTES DE AVALIACAO INCREMENTAL                 \n");
+    printf("==================================================================\n");
+    executar_teste_incremental();
+
+    printf("\n==================================================================\n");
+    printf("                    TESTES DE AVALIACAO EM FLUXO                  \n");
+    printf("==================================================================\n");
+    executar_teste_fluxo_casos(testes_obrigatorios, sizeof(testes_obrigatorios) / sizeof(CasoTeste));
+    executar_teste_fluxo_casos(testes_adicionais, sizeof(testes_adicionais) / sizeof(CasoTeste));
+    executar_teste_fluxo();
+
+    printf("\n==================================================================\n");
+    printf("                 TESTES DA BIBLIOTECA BINARIA (mmap)              \n");
+    printf("==================================================================\n");
+    executar_teste_biblioteca(testes_adicionais, sizeof(testes_adicionais) / sizeof(CasoTeste));
+
+    printf("\n==================================================================\n");
+    printf("            TESTES DA EXPRESSAO COMPLETA (uma passada)            \n");
+    printf("==================================================================\n");
+    executar_teste_expressao_completa(testes_obrigatorios, sizeof(testes_obrigatorios) / sizeof(CasoTeste));
+    executar_teste_expressao_completa(testes_adicionais, sizeof(testes_adicionais) / sizeof(CasoTeste));
+
+    printf("\n==================================================================\n");
+    printf("            TESTES DA AVALIACAO PARALELA (fork-join)              \n");
+    printf("==================================================================\n");
+    executar_teste_paralelo(testes_adicionais, sizeof(testes_adicionais) / sizeof(CasoTeste));
+
+    printf("\n==================================================================\n");
+    printf("      TESTES DA OTIMIZACAO (constantes, reducoes, subexpressoes)  \n");
+    printf("==================================================================\n");
+    executar_teste_otimizacao_casos(testes_obrigatorios, sizeof(testes_obrigatorios) / sizeof(CasoTeste));
+    executar_teste_otimizacao_casos(testes_adicionais, sizeof(testes_adicionais) / sizeof(CasoTeste));
+    executar_teste_otimizacao();
+
     return 0;
 }
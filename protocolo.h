@@ -0,0 +1,28 @@
+#ifndef PROTOCOLO_H
+#define PROTOCOLO_H
+
+/*
+ * Protocolo binário do servidor de expressões (servidor.c, gerador_carga.c).
+ *
+ * Cada mensagem começa com o comprimento (uint32, little-endian) dos bytes que
+ * vêm depois dele. Várias requisições podem ser enviadas sem esperar as
+ * respostas (pipelining); cada conexão recebe as respostas na ordem das
+ * requisições, com o mesmo id.
+ *
+ * Requisição: comprimento | id (uint32) | tipo (uint8) | expressão pós-fixa (sem '\0')
+ * Resposta:   comprimento | id (uint32) | código (uint8, CodigoErro) | carga
+ *   - PROTOCOLO_VALOR: carga = valor (float IEEE 754, 4 bytes little-endian)
+ *   - PROTOCOLO_INFIXA: carga = texto infixo (vazio em caso de erro)
+ *
+ * Uma requisição com tipo desconhecido ou maior que PROTOCOLO_TAMANHO_MAXIMO
+ * encerra a conexão.
+ */
+
+#define PROTOCOLO_VALOR 1  // getValorPosFixa
+#define PROTOCOLO_INFIXA 2 // getFormaInFixa
+
+#define PROTOCOLO_TAMANHO_COMPRIMENTO 4
+#define PROTOCOLO_TAMANHO_CABECALHO 5       // id + tipo/código, depois do comprimento
+#define PROTOCOLO_TAMANHO_MAXIMO (1u << 20) // Maior comprimento aceito
+
+#endif
@@ -0,0 +1,445 @@
+#define _GNU_SOURCE // accept4
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "expressao.h"
+#include "protocolo.h"
+
+/*
+ * Servidor de avaliação de expressões sobre um socket de domínio Unix.
+ *
+ * Compilação: gcc -O2 expressao.c servidor.c -o servidor.exe -lm -lpthread
+ * Uso: servidor.exe <caminho_socket> [threads]
+ *
+ * Um laço epoll na thread principal aceita as conexões e lê as requisições
+ * (protocolo.h), que podem chegar encadeadas. As requisições completas
+ * recebidas numa mesma volta do laço formam um lote, dividido em tarefas no
+ * pool de trabalho; depois as respostas são gravadas em cada conexão, na ordem
+ * das requisições. As avaliações usam as variantes silenciosas
+ * (getValorPosFixaComErro / getFormaInFixaComErro) e o código do erro segue na
+ * resposta. SIGINT ou SIGTERM encerram o servidor e removem o socket.
+ */
+
+#define MAX_EVENTOS 256
+#define TAMANHO_LEITURA 65536            // Bytes pedidos a cada read
+#define LEITURA_MAXIMA_POR_VOLTA (1 << 20) // Uma conexão não monopoliza a volta do laço
+#define SAIDA_MAXIMA_PENDENTE (8 << 20)  // Acima disso, a conexão para de ser lida
+#define REQUISICOES_POR_TAREFA 32
+
+// Vetor de bytes que cresce geometricamente
+typedef struct {
+    unsigned char *dados;
+    size_t usado;
+    size_t capacidade;
+} BufferBytes;
+
+typedef struct Conexao {
+    int fd;
+    BufferBytes entrada;     // Bytes recebidos ainda não consumidos
+    BufferBytes saida;       // Respostas a enviar
+    size_t enviado;          // Bytes de saida já enviados
+    unsigned int interesse;  // Eventos registrados no epoll
+    int fim_entrada;         // O cliente não envia mais nada (fecha ao esvaziar a saída)
+    int fechar;              // Encerrar ao fim da volta atual
+    struct Conexao *anterior;
+    struct Conexao *proxima;
+} Conexao;
+
+typedef struct {
+    Conexao *conexao;
+    unsigned int id;
+    unsigned char tipo;
+    size_t texto;            // Deslocamento da expressão em LoteRequisicoes.textos
+    CodigoErro codigo;       // Resultado
+    float valor;
+    char *infixa;
+} Requisicao;
+
+// Requisições recebidas numa volta do laço
+typedef struct {
+    Requisicao *itens;
+    size_t num_itens;
+    size_t capacidade;
+    BufferBytes textos;      // Expressões terminadas em '\0'
+} LoteRequisicoes;
+
+volatile sig_atomic_t encerrar = 0;
+
+void tratar_sinal(int sinal) {
+    (void)sinal;
+    encerrar = 1;
+}
+
+// Garante espaço para mais 'extra' bytes; 0 se faltar memória
+int reservar_buffer(BufferBytes *buffer, size_t extra) {
+    if (buffer->usado + extra <= buffer->capacidade) {
+        return 1;
+    }
+    size_t nova_capacidade = buffer->capacidade * 2 + extra + 4096;
+    unsigned char *novos = (unsigned char *)realloc(buffer->dados, nova_capacidade);
+    if (novos == NULL) {
+        return 0;
+    }
+    buffer->dados = novos;
+    buffer->capacidade = nova_capacidade;
+    return 1;
+}
+
+unsigned int ler_u32(const unsigned char *p) {
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+void escrever_u32(unsigned char *p, unsigned int valor) {
+    p[0] = (unsigned char)valor;
+    p[1] = (unsigned char)(valor >> 8);
+    p[2] = (unsigned char)(valor >> 16);
+    p[3] = (unsigned char)(valor >> 24);
+}
+
+// Registra no epoll os eventos que a conexão precisa agora
+void atualizar_interesse(int epoll_fd, Conexao *conexao) {
+    size_t pendente = conexao->saida.usado - conexao->enviado;
+    unsigned int interesse = (pendente > 0 ? EPOLLOUT : 0u) |
+                             (!conexao->fim_entrada && pendente < SAIDA_MAXIMA_PENDENTE ? EPOLLIN : 0u);
+    if (interesse != conexao->interesse) {
+        struct epoll_event evento;
+        evento.events = interesse;
+        evento.data.ptr = conexao;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conexao->fd, &evento);
+        conexao->interesse = interesse;
+    }
+}
+
+// Envia o que for possível sem bloquear
+void enviar_saida(int epoll_fd, Conexao *conexao) {
+    while (conexao->enviado < conexao->saida.usado) {
+        ssize_t n = send(conexao->fd, conexao->saida.dados + conexao->enviado,
+                         conexao->saida.usado - conexao->enviado, MSG_NOSIGNAL);
+        if (n > 0) {
+            conexao->enviado += (size_t)n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                conexao->fechar = 1;
+            }
+            break;
+        }
+    }
+    if (conexao->enviado == conexao->saida.usado) {
+        conexao->enviado = 0;
+        conexao->saida.usado = 0;
+    }
+    if (!conexao->fechar) {
+        atualizar_interesse(epoll_fd, conexao);
+    }
+}
+
+// Separa as requisições completas do buffer de entrada e as acrescenta ao lote
+void extrair_requisicoes(Conexao *conexao, LoteRequisicoes *lote) {
+    size_t p = 0;
+    const unsigned char *dados = conexao->entrada.dados;
+    size_t usado = conexao->entrada.usado;
+
+    while (usado - p >= PROTOCOLO_TAMANHO_COMPRIMENTO) {
+        unsigned int comprimento = ler_u32(dados + p);
+        if (comprimento < PROTOCOLO_TAMANHO_CABECALHO || comprimento > PROTOCOLO_TAMANHO_MAXIMO) {
+            conexao->fechar = 1; // Fora do protocolo
+            return;
+        }
+        if (usado - p - PROTOCOLO_TAMANHO_COMPRIMENTO < comprimento) {
+            break; // Requisição incompleta: espera o resto
+        }
+        const unsigned char *mensagem = dados + p + PROTOCOLO_TAMANHO_COMPRIMENTO;
+        unsigned char tipo = mensagem[4];
+        size_t tamanho_texto = comprimento - PROTOCOLO_TAMANHO_CABECALHO;
+        if (tipo != PROTOCOLO_VALOR && tipo != PROTOCOLO_INFIXA) {
+            conexao->fechar = 1;
+            return;
+        }
+        if (lote->num_itens == lote->capacidade) {
+            size_t nova_capacidade = lote->capacidade * 2 + 256;
+            Requisicao *novos = (Requisicao *)realloc(lote->itens, nova_capacidade * sizeof(Requisicao));
+            if (novos == NULL) {
+                conexao->fechar = 1;
+                return;
+            }
+            lote->itens = novos;
+            lote->capacidade = nova_capacidade;
+        }
+        if (!reservar_buffer(&lote->textos, tamanho_texto + 1)) {
+            conexao->fechar = 1;
+            return;
+        }
+        Requisicao *requisicao = &lote->itens[lote->num_itens++];
+        requisicao->conexao = conexao;
+        requisicao->id = ler_u32(mensagem);
+        requisicao->tipo = tipo;
+        requisicao->texto = lote->textos.usado;
+        requisicao->infixa = NULL;
+        memcpy(lote->textos.dados + lote->textos.usado, mensagem + PROTOCOLO_TAMANHO_CABECALHO, tamanho_texto);
+        lote->textos.usado += tamanho_texto;
+        lote->textos.dados[lote->textos.usado++] = '\0';
+        p += PROTOCOLO_TAMANHO_COMPRIMENTO + comprimento;
+    }
+    memmove(conexao->entrada.dados, dados + p, usado - p);
+    conexao->entrada.usado = usado - p;
+}
+
+// Lê o que houver na conexão (até LEITURA_MAXIMA_POR_VOLTA) e extrai as requisições
+void ler_conexao(Conexao *conexao, LoteRequisicoes *lote) {
+    size_t lidos_na_volta = 0;
+    while (lidos_na_volta < LEITURA_MAXIMA_POR_VOLTA) {
+        if (!reservar_buffer(&conexao->entrada, TAMANHO_LEITURA)) {
+            conexao->fechar = 1;
+            return;
+        }
+        ssize_t n = read(conexao->fd, conexao->entrada.dados + conexao->entrada.usado, TAMANHO_LEITURA);
+        if (n > 0) {
+            conexao->entrada.usado += (size_t)n;
+            lidos_na_volta += (size_t)n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n == 0) {
+            conexao->fim_entrada = 1; // As requisições já recebidas ainda são respondidas
+            break;
+        } else {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                conexao->fechar = 1;
+                return;
+            }
+            break;
+        }
+    }
+    extrair_requisicoes(conexao, lote);
+}
+
+// Tarefa do pool: avalia as requisições [indice * REQUISICOES_POR_TAREFA, ...)
+void avaliar_tarefa_lote(void *contexto, size_t indice, int trabalhador) {
+    (void)trabalhador;
+    LoteRequisicoes *lote = (LoteRequisicoes *)contexto;
+    size_t inicio = indice * REQUISICOES_POR_TAREFA;
+    size_t fim = (inicio + REQUISICOES_POR_TAREFA < lote->num_itens) ? inicio + REQUISICOES_POR_TAREFA : lote->num_itens;
+    for (size_t i = inicio; i < fim; i++) {
+        Requisicao *requisicao = &lote->itens[i];
+        const char *texto = (const char *)lote->textos.dados + requisicao->texto;
+        ErroExpressao erro;
+        if (requisicao->tipo == PROTOCOLO_VALOR) {
+            requisicao->valor = getValorPosFixaComErro(texto, &erro);
+        } else {
+            requisicao->infixa = getFormaInFixaComErro(texto, &erro);
+        }
+        requisicao->codigo = erro.codigo;
+    }
+}
+
+// Grava as respostas do lote nas conexões e tenta enviá-las
+void responder_lote(int epoll_fd, LoteRequisicoes *lote) {
+    for (size_t i = 0; i < lote->num_itens; i++) {
+        Requisicao *requisicao = &lote->itens[i];
+        Conexao *conexao = requisicao->conexao;
+        size_t tamanho_carga = (requisicao->tipo == PROTOCOLO_VALOR) ? sizeof(float)
+                             : (requisicao->infixa != NULL) ? strlen(requisicao->infixa) : 0;
+        size_t total = PROTOCOLO_TAMANHO_COMPRIMENTO + PROTOCOLO_TAMANHO_CABECALHO + tamanho_carga;
+        if (conexao->fechar || !reservar_buffer(&conexao->saida, total)) {
+            conexao->fechar = 1;
+            free(requisicao->infixa);
+            continue;
+        }
+        unsigned char *p = conexao->saida.dados + conexao->saida.usado;
+        escrever_u32(p, (unsigned int)(PROTOCOLO_TAMANHO_CABECALHO + tamanho_carga));
+        escrever_u32(p + 4, requisicao->id);
+        p[8] = (unsigned char)requisicao->codigo;
+        if (requisicao->tipo == PROTOCOLO_VALOR) {
+            unsigned int bits;
+            memcpy(&bits, &requisicao->valor, sizeof(bits));
+            escrever_u32(p + 9, bits);
+        } else if (tamanho_carga > 0) {
+            memcpy(p + 9, requisicao->infixa, tamanho_carga);
+        }
+        conexao->saida.usado += total;
+        free(requisicao->infixa);
+    }
+    for (size_t i = 0; i < lote->num_itens; i++) {
+        Conexao *conexao = lote->itens[i].conexao;
+        if (!conexao->fechar && conexao->enviado < conexao->saida.usado) {
+            enviar_saida(epoll_fd, conexao);
+        }
+    }
+}
+
+void fechar_conexao(Conexao **conexoes, Conexao *conexao) {
+    close(conexao->fd); // Também remove o descritor do epoll
+    if (conexao->anterior != NULL) {
+        conexao->anterior->proxima = conexao->proxima;
+    } else {
+        *conexoes = conexao->proxima;
+    }
+    if (conexao->proxima != NULL) {
+        conexao->proxima->anterior = conexao->anterior;
+    }
+    free(conexao->entrada.dados);
+    free(conexao->saida.dados);
+    free(conexao);
+}
+
+// Aceita todas as conexões pendentes no socket de escuta
+void aceitar_conexoes(int epoll_fd, int escuta, Conexao **conexoes) {
+    for (;;) {
+        int fd = accept4(escuta, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("accept4");
+            }
+            return;
+        }
+        Conexao *conexao = (Conexao *)calloc(1, sizeof(Conexao));
+        if (conexao == NULL) {
+            close(fd);
+            continue;
+        }
+        conexao->fd = fd;
+        conexao->interesse = EPOLLIN;
+        struct epoll_event evento;
+        evento.events = EPOLLIN;
+        evento.data.ptr = conexao;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &evento) != 0) {
+            close(fd);
+            free(conexao);
+            continue;
+        }
+        conexao->proxima = *conexoes;
+        if (*conexoes != NULL) {
+            (*conexoes)->anterior = conexao;
+        }
+        *conexoes = conexao;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Uso: %s <caminho_socket> [threads]\n", argv[0]);
+        return 1;
+    }
+    const char *caminho = argv[1];
+    int num_threads = (argc > 2) ? atoi(argv[2]) : 0;
+
+    struct sockaddr_un endereco;
+    memset(&endereco, 0, sizeof(endereco));
+    endereco.sun_family = AF_UNIX;
+    if (strlen(caminho) >= sizeof(endereco.sun_path)) {
+        fprintf(stderr, "Erro: Caminho do socket muito longo.\n");
+        return 1;
+    }
+    strcpy(endereco.sun_path, caminho);
+
+    // Sem SA_RESTART: o sinal interrompe epoll_wait
+    struct sigaction acao;
+    memset(&acao, 0, sizeof(acao));
+    acao.sa_handler = tratar_sinal;
+    sigaction(SIGINT, &acao, NULL);
+    sigaction(SIGTERM, &acao, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    int escuta = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (escuta < 0) {
+        perror("socket");
+        return 1;
+    }
+    unlink(caminho); // Socket deixado por uma execução anterior
+    if (bind(escuta, (struct sockaddr *)&endereco, sizeof(endereco)) != 0 || listen(escuta, SOMAXCONN) != 0) {
+        perror("bind/listen");
+        close(escuta);
+        return 1;
+    }
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    PoolTrabalho *pool = criarPoolTrabalho(num_threads);
+    struct epoll_event evento;
+    evento.events = EPOLLIN;
+    evento.data.ptr = NULL; // NULL identifica o socket de escuta
+    if (epoll_fd < 0 || pool == NULL || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, escuta, &evento) != 0) {
+        fprintf(stderr, "Erro: Nao foi possivel iniciar o servidor.\n");
+        destruirPoolTrabalho(pool);
+        close(escuta);
+        unlink(caminho);
+        return 1;
+    }
+    printf("Servidor em %s com %d threads de avaliacao.\n", caminho, numeroTrabalhadores(pool));
+    fflush(stdout);
+
+    Conexao *conexoes = NULL;
+    LoteRequisicoes lote;
+    memset(&lote, 0, sizeof(lote));
+    unsigned long long total_requisicoes = 0;
+    unsigned long long total_lotes = 0;
+    struct epoll_event eventos[MAX_EVENTOS];
+
+    while (!encerrar) {
+        int n = epoll_wait(epoll_fd, eventos, MAX_EVENTOS, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            break;
+        }
+
+        // 1) Lê tudo o que chegou nesta volta
+        lote.num_itens = 0;
+        lote.textos.usado = 0;
+        for (int i = 0; i < n; i++) {
+            Conexao *conexao = (Conexao *)eventos[i].data.ptr;
+            if (conexao == NULL) {
+                aceitar_conexoes(epoll_fd, escuta, &conexoes);
+                continue;
+            }
+            if (eventos[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                ler_conexao(conexao, &lote);
+            }
+            if ((eventos[i].events & EPOLLOUT) && !conexao->fechar) {
+                enviar_saida(epoll_fd, conexao);
+            }
+        }
+
+        // 2) Avalia o lote no pool e 3) devolve as respostas
+        if (lote.num_itens > 0) {
+            size_t num_tarefas = (lote.num_itens + REQUISICOES_POR_TAREFA - 1) / REQUISICOES_POR_TAREFA;
+            executarNoPool(pool, num_tarefas, avaliar_tarefa_lote, &lote);
+            responder_lote(epoll_fd, &lote);
+            total_requisicoes += lote.num_itens;
+            total_lotes++;
+        }
+
+        // Só agora as conexões encerradas podem ser liberadas (o lote as referenciava)
+        for (int i = 0; i < n; i++) {
+            Conexao *conexao = (Conexao *)eventos[i].data.ptr;
+            if (conexao != NULL &&
+                (conexao->fechar || (conexao->fim_entrada && conexao->saida.usado == conexao->enviado))) {
+                fechar_conexao(&conexoes, conexao);
+            }
+        }
+    }
+
+    printf("%llu requisicoes em %llu lotes (%.1f por lote).\n", total_requisicoes, total_lotes,
+           total_lotes > 0 ? (double)total_requisicoes / (double)total_lotes : 0.0);
+    while (conexoes != NULL) {
+        fechar_conexao(&conexoes, conexoes);
+    }
+    free(lote.itens);
+    free(lote.textos.dados);
+    destruirPoolTrabalho(pool);
+    close(epoll_fd);
+    close(escuta);
+    unlink(caminho);
+    return 0;
+}